@@ -0,0 +1,861 @@
+#include "CoreDefs.h"
+#include "IGpAudioBuffer.h"
+#include "IGpAudioDriver.h"
+#include "IGpAudioChannel.h"
+#include "IGpAudioChannelCallbacks.h"
+#include "IGpLogDriver.h"
+#include "IGpMutex.h"
+#include "IGpPrefsHandler.h"
+#include "IGpSystemServices.h"
+#include "IGpThreadEvent.h"
+#include "GpAudioDriverProperties.h"
+#include "GpAudioMixKernels.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+// Audio driver that doesn't need an audio device.  Channels are mixed the same way as the SDL driver (mono
+// s16, per-driver volume scale, saturating adds, chunks of kMixChunkSamples) on a mixer thread paced by the
+// wall clock, but all timing inside the driver is done in samples, so the leading silence inserted for
+// buffers posted mid-chunk doesn't depend on scheduler jitter.  The mix is either written to a WAV file or
+// discarded, and the time spent mixing each chunk is logged on shutdown.  Intended for soak testing and
+// benchmarking on machines without audio hardware.
+//
+// With a virtual clock, there is no mixer thread.  The sample clock advances by a fixed number of samples
+// per tick in ServeTicks, which mixes every chunk that has started on the caller's thread, so the mix only
+// depends on what was posted on which tick and two runs of the same input write identical WAVs.
+
+class GpAudioDriver_Null;
+
+class GpAudioBuffer_Null final : public IGpAudioBuffer
+{
+public:
+	typedef int16_t AudioSample_t;
+
+	static GpAudioBuffer_Null *Create(const void *data, size_t size);
+
+	void AddRef() override;
+	void Release() override;
+
+	const AudioSample_t *GetData() const;
+	size_t GetSize() const;
+
+private:
+	GpAudioBuffer_Null(const AudioSample_t *data, size_t size);
+	~GpAudioBuffer_Null();
+
+	const AudioSample_t *m_data;
+	size_t m_size;
+	std::atomic<int> m_count;
+};
+
+GpAudioBuffer_Null *GpAudioBuffer_Null::Create(const void *data, size_t size)
+{
+	size_t baseSize = sizeof(GpAudioBuffer_Null) + GP_SYSTEM_MEMORY_ALIGNMENT + 1;
+	baseSize -= baseSize % GP_SYSTEM_MEMORY_ALIGNMENT;
+	void *storage = malloc(size * sizeof(AudioSample_t) + baseSize);
+	if (!storage)
+		return nullptr;
+
+	AudioSample_t *dataPos = reinterpret_cast<AudioSample_t*>(static_cast<uint8_t*>(storage) + baseSize);
+
+	// Convert from u8 to s16
+	const uint8_t *srcData = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; i++)
+		dataPos[i] = srcData[i] - 0x80;
+
+	return new (storage) GpAudioBuffer_Null(dataPos, size);
+}
+
+void GpAudioBuffer_Null::AddRef()
+{
+	m_count.fetch_add(1);
+}
+
+void GpAudioBuffer_Null::Release()
+{
+	if (m_count.fetch_sub(1) == 1)
+	{
+		this->~GpAudioBuffer_Null();
+		free(this);
+	}
+}
+
+const int16_t *GpAudioBuffer_Null::GetData() const
+{
+	return m_data;
+}
+
+size_t GpAudioBuffer_Null::GetSize() const
+{
+	return m_size;
+}
+
+GpAudioBuffer_Null::GpAudioBuffer_Null(const int16_t *data, size_t size)
+	: m_data(data)
+	, m_size(size)
+	, m_count(1)
+{
+}
+
+GpAudioBuffer_Null::~GpAudioBuffer_Null()
+{
+}
+
+
+class GpAudioChannel_Null final : public IGpAudioChannel
+{
+public:
+	friend class GpAudioDriver_Null;
+	typedef GpAudioBuffer_Null::AudioSample_t AudioSample_t;
+
+	void SetAudioChannelContext(IGpAudioChannelCallbacks *callbacks) override;
+	bool PostBuffer(IGpAudioBuffer *buffer) override;
+	void Stop() override;
+	void Destroy() override;
+
+	// Mixes into output, which covers the samples ending at mixEndPosition on the driver's sample clock
+	void Consume(int16_t *output, size_t sz, uint64_t mixEndPosition);
+
+	static GpAudioChannel_Null *Create(GpAudioDriver_Null *driver, IGpMutex *mutex);
+
+private:
+	// The queue is guarded by m_mutex, which is never held while calling back into the channel owner, since
+	// the callback may post the next buffer.
+	struct PendingBuffer
+	{
+		GpAudioBuffer_Null *m_buffer;
+		size_t m_leadingSilence;
+	};
+
+	static const size_t kMaxBuffers = 16;
+
+	GpAudioChannel_Null(GpAudioDriver_Null *driver, IGpMutex *mutex);
+	~GpAudioChannel_Null();
+
+	void NotifyFinished(GpAudioBuffer_Null *const *buffers, size_t numBuffers);
+
+	IGpAudioChannelCallbacks *m_callbacks;
+	GpAudioDriver_Null *m_owner;
+	IGpMutex *m_mutex;
+
+	PendingBuffer m_pendingBuffers[kMaxBuffers];
+	size_t m_firstPending;
+	size_t m_numPending;
+	size_t m_firstBufferSamplesConsumed;
+
+	uint64_t m_lastMixEndPosition;
+	bool m_hasMixPosition;
+};
+
+class GpAudioDriver_Null final : public IGpAudioDriver, public IGpPrefsHandler
+{
+public:
+	friend class GpAudioChannel_Null;
+
+	typedef GpAudioChannel_Null::AudioSample_t AudioSample_t;
+
+	explicit GpAudioDriver_Null(const GpAudioDriverProperties &properties);
+	~GpAudioDriver_Null();
+
+	IGpAudioBuffer *CreateBuffer(const void *data, size_t size) override;
+	IGpAudioChannel *CreateChannel() override;
+	void SetMasterVolume(uint32_t vol, uint32_t maxVolume) override;
+	void Shutdown() override;
+	IGpPrefsHandler *GetPrefsHandler() const override;
+	void ServeTicks(int tickCount) override;
+
+	void ApplyPrefs(const void *identifier, size_t identifierSize, const void *contents, size_t contentsSize, uint32_t version) override;
+	bool SavePrefs(void *context, WritePrefsFunc_t writeFunc) override;
+
+	bool Init();
+
+private:
+	static const size_t kMaxChannels = 16;
+	static const size_t kMixChunkSamples = 512;
+	static const int16_t kMaxAudioVolumeScale = 64;
+
+	// If the mixer falls further behind than this (i.e. the process was suspended), the clock skips ahead
+	static const size_t kMaxCatchUpChunks = 8;
+
+	static const unsigned int kTicksPerSecond = 60;
+
+	static const size_t kWavHeaderSize = 44;
+
+	void DetachAudioChannel(GpAudioChannel_Null *channel);
+	void WaitForMixGracePeriod();
+
+	// Estimated position on the sample clock of audio posted now
+	uint64_t GetCurrentPosition() const;
+	uint64_t GetClockPosition() const;
+
+	static int MixThreadFunc(void *context);
+	void MixThreadMain();
+	void MixChunk();
+
+	bool OpenWavFile();
+	void WriteWavChunk(const AudioSample_t *samples, size_t numSamples);
+	void UpdateWavHeader();
+	void LogMixStats();
+
+	GpAudioDriverProperties m_properties;
+	IGpMutex *m_mutex;	// Serializes channel registration, never taken by the mixer
+
+	// Channel slots are read by the mixer without locking.  The mixer bumps m_mixEpoch on entry and exit, so
+	// it is odd while a mix is in progress.  A detached channel may only be freed once any mix that could
+	// have seen its slot has finished.
+	std::atomic<GpAudioChannel_Null*> m_channelSlots[kMaxChannels];
+	std::atomic<unsigned int> m_mixEpoch;
+
+	IGpThreadEvent *m_mixWakeEvent;
+	IGpThreadEvent *m_mixExitEvent;
+	std::atomic<bool> m_mixQuit;
+	bool m_mixThreadRunning;
+
+	unsigned int m_sampleRate;
+	std::chrono::steady_clock::time_point m_clockStartTime;	// Wall time of sample 0, set before the mixer starts
+	std::atomic<uint64_t> m_mixedSamples;
+
+	bool m_virtualClock;
+	IGpMutex *m_virtualClockMutex;	// Serializes ServeTicks, which mixes on the caller's thread
+	std::atomic<uint64_t> m_virtualTicks;
+
+	std::atomic<int> m_audioVolumeScale;
+
+	FILE *m_wavFile;
+	uint64_t m_wavDataSize;
+
+	uint64_t m_numMixedChunks;
+	uint64_t m_numClockSkips;
+	std::chrono::steady_clock::duration m_totalMixTime;
+	std::chrono::steady_clock::duration m_maxMixTime;
+
+	AudioSample_t m_mixChunk[kMixChunkSamples];
+	AudioSample_t m_channelChunk[kMixChunkSamples];
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// GpAudioChannel
+
+GpAudioChannel_Null::GpAudioChannel_Null(GpAudioDriver_Null *driver, IGpMutex *mutex)
+	: m_callbacks(nullptr)
+	, m_owner(driver)
+	, m_mutex(mutex)
+	, m_firstPending(0)
+	, m_numPending(0)
+	, m_firstBufferSamplesConsumed(0)
+	, m_lastMixEndPosition(0)
+	, m_hasMixPosition(false)
+{
+}
+
+GpAudioChannel_Null::~GpAudioChannel_Null()
+{
+	// The channel is no longer reachable from the mixer, so nothing else can touch the queue
+	GpAudioBuffer_Null *finishedBuffers[kMaxBuffers];
+	const size_t numFinished = m_numPending;
+
+	for (size_t i = 0; i < numFinished; i++)
+		finishedBuffers[i] = m_pendingBuffers[(m_firstPending + i) % kMaxBuffers].m_buffer;
+
+	m_numPending = 0;
+
+	NotifyFinished(finishedBuffers, numFinished);
+
+	m_mutex->Destroy();
+}
+
+void GpAudioChannel_Null::SetAudioChannelContext(IGpAudioChannelCallbacks *callbacks)
+{
+	m_callbacks = callbacks;
+}
+
+bool GpAudioChannel_Null::PostBuffer(IGpAudioBuffer *buffer)
+{
+	m_mutex->Lock();
+
+	if (m_numPending == kMaxBuffers)
+	{
+		m_mutex->Unlock();
+		return false;
+	}
+
+	buffer->AddRef();
+
+	size_t leadingSilence = 0;
+	if (m_numPending == 0 && m_hasMixPosition)
+	{
+		// Same as the SDL driver: audio posted to an idle channel starts one chunk after it was posted,
+		// instead of at the start of whatever chunk the mixer renders next
+		const uint64_t queuePosition = m_owner->GetCurrentPosition() + GpAudioDriver_Null::kMixChunkSamples;
+		if (queuePosition > m_lastMixEndPosition)
+		{
+			const uint64_t leadSamples = queuePosition - m_lastMixEndPosition;
+			leadingSilence = (leadSamples > GpAudioDriver_Null::kMixChunkSamples) ? GpAudioDriver_Null::kMixChunkSamples : static_cast<size_t>(leadSamples);
+		}
+	}
+
+	PendingBuffer &pending = m_pendingBuffers[(m_firstPending + m_numPending) % kMaxBuffers];
+	pending.m_buffer = static_cast<GpAudioBuffer_Null*>(buffer);
+	pending.m_leadingSilence = leadingSilence;
+	m_numPending++;
+
+	m_mutex->Unlock();
+
+	return true;
+}
+
+void GpAudioChannel_Null::Stop()
+{
+	GpAudioBuffer_Null *finishedBuffers[kMaxBuffers];
+
+	m_mutex->Lock();
+
+	const size_t numFinished = m_numPending;
+	for (size_t i = 0; i < numFinished; i++)
+		finishedBuffers[i] = m_pendingBuffers[(m_firstPending + i) % kMaxBuffers].m_buffer;
+
+	m_firstPending = (m_firstPending + numFinished) % kMaxBuffers;
+	m_numPending = 0;
+	m_firstBufferSamplesConsumed = 0;
+
+	m_mutex->Unlock();
+
+	NotifyFinished(finishedBuffers, numFinished);
+}
+
+void GpAudioChannel_Null::Destroy()
+{
+	m_owner->DetachAudioChannel(this);
+
+	this->~GpAudioChannel_Null();
+	free(this);
+}
+
+void GpAudioChannel_Null::Consume(int16_t *output, size_t sz, uint64_t mixEndPosition)
+{
+	GpAudioBuffer_Null *finishedBuffers[kMaxBuffers];
+	size_t numFinished = 0;
+
+	m_mutex->Lock();
+
+	m_lastMixEndPosition = mixEndPosition;
+	m_hasMixPosition = true;
+
+	while (sz > 0 && m_numPending > 0)
+	{
+		PendingBuffer &pending = m_pendingBuffers[m_firstPending];
+
+		if (pending.m_leadingSilence > 0)
+		{
+			size_t silence = pending.m_leadingSilence;
+			if (silence > sz)
+				silence = sz;
+
+			memset(output, 0, silence * sizeof(AudioSample_t));
+			output += silence;
+			sz -= silence;
+
+			pending.m_leadingSilence -= silence;
+			continue;
+		}
+
+		GpAudioBuffer_Null *buffer = pending.m_buffer;
+		const int16_t *bufferData = buffer->GetData();
+		const size_t bufferSize = buffer->GetSize();
+
+		assert(m_firstBufferSamplesConsumed < bufferSize);
+
+		const size_t available = (bufferSize - m_firstBufferSamplesConsumed);
+		if (available <= sz)
+		{
+			memcpy(output, bufferData + m_firstBufferSamplesConsumed, available * sizeof(AudioSample_t));
+			sz -= available;
+			output += available;
+
+			m_firstPending = (m_firstPending + 1) % kMaxBuffers;
+			m_numPending--;
+			m_firstBufferSamplesConsumed = 0;
+
+			finishedBuffers[numFinished++] = buffer;
+		}
+		else
+		{
+			memcpy(output, bufferData + m_firstBufferSamplesConsumed, sz * sizeof(AudioSample_t));
+			m_firstBufferSamplesConsumed += sz;
+			output += sz;
+			sz = 0;
+		}
+	}
+
+	m_mutex->Unlock();
+
+	memset(output, 0, sz * sizeof(AudioSample_t));
+
+	NotifyFinished(finishedBuffers, numFinished);
+}
+
+void GpAudioChannel_Null::NotifyFinished(GpAudioBuffer_Null *const *buffers, size_t numBuffers)
+{
+	for (size_t i = 0; i < numBuffers; i++)
+	{
+		if (m_callbacks)
+			m_callbacks->NotifyBufferFinished();
+
+		buffers[i]->Release();
+	}
+}
+
+GpAudioChannel_Null *GpAudioChannel_Null::Create(GpAudioDriver_Null *driver, IGpMutex *mutex)
+{
+	void *storage = malloc(sizeof(GpAudioChannel_Null));
+	if (!storage)
+		return nullptr;
+
+	return new (storage) GpAudioChannel_Null(driver, mutex);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// GpAudioDriver_Null
+
+GpAudioDriver_Null::GpAudioDriver_Null(const GpAudioDriverProperties &properties)
+	: m_properties(properties)
+	, m_mutex(nullptr)
+	, m_mixEpoch(0)
+	, m_mixWakeEvent(nullptr)
+	, m_mixExitEvent(nullptr)
+	, m_mixQuit(false)
+	, m_mixThreadRunning(false)
+	, m_sampleRate(properties.m_sampleRate)
+	, m_mixedSamples(0)
+	, m_virtualClock(properties.m_virtualClock)
+	, m_virtualClockMutex(nullptr)
+	, m_virtualTicks(0)
+	, m_audioVolumeScale(kMaxAudioVolumeScale)
+	, m_wavFile(nullptr)
+	, m_wavDataSize(0)
+	, m_numMixedChunks(0)
+	, m_numClockSkips(0)
+	, m_totalMixTime(std::chrono::steady_clock::duration::zero())
+	, m_maxMixTime(std::chrono::steady_clock::duration::zero())
+{
+	for (size_t i = 0; i < kMaxChannels; i++)
+		m_channelSlots[i].store(nullptr);
+
+	memset(m_mixChunk, 0, sizeof(m_mixChunk));
+	memset(m_channelChunk, 0, sizeof(m_channelChunk));
+}
+
+GpAudioDriver_Null::~GpAudioDriver_Null()
+{
+	if (m_mixThreadRunning)
+	{
+		m_mixQuit.store(true);
+		m_mixWakeEvent->Signal();
+		m_mixExitEvent->Wait();
+	}
+
+	LogMixStats();
+
+	if (m_wavFile)
+	{
+		UpdateWavHeader();
+		fclose(m_wavFile);
+	}
+
+	if (m_mixWakeEvent)
+		m_mixWakeEvent->Destroy();
+
+	if (m_mixExitEvent)
+		m_mixExitEvent->Destroy();
+
+	if (m_virtualClockMutex)
+		m_virtualClockMutex->Destroy();
+
+	if (m_mutex)
+		m_mutex->Destroy();
+}
+
+IGpAudioBuffer *GpAudioDriver_Null::CreateBuffer(const void *data, size_t size)
+{
+	return GpAudioBuffer_Null::Create(data, size);
+}
+
+IGpAudioChannel *GpAudioDriver_Null::CreateChannel()
+{
+	IGpMutex *channelMutex = m_properties.m_systemServices->CreateMutex();
+	if (!channelMutex)
+		return nullptr;
+
+	GpAudioChannel_Null *newChannel = GpAudioChannel_Null::Create(this, channelMutex);
+	if (!newChannel)
+	{
+		channelMutex->Destroy();
+		return nullptr;
+	}
+
+	bool published = false;
+
+	m_mutex->Lock();
+	for (size_t i = 0; i < kMaxChannels; i++)
+	{
+		if (m_channelSlots[i].load() == nullptr)
+		{
+			m_channelSlots[i].store(newChannel);
+			published = true;
+			break;
+		}
+	}
+	m_mutex->Unlock();
+
+	if (!published)
+	{
+		newChannel->Destroy();
+		return nullptr;
+	}
+
+	return newChannel;
+}
+
+void GpAudioDriver_Null::SetMasterVolume(uint32_t vol, uint32_t maxVolume)
+{
+	double scale = vol * static_cast<uint64_t>(kMaxAudioVolumeScale) / maxVolume;
+
+	m_audioVolumeScale.store(static_cast<int16_t>(scale));
+}
+
+void GpAudioDriver_Null::Shutdown()
+{
+	this->~GpAudioDriver_Null();
+	free(this);
+}
+
+IGpPrefsHandler *GpAudioDriver_Null::GetPrefsHandler() const
+{
+	return const_cast<GpAudioDriver_Null*>(this);
+}
+
+void GpAudioDriver_Null::ApplyPrefs(const void *identifier, size_t identifierSize, const void *contents, size_t contentsSize, uint32_t version)
+{
+}
+
+bool GpAudioDriver_Null::SavePrefs(void *context, WritePrefsFunc_t writeFunc)
+{
+	return true;
+}
+
+void GpAudioDriver_Null::ServeTicks(int tickCount)
+{
+	if (!m_virtualClock || tickCount <= 0)
+		return;
+
+	m_virtualClockMutex->Lock();
+
+	m_virtualTicks.fetch_add(static_cast<uint64_t>(tickCount));
+
+	// Render every chunk whose start time has passed, same as the wall clock mixer
+	const uint64_t clockPosition = GetClockPosition();
+	while (m_mixedSamples.load() <= clockPosition)
+		MixChunk();
+
+	m_virtualClockMutex->Unlock();
+}
+
+bool GpAudioDriver_Null::Init()
+{
+	IGpSystemServices *sysServices = m_properties.m_systemServices;
+
+	m_mutex = sysServices->CreateMutex();
+	m_mixWakeEvent = sysServices->CreateThreadEvent(true, false);
+	m_mixExitEvent = sysServices->CreateThreadEvent(true, false);
+
+	if (!m_mutex || !m_mixWakeEvent || !m_mixExitEvent)
+		return false;
+
+	if (m_properties.m_wavOutputPath != nullptr && !OpenWavFile())
+		return false;
+
+	m_clockStartTime = std::chrono::steady_clock::now();
+
+	if (m_virtualClock)
+	{
+		m_virtualClockMutex = sysServices->CreateMutex();
+		if (!m_virtualClockMutex)
+			return false;
+	}
+	else
+	{
+		m_mixThreadRunning = true;
+		if (!sysServices->CreateThread(MixThreadFunc, this))
+		{
+			m_mixThreadRunning = false;
+			return false;
+		}
+	}
+
+	if (IGpLogDriver *logger = m_properties.m_logger)
+	{
+		const char *clockName = m_virtualClock ? "tick" : "wall";
+
+		if (m_wavFile)
+			logger->Printf(IGpLogDriver::Category_Information, "Null audio driver started at %u Hz on the %s clock, writing mix to %s", m_sampleRate, clockName, m_properties.m_wavOutputPath);
+		else
+			logger->Printf(IGpLogDriver::Category_Information, "Null audio driver started at %u Hz on the %s clock, discarding mix", m_sampleRate, clockName);
+	}
+
+	return true;
+}
+
+void GpAudioDriver_Null::DetachAudioChannel(GpAudioChannel_Null *channel)
+{
+	bool wasPublished = false;
+
+	m_mutex->Lock();
+	for (size_t i = 0; i < kMaxChannels; i++)
+	{
+		if (m_channelSlots[i].load() == channel)
+		{
+			m_channelSlots[i].store(nullptr);
+			wasPublished = true;
+			break;
+		}
+	}
+	m_mutex->Unlock();
+
+	if (wasPublished)
+		WaitForMixGracePeriod();
+}
+
+void GpAudioDriver_Null::WaitForMixGracePeriod()
+{
+	const unsigned int epoch = m_mixEpoch.load();
+	if ((epoch & 1) == 0)
+		return;
+
+	while (m_mixEpoch.load() == epoch)
+		std::this_thread::yield();
+}
+
+uint64_t GpAudioDriver_Null::GetCurrentPosition() const
+{
+	const uint64_t clockPosition = GetClockPosition();
+
+	// Keep the estimate within the chunk that the mixer last rendered, so a late or early wakeup of the
+	// mixer thread doesn't change where posted audio lands
+	const uint64_t mixedSamples = m_mixedSamples.load();
+	const uint64_t lastChunkStart = (mixedSamples >= kMixChunkSamples) ? (mixedSamples - kMixChunkSamples) : 0;
+
+	if (clockPosition < lastChunkStart)
+		return lastChunkStart;
+	if (clockPosition > mixedSamples)
+		return mixedSamples;
+
+	return clockPosition;
+}
+
+uint64_t GpAudioDriver_Null::GetClockPosition() const
+{
+	if (m_virtualClock)
+		return m_virtualTicks.load() * m_sampleRate / kTicksPerSecond;
+
+	const std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - m_clockStartTime;
+	const uint64_t elapsedUSec = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+	return elapsedUSec * m_sampleRate / 1000000u;
+}
+
+int GpAudioDriver_Null::MixThreadFunc(void *context)
+{
+	static_cast<GpAudioDriver_Null*>(context)->MixThreadMain();
+	return 0;
+}
+
+void GpAudioDriver_Null::MixThreadMain()
+{
+	while (!m_mixQuit.load())
+	{
+		const std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - m_clockStartTime;
+		const uint64_t elapsedUSec = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+		const uint64_t wallPosition = elapsedUSec * m_sampleRate / 1000000u;
+
+		uint64_t mixedSamples = m_mixedSamples.load();
+
+		if (wallPosition >= mixedSamples + kMaxCatchUpChunks * kMixChunkSamples)
+		{
+			// Too far behind to catch up, skip the sample clock ahead instead of mixing a burst of audio
+			m_mixedSamples.store(wallPosition);
+			m_numClockSkips++;
+			continue;
+		}
+
+		// Render every chunk whose start time has passed
+		while (mixedSamples <= wallPosition && !m_mixQuit.load())
+		{
+			MixChunk();
+			mixedSamples = m_mixedSamples.load();
+		}
+
+		const uint64_t nextChunkUSec = mixedSamples * 1000000u / m_sampleRate;
+		if (nextChunkUSec > elapsedUSec)
+		{
+			const uint64_t waitMSec = (nextChunkUSec - elapsedUSec + 999) / 1000;
+			m_mixWakeEvent->WaitTimed(static_cast<uint32_t>(waitMSec));
+		}
+	}
+
+	m_mixExitEvent->Signal();
+}
+
+void GpAudioDriver_Null::MixChunk()
+{
+	const std::chrono::steady_clock::time_point mixStartTime = std::chrono::steady_clock::now();
+
+	GpAudioChannel_Null *mixingChannels[kMaxChannels];
+	size_t numChannels = 0;
+
+	m_mixEpoch.fetch_add(1);
+
+	for (size_t i = 0; i < kMaxChannels; i++)
+	{
+		GpAudioChannel_Null *channel = m_channelSlots[i].load();
+		if (channel)
+			mixingChannels[numChannels++] = channel;
+	}
+
+	const uint64_t mixEndPosition = m_mixedSamples.load() + kMixChunkSamples;
+	const int16_t audioVolumeScale = static_cast<int16_t>(m_audioVolumeScale.load());
+
+	for (size_t i = 0; i < numChannels; i++)
+	{
+		mixingChannels[i]->Consume(m_channelChunk, kMixChunkSamples, mixEndPosition);
+
+		if (i == 0)
+			GpAudioMixKernels::ScaleSamples(m_mixChunk, m_channelChunk, kMixChunkSamples, audioVolumeScale);
+		else
+			GpAudioMixKernels::MixScaledSamples(m_mixChunk, m_channelChunk, kMixChunkSamples, audioVolumeScale);
+	}
+
+	if (numChannels == 0)
+		memset(m_mixChunk, 0, sizeof(m_mixChunk));
+
+	m_mixEpoch.fetch_add(1);
+
+	m_mixedSamples.store(mixEndPosition);
+
+	const std::chrono::steady_clock::duration mixTime = std::chrono::steady_clock::now() - mixStartTime;
+	m_totalMixTime += mixTime;
+	if (mixTime > m_maxMixTime)
+		m_maxMixTime = mixTime;
+	m_numMixedChunks++;
+
+	if (m_wavFile)
+		WriteWavChunk(m_mixChunk, kMixChunkSamples);
+}
+
+static void WriteLE16(uint8_t *dest, uint16_t value)
+{
+	dest[0] = static_cast<uint8_t>(value & 0xff);
+	dest[1] = static_cast<uint8_t>((value >> 8) & 0xff);
+}
+
+static void WriteLE32(uint8_t *dest, uint32_t value)
+{
+	WriteLE16(dest, static_cast<uint16_t>(value & 0xffff));
+	WriteLE16(dest + 2, static_cast<uint16_t>((value >> 16) & 0xffff));
+}
+
+bool GpAudioDriver_Null::OpenWavFile()
+{
+	m_wavFile = fopen(m_properties.m_wavOutputPath, "wb");
+	if (!m_wavFile)
+	{
+		if (IGpLogDriver *logger = m_properties.m_logger)
+			logger->Printf(IGpLogDriver::Category_Error, "Failed to open audio output file %s", m_properties.m_wavOutputPath);
+
+		return false;
+	}
+
+	UpdateWavHeader();
+	return true;
+}
+
+void GpAudioDriver_Null::WriteWavChunk(const AudioSample_t *samples, size_t numSamples)
+{
+	uint8_t chunkBytes[kMixChunkSamples * sizeof(AudioSample_t)];
+	assert(numSamples <= kMixChunkSamples);
+
+	for (size_t i = 0; i < numSamples; i++)
+		WriteLE16(chunkBytes + i * 2, static_cast<uint16_t>(samples[i]));
+
+	fwrite(chunkBytes, sizeof(AudioSample_t), numSamples, m_wavFile);
+	m_wavDataSize += numSamples * sizeof(AudioSample_t);
+
+	// The process may exit without shutting down the audio driver, so keep the header valid as the file grows
+	UpdateWavHeader();
+}
+
+void GpAudioDriver_Null::UpdateWavHeader()
+{
+	// RIFF sizes are 32-bit, so stop counting once the file reaches 4GB
+	const uint32_t maxDataSize = 0xffffffffu - kWavHeaderSize;
+	const uint32_t dataSize = (m_wavDataSize > maxDataSize) ? maxDataSize : static_cast<uint32_t>(m_wavDataSize);
+
+	uint8_t header[kWavHeaderSize];
+	memcpy(header + 0, "RIFF", 4);
+	WriteLE32(header + 4, static_cast<uint32_t>(kWavHeaderSize - 8) + dataSize);
+	memcpy(header + 8, "WAVE", 4);
+	memcpy(header + 12, "fmt ", 4);
+	WriteLE32(header + 16, 16);
+	WriteLE16(header + 20, 1);	// PCM
+	WriteLE16(header + 22, 1);	// Mono
+	WriteLE32(header + 24, m_sampleRate);
+	WriteLE32(header + 28, m_sampleRate * static_cast<uint32_t>(sizeof(AudioSample_t)));
+	WriteLE16(header + 32, static_cast<uint16_t>(sizeof(AudioSample_t)));
+	WriteLE16(header + 34, 16);
+	memcpy(header + 36, "data", 4);
+	WriteLE32(header + 40, dataSize);
+
+	fseek(m_wavFile, 0, SEEK_SET);
+	fwrite(header, 1, kWavHeaderSize, m_wavFile);
+	fseek(m_wavFile, 0, SEEK_END);
+	fflush(m_wavFile);
+}
+
+void GpAudioDriver_Null::LogMixStats()
+{
+	IGpLogDriver *logger = m_properties.m_logger;
+	if (!logger || m_numMixedChunks == 0)
+		return;
+
+	const long long totalMicroseconds = static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(m_totalMixTime).count());
+	const long long maxMicroseconds = static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(m_maxMixTime).count());
+	const double audioSeconds = static_cast<double>(m_mixedSamples.load()) / static_cast<double>(m_sampleRate);
+
+	logger->Printf(IGpLogDriver::Category_Information, "Null audio driver mixed %u chunks (%.1f s of audio), average %lli us, max %lli us per chunk, %u clock skips",
+		static_cast<unsigned int>(m_numMixedChunks), audioSeconds, totalMicroseconds / static_cast<long long>(m_numMixedChunks), maxMicroseconds, static_cast<unsigned int>(m_numClockSkips));
+}
+
+IGpAudioDriver *GpDriver_CreateAudioDriver_Null(const GpAudioDriverProperties &properties)
+{
+	void *storage = malloc(sizeof(GpAudioDriver_Null));
+	if (!storage)
+		return nullptr;
+
+	GpAudioDriver_Null *driver = new (storage) GpAudioDriver_Null(properties);
+	if (!driver->Init())
+	{
+		driver->Shutdown();
+		return nullptr;
+	}
+
+	return driver;
+}
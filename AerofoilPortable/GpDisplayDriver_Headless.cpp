@@ -0,0 +1,635 @@
+#include "IGpDisplayDriver.h"
+
+#include "CoreDefs.h"
+#include "GpDisplayDriverFrameStats.h"
+#include "GpDisplayDriverProperties.h"
+#include "GpVOSEvent.h"
+#include "IGpCursor.h"
+#include "IGpDisplayDriverSurface.h"
+#include "IGpLogDriver.h"
+#include "IGpVOSEventQueue.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+
+#include <chrono>
+
+// Display driver that composites into a system memory frame buffer instead of a window.
+// Frames are rendered back-to-back with no vsync or frame time lock, so the game runs
+// as fast as the CPU allows.  Intended for automated soak testing and benchmarking on
+// machines without a GPU or a display server.
+
+static GpDisplayDriverSurfaceEffects gs_defaultEffects;
+
+class GpDisplayDriver_Headless;
+
+class GpDisplayDriverSurface_Headless final : public IGpDisplayDriverSurface
+{
+public:
+	static GpDisplayDriverSurface_Headless *Create(size_t width, size_t height, GpPixelFormat_t pixelFormat);
+
+	void Upload(const void *data, size_t x, size_t y, size_t width, size_t height, size_t pitch) override;
+	void UploadEntire(const void *data, size_t pitch) override;
+	void Destroy() override;
+
+	size_t GetWidth() const;
+	size_t GetHeight() const;
+	size_t GetPitch() const;
+	GpPixelFormat_t GetPixelFormat() const;
+	const uint8_t *GetPixels() const;
+
+private:
+	GpDisplayDriverSurface_Headless(size_t width, size_t height, size_t pitch, size_t pixelSize, GpPixelFormat_t pixelFormat, uint8_t *pixels);
+	~GpDisplayDriverSurface_Headless();
+
+	size_t m_width;
+	size_t m_height;
+	size_t m_pitch;
+	size_t m_pixelSize;
+	GpPixelFormat_t m_pixelFormat;
+	uint8_t *m_pixels;
+};
+
+GpDisplayDriverSurface_Headless::GpDisplayDriverSurface_Headless(size_t width, size_t height, size_t pitch, size_t pixelSize, GpPixelFormat_t pixelFormat, uint8_t *pixels)
+	: m_width(width)
+	, m_height(height)
+	, m_pitch(pitch)
+	, m_pixelSize(pixelSize)
+	, m_pixelFormat(pixelFormat)
+	, m_pixels(pixels)
+{
+}
+
+GpDisplayDriverSurface_Headless::~GpDisplayDriverSurface_Headless()
+{
+	free(m_pixels);
+}
+
+GpDisplayDriverSurface_Headless *GpDisplayDriverSurface_Headless::Create(size_t width, size_t height, GpPixelFormat_t pixelFormat)
+{
+	size_t pixelSize = 0;
+	switch (pixelFormat)
+	{
+	case GpPixelFormats::k8BitStandard:
+	case GpPixelFormats::k8BitCustom:
+		pixelSize = 1;
+		break;
+	case GpPixelFormats::kRGB555:
+		pixelSize = 2;
+		break;
+	case GpPixelFormats::kRGB24:
+		pixelSize = 3;
+		break;
+	case GpPixelFormats::kRGB32:
+		pixelSize = 4;
+		break;
+	default:
+		return nullptr;
+	}
+
+	const size_t pitch = width * pixelSize;
+
+	uint8_t *pixels = static_cast<uint8_t*>(malloc(pitch * height));
+	if (!pixels)
+		return nullptr;
+
+	memset(pixels, 0, pitch * height);
+
+	void *storage = malloc(sizeof(GpDisplayDriverSurface_Headless));
+	if (!storage)
+	{
+		free(pixels);
+		return nullptr;
+	}
+
+	return new (storage) GpDisplayDriverSurface_Headless(width, height, pitch, pixelSize, pixelFormat, pixels);
+}
+
+void GpDisplayDriverSurface_Headless::Upload(const void *data, size_t x, size_t y, size_t width, size_t height, size_t pitch)
+{
+	if (x >= m_width || y >= m_height)
+		return;
+
+	if (width > m_width - x)
+		width = m_width - x;
+	if (height > m_height - y)
+		height = m_height - y;
+
+	const uint8_t *srcRow = static_cast<const uint8_t*>(data);
+	uint8_t *destRow = m_pixels + y * m_pitch + x * m_pixelSize;
+	const size_t rowSize = width * m_pixelSize;
+
+	for (size_t row = 0; row < height; row++)
+	{
+		memcpy(destRow, srcRow, rowSize);
+		srcRow += pitch;
+		destRow += m_pitch;
+	}
+}
+
+void GpDisplayDriverSurface_Headless::UploadEntire(const void *data, size_t pitch)
+{
+	Upload(data, 0, 0, m_width, m_height, pitch);
+}
+
+void GpDisplayDriverSurface_Headless::Destroy()
+{
+	this->~GpDisplayDriverSurface_Headless();
+	free(this);
+}
+
+size_t GpDisplayDriverSurface_Headless::GetWidth() const
+{
+	return m_width;
+}
+
+size_t GpDisplayDriverSurface_Headless::GetHeight() const
+{
+	return m_height;
+}
+
+size_t GpDisplayDriverSurface_Headless::GetPitch() const
+{
+	return m_pitch;
+}
+
+GpPixelFormat_t GpDisplayDriverSurface_Headless::GetPixelFormat() const
+{
+	return m_pixelFormat;
+}
+
+const uint8_t *GpDisplayDriverSurface_Headless::GetPixels() const
+{
+	return m_pixels;
+}
+
+
+class GpCursor_Headless final : public IGpCursor
+{
+public:
+	static GpCursor_Headless *Create();
+
+	void Destroy() override;
+};
+
+GpCursor_Headless *GpCursor_Headless::Create()
+{
+	void *storage = malloc(sizeof(GpCursor_Headless));
+	if (!storage)
+		return nullptr;
+
+	return new (storage) GpCursor_Headless();
+}
+
+void GpCursor_Headless::Destroy()
+{
+	this->~GpCursor_Headless();
+	free(this);
+}
+
+
+class GpDisplayDriver_Headless final : public IGpDisplayDriver
+{
+public:
+	explicit GpDisplayDriver_Headless(const GpDisplayDriverProperties &properties);
+	~GpDisplayDriver_Headless();
+
+	bool Init() override;
+	void ServeTicks(int tickCount) override;
+	void ForceSync() override;
+	void Shutdown() override;
+
+	void GetInitialDisplayResolution(unsigned int *width, unsigned int *height) override;
+	IGpDisplayDriverSurface *CreateSurface(size_t width, size_t height, size_t pitch, GpPixelFormat_t pixelFormat, SurfaceInvalidateCallback_t invalidateCallback, void *invalidateContext) override;
+	void DrawSurface(IGpDisplayDriverSurface *surface, int32_t x, int32_t y, size_t width, size_t height, const GpDisplayDriverSurfaceEffects *effects) override;
+	IGpCursor *CreateBWCursor(size_t width, size_t height, const void *pixelData, const void *maskData, size_t hotSpotX, size_t hotSpotY) override;
+	IGpCursor *CreateColorCursor(size_t width, size_t height, const void *pixelDataRGBA, size_t hotSpotX, size_t hotSpotY) override;
+	void SetCursor(IGpCursor *cursor) override;
+	void SetStandardCursor(EGpStandardCursor_t standardCursor) override;
+	void UpdatePalette(const void *paletteData) override;
+	void SetBackgroundColor(uint8_t r, uint8_t g, uint8_t b, uint8_t a) override;
+	void SetBackgroundDarkenEffect(bool isDark) override;
+	void SetUseICCProfile(bool useICCProfile) override;
+	void RequestToggleFullScreen(uint32_t timestamp) override;
+	void RequestResetVirtualResolution() override;
+	bool IsFullScreen() const override;
+
+	const GpDisplayDriverProperties &GetProperties() const override;
+	IGpPrefsHandler *GetPrefsHandler() const override;
+	void GetFrameStats(GpDisplayDriverFrameStats &outStats) const override;
+
+private:
+	static const uint32_t kDefaultWidth = 640;
+	static const uint32_t kDefaultHeight = 480;
+	static const size_t kFrameDumpChunkPixels = 1024;
+
+	void RenderFrame();
+	void LogFrameStats();
+	void ClearFrameBuffer();
+	void DumpFrame();
+
+	GpDisplayDriverProperties m_properties;
+
+	uint32_t m_width;
+	uint32_t m_height;
+	uint8_t *m_frameBuffer;
+
+	uint8_t m_palette[256 * 4];
+	uint8_t m_bgColor[4];
+	bool m_bgIsDark;
+
+	uint32_t m_frameCount;
+	bool m_quitPosted;
+
+	std::chrono::high_resolution_clock::duration m_totalRenderTime;
+	std::chrono::high_resolution_clock::duration m_maxRenderTime;
+
+	// Frames aren't paced, so the tick interval is left at zero and no frames count as dropped
+	GpDisplayDriverFrameStats m_frameStats;
+	std::chrono::high_resolution_clock::time_point m_lastPresentTime;
+	uint32_t m_frameDrawCalls;
+};
+
+GpDisplayDriver_Headless::GpDisplayDriver_Headless(const GpDisplayDriverProperties &properties)
+	: m_properties(properties)
+	, m_width(kDefaultWidth)
+	, m_height(kDefaultHeight)
+	, m_frameBuffer(nullptr)
+	, m_bgIsDark(false)
+	, m_frameCount(0)
+	, m_quitPosted(false)
+	, m_totalRenderTime(std::chrono::high_resolution_clock::duration::zero())
+	, m_maxRenderTime(std::chrono::high_resolution_clock::duration::zero())
+	, m_frameDrawCalls(0)
+{
+	memset(m_palette, 255, sizeof(m_palette));
+
+	m_bgColor[0] = 0;
+	m_bgColor[1] = 0;
+	m_bgColor[2] = 0;
+	m_bgColor[3] = 255;
+}
+
+GpDisplayDriver_Headless::~GpDisplayDriver_Headless()
+{
+	free(m_frameBuffer);
+}
+
+bool GpDisplayDriver_Headless::Init()
+{
+	IGpLogDriver *logger = m_properties.m_logger;
+
+	uint32_t physicalWidth = m_width;
+	uint32_t physicalHeight = m_height;
+	uint32_t virtualWidth = m_width;
+	uint32_t virtualHeight = m_height;
+	float pixelScaleX = 1.0f;
+	float pixelScaleY = 1.0f;
+
+	if (m_properties.m_adjustRequestedResolutionFunc(m_properties.m_adjustRequestedResolutionFuncContext, physicalWidth, physicalHeight, virtualWidth, virtualHeight, pixelScaleX, pixelScaleY))
+	{
+		m_width = virtualWidth;
+		m_height = virtualHeight;
+	}
+
+	m_frameBuffer = static_cast<uint8_t*>(malloc(static_cast<size_t>(m_width) * m_height * 4));
+	if (!m_frameBuffer)
+	{
+		if (logger)
+			logger->Printf(IGpLogDriver::Category_Error, "Failed to allocate headless frame buffer");
+
+		return false;
+	}
+
+	ClearFrameBuffer();
+
+	if (logger)
+		logger->Printf(IGpLogDriver::Category_Information, "Initialized headless display %i x %i", static_cast<int>(m_width), static_cast<int>(m_height));
+
+	return true;
+}
+
+void GpDisplayDriver_Headless::ServeTicks(int ticks)
+{
+	while (ticks > 0)
+	{
+		RenderFrame();
+		ticks--;
+	}
+}
+
+void GpDisplayDriver_Headless::ForceSync()
+{
+}
+
+void GpDisplayDriver_Headless::Shutdown()
+{
+	LogFrameStats();
+
+	this->~GpDisplayDriver_Headless();
+	free(this);
+}
+
+void GpDisplayDriver_Headless::GetInitialDisplayResolution(unsigned int *width, unsigned int *height)
+{
+	if (width)
+		*width = m_width;
+
+	if (height)
+		*height = m_height;
+}
+
+IGpDisplayDriverSurface *GpDisplayDriver_Headless::CreateSurface(size_t width, size_t height, size_t pitch, GpPixelFormat_t pixelFormat, SurfaceInvalidateCallback_t invalidateCallback, void *invalidateContext)
+{
+	// Surfaces live in system memory, so they are never invalidated
+	(void)pitch;
+	(void)invalidateCallback;
+	(void)invalidateContext;
+
+	return GpDisplayDriverSurface_Headless::Create(width, height, pixelFormat);
+}
+
+void GpDisplayDriver_Headless::DrawSurface(IGpDisplayDriverSurface *surface, int32_t x, int32_t y, size_t width, size_t height, const GpDisplayDriverSurfaceEffects *effects)
+{
+	if (!effects)
+		effects = &gs_defaultEffects;
+
+	const GpDisplayDriverSurface_Headless *hlSurface = static_cast<const GpDisplayDriverSurface_Headless*>(surface);
+	const GpPixelFormat_t pixelFormat = hlSurface->GetPixelFormat();
+
+	const bool isPaletted = (pixelFormat == GpPixelFormats::k8BitStandard || pixelFormat == GpPixelFormats::k8BitCustom);
+	if (!isPaletted && pixelFormat != GpPixelFormats::kRGB32)
+		return;
+
+	if (width == 0 || height == 0)
+		return;
+
+	const size_t surfaceWidth = hlSurface->GetWidth();
+	const size_t surfaceHeight = hlSurface->GetHeight();
+	const size_t surfacePitch = hlSurface->GetPitch();
+	const uint8_t *surfacePixels = hlSurface->GetPixels();
+
+	// Clip the destination rect to the frame buffer
+	int32_t firstCol = 0;
+	int32_t firstRow = 0;
+	int32_t endCol = static_cast<int32_t>(width);
+	int32_t endRow = static_cast<int32_t>(height);
+
+	if (x < 0)
+		firstCol = -x;
+	if (y < 0)
+		firstRow = -y;
+	if (x + endCol > static_cast<int32_t>(m_width))
+		endCol = static_cast<int32_t>(m_width) - x;
+	if (y + endRow > static_cast<int32_t>(m_height))
+		endRow = static_cast<int32_t>(m_height) - y;
+
+	if (firstCol >= endCol || firstRow >= endRow)
+		return;
+
+	m_frameDrawCalls++;
+
+	const uint16_t modulation = effects->m_darken ? 128 : 256;
+	const bool desaturate = (effects->m_desaturation != 0.0f);
+	const uint16_t desaturation = static_cast<uint16_t>(effects->m_desaturation * 256.0f);
+
+	for (int32_t row = firstRow; row < endRow; row++)
+	{
+		// Nearest-neighbor sampling, matching the GPU drivers when the draw size differs from the surface size
+		const size_t srcY = static_cast<size_t>(row) * surfaceHeight / height;
+		const uint8_t *srcRow = surfacePixels + srcY * surfacePitch;
+		uint8_t *destRow = m_frameBuffer + (static_cast<size_t>(y + row) * m_width + static_cast<size_t>(x)) * 4;
+
+		for (int32_t col = firstCol; col < endCol; col++)
+		{
+			const size_t srcX = static_cast<size_t>(col) * surfaceWidth / width;
+
+			if (effects->m_flicker)
+			{
+				const int32_t flickerTotal = effects->m_flickerAxisX * static_cast<int32_t>(srcX) + effects->m_flickerAxisY * static_cast<int32_t>(srcY);
+				if (flickerTotal < effects->m_flickerStartThreshold)
+					continue;
+				else if (flickerTotal < effects->m_flickerEndThreshold)
+				{
+					uint8_t *destPixel = destRow + col * 4;
+					destPixel[0] = destPixel[1] = destPixel[2] = destPixel[3] = 255;
+					continue;
+				}
+			}
+
+			const uint8_t *srcPixel = isPaletted ? (m_palette + srcRow[srcX] * 4) : (srcRow + srcX * 4);
+
+			uint16_t r = static_cast<uint16_t>((srcPixel[0] * modulation) >> 8);
+			uint16_t g = static_cast<uint16_t>((srcPixel[1] * modulation) >> 8);
+			uint16_t b = static_cast<uint16_t>((srcPixel[2] * modulation) >> 8);
+
+			// This is intentionally done in gamma space, and keeps solid yellow
+			if (desaturate && !(r == 255 && g == 255 && b == 0))
+			{
+				const uint16_t gray = static_cast<uint16_t>((r * 3 + g * 6 + b) / 10);
+				r = static_cast<uint16_t>((r * (256 - desaturation) + gray * desaturation) >> 8);
+				g = static_cast<uint16_t>((g * (256 - desaturation) + gray * desaturation) >> 8);
+				b = static_cast<uint16_t>((b * (256 - desaturation) + gray * desaturation) >> 8);
+			}
+
+			uint8_t *destPixel = destRow + col * 4;
+			destPixel[0] = static_cast<uint8_t>(r);
+			destPixel[1] = static_cast<uint8_t>(g);
+			destPixel[2] = static_cast<uint8_t>(b);
+			destPixel[3] = 255;
+		}
+	}
+}
+
+IGpCursor *GpDisplayDriver_Headless::CreateBWCursor(size_t width, size_t height, const void *pixelData, const void *maskData, size_t hotSpotX, size_t hotSpotY)
+{
+	return GpCursor_Headless::Create();
+}
+
+IGpCursor *GpDisplayDriver_Headless::CreateColorCursor(size_t width, size_t height, const void *pixelDataRGBA, size_t hotSpotX, size_t hotSpotY)
+{
+	return GpCursor_Headless::Create();
+}
+
+void GpDisplayDriver_Headless::SetCursor(IGpCursor *cursor)
+{
+}
+
+void GpDisplayDriver_Headless::SetStandardCursor(EGpStandardCursor_t standardCursor)
+{
+}
+
+void GpDisplayDriver_Headless::UpdatePalette(const void *paletteData)
+{
+	memcpy(m_palette, paletteData, 256 * 4);
+}
+
+void GpDisplayDriver_Headless::SetBackgroundColor(uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+{
+	m_bgColor[0] = r;
+	m_bgColor[1] = g;
+	m_bgColor[2] = b;
+	m_bgColor[3] = a;
+}
+
+void GpDisplayDriver_Headless::SetBackgroundDarkenEffect(bool isDark)
+{
+	m_bgIsDark = isDark;
+}
+
+void GpDisplayDriver_Headless::SetUseICCProfile(bool useICCProfile)
+{
+}
+
+void GpDisplayDriver_Headless::RequestToggleFullScreen(uint32_t timestamp)
+{
+}
+
+void GpDisplayDriver_Headless::RequestResetVirtualResolution()
+{
+}
+
+bool GpDisplayDriver_Headless::IsFullScreen() const
+{
+	return false;
+}
+
+const GpDisplayDriverProperties &GpDisplayDriver_Headless::GetProperties() const
+{
+	return m_properties;
+}
+
+IGpPrefsHandler *GpDisplayDriver_Headless::GetPrefsHandler() const
+{
+	return nullptr;
+}
+
+void GpDisplayDriver_Headless::GetFrameStats(GpDisplayDriverFrameStats &outStats) const
+{
+	outStats = m_frameStats;
+}
+
+void GpDisplayDriver_Headless::RenderFrame()
+{
+	const std::chrono::high_resolution_clock::time_point renderStartTime = std::chrono::high_resolution_clock::now();
+
+	ClearFrameBuffer();
+
+	m_frameDrawCalls = 0;
+
+	m_properties.m_renderFunc(m_properties.m_renderFuncContext);
+
+	const std::chrono::high_resolution_clock::time_point renderEndTime = std::chrono::high_resolution_clock::now();
+	const std::chrono::high_resolution_clock::duration renderTime = renderEndTime - renderStartTime;
+
+	m_frameStats.RecordTick(false);
+	m_frameStats.RecordPresent(static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(renderEndTime - m_lastPresentTime).count()), false);
+	m_frameStats.RecordFrameWork(0, 0, m_frameDrawCalls);
+	m_lastPresentTime = renderEndTime;
+
+	m_totalRenderTime += renderTime;
+	if (renderTime > m_maxRenderTime)
+		m_maxRenderTime = renderTime;
+
+	if (m_properties.m_frameDumpPath != nullptr && m_properties.m_frameDumpInterval > 0 && (m_frameCount % m_properties.m_frameDumpInterval) == 0)
+		DumpFrame();
+
+	m_frameCount++;
+
+	if (m_properties.m_frameLimit > 0 && m_frameCount >= m_properties.m_frameLimit && !m_quitPosted)
+	{
+		LogFrameStats();
+
+		if (IGpLogDriver *logger = m_properties.m_logger)
+			logger->Printf(IGpLogDriver::Category_Information, "Headless frame limit reached, requesting quit");
+
+		if (GpVOSEvent *evt = m_properties.m_eventQueue->QueueEvent())
+		{
+			evt->m_eventType = GpVOSEventTypes::kQuit;
+			m_quitPosted = true;
+		}
+	}
+}
+
+void GpDisplayDriver_Headless::LogFrameStats()
+{
+	IGpLogDriver *logger = m_properties.m_logger;
+	if (!logger || m_frameCount == 0)
+		return;
+
+	const long long totalMicroseconds = static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(m_totalRenderTime).count());
+	const long long maxMicroseconds = static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(m_maxRenderTime).count());
+	logger->Printf(IGpLogDriver::Category_Information, "Headless display rendered %u frames, average %lli us, max %lli us", static_cast<unsigned int>(m_frameCount), totalMicroseconds / static_cast<long long>(m_frameCount), maxMicroseconds);
+}
+
+void GpDisplayDriver_Headless::ClearFrameBuffer()
+{
+	uint8_t bgColor[4];
+	for (int i = 0; i < 4; i++)
+		bgColor[i] = m_bgColor[i];
+
+	if (m_bgIsDark)
+	{
+		for (int i = 0; i < 3; i++)
+			bgColor[i] = static_cast<uint8_t>(bgColor[i] / 4);
+	}
+
+	const size_t numPixels = static_cast<size_t>(m_width) * m_height;
+	uint8_t *pixel = m_frameBuffer;
+	for (size_t i = 0; i < numPixels; i++)
+	{
+		memcpy(pixel, bgColor, 4);
+		pixel += 4;
+	}
+}
+
+void GpDisplayDriver_Headless::DumpFrame()
+{
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/frame%08u.ppm", m_properties.m_frameDumpPath, static_cast<unsigned int>(m_frameCount));
+
+	FILE *f = fopen(path, "wb");
+	if (!f)
+	{
+		if (IGpLogDriver *logger = m_properties.m_logger)
+			logger->Printf(IGpLogDriver::Category_Warning, "Failed to open frame dump file %s", path);
+
+		return;
+	}
+
+	fprintf(f, "P6\n%u %u\n255\n", static_cast<unsigned int>(m_width), static_cast<unsigned int>(m_height));
+
+	uint8_t rowBuffer[kFrameDumpChunkPixels * 3];
+	const uint8_t *srcPixel = m_frameBuffer;
+	const size_t numPixels = static_cast<size_t>(m_width) * m_height;
+
+	size_t numBuffered = 0;
+	for (size_t i = 0; i < numPixels; i++)
+	{
+		memcpy(rowBuffer + numBuffered * 3, srcPixel, 3);
+		srcPixel += 4;
+		numBuffered++;
+
+		if (numBuffered == kFrameDumpChunkPixels)
+		{
+			fwrite(rowBuffer, 3, numBuffered, f);
+			numBuffered = 0;
+		}
+	}
+
+	if (numBuffered > 0)
+		fwrite(rowBuffer, 3, numBuffered, f);
+
+	fclose(f);
+}
+
+IGpDisplayDriver *GpDriver_CreateDisplayDriver_Headless(const GpDisplayDriverProperties &properties)
+{
+	void *storage = malloc(sizeof(GpDisplayDriver_Headless));
+	if (!storage)
+		return nullptr;
+
+	return new (storage) GpDisplayDriver_Headless(properties);
+}
@@ -7,6 +7,7 @@
 #include "IGpPrefsHandler.h"
 #include "IGpSystemServices.h"
 #include "GpAudioDriverProperties.h"
+#include "GpAudioMixKernels.h"
 #include "GpSDL.h"
 
 #include "SDL_audio.h"
@@ -21,6 +22,7 @@
 #include <new>
 #include <stdio.h>
 #include <chrono>
+#include <atomic>
 
 class GpAudioDriver_SDL2;
 
@@ -161,30 +163,44 @@ public:
 	static GpAudioChannel_SDL2 *Alloc(GpAudioDriver_SDL2 *driver, GpAudioDriver_SDL2_Duration_t latency, GpAudioDriver_SDL2_Duration_t bufferTime, size_t bufferSamplesMax, uint16_t sampleRate);
 
 private:
+	// The pending buffer queue is a single-producer/single-consumer ring.  PostBuffer and Stop are the producer
+	// (callers must serialize them, which PortabilityLayer does under its channel lock), Consume is the consumer
+	// and only ever runs on the audio callback thread.  Positions run over [0, kQueuePosRange) so that a full
+	// queue can be told apart from an empty one.
+	struct PendingBuffer
+	{
+		GpAudioBuffer_SDL2 *m_buffer;
+		size_t m_leadingSilence;
+	};
+
 	bool Init(GpAudioDriver_SDL2 *driver);
+	void DischargeBuffers(int untilPos);
 
 	static const size_t kMaxBuffers = 16;
+	static const int kQueuePosRange = static_cast<int>(kMaxBuffers * 2);
+
+	static const int kConsumerIdle = 0;
+	static const int kConsumerMixing = 1;		// Consume is running on the audio thread
+	static const int kConsumerDischarging = 2;	// Stop is discharging the queue on the calling thread
 
 	IGpAudioChannelCallbacks *m_callbacks;
-	IGpMutex *m_mutex;
 	GpAudioDriver_SDL2 *m_owner;
 
 	SDL_atomic_t m_refCount;
 
-	GpAudioBuffer_SDL2 *m_pendingBuffers[kMaxBuffers];
-	size_t m_nextPendingBufferConsumePos;
-	size_t m_nextPendingBufferInsertionPos;
-	size_t m_numQueuedBuffers;
+	PendingBuffer m_pendingBuffers[kMaxBuffers];
+	SDL_atomic_t m_insertPos;		// Written by the producer only
+	SDL_atomic_t m_consumePos;		// Written by the consumer only
+	SDL_atomic_t m_flushRequest;	// 1 + insert position to discard up to, or 0 if no flush is pending
 	size_t m_firstBufferSamplesConsumed;
 
-	GpAudioDriver_SDL2_TimePoint_t m_timestamp;		// Time that audio will be consumed if posted to the channel, if m_hasTimestamp is true.
+	std::atomic<GpAudioDriver_SDL2_Rep_t> m_timestamp;		// Time that audio will be consumed if posted to the channel, if m_hasTimestamp is set.
 	GpAudioDriver_SDL2_Duration_t m_latency;
 	GpAudioDriver_SDL2_Duration_t m_bufferTime;
 	size_t m_bufferSamplesMax;
-	size_t m_leadingSilence;
 	uint16_t m_sampleRate;
-	bool m_isMixing;
-	bool m_hasTimestamp;
+	SDL_atomic_t m_consumerState;
+	SDL_atomic_t m_hasTimestamp;
 };
 
 class GpAudioDriver_SDL2 final : public IGpAudioDriver, public IGpPrefsHandler
@@ -213,23 +229,25 @@ public:
 
 private:
 	void DetachAudioChannel(GpAudioChannel_SDL2 *channel);
+	void WaitForMixGracePeriod();
 
 	static void SDLCALL StaticMixAudio(void *userdata, Uint8 *stream, int len);
 
 	void MixAudio(void *stream, size_t len);
 	void RefillMixChunk(GpAudioChannel_SDL2 *const*channels, size_t numChannels, size_t maxSamplesToFill, GpAudioDriver_SDL2_TimePoint_t mixStartTime, GpAudioDriver_SDL2_TimePoint_t mixEndTime);
-	static void AddSamples(AudioSample_t *GP_RESTRICT dest, const AudioSample_t *GP_RESTRICT src, size_t nSamples);
 
 	GpAudioDriverProperties m_properties;
-	IGpMutex *m_mutex;
-	IGpMutex *m_mixState;
+	IGpMutex *m_mutex;	// Serializes channel registration, never taken by the audio callback
 
 	static const size_t kMaxChannels = 16;
 	static const size_t kMixChunkSamples = 512;
 	static const int16_t kMaxAudioVolumeScale = 64;
 
-	GpAudioChannel_SDL2 *m_channels[kMaxChannels];
-	size_t m_numChannels;
+	// Channel slots are read by the audio callback without locking.  The callback bumps m_mixEpoch on entry
+	// and exit, so it is odd while a mix is in progress.  A detached channel may only be freed once any mix
+	// that could have seen its slot has finished.
+	void *m_channelSlots[kMaxChannels];
+	SDL_atomic_t m_mixEpoch;
 
 	unsigned int m_sampleRate;
 	GpAudioDriver_SDL2_Duration_t m_latency;
@@ -249,31 +267,28 @@ private:
 
 GpAudioChannel_SDL2::GpAudioChannel_SDL2(GpAudioDriver_SDL2_Duration_t latency, GpAudioDriver_SDL2_Duration_t bufferTime, size_t bufferSamplesMax, uint16_t sampleRate)
 	: m_callbacks(nullptr)
-	, m_mutex(nullptr)
 	, m_owner(nullptr)
+	, m_firstBufferSamplesConsumed(0)
+	, m_timestamp(0)
 	, m_latency(latency)
 	, m_bufferTime(bufferTime)
 	, m_bufferSamplesMax(bufferSamplesMax)
-	, m_leadingSilence(0)
 	, m_sampleRate(sampleRate)
-	, m_isMixing(false)
-	, m_hasTimestamp(false)
-	, m_nextPendingBufferConsumePos(0)
-	, m_nextPendingBufferInsertionPos(0)
-	, m_numQueuedBuffers(0)
-	, m_firstBufferSamplesConsumed(0)
 {
 	SDL_AtomicSet(&m_refCount, 1);
+	SDL_AtomicSet(&m_insertPos, 0);
+	SDL_AtomicSet(&m_consumePos, 0);
+	SDL_AtomicSet(&m_flushRequest, 0);
+	SDL_AtomicSet(&m_consumerState, kConsumerIdle);
+	SDL_AtomicSet(&m_hasTimestamp, 0);
 }
 
 GpAudioChannel_SDL2::~GpAudioChannel_SDL2()
 {
-	Stop();
+	// The channel is no longer reachable from the mixer, so this thread is the only consumer left
+	DischargeBuffers(SDL_AtomicGet(&m_insertPos));
 
-	if (m_mutex)
-		m_mutex->Destroy();
-
-	assert(m_numQueuedBuffers == 0);
+	assert(SDL_AtomicGet(&m_consumePos) == SDL_AtomicGet(&m_insertPos));
 }
 
 void GpAudioChannel_SDL2::AddRef()
@@ -298,24 +313,22 @@ void GpAudioChannel_SDL2::SetAudioChannelContext(IGpAudioChannelCallbacks *callb
 
 bool GpAudioChannel_SDL2::PostBuffer(IGpAudioBuffer *buffer)
 {
-	buffer->AddRef();
+	const int insertPos = SDL_AtomicGet(&m_insertPos);
+	const int numQueuedBuffers = (insertPos - SDL_AtomicGet(&m_consumePos) + kQueuePosRange) % kQueuePosRange;
 
-	m_mutex->Lock();
-
-	if (m_numQueuedBuffers == kMaxBuffers)
-	{
-		m_mutex->Unlock();
-		buffer->Release();
+	if (static_cast<size_t>(numQueuedBuffers) == kMaxBuffers)
 		return false;
-	}
+
+	buffer->AddRef();
 
 	size_t leadingSilence = 0;
-	if (m_numQueuedBuffers == 0 && m_hasTimestamp && !m_isMixing)
+	if (numQueuedBuffers == 0 && SDL_AtomicGet(&m_hasTimestamp) != 0 && SDL_AtomicGet(&m_consumerState) != kConsumerMixing)
 	{
+		const GpAudioDriver_SDL2_TimePoint_t timestamp = GpAudioDriver_SDL2_TimePoint_t(GpAudioDriver_SDL2_Duration_t(m_timestamp.load()));
 		GpAudioDriver_SDL2_TimePoint_t queueTime = GpAudioDriver_SDL2::GetCurrentTime() + m_latency;
-		if (queueTime > m_timestamp)
+		if (queueTime > timestamp)
 		{
-			const GpAudioDriver_SDL2_Duration_t leadTime = queueTime - m_timestamp;
+			const GpAudioDriver_SDL2_Duration_t leadTime = queueTime - timestamp;
 
 			if (leadTime > m_bufferTime)
 				leadingSilence = m_bufferSamplesMax;
@@ -327,42 +340,29 @@ bool GpAudioChannel_SDL2::PostBuffer(IGpAudioBuffer *buffer)
 		}
 	}
 
-	m_leadingSilence = leadingSilence;
+	PendingBuffer &pending = m_pendingBuffers[insertPos % kMaxBuffers];
+	pending.m_buffer = static_cast<GpAudioBuffer_SDL2*>(buffer);
+	pending.m_leadingSilence = leadingSilence;
 
-	m_pendingBuffers[m_nextPendingBufferInsertionPos++] = static_cast<GpAudioBuffer_SDL2*>(buffer);
-	m_numQueuedBuffers++;
-
-	m_nextPendingBufferInsertionPos = m_nextPendingBufferInsertionPos % kMaxBuffers;
-
-	m_mutex->Unlock();
+	SDL_AtomicSet(&m_insertPos, (insertPos + 1) % kQueuePosRange);
 
 	return true;
 }
 
 void GpAudioChannel_SDL2::Stop()
 {
-	m_mutex->Lock();
-
-	m_leadingSilence = 0;
-
-	size_t numBuffersToDischarge = m_numQueuedBuffers;
+	const int insertPos = SDL_AtomicGet(&m_insertPos);
 
-	for (size_t i = 0; i < numBuffersToDischarge; i++)
+	// If the mixer isn't consuming from this channel, take over as the consumer and discharge now.
+	// Otherwise, leave a flush request for the mixer to pick up so that the audio thread never waits on us.
+	if (SDL_AtomicCAS(&m_consumerState, kConsumerIdle, kConsumerDischarging))
 	{
-		GpAudioBuffer_SDL2 *buffer = m_pendingBuffers[m_nextPendingBufferConsumePos];
-
-		m_nextPendingBufferConsumePos = (m_nextPendingBufferConsumePos + 1) % kMaxBuffers;
-		m_numQueuedBuffers--;
-
-		m_firstBufferSamplesConsumed = 0;
-
-		if (m_callbacks)
-			m_callbacks->NotifyBufferFinished();
-
-		buffer->Release();
+		SDL_AtomicSet(&m_flushRequest, 0);
+		DischargeBuffers(insertPos);
+		SDL_AtomicSet(&m_consumerState, kConsumerIdle);
 	}
-
-	m_mutex->Unlock();
+	else
+		SDL_AtomicSet(&m_flushRequest, insertPos + 1);
 }
 
 void GpAudioChannel_SDL2::Destroy()
@@ -376,46 +376,72 @@ void GpAudioChannel_SDL2::Destroy()
 bool GpAudioChannel_SDL2::Init(GpAudioDriver_SDL2 *driver)
 {
 	m_owner = driver;
-	m_mutex = driver->m_properties.m_systemServices->CreateRecursiveMutex();
-	if (!m_mutex)
-		return false;
 
 	return true;
 }
 
-void GpAudioChannel_SDL2::Consume(int16_t *output, size_t sz, GpAudioDriver_SDL2_TimePoint_t mixStartTime, GpAudioDriver_SDL2_TimePoint_t mixEndTime)
+void GpAudioChannel_SDL2::DischargeBuffers(int untilPos)
 {
-	m_mutex->Lock();
+	int consumePos = SDL_AtomicGet(&m_consumePos);
 
-	m_isMixing = true;
-	m_hasTimestamp = true;
-	m_timestamp = mixEndTime;
+	// Ignore stale requests for buffers that have already been consumed
+	const int numQueuedBuffers = (SDL_AtomicGet(&m_insertPos) - consumePos + kQueuePosRange) % kQueuePosRange;
+	const int numToDischarge = (untilPos - consumePos + kQueuePosRange) % kQueuePosRange;
+	if (numToDischarge > numQueuedBuffers)
+		return;
 
-	if (sz <= m_leadingSilence)
+	for (int i = 0; i < numToDischarge; i++)
 	{
-		memset(output, 0, sz * sizeof(AudioSample_t));
-		m_leadingSilence -= sz;
+		GpAudioBuffer_SDL2 *buffer = m_pendingBuffers[consumePos % kMaxBuffers].m_buffer;
+
+		consumePos = (consumePos + 1) % kQueuePosRange;
+		m_firstBufferSamplesConsumed = 0;
+
+		SDL_AtomicSet(&m_consumePos, consumePos);
+
+		if (m_callbacks)
+			m_callbacks->NotifyBufferFinished();
 
-		m_isMixing = false;
-		m_mutex->Unlock();
+		buffer->Release();
+	}
+}
+
+void GpAudioChannel_SDL2::Consume(int16_t *output, size_t sz, GpAudioDriver_SDL2_TimePoint_t mixStartTime, GpAudioDriver_SDL2_TimePoint_t mixEndTime)
+{
+	if (!SDL_AtomicCAS(&m_consumerState, kConsumerIdle, kConsumerMixing))
+	{
+		// Stop is discharging the queue on another thread, treat the channel as silent for this chunk
+		memset(output, 0, sz * sizeof(AudioSample_t));
 		return;
 	}
-	else
+
+	m_timestamp.store(mixEndTime.time_since_epoch().count());
+	SDL_AtomicSet(&m_hasTimestamp, 1);
+
+	const int flushRequest = SDL_AtomicSet(&m_flushRequest, 0);
+	if (flushRequest != 0)
+		DischargeBuffers(flushRequest - 1);
+
+	int consumePos = SDL_AtomicGet(&m_consumePos);
+	while (sz > 0 && consumePos != SDL_AtomicGet(&m_insertPos))
 	{
-		size_t leadingSilence = m_leadingSilence;
-		if (leadingSilence > 0)
+		PendingBuffer &pending = m_pendingBuffers[consumePos % kMaxBuffers];
+
+		if (pending.m_leadingSilence > 0)
 		{
-			memset(output, 0, leadingSilence * sizeof(AudioSample_t));
-			output += leadingSilence;
-			sz -= leadingSilence;
+			size_t silence = pending.m_leadingSilence;
+			if (silence > sz)
+				silence = sz;
 
-			m_leadingSilence = 0;
+			memset(output, 0, silence * sizeof(AudioSample_t));
+			output += silence;
+			sz -= silence;
+
+			pending.m_leadingSilence -= silence;
+			continue;
 		}
-	}
 
-	while (m_numQueuedBuffers > 0)
-	{
-		GpAudioBuffer_SDL2 *buffer = m_pendingBuffers[m_nextPendingBufferConsumePos];
+		GpAudioBuffer_SDL2 *buffer = pending.m_buffer;
 		const int16_t *bufferData = buffer->GetData();
 		const size_t bufferSize = buffer->GetSize();
 
@@ -428,18 +454,16 @@ void GpAudioChannel_SDL2::Consume(int16_t *output, size_t sz, GpAudioDriver_SDL2
 			sz -= available;
 			output += available;
 
-			m_nextPendingBufferConsumePos = (m_nextPendingBufferConsumePos + 1) % kMaxBuffers;
-			m_numQueuedBuffers--;
-
+			consumePos = (consumePos + 1) % kQueuePosRange;
 			m_firstBufferSamplesConsumed = 0;
 
+			// Publish the free slot before notifying, so whoever sees the completion also sees the room to post another buffer
+			SDL_AtomicSet(&m_consumePos, consumePos);
+
 			if (m_callbacks)
 				m_callbacks->NotifyBufferFinished();
 
 			buffer->Release();
-
-			if (sz == 0)
-				break;
 		}
 		else
 		{
@@ -447,13 +471,10 @@ void GpAudioChannel_SDL2::Consume(int16_t *output, size_t sz, GpAudioDriver_SDL2
 			m_firstBufferSamplesConsumed += sz;
 			output += sz;
 			sz = 0;
-			break;
 		}
 	}
 
-	m_isMixing = false;
-
-	m_mutex->Unlock();
+	SDL_AtomicSet(&m_consumerState, kConsumerIdle);
 
 	memset(output, 0, sz * sizeof(AudioSample_t));
 }
@@ -481,7 +502,6 @@ GpAudioChannel_SDL2 *GpAudioChannel_SDL2::Alloc(GpAudioDriver_SDL2 *driver, GpAu
 GpAudioDriver_SDL2::GpAudioDriver_SDL2(const GpAudioDriverProperties &properties)
 	: m_properties(properties)
 	, m_mutex(nullptr)
-	, m_numChannels(0)
 	, m_sampleRate(0)
 	, m_latency(GpAudioDriver_SDL2_Duration_t::zero())
 	, m_bufferTime(GpAudioDriver_SDL2_Duration_t::zero())
@@ -491,7 +511,9 @@ GpAudioDriver_SDL2::GpAudioDriver_SDL2(const GpAudioDriverProperties &properties
 
 {
 	for (size_t i = 0; i < kMaxChannels; i++)
-		m_channels[i] = nullptr;
+		m_channelSlots[i] = nullptr;
+
+	SDL_AtomicSet(&m_mixEpoch, 0);
 
 	for (size_t i = 0; i < kMixChunkSamples; i++)
 		m_mixChunk[i] = 0;
@@ -517,19 +539,26 @@ IGpAudioChannel *GpAudioDriver_SDL2::CreateChannel()
 	if (!newChannel)
 		return nullptr;
 
+	bool published = false;
+
 	m_mutex->Lock();
-	if (m_numChannels == kMaxChannels)
+	for (size_t i = 0; i < kMaxChannels; i++)
+	{
+		if (SDL_AtomicGetPtr(&m_channelSlots[i]) == nullptr)
+		{
+			SDL_AtomicSetPtr(&m_channelSlots[i], newChannel);
+			published = true;
+			break;
+		}
+	}
+	m_mutex->Unlock();
+
+	if (!published)
 	{
 		newChannel->Destroy();
-		m_mutex->Unlock();
 		return nullptr;
 	}
 
-	m_channels[m_numChannels] = newChannel;
-	m_numChannels++;
-
-	m_mutex->Unlock();
-
 	return newChannel;
 }
 
@@ -596,19 +625,35 @@ bool GpAudioDriver_SDL2::Init()
 
 void GpAudioDriver_SDL2::DetachAudioChannel(GpAudioChannel_SDL2 *channel)
 {
+	bool wasPublished = false;
+
 	m_mutex->Lock();
-	const size_t numChannels = m_numChannels;
-	for (size_t i = 0; i < numChannels; i++)
+	for (size_t i = 0; i < kMaxChannels; i++)
 	{
-		if (m_channels[i] == channel)
+		if (SDL_AtomicGetPtr(&m_channelSlots[i]) == channel)
 		{
-			m_numChannels = numChannels - 1;
-			m_channels[i] = m_channels[numChannels - 1];
-			m_channels[numChannels - 1] = nullptr;
+			SDL_AtomicSetPtr(&m_channelSlots[i], nullptr);
+			wasPublished = true;
 			break;
 		}
 	}
 	m_mutex->Unlock();
+
+	if (wasPublished)
+		WaitForMixGracePeriod();
+}
+
+void GpAudioDriver_SDL2::WaitForMixGracePeriod()
+{
+	// If a mix is in progress, it may have picked up a channel before its slot was cleared, so wait for it to
+	// finish.  Mixes that start after this point can't see the cleared slot.  The wait is bounded by the time
+	// it takes to mix one callback's worth of audio.
+	const int epoch = SDL_AtomicGet(&m_mixEpoch);
+	if ((epoch & 1) == 0)
+		return;
+
+	while (SDL_AtomicGet(&m_mixEpoch) == epoch)
+		SDL_CPUPauseInstruction();
 }
 
 void GpAudioDriver_SDL2::StaticMixAudio(void *userdata, Uint8 *stream, int len)
@@ -621,16 +666,16 @@ void GpAudioDriver_SDL2::MixAudio(void *stream, size_t len)
 	GpAudioChannel_SDL2 *mixingChannels[kMaxChannels];
 	size_t numChannels = 0;
 
-	m_mutex->Lock();
-	numChannels = m_numChannels;
-	for (size_t i = 0; i < numChannels; i++)
-	{
-		GpAudioChannel_SDL2 *channel = m_channels[i];
-		channel->AddRef();
+	// Enter the mix epoch (odd while mixing).  Channels are kept alive until the epoch advances, so no
+	// references need to be taken here.
+	SDL_AtomicIncRef(&m_mixEpoch);
 
-		mixingChannels[i] = channel;
+	for (size_t i = 0; i < kMaxChannels; i++)
+	{
+		GpAudioChannel_SDL2 *channel = static_cast<GpAudioChannel_SDL2*>(SDL_AtomicGetPtr(&m_channelSlots[i]));
+		if (channel)
+			mixingChannels[numChannels++] = channel;
 	}
-	m_mutex->Unlock();
 
 	const size_t totalSamples = len / sizeof(int16_t);
 	size_t samplesRemaining = totalSamples;
@@ -669,8 +714,7 @@ void GpAudioDriver_SDL2::MixAudio(void *stream, size_t len)
 		}
 	}
 
-	for (size_t i = 0; i < numChannels; i++)
-		mixingChannels[i]->Release();
+	SDL_AtomicIncRef(&m_mixEpoch);
 }
 
 void GpAudioDriver_SDL2::RefillMixChunk(GpAudioChannel_SDL2 *const*channels, size_t numChannels, size_t maxSamplesToFill, GpAudioDriver_SDL2_TimePoint_t mixStartTime, GpAudioDriver_SDL2_TimePoint_t mixEndTime)
@@ -707,28 +751,16 @@ void GpAudioDriver_SDL2::RefillMixChunk(GpAudioChannel_SDL2 *const*channels, siz
 		if (i == 0)
 		{
 			noAudio = false;
-			memcpy(mixChunkStart, audioMixBuffer, samplesToFill * sizeof(AudioSample_t));
+			GpAudioMixKernels::ScaleSamples(mixChunkStart, audioMixBuffer, samplesToFill, audioVolumeScale);
 		}
 		else
-			AddSamples(mixChunkStart, audioMixBuffer, samplesToFill);
+			GpAudioMixKernels::MixScaledSamples(mixChunkStart, audioMixBuffer, samplesToFill, audioVolumeScale);
 	}
 
 	if (noAudio)
 		memset(mixChunkStart, 0, samplesToFill * sizeof(AudioSample_t));
-	else
-	{
-		for (size_t i = 0; i < samplesToFill; i++)
-			mixChunkStart[i] *= audioVolumeScale;
-	}
-}
-
-void GpAudioDriver_SDL2::AddSamples(AudioSample_t *GP_RESTRICT dest, const AudioSample_t *GP_RESTRICT src, size_t nSamples)
-{
-	for (size_t i = 0; i < nSamples; i++)
-		dest[i] += src[i];
 }
 
-
 GpAudioDriver_SDL2_TimePoint_t GpAudioDriver_SDL2::GetCurrentTime()
 {
 	return std::chrono::high_resolution_clock::now();
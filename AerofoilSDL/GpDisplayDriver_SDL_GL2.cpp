@@ -3,6 +3,7 @@
 #include "CoreDefs.h"
 #include "GpApplicationName.h"
 #include "GpComPtr.h"
+#include "GpDisplayDriverFrameStats.h"
 #include "GpDisplayDriverProperties.h"
 #include "GpVOSEvent.h"
 #include "GpRingBuffer.h"
@@ -12,8 +13,10 @@
 #include "IGpCursor.h"
 #include "IGpDisplayDriverSurface.h"
 #include "IGpLogDriver.h"
+#include "IGpMutex.h"
 #include "IGpPrefsHandler.h"
 #include "IGpSystemServices.h"
+#include "IGpThreadEvent.h"
 #include "IGpVOSEventQueue.h"
 
 #include "SDL_events.h"
@@ -45,6 +48,17 @@ class GpDisplayDriver_SDL_GL2;
 
 static GpDisplayDriverSurfaceEffects gs_defaultEffects;
 
+static bool AreSurfaceEffectsEqual(const GpDisplayDriverSurfaceEffects &a, const GpDisplayDriverSurfaceEffects &b)
+{
+	return a.m_darken == b.m_darken
+		&& a.m_flicker == b.m_flicker
+		&& a.m_flickerAxisX == b.m_flickerAxisX
+		&& a.m_flickerAxisY == b.m_flickerAxisY
+		&& a.m_flickerStartThreshold == b.m_flickerStartThreshold
+		&& a.m_flickerEndThreshold == b.m_flickerEndThreshold
+		&& a.m_desaturation == b.m_desaturation;
+}
+
 static const char *kPrefsIdentifier = "GpDisplayDriverSDL_GL2";
 static uint32_t kPrefsVersion = 1;
 
@@ -56,6 +70,7 @@ struct GpDisplayDriver_SDL_GL2_Prefs
 namespace GpBinarizedShaders
 {
 	extern const char *g_drawQuadV_GL2;
+	extern const char *g_drawQuadBatchV_GL2;
 
 	extern const char *g_drawQuadPalettePF_GL2;
 	extern const char *g_drawQuadPalettePNF_GL2;
@@ -102,6 +117,12 @@ struct GpGLFunctions
 	PFNGLCHECKFRAMEBUFFERSTATUSPROC CheckFramebufferStatus;
 	PFNGLDELETEFRAMEBUFFERSPROC DeleteFramebuffers;
 
+	PFNGLGENRENDERBUFFERSPROC GenRenderbuffers;
+	PFNGLBINDRENDERBUFFERPROC BindRenderbuffer;
+	PFNGLRENDERBUFFERSTORAGEPROC RenderbufferStorage;
+	PFNGLFRAMEBUFFERRENDERBUFFERPROC FramebufferRenderbuffer;
+	PFNGLDELETERENDERBUFFERSPROC DeleteRenderbuffers;
+
 	PFNGLGENBUFFERSPROC GenBuffers;
 	PFNGLBUFFERDATAPROC BufferData;
 	PFNGLBINDBUFFERPROC BindBuffer;
@@ -152,7 +173,12 @@ struct GpGLFunctions
 
 	PFNGLGETERRORPROC GetError;
 
+	// Optional, only used for streaming uploads
+	PFNGLMAPBUFFERRANGEPROC MapBufferRange;
+	PFNGLUNMAPBUFFERPROC UnmapBuffer;
+
 	bool LookUpFunctions();
+	bool LookUpStreamingFunctions();
 };
 
 static void CheckGLError(const GpGLFunctions &gl, IGpLogDriver *logger)
@@ -273,6 +299,43 @@ GLuint GpGLRenderTargetView::GetID() const
 	return m_id;
 }
 
+class GpGLRenderbuffer final : public GpGLObjectImpl<GpGLRenderbuffer>
+{
+public:
+	GpGLRenderbuffer();
+	~GpGLRenderbuffer();
+
+	bool Init() override;
+	GLuint GetID() const;
+
+private:
+	GLuint m_id;
+};
+
+
+GpGLRenderbuffer::GpGLRenderbuffer()
+	: m_id(0)
+{
+}
+
+GpGLRenderbuffer::~GpGLRenderbuffer()
+{
+	if (m_id)
+		m_gl->DeleteRenderbuffers(1, &m_id);
+}
+
+bool GpGLRenderbuffer::Init()
+{
+	m_gl->GenRenderbuffers(1, &m_id);
+
+	return m_id != 0;
+}
+
+GLuint GpGLRenderbuffer::GetID() const
+{
+	return m_id;
+}
+
 class GpGLTexture final : public GpGLObjectImpl<GpGLTexture>
 {
 public:
@@ -582,30 +645,137 @@ GLuint GpGLShader<TShaderType>::GetID() const
 	return m_id;
 }
 
+class GpDisplayDriverSurface_GL2;
+
+namespace GpPresentCommandTypes
+{
+	enum GpPresentCommandType
+	{
+		kCreateSurface,
+		kRecreateSurface,
+		kDestroySurface,
+		kUpload,
+		kUploadEntire,
+		kUpdatePalette,
+		kResetResources,
+		kDrawSurface,
+	};
+}
+
+typedef GpPresentCommandTypes::GpPresentCommandType GpPresentCommandType_t;
+
+// In threaded present mode, everything that touches GL is recorded as a command and replayed by the render thread
+struct GpPresentCommand
+{
+	GpPresentCommandType_t m_type;
+	GpDisplayDriverSurface_GL2 *m_surface;
+	int32_t m_x;
+	int32_t m_y;
+	size_t m_width;
+	size_t m_height;
+	size_t m_pitch;
+	size_t m_dataOffset;	// Offset of the pixel or palette data in the packet data
+	size_t m_dataSize;
+	GpDisplayDriverSurfaceEffects m_effects;
+};
+
+// Display state that the GL code renders with
+struct GpPresentState
+{
+	uint32_t m_windowWidthPhysical;
+	uint32_t m_windowHeightPhysical;
+	uint32_t m_windowWidthVirtual;
+	uint32_t m_windowHeightVirtual;
+	float m_pixelScaleX;
+	float m_pixelScaleY;
+	float m_bgColor[4];
+	bool m_useICCProfile;
+};
+
+struct GpPresentPacket
+{
+	std::vector<GpPresentCommand> m_commands;
+	std::vector<uint8_t> m_data;
+	GpPresentState m_state;
+
+	void Clear();
+	void MergeNewer(const GpPresentPacket &newer);
+
+private:
+	void RemoveSupersededCommands();
+};
+
+// Hands out regions of a shared texture to surfaces too thin to be worth a texture of their own.  The texture is split
+// into shelves, full-width bands stacked from the top that each hold surfaces of about the same height side by side.
+class GpGLSurfaceAtlas
+{
+public:
+	static const size_t kDimension = 2048;
+
+	GpGLSurfaceAtlas();
+
+	bool Allocate(size_t width, size_t height, size_t &outX, size_t &outY);
+	void Free(size_t x, size_t y, size_t width, size_t height);
+	bool IsEmpty() const;
+
+private:
+	static const size_t kShelfHeightGranularity = 8;
+	static const size_t kPadding = 1;	// Keeps neighbors from bleeding in when a surface is drawn scaled
+
+	struct Span
+	{
+		size_t m_x;
+		size_t m_width;
+	};
+
+	struct Shelf
+	{
+		size_t m_y;
+		size_t m_height;
+		size_t m_numAllocations;
+		std::vector<Span> m_freeSpans;	// Sorted by position
+	};
+
+	std::vector<Shelf> m_shelves;
+	size_t m_shelvesHeight;
+	size_t m_numAllocations;
+};
+
 class GpDisplayDriverSurface_GL2 : public IGpDisplayDriverSurface
 {
 public:
 	GpDisplayDriverSurface_GL2(GpDisplayDriver_SDL_GL2 *driver, size_t width, size_t height, size_t pitch, GpGLTexture *texture, GpPixelFormat_t pixelFormat, IGpDisplayDriver::SurfaceInvalidateCallback_t invalidateCallback, void *invalidateContext);
-	~GpDisplayDriverSurface_GL2();
 
-	static GpDisplayDriverSurface_GL2 *Create(GpDisplayDriver_SDL_GL2 *driver, size_t width, size_t height, size_t pitch, GpPixelFormat_t pixelFormat, GpDisplayDriverSurface_GL2 *prevSurface, IGpDisplayDriver::SurfaceInvalidateCallback_t invalidateCallback, void *invalidateContext);
+	static GpDisplayDriverSurface_GL2 *Create(GpDisplayDriver_SDL_GL2 *driver, size_t width, size_t height, size_t pitch, GpPixelFormat_t pixelFormat, IGpDisplayDriver::SurfaceInvalidateCallback_t invalidateCallback, void *invalidateContext);
 
 	void Upload(const void *data, size_t x, size_t y, size_t width, size_t height, size_t pitch);
 	void UploadEntire(const void *data, size_t pitch);
 	void Destroy();
 
+	void ExecuteUpload(const void *data, size_t x, size_t y, size_t width, size_t height, size_t pitch);
+	void ExecuteUploadEntire(const void *data, size_t pitch);
+	void Delete();
+
+	void Link(GpDisplayDriverSurface_GL2 *prevSurface);
+	void Unlink();
+
 	void DestroyAll();
 	bool RecreateAll();
+	bool RecreateSingle();
 
 	size_t GetImageWidth() const;
 	size_t GetPaddedTextureWidth() const;
 	size_t GetHeight() const;
 	GpPixelFormat_t GetPixelFormat() const;
 	GpGLTexture *GetTexture() const;
+	void GetTextureRegion(float *outUVRect) const;
+
+	bool HasQueuedDraws() const;
+	void SetHasQueuedDraws(bool hasQueuedDraws);
 
 private:
-	bool Init(GpDisplayDriverSurface_GL2 *prevSurface);
-	bool RecreateSingle();
+	bool Init();
+	void ReleaseAtlasRegion();
 	GLenum ResolveGLFormat() const;
 	GLenum ResolveGLInternalFormat() const;
 	GLenum ResolveGLType() const;
@@ -618,6 +788,13 @@ private:
 	size_t m_pitch;
 	size_t m_height;
 
+	// Surfaces in the atlas share its texture, starting at this position
+	bool m_isInAtlas;
+	size_t m_atlasX;
+	size_t m_atlasY;
+
+	bool m_hasQueuedDraws;
+
 	GpDisplayDriver_SDL_GL2 *m_driver;
 	GpDisplayDriverSurface_GL2 *m_next;
 	GpDisplayDriverSurface_GL2 *m_prev;
@@ -697,6 +874,7 @@ public:
 	bool IsFullScreen() const override;
 	const GpDisplayDriverProperties &GetProperties() const override;
 	IGpPrefsHandler *GetPrefsHandler() const override;
+	void GetFrameStats(GpDisplayDriverFrameStats &outStats) const override;
 
 	bool SupportsSizedFormats() const;
 
@@ -709,7 +887,29 @@ public:
 
 	template<GLuint TShaderType> GpComPtr<GpGLShader<TShaderType> > CreateShader(const char *shaderSrc);
 
+	bool StreamTextureRegion(GpGLTexture *texture, size_t x, size_t y, size_t width, size_t height, size_t pixelSize, GLenum glFormat, GLenum glType, const void *data, size_t pitch);
+	void AddUploadStats(size_t numBytes, std::chrono::high_resolution_clock::duration uploadTime);
+
+	void FlushDrawsUsingSurface(GpDisplayDriverSurface_GL2 *surface);
+	GpGLTexture *AllocateAtlasRegion(size_t width, size_t height, GpPixelFormat_t pixelFormat, size_t &outX, size_t &outY);
+	void ReleaseAtlasRegion(size_t x, size_t y, size_t width, size_t height);
+
+	bool IsPresentThreaded() const;
+	GpPresentCommand *RecordPresentCommand(GpPresentCommandType_t commandType, GpDisplayDriverSurface_GL2 *surface);
+	uint8_t *RecordPresentData(GpPresentCommand *command, size_t size);
+
 private:
+	static const size_t kNumStreamingUploadBuffers = 4;
+	static const size_t kNumPresentPackets = 3;
+	static const size_t kMaxMergedPresentDataSize = 32 * 1024 * 1024;
+	static const int kMaxPresentTicksBehind = 4;
+
+	// Quad indices are 16-bit, so a batch can't address more than 65536 vertices
+	static const size_t kMaxDrawBatchQuads = 16384;
+
+	// 8-bit surfaces this thin or thinner (window chrome, menu bar, scroll bars) are packed into the atlas
+	static const size_t kMaxAtlasSurfaceThickness = 32;
+
 	struct DrawQuadPixelFloatConstants
 	{
 		float m_modulation[4];
@@ -722,6 +922,24 @@ private:
 		float m_unused[3];
 	};
 
+	struct DrawQuadProgram;
+
+	struct DrawBatchVertex
+	{
+		GLfloat m_pos[3];
+		GLfloat m_texCoord[4];
+	};
+
+	struct DrawBatchQuad
+	{
+		DrawQuadProgram *m_program;
+		GpGLTexture *m_texture;
+		GpDisplayDriverSurface_GL2 *m_surface;
+		size_t m_effectsIndex;
+		size_t m_sequence;
+		bool m_usesPalette;
+	};
+
 	struct CompactedPresentHistoryItem
 	{
 		std::chrono::time_point<std::chrono::high_resolution_clock>::duration m_timestamp;
@@ -743,7 +961,30 @@ private:
 
 	void ScaleVirtualScreen();
 
+	void ExecuteDrawSurface(GpDisplayDriverSurface_GL2 *surface, int32_t x, int32_t y, size_t width, size_t height, const GpDisplayDriverSurfaceEffects *effects);
+	void ApplyDrawEffects(const DrawQuadProgram *program, const GpDisplayDriverSurfaceEffects &effects);
+	void EndDraws();
+	void ExecuteUpdatePalette(const void *paletteData);
+
+	void CapturePresentState(GpPresentState &state) const;
+	void BeginFrame();
+	void ResetFrameUploadStats();
+	void LogFrameUploadStats();
+	void RecordTickStats(bool isCatchUp);
+	void RecordPresentStats();
+
 	bool SyncRender();
+	bool SyncRenderThreaded();
+
+	bool StartPresentThread();
+	void StopPresentThread();
+	void DestroyPresentThreadObjects();
+	void PublishPresentPacket();
+	bool IsPresentThreadFailed();
+	void PresentThreadMain();
+	bool ExecutePresentPacket(const GpPresentPacket &packet);
+
+	static int PresentThreadFunc(void *context);
 
 	GpGLFunctions m_gl;
 	GpDisplayDriverProperties m_properties;
@@ -751,9 +992,8 @@ private:
 	struct DrawQuadProgram
 	{
 		GpComPtr<GpGLProgram> m_program;
-		GLint m_vertexNDCOriginAndDimensionsLocation;
-		GLint m_vertexSurfaceDimensionsLocation;
-		GLint m_vertexPosUVLocation;
+		GLint m_vertexNDCPosLocation;
+		GLint m_vertexTexCoordLocation;
 		GLint m_pixelModulationLocation;
 		GLint m_pixelFlickerAxisLocation;
 		GLint m_pixelFlickerStartThresholdLocation;
@@ -789,8 +1029,15 @@ private:
 		GpComPtr<GpGLBuffer> m_quadVertexBufferKeepalive;
 		GpComPtr<GpGLBuffer> m_quadIndexBuffer;
 
+		GpComPtr<GpGLRenderbuffer> m_virtualScreenDepthBuffer;
+
+		GpComPtr<GpGLVertexArray> m_drawBatchVertexArray;
+		GpComPtr<GpGLBuffer> m_drawBatchVertexBuffer;
+
 		GpComPtr<GpGLTexture> m_paletteTexture;
 
+		GpComPtr<GpGLBuffer> m_streamingUploadBuffers[kNumStreamingUploadBuffers];
+
 		BlitQuadProgram m_scaleQuadProgram;
 		BlitQuadProgram m_copyQuadProgram;
 
@@ -867,9 +1114,322 @@ private:
 	uint8_t *m_paletteData;
 
 	bool m_textInputEnabled;
+
+	bool m_useStreamingUploads;
+	size_t m_nextStreamingUploadBuffer;
+
+	size_t m_frameUploadBytes;
+	unsigned int m_frameUploadCount;
+	std::chrono::high_resolution_clock::duration m_frameUploadTime;
+	unsigned int m_frameDrawCalls;
+
+	// Guarded by the present mutex in threaded present mode, since presents are counted on the render thread
+	GpDisplayDriverFrameStats m_frameStats;
+	std::chrono::high_resolution_clock::time_point m_lastPresentTime;
+	unsigned int m_ticksSincePresent;
+
+	// The GL code only reads the display state from here.  It's captured from the members above when a frame
+	// is rendered, or when a packet is published in threaded present mode.
+	GpPresentState m_presentState;
+
+	// Draws are queued until EndDraws, or until something changes a texture that a queued draw reads.  Each quad
+	// gets a depth from its draw order, so the batch can be drawn grouped by program and texture without changing
+	// which window ends up on top.
+	std::vector<DrawBatchQuad> m_drawBatchQuads;
+	std::vector<DrawBatchVertex> m_drawBatchVertices;
+	std::vector<DrawBatchVertex> m_drawBatchSortedVertices;
+	std::vector<GpDisplayDriverSurfaceEffects> m_drawBatchEffects;
+
+	// Shared texture for the thin 8-bit surfaces.  Only touched by the thread that owns the GL context.
+	GpGLSurfaceAtlas m_surfaceAtlas;
+	GpComPtr<GpGLTexture> m_surfaceAtlasTexture;
+
+	// Threaded present mode.  Packets are triple-buffered: the game thread records into the write packet, publishes
+	// it as the ready packet, and the render thread swaps the ready packet for the one it last rendered.
+	bool m_isPresentThreaded;
+	IGpMutex *m_presentMutex;
+	IGpThreadEvent *m_presentWakeEvent;
+	IGpThreadEvent *m_presentTakenEvent;
+	IGpThreadEvent *m_presentExitEvent;
+	GpPresentPacket m_presentPackets[kNumPresentPackets];
+	size_t m_presentWriteIndex;
+	size_t m_presentReadyIndex;
+	size_t m_presentRenderIndex;
+	bool m_presentHasReady;
+	bool m_presentQuit;
+	bool m_presentFailed;
+	std::chrono::high_resolution_clock::time_point m_presentNextTickTime;
 };
 
 
+void GpPresentPacket::Clear()
+{
+	m_commands.clear();
+	m_data.clear();
+}
+
+void GpPresentPacket::MergeNewer(const GpPresentPacket &newer)
+{
+	// Draws from this packet are superseded, but everything else changes state that later frames depend on
+	size_t numKept = 0;
+	for (size_t i = 0; i < m_commands.size(); i++)
+	{
+		if (m_commands[i].m_type != GpPresentCommandTypes::kDrawSurface)
+			m_commands[numKept++] = m_commands[i];
+	}
+	m_commands.resize(numKept);
+
+	const size_t dataBase = m_data.size();
+	m_data.insert(m_data.end(), newer.m_data.begin(), newer.m_data.end());
+
+	for (size_t i = 0; i < newer.m_commands.size(); i++)
+	{
+		m_commands.push_back(newer.m_commands[i]);
+		m_commands.back().m_dataOffset += dataBase;
+	}
+
+	m_state = newer.m_state;
+
+	RemoveSupersededCommands();
+}
+
+void GpPresentPacket::RemoveSupersededCommands()
+{
+	// Surfaces are usually uploaded every frame, so when frames pile up, most of the uploads are overwritten by
+	// later ones.  Going backwards, an upload is dropped if a later upload to the same surface covers it and
+	// nothing draws the surface in between, and a palette update is dropped if a later one replaces it.
+	struct CoveredRegion
+	{
+		const GpDisplayDriverSurface_GL2 *m_surface;
+		int32_t m_x;
+		int32_t m_y;
+		size_t m_width;
+		size_t m_height;
+		bool m_isEntire;
+	};
+
+	std::vector<CoveredRegion> coveredRegions;
+	std::vector<bool> isSuperseded(m_commands.size(), false);
+	bool paletteReplaced = false;
+	bool anySuperseded = false;
+
+	for (size_t i = m_commands.size(); i > 0; i--)
+	{
+		const GpPresentCommand &command = m_commands[i - 1];
+
+		switch (command.m_type)
+		{
+		case GpPresentCommandTypes::kUpload:
+		case GpPresentCommandTypes::kUploadEntire:
+			{
+				const bool isEntire = (command.m_type == GpPresentCommandTypes::kUploadEntire);
+				bool covered = false;
+				for (size_t r = 0; r < coveredRegions.size() && !covered; r++)
+				{
+					const CoveredRegion &region = coveredRegions[r];
+					if (region.m_surface != command.m_surface)
+						continue;
+
+					if (region.m_isEntire)
+						covered = true;
+					else if (!isEntire)
+						covered = (command.m_x >= region.m_x && command.m_y >= region.m_y
+							&& static_cast<size_t>(command.m_x) + command.m_width <= static_cast<size_t>(region.m_x) + region.m_width
+							&& static_cast<size_t>(command.m_y) + command.m_height <= static_cast<size_t>(region.m_y) + region.m_height);
+				}
+
+				if (covered)
+				{
+					isSuperseded[i - 1] = true;
+					anySuperseded = true;
+				}
+				else
+				{
+					CoveredRegion region;
+					region.m_surface = command.m_surface;
+					region.m_x = command.m_x;
+					region.m_y = command.m_y;
+					region.m_width = command.m_width;
+					region.m_height = command.m_height;
+					region.m_isEntire = isEntire;
+					coveredRegions.push_back(region);
+				}
+			}
+			break;
+		case GpPresentCommandTypes::kCreateSurface:
+		case GpPresentCommandTypes::kDrawSurface:
+			{
+				// Earlier uploads are visible to this draw, and a surface created here may reuse the address of
+				// one destroyed earlier
+				size_t numKept = 0;
+				for (size_t r = 0; r < coveredRegions.size(); r++)
+				{
+					if (coveredRegions[r].m_surface != command.m_surface)
+						coveredRegions[numKept++] = coveredRegions[r];
+				}
+				coveredRegions.resize(numKept);
+
+				if (command.m_type == GpPresentCommandTypes::kDrawSurface)
+					paletteReplaced = false;
+			}
+			break;
+		case GpPresentCommandTypes::kUpdatePalette:
+			if (paletteReplaced)
+			{
+				isSuperseded[i - 1] = true;
+				anySuperseded = true;
+			}
+			paletteReplaced = true;
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (!anySuperseded)
+		return;
+
+	// Data is recorded in command order, so the remaining data can be packed down in place
+	size_t numKept = 0;
+	size_t dataSize = 0;
+	for (size_t i = 0; i < m_commands.size(); i++)
+	{
+		if (isSuperseded[i])
+			continue;
+
+		GpPresentCommand &command = m_commands[i];
+		if (command.m_dataSize > 0 && command.m_dataOffset != dataSize)
+			memmove(m_data.data() + dataSize, m_data.data() + command.m_dataOffset, command.m_dataSize);
+
+		command.m_dataOffset = dataSize;
+		dataSize += command.m_dataSize;
+
+		m_commands[numKept++] = command;
+	}
+
+	m_commands.resize(numKept);
+	m_data.resize(dataSize);
+}
+
+GpGLSurfaceAtlas::GpGLSurfaceAtlas()
+	: m_shelvesHeight(0)
+	, m_numAllocations(0)
+{
+}
+
+bool GpGLSurfaceAtlas::Allocate(size_t width, size_t height, size_t &outX, size_t &outY)
+{
+	const size_t paddedWidth = width + kPadding;
+	const size_t paddedHeight = height + kPadding;
+	if (paddedWidth > kDimension || paddedHeight > kDimension)
+		return false;
+
+	const size_t shelfHeight = std::min<size_t>(kDimension, (paddedHeight + kShelfHeightGranularity - 1) / kShelfHeightGranularity * kShelfHeightGranularity);
+
+	for (size_t i = 0; i < m_shelves.size(); i++)
+	{
+		Shelf &shelf = m_shelves[i];
+
+		// Empty shelves can be taken over by shorter surfaces
+		if (shelf.m_height != shelfHeight && (shelf.m_numAllocations > 0 || shelf.m_height < shelfHeight))
+			continue;
+
+		for (size_t s = 0; s < shelf.m_freeSpans.size(); s++)
+		{
+			Span &span = shelf.m_freeSpans[s];
+			if (span.m_width < paddedWidth)
+				continue;
+
+			outX = span.m_x;
+			outY = shelf.m_y;
+
+			span.m_x += paddedWidth;
+			span.m_width -= paddedWidth;
+			if (span.m_width == 0)
+				shelf.m_freeSpans.erase(shelf.m_freeSpans.begin() + s);
+
+			shelf.m_numAllocations++;
+			m_numAllocations++;
+			return true;
+		}
+	}
+
+	if (kDimension - m_shelvesHeight < shelfHeight)
+		return false;
+
+	m_shelves.push_back(Shelf());
+
+	Shelf &shelf = m_shelves.back();
+	shelf.m_y = m_shelvesHeight;
+	shelf.m_height = shelfHeight;
+	shelf.m_numAllocations = 1;
+
+	if (paddedWidth < kDimension)
+	{
+		Span span;
+		span.m_x = paddedWidth;
+		span.m_width = kDimension - paddedWidth;
+		shelf.m_freeSpans.push_back(span);
+	}
+
+	m_shelvesHeight += shelfHeight;
+	m_numAllocations++;
+
+	outX = 0;
+	outY = shelf.m_y;
+
+	return true;
+}
+
+void GpGLSurfaceAtlas::Free(size_t x, size_t y, size_t width, size_t height)
+{
+	for (size_t i = 0; i < m_shelves.size(); i++)
+	{
+		Shelf &shelf = m_shelves[i];
+		if (shelf.m_y != y)
+			continue;
+
+		std::vector<Span> &spans = shelf.m_freeSpans;
+
+		size_t insertPos = 0;
+		while (insertPos < spans.size() && spans[insertPos].m_x < x)
+			insertPos++;
+
+		Span span;
+		span.m_x = x;
+		span.m_width = width + kPadding;
+		spans.insert(spans.begin() + insertPos, span);
+
+		if (insertPos + 1 < spans.size() && spans[insertPos].m_x + spans[insertPos].m_width == spans[insertPos + 1].m_x)
+		{
+			spans[insertPos].m_width += spans[insertPos + 1].m_width;
+			spans.erase(spans.begin() + insertPos + 1);
+		}
+
+		if (insertPos > 0 && spans[insertPos - 1].m_x + spans[insertPos - 1].m_width == spans[insertPos].m_x)
+		{
+			spans[insertPos - 1].m_width += spans[insertPos].m_width;
+			spans.erase(spans.begin() + insertPos);
+		}
+
+		shelf.m_numAllocations--;
+		m_numAllocations--;
+		break;
+	}
+
+	// Empty shelves at the end give their space back for shelves of any height
+	while (!m_shelves.empty() && m_shelves.back().m_numAllocations == 0)
+	{
+		m_shelvesHeight -= m_shelves.back().m_height;
+		m_shelves.pop_back();
+	}
+}
+
+bool GpGLSurfaceAtlas::IsEmpty() const
+{
+	return m_numAllocations == 0;
+}
+
 GpDisplayDriverSurface_GL2::GpDisplayDriverSurface_GL2(GpDisplayDriver_SDL_GL2 *driver, size_t width, size_t height, size_t pitch, GpGLTexture *texture, GpPixelFormat_t pixelFormat, IGpDisplayDriver::SurfaceInvalidateCallback_t invalidateCallback, void *invalidateContext)
 	: m_gl(driver->GetGLFunctions())
 	, m_texture(texture)
@@ -878,6 +1438,10 @@ GpDisplayDriverSurface_GL2::GpDisplayDriverSurface_GL2(GpDisplayDriver_SDL_GL2 *
 	, m_paddedTextureWidth(0)
 	, m_height(height)
 	, m_pitch(pitch)
+	, m_isInAtlas(false)
+	, m_atlasX(0)
+	, m_atlasY(0)
+	, m_hasQueuedDraws(false)
 	, m_driver(driver)
 	, m_prev(nullptr)
 	, m_next(nullptr)
@@ -913,28 +1477,22 @@ GpDisplayDriverSurface_GL2::GpDisplayDriverSurface_GL2(GpDisplayDriver_SDL_GL2 *
 	m_paddedTextureWidth = width + paddingPixels;
 }
 
-GpDisplayDriverSurface_GL2::~GpDisplayDriverSurface_GL2()
-{
-	if (m_prev)
-		m_prev->m_next = m_next;
-	if (m_next)
-		m_next->m_prev = m_prev;
-
-	m_driver->UnlinkSurface(this, m_prev, m_next);
-}
-
-GpDisplayDriverSurface_GL2 *GpDisplayDriverSurface_GL2::Create(GpDisplayDriver_SDL_GL2 *driver, size_t width, size_t height, size_t pitch, GpPixelFormat_t pixelFormat, GpDisplayDriverSurface_GL2 *prevSurface, IGpDisplayDriver::SurfaceInvalidateCallback_t invalidateCallback, void *invalidateContext)
+GpDisplayDriverSurface_GL2 *GpDisplayDriverSurface_GL2::Create(GpDisplayDriver_SDL_GL2 *driver, size_t width, size_t height, size_t pitch, GpPixelFormat_t pixelFormat, IGpDisplayDriver::SurfaceInvalidateCallback_t invalidateCallback, void *invalidateContext)
 {
-	GpComPtr<GpGLTexture> texture = GpComPtr<GpGLTexture>(GpGLTexture::Create(driver));
-	if (!texture)
-		return nullptr;
-
 	GpDisplayDriverSurface_GL2 *surface = static_cast<GpDisplayDriverSurface_GL2*>(malloc(sizeof(GpDisplayDriverSurface_GL2)));
 	if (!surface)
 		return nullptr;
 
-	new (surface) GpDisplayDriverSurface_GL2(driver, width, height, pitch, texture, pixelFormat, invalidateCallback, invalidateContext);
-	if (!surface->Init(prevSurface))
+	new (surface) GpDisplayDriverSurface_GL2(driver, width, height, pitch, nullptr, pixelFormat, invalidateCallback, invalidateContext);
+
+	if (driver->IsPresentThreaded())
+	{
+		// The render thread owns the context, so it creates the texture
+		driver->RecordPresentCommand(GpPresentCommandTypes::kCreateSurface, surface);
+		return surface;
+	}
+
+	if (!surface->RecreateSingle())
 	{
 		surface->Destroy();
 		return nullptr;
@@ -945,40 +1503,173 @@ GpDisplayDriverSurface_GL2 *GpDisplayDriverSurface_GL2::Create(GpDisplayDriver_S
 
 void GpDisplayDriverSurface_GL2::Upload(const void *data, size_t x, size_t y, size_t width, size_t height, size_t pitch)
 {
-	m_gl->BindTexture(GL_TEXTURE_2D, m_texture->GetID());
-	m_gl->TexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, ResolveGLFormat(), ResolveGLType(), data);
-	m_gl->BindTexture(GL_TEXTURE_2D, 0);
+	if (!m_driver->IsPresentThreaded())
+	{
+		ExecuteUpload(data, x, y, width, height, pitch);
+		return;
+	}
+
+	const size_t pixelSize = m_pitch / m_paddedTextureWidth;
+	const size_t rowSize = width * pixelSize;
+	if (rowSize * height == 0)
+		return;
+
+	GpPresentCommand *command = m_driver->RecordPresentCommand(GpPresentCommandTypes::kUpload, this);
+	command->m_x = static_cast<int32_t>(x);
+	command->m_y = static_cast<int32_t>(y);
+	command->m_width = width;
+	command->m_height = height;
+	command->m_pitch = rowSize;
+
+	// Rows are packed tightly, since the source rows are usually only part of the surface
+	uint8_t *packetData = m_driver->RecordPresentData(command, rowSize * height);
+	const uint8_t *srcBytes = static_cast<const uint8_t*>(data);
+	for (size_t row = 0; row < height; row++)
+		memcpy(packetData + row * rowSize, srcBytes + row * pitch, rowSize);
 }
 
 void GpDisplayDriverSurface_GL2::UploadEntire(const void *data, size_t pitch)
 {
 	assert(pitch == m_pitch);
 
-	CheckGLError(*m_gl, m_driver->GetProperties().m_logger);
-
-	const GLint internalFormat = ResolveGLInternalFormat();
-	const GLenum glFormat = ResolveGLFormat();
-	const GLenum glType = ResolveGLType();
+	if (!m_driver->IsPresentThreaded())
+	{
+		ExecuteUploadEntire(data, pitch);
+		return;
+	}
 
-	m_gl->BindTexture(GL_TEXTURE_2D, m_texture->GetID());
-	m_gl->TexImage2D(GL_TEXTURE_2D, 0, internalFormat, m_paddedTextureWidth, m_height, 0, glFormat, glType, data);
-	m_gl->BindTexture(GL_TEXTURE_2D, 0);
+	GpPresentCommand *command = m_driver->RecordPresentCommand(GpPresentCommandTypes::kUploadEntire, this);
+	command->m_pitch = pitch;
 
-	CheckGLError(*m_gl, m_driver->GetProperties().m_logger);
+	uint8_t *packetData = m_driver->RecordPresentData(command, pitch * m_height);
+	memcpy(packetData, data, pitch * m_height);
 }
 
-void GpDisplayDriverSurface_GL2::Destroy()
+void GpDisplayDriverSurface_GL2::ExecuteUpload(const void *data, size_t x, size_t y, size_t width, size_t height, size_t pitch)
 {
-	this->~GpDisplayDriverSurface_GL2();
-	free(this);
-}
+	if (!m_texture)
+		return;
+
+	const size_t pixelSize = m_pitch / m_paddedTextureWidth;
+	const GLenum glFormat = ResolveGLFormat();
+	const GLenum glType = ResolveGLType();
+
+	m_driver->FlushDrawsUsingSurface(this);
+
+	x += m_atlasX;
+	y += m_atlasY;
+
+	const std::chrono::high_resolution_clock::time_point uploadStartTime = std::chrono::high_resolution_clock::now();
+
+	if (m_driver->StreamTextureRegion(m_texture, x, y, width, height, pixelSize, glFormat, glType, data, pitch))
+	{
+		m_driver->AddUploadStats(width * height * pixelSize, std::chrono::high_resolution_clock::now() - uploadStartTime);
+		return;
+	}
+
+	m_gl->BindTexture(GL_TEXTURE_2D, m_texture->GetID());
+
+	// GLES2 has no GL_UNPACK_ROW_LENGTH, so sub-rects narrower than the source pitch go up one row at a time
+	if (width * pixelSize == pitch)
+		m_gl->TexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, glFormat, glType, data);
+	else
+	{
+		const uint8_t *rowData = static_cast<const uint8_t*>(data);
+		for (size_t row = 0; row < height; row++)
+		{
+			m_gl->TexSubImage2D(GL_TEXTURE_2D, 0, x, y + row, width, 1, glFormat, glType, rowData);
+			rowData += pitch;
+		}
+	}
+
+	m_gl->BindTexture(GL_TEXTURE_2D, 0);
+
+	m_driver->AddUploadStats(width * height * pixelSize, std::chrono::high_resolution_clock::now() - uploadStartTime);
+}
+
+void GpDisplayDriverSurface_GL2::ExecuteUploadEntire(const void *data, size_t pitch)
+{
+	if (!m_texture)
+		return;
+
+	CheckGLError(*m_gl, m_driver->GetProperties().m_logger);
+
+	const size_t pixelSize = m_pitch / m_paddedTextureWidth;
+	const GLenum glFormat = ResolveGLFormat();
+	const GLenum glType = ResolveGLType();
+
+	m_driver->FlushDrawsUsingSurface(this);
+
+	const std::chrono::high_resolution_clock::time_point uploadStartTime = std::chrono::high_resolution_clock::now();
+
+	// Texture storage is allocated once in Init, so this only replaces the contents
+	if (!m_driver->StreamTextureRegion(m_texture, m_atlasX, m_atlasY, m_paddedTextureWidth, m_height, pixelSize, glFormat, glType, data, pitch))
+	{
+		m_gl->BindTexture(GL_TEXTURE_2D, m_texture->GetID());
+		m_gl->TexSubImage2D(GL_TEXTURE_2D, 0, m_atlasX, m_atlasY, m_paddedTextureWidth, m_height, glFormat, glType, data);
+		m_gl->BindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	m_driver->AddUploadStats(m_pitch * m_height, std::chrono::high_resolution_clock::now() - uploadStartTime);
+
+	CheckGLError(*m_gl, m_driver->GetProperties().m_logger);
+}
+
+void GpDisplayDriverSurface_GL2::Destroy()
+{
+	Unlink();
+
+	// Commands recorded earlier may still refer to the surface, so the render thread deletes it
+	if (m_driver->IsPresentThreaded())
+		m_driver->RecordPresentCommand(GpPresentCommandTypes::kDestroySurface, this);
+	else
+		Delete();
+}
+
+void GpDisplayDriverSurface_GL2::Delete()
+{
+	m_driver->FlushDrawsUsingSurface(this);
+	ReleaseAtlasRegion();
+
+	this->~GpDisplayDriverSurface_GL2();
+	free(this);
+}
+
+void GpDisplayDriverSurface_GL2::Link(GpDisplayDriverSurface_GL2 *prevSurface)
+{
+	m_prev = prevSurface;
+	if (prevSurface)
+		prevSurface->m_next = this;
+}
+
+void GpDisplayDriverSurface_GL2::Unlink()
+{
+	if (m_prev)
+		m_prev->m_next = m_next;
+	if (m_next)
+		m_next->m_prev = m_prev;
+
+	m_driver->UnlinkSurface(this, m_prev, m_next);
+
+	m_prev = nullptr;
+	m_next = nullptr;
+}
 
 void GpDisplayDriverSurface_GL2::DestroyAll()
 {
+	const bool isPresentThreaded = m_driver->IsPresentThreaded();
+
 	for (GpDisplayDriverSurface_GL2 *scan = this; scan; scan = scan->m_next)
 	{
 		scan->m_invalidateCallback(scan->m_invalidateContext);
-		scan->m_texture = nullptr;
+
+		if (isPresentThreaded)
+			m_driver->RecordPresentCommand(GpPresentCommandTypes::kRecreateSurface, scan);
+		else
+		{
+			scan->ReleaseAtlasRegion();
+			scan->m_texture = nullptr;
+		}
 	}
 }
 
@@ -1018,8 +1709,38 @@ GpGLTexture *GpDisplayDriverSurface_GL2::GetTexture() const
 	return m_texture;
 }
 
+void GpDisplayDriverSurface_GL2::GetTextureRegion(float *outUVRect) const
+{
+	if (m_isInAtlas)
+	{
+		const float atlasScale = 1.0f / static_cast<float>(GpGLSurfaceAtlas::kDimension);
+
+		outUVRect[0] = static_cast<float>(m_atlasX) * atlasScale;
+		outUVRect[1] = static_cast<float>(m_atlasY) * atlasScale;
+		outUVRect[2] = static_cast<float>(m_atlasX + m_imageWidth) * atlasScale;
+		outUVRect[3] = static_cast<float>(m_atlasY + m_height) * atlasScale;
+	}
+	else
+	{
+		outUVRect[0] = 0.f;
+		outUVRect[1] = 0.f;
+		outUVRect[2] = static_cast<float>(m_imageWidth) / static_cast<float>(m_paddedTextureWidth);
+		outUVRect[3] = 1.f;
+	}
+}
+
+bool GpDisplayDriverSurface_GL2::HasQueuedDraws() const
+{
+	return m_hasQueuedDraws;
+}
+
+void GpDisplayDriverSurface_GL2::SetHasQueuedDraws(bool hasQueuedDraws)
+{
+	m_hasQueuedDraws = hasQueuedDraws;
+}
+
 
-bool GpDisplayDriverSurface_GL2::Init(GpDisplayDriverSurface_GL2 *prevSurface)
+bool GpDisplayDriverSurface_GL2::Init()
 {
 	CheckGLError(*m_gl, m_driver->GetProperties().m_logger);
 
@@ -1034,15 +1755,36 @@ bool GpDisplayDriverSurface_GL2::Init(GpDisplayDriverSurface_GL2 *prevSurface)
 
 	CheckGLError(*m_gl, m_driver->GetProperties().m_logger);
 
-	m_prev = prevSurface;
-
 	return true;
 }
 
 bool GpDisplayDriverSurface_GL2::RecreateSingle()
 {
+	m_driver->FlushDrawsUsingSurface(this);
+	ReleaseAtlasRegion();
+
+	m_texture = m_driver->AllocateAtlasRegion(m_paddedTextureWidth, m_height, m_pixelFormat, m_atlasX, m_atlasY);
+	if (m_texture)
+	{
+		m_isInAtlas = true;
+		return true;
+	}
+
 	m_texture = GpGLTexture::Create(m_driver);
-	return m_texture != nullptr && this->Init(m_prev);
+	return m_texture != nullptr && this->Init();
+}
+
+void GpDisplayDriverSurface_GL2::ReleaseAtlasRegion()
+{
+	if (!m_isInAtlas)
+		return;
+
+	m_texture = nullptr;
+	m_driver->ReleaseAtlasRegion(m_atlasX, m_atlasY, m_paddedTextureWidth, m_height);
+
+	m_isInAtlas = false;
+	m_atlasX = 0;
+	m_atlasY = 0;
 }
 
 GLenum GpDisplayDriverSurface_GL2::ResolveGLFormat() const
@@ -1163,6 +1905,24 @@ GpDisplayDriver_SDL_GL2::GpDisplayDriver_SDL_GL2(const GpDisplayDriverProperties
 	, m_lastSurface(nullptr)
 	, m_firstSurface(nullptr)
 	, m_textInputEnabled(false)
+	, m_useStreamingUploads(false)
+	, m_nextStreamingUploadBuffer(0)
+	, m_frameUploadBytes(0)
+	, m_frameUploadCount(0)
+	, m_frameUploadTime(std::chrono::high_resolution_clock::duration::zero())
+	, m_frameDrawCalls(0)
+	, m_ticksSincePresent(0)
+	, m_isPresentThreaded(false)
+	, m_presentMutex(nullptr)
+	, m_presentWakeEvent(nullptr)
+	, m_presentTakenEvent(nullptr)
+	, m_presentExitEvent(nullptr)
+	, m_presentWriteIndex(0)
+	, m_presentReadyIndex(1)
+	, m_presentRenderIndex(2)
+	, m_presentHasReady(false)
+	, m_presentQuit(false)
+	, m_presentFailed(false)
 {
 	m_bgColor[0] = 0.f;
 	m_bgColor[1] = 0.f;
@@ -1176,6 +1936,7 @@ GpDisplayDriver_SDL_GL2::GpDisplayDriver_SDL_GL2(const GpDisplayDriverProperties
 	const intmax_t periodDen = std::chrono::high_resolution_clock::period::den;
 
 	m_frameTimeSliceSize = std::chrono::high_resolution_clock::duration(periodDen * static_cast<intmax_t>(properties.m_frameTimeLockNumerator) / static_cast<intmax_t>(properties.m_frameTimeLockDenominator) / periodNum);
+	m_frameStats.m_tickIntervalUSec = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(m_frameTimeSliceSize).count());
 
 	m_waitCursor = SDL_CreateSystemCursor(SDL_SYSTEM_CURSOR_WAIT);
 	m_iBeamCursor = SDL_CreateSystemCursor(SDL_SYSTEM_CURSOR_IBEAM);
@@ -1186,6 +1947,8 @@ GpDisplayDriver_SDL_GL2::GpDisplayDriver_SDL_GL2(const GpDisplayDriverProperties
 		m_paletteData++;
 
 	memset(m_paletteData, 255, 256 * 4);
+
+	CapturePresentState(m_presentState);
 }
 
 template<class T>
@@ -1221,6 +1984,12 @@ bool GpGLFunctions::LookUpFunctions()
 	LOOKUP_FUNC(CheckFramebufferStatus);
 	LOOKUP_FUNC(DeleteFramebuffers);
 
+	LOOKUP_FUNC(GenRenderbuffers);
+	LOOKUP_FUNC(BindRenderbuffer);
+	LOOKUP_FUNC(RenderbufferStorage);
+	LOOKUP_FUNC(FramebufferRenderbuffer);
+	LOOKUP_FUNC(DeleteRenderbuffers);
+
 	LOOKUP_FUNC(CreateProgram);
 	LOOKUP_FUNC(DeleteProgram);
 	LOOKUP_FUNC(LinkProgram);
@@ -1275,8 +2044,18 @@ bool GpGLFunctions::LookUpFunctions()
 	return true;
 }
 
+bool GpGLFunctions::LookUpStreamingFunctions()
+{
+	LOOKUP_FUNC(MapBufferRange);
+	LOOKUP_FUNC(UnmapBuffer);
+
+	return true;
+}
+
 GpDisplayDriver_SDL_GL2::~GpDisplayDriver_SDL_GL2()
 {
+	StopPresentThread();
+
 	SDL_DestroyWindow(m_window);
 }
 
@@ -1358,9 +2137,28 @@ bool GpDisplayDriver_SDL_GL2::Init()
 	if (!m_gl.LookUpFunctions())
 		return false;
 
+	if (m_properties.m_streamTextureUploads)
+	{
+		if (SDL_GL_ExtensionSupported("GL_ARB_pixel_buffer_object") && SDL_GL_ExtensionSupported("GL_ARB_map_buffer_range") && m_gl.LookUpStreamingFunctions())
+			m_useStreamingUploads = true;
+		else
+		{
+			if (logger)
+				logger->Printf(IGpLogDriver::Category_Warning, "Streaming texture uploads were requested, but pixel unpack buffers aren't supported, using direct uploads");
+		}
+	}
+
 	m_initialWidthVirtual = m_windowWidthVirtual;
 	m_initialHeightVirtual = m_windowHeightVirtual;
 
+#ifndef __EMSCRIPTEN__
+	if (m_properties.m_threadedPresent && !StartPresentThread())
+	{
+		if (logger)
+			logger->Printf(IGpLogDriver::Category_Warning, "Threaded present was requested, but the render thread couldn't be started, presenting on the game thread");
+	}
+#endif
+
 	return true;
 }
 
@@ -1478,27 +2276,49 @@ void GpDisplayDriver_SDL_GL2::ServeTicks(int ticks)
 				if (logger)
 					logger->Printf(IGpLogDriver::Category_Information, "Resetting OpenGL context.  Physical: %i x %i   Virtual %i x %i", static_cast<int>(m_windowWidthPhysical), static_cast<int>(m_windowHeightPhysical), static_cast<int>(m_windowWidthVirtual), static_cast<int>(m_windowHeightVirtual));
 
-				// Drop everything and reset
-				m_res = InstancedResources();
-
-				if (m_firstSurface)
-					m_firstSurface->DestroyAll();
-
-				if (!InitResources(m_windowWidthPhysical, m_windowHeightPhysical, m_windowWidthVirtual, m_windowHeightVirtual))
+				if (m_isPresentThreaded)
 				{
-					if (logger)
-						logger->Printf(IGpLogDriver::Category_Information, "Terminating display driver due to InitResources failing");
+					// The render thread resets its resources when it reaches this point in the command stream,
+					// followed by recreating the surface textures
+					RecordPresentCommand(GpPresentCommandTypes::kResetResources, nullptr);
 
-					break;
+					if (m_firstSurface)
+						m_firstSurface->DestroyAll();
 				}
+				else
+				{
+					// Drop everything and reset
+					m_res = InstancedResources();
+
+					if (m_firstSurface)
+						m_firstSurface->DestroyAll();
+
+					CapturePresentState(m_presentState);
+
+					if (!InitResources(m_windowWidthPhysical, m_windowHeightPhysical, m_windowWidthVirtual, m_windowHeightVirtual))
+					{
+						if (logger)
+							logger->Printf(IGpLogDriver::Category_Information, "Terminating display driver due to InitResources failing");
 
-				if (m_firstSurface)
-					m_firstSurface->RecreateAll();
+						break;
+					}
+
+					if (m_firstSurface)
+						m_firstSurface->RecreateAll();
+				}
 
 				m_contextLost = false;
 				continue;
 			}
 
+			if (m_isPresentThreaded && IsPresentThreadFailed())
+			{
+				if (logger)
+					logger->Printf(IGpLogDriver::Category_Information, "Terminating display driver due to the render thread failing");
+
+				break;
+			}
+
 			bool wantTextInput = m_properties.m_systemServices->IsTextInputEnabled();
 			if (wantTextInput != m_textInputEnabled)
 			{
@@ -1527,6 +2347,7 @@ void GpDisplayDriver_SDL_GL2::ServeTicks(int ticks)
 void GpDisplayDriver_SDL_GL2::ForceSync()
 {
 	m_frameTimeAccumulated = std::chrono::nanoseconds::zero();
+	m_presentNextTickTime = std::chrono::high_resolution_clock::now();
 }
 
 static void PostMouseEvent(IGpVOSEventQueue *eventQueue, GpMouseEventType_t eventType, GpMouseButton_t button, int32_t x, int32_t y, float pixelScaleX, float pixelScaleY)
@@ -2047,9 +2868,11 @@ void GpDisplayDriver_SDL_GL2::GetInitialDisplayResolution(unsigned int *width, u
 
 IGpDisplayDriverSurface *GpDisplayDriver_SDL_GL2::CreateSurface(size_t width, size_t height, size_t pitch, GpPixelFormat_t pixelFormat, SurfaceInvalidateCallback_t invalidateCallback, void *invalidateContext)
 {
-	GpDisplayDriverSurface_GL2 *surface = GpDisplayDriverSurface_GL2::Create(this, width, height, pitch, pixelFormat, m_lastSurface, invalidateCallback, invalidateContext);
+	GpDisplayDriverSurface_GL2 *surface = GpDisplayDriverSurface_GL2::Create(this, width, height, pitch, pixelFormat, invalidateCallback, invalidateContext);
 	if (surface)
 	{
+		surface->Link(m_lastSurface);
+
 		m_lastSurface = surface;
 		if (m_firstSurface == nullptr)
 			m_firstSurface = surface;
@@ -2062,18 +2885,34 @@ void GpDisplayDriver_SDL_GL2::DrawSurface(IGpDisplayDriverSurface *surface, int3
 	if (!effects)
 		effects = &gs_defaultEffects;
 
-	GpGLVertexArray *vaPtr = m_res.m_quadVertexArray;
-	size_t vbStride = sizeof(float) * 2;
-	size_t zero = 0;
-
 	GpDisplayDriverSurface_GL2 *glSurface = static_cast<GpDisplayDriverSurface_GL2*>(surface);
+
+	if (!m_isPresentThreaded)
+	{
+		ExecuteDrawSurface(glSurface, x, y, width, height, effects);
+		return;
+	}
+
+	GpPresentCommand *command = RecordPresentCommand(GpPresentCommandTypes::kDrawSurface, glSurface);
+	command->m_x = x;
+	command->m_y = y;
+	command->m_width = width;
+	command->m_height = height;
+	command->m_effects = *effects;
+}
+
+void GpDisplayDriver_SDL_GL2::ExecuteDrawSurface(GpDisplayDriverSurface_GL2 *glSurface, int32_t x, int32_t y, size_t width, size_t height, const GpDisplayDriverSurfaceEffects *effects)
+{
+	if (!glSurface->GetTexture())
+		return;
+
 	GpPixelFormat_t pixelFormat = glSurface->GetPixelFormat();
 
 	DrawQuadProgram *program = nullptr;
 
 	if (pixelFormat == GpPixelFormats::k8BitStandard || pixelFormat == GpPixelFormats::k8BitCustom)
 	{
-		if (m_useICCProfile)
+		if (m_presentState.m_useICCProfile)
 		{
 			if (effects->m_flicker)
 				program = &m_res.m_drawQuadPaletteICCFlickerProgram;
@@ -2094,7 +2933,7 @@ void GpDisplayDriver_SDL_GL2::DrawSurface(IGpDisplayDriverSurface *surface, int3
 	}
 	else if (pixelFormat == GpPixelFormats::kRGB32)
 	{
-		if (m_useICCProfile)
+		if (m_presentState.m_useICCProfile)
 		{
 			if (effects->m_flicker)
 				program = &m_res.m_drawQuad32ICCFlickerProgram;
@@ -2114,84 +2953,187 @@ void GpDisplayDriver_SDL_GL2::DrawSurface(IGpDisplayDriverSurface *surface, int3
 		return;
 	}
 
-	CheckGLError(m_gl, m_properties.m_logger);
+	if (m_drawBatchQuads.size() == kMaxDrawBatchQuads)
+		EndDraws();
 
-	m_gl.UseProgram(program->m_program->GetID());
+	size_t effectsIndex = 0;
+	while (effectsIndex < m_drawBatchEffects.size() && !AreSurfaceEffectsEqual(m_drawBatchEffects[effectsIndex], *effects))
+		effectsIndex++;
 
-	CheckGLError(m_gl, m_properties.m_logger);
+	if (effectsIndex == m_drawBatchEffects.size())
+		m_drawBatchEffects.push_back(*effects);
 
-	{
-		const float twoDivWidth = 2.0f / static_cast<float>(m_windowWidthVirtual);
-		const float negativeTwoDivHeight = -2.0f / static_cast<float>(m_windowHeightVirtual);
+	const size_t sequence = m_drawBatchQuads.size();
 
-		GLfloat ndcOriginAndDimensions[4] =
-		{
+	DrawBatchQuad quad;
+	quad.m_program = program;
+	quad.m_texture = glSurface->GetTexture();
+	quad.m_surface = glSurface;
+	quad.m_effectsIndex = effectsIndex;
+	quad.m_sequence = sequence;
+	quad.m_usesPalette = (pixelFormat == GpPixelFormats::k8BitStandard || pixelFormat == GpPixelFormats::k8BitCustom);
 
-			static_cast<GLfloat>(x) * twoDivWidth - 1.0f,
-			static_cast<GLfloat>(y) * negativeTwoDivHeight + 1.0f,
-			static_cast<GLfloat>(width) * twoDivWidth,
-			static_cast<GLfloat>(height) * negativeTwoDivHeight,
-		};
+	m_drawBatchQuads.push_back(quad);
 
-		GLfloat surfaceDimensions_TextureRegion[4] =
-		{
-			static_cast<GLfloat>(glSurface->GetImageWidth()),
-			static_cast<GLfloat>(glSurface->GetHeight()),
-			static_cast<GLfloat>(static_cast<float>(glSurface->GetImageWidth()) / static_cast<float>(glSurface->GetPaddedTextureWidth())),
-			1.f
-		};
+	const float twoDivWidth = 2.0f / static_cast<float>(m_presentState.m_windowWidthVirtual);
+	const float negativeTwoDivHeight = -2.0f / static_cast<float>(m_presentState.m_windowHeightVirtual);
 
-		m_gl.Uniform4fv(program->m_vertexNDCOriginAndDimensionsLocation, 1, reinterpret_cast<const GLfloat*>(ndcOriginAndDimensions));
-		m_gl.Uniform4fv(program->m_vertexSurfaceDimensionsLocation, 1, reinterpret_cast<const GLfloat*>(surfaceDimensions_TextureRegion));
+	const GLfloat ndcLeft = static_cast<GLfloat>(x) * twoDivWidth - 1.0f;
+	const GLfloat ndcTop = static_cast<GLfloat>(y) * negativeTwoDivHeight + 1.0f;
+	const GLfloat ndcRight = ndcLeft + static_cast<GLfloat>(width) * twoDivWidth;
+	const GLfloat ndcBottom = ndcTop + static_cast<GLfloat>(height) * negativeTwoDivHeight;
 
-		GLfloat modulation[4] = { 1.f, 1.f, 1.f, 1.f };
-		GLfloat flickerAxis[2] = { 0.f, 0.f };
-		GLfloat flickerStart = -1.f;
-		GLfloat flickerEnd = -2.f;
+	// Later draws are nearer, so they still cover earlier ones after the batch is reordered
+	const GLfloat ndcDepth = 1.0f - 2.0f * static_cast<GLfloat>(sequence + 1) / static_cast<GLfloat>(kMaxDrawBatchQuads + 1);
 
-		if (effects->m_flicker)
-		{
-			flickerAxis[0] = effects->m_flickerAxisX;
-			flickerAxis[1] = effects->m_flickerAxisY;
-			flickerStart = effects->m_flickerStartThreshold;
-			flickerEnd = effects->m_flickerEndThreshold;
-		}
+	float uvRect[4];
+	glSurface->GetTextureRegion(uvRect);
+
+	const GLfloat surfaceWidth = static_cast<GLfloat>(glSurface->GetImageWidth());
+	const GLfloat surfaceHeight = static_cast<GLfloat>(glSurface->GetHeight());
 
-		float desaturation = effects->m_desaturation;
+	// The texture coordinate's zw is the position in the surface in pixels, which the flicker effect uses
+	const DrawBatchVertex vertices[4] =
+	{
+		{ { ndcLeft, ndcTop, ndcDepth }, { uvRect[0], uvRect[1], 0.f, 0.f } },
+		{ { ndcRight, ndcTop, ndcDepth }, { uvRect[2], uvRect[1], surfaceWidth, 0.f } },
+		{ { ndcLeft, ndcBottom, ndcDepth }, { uvRect[0], uvRect[3], 0.f, surfaceHeight } },
+		{ { ndcRight, ndcBottom, ndcDepth }, { uvRect[2], uvRect[3], surfaceWidth, surfaceHeight } },
+	};
+
+	for (int i = 0; i < 4; i++)
+		m_drawBatchVertices.push_back(vertices[i]);
 
-		if (effects->m_darken)
-			for (int i = 0; i < 3; i++)
-				modulation[i] = 0.5f;
+	glSurface->SetHasQueuedDraws(true);
+}
+
+void GpDisplayDriver_SDL_GL2::ApplyDrawEffects(const DrawQuadProgram *program, const GpDisplayDriverSurfaceEffects &effects)
+{
+	GLfloat modulation[4] = { 1.f, 1.f, 1.f, 1.f };
+	GLfloat flickerAxis[2] = { 0.f, 0.f };
+	GLfloat flickerStart = -1.f;
+	GLfloat flickerEnd = -2.f;
 
-		m_gl.Uniform4fv(program->m_pixelModulationLocation, 1, modulation);
-		m_gl.Uniform2fv(program->m_pixelFlickerAxisLocation, 1, flickerAxis);
-		m_gl.Uniform1fv(program->m_pixelFlickerStartThresholdLocation, 1, &flickerStart);
-		m_gl.Uniform1fv(program->m_pixelFlickerEndThresholdLocation, 1, &flickerEnd);
-		m_gl.Uniform1fv(program->m_pixelDesaturationLocation, 1, &desaturation);
+	if (effects.m_flicker)
+	{
+		flickerAxis[0] = effects.m_flickerAxisX;
+		flickerAxis[1] = effects.m_flickerAxisY;
+		flickerStart = effects.m_flickerStartThreshold;
+		flickerEnd = effects.m_flickerEndThreshold;
 	}
 
-	GLint vpos[1] = { program->m_vertexPosUVLocation };
+	float desaturation = effects.m_desaturation;
 
-	m_res.m_quadVertexArray->Activate(vpos);
+	if (effects.m_darken)
+		for (int i = 0; i < 3; i++)
+			modulation[i] = 0.5f;
 
-	m_gl.ActiveTexture(GL_TEXTURE0);
-	m_gl.BindTexture(GL_TEXTURE_2D, glSurface->GetTexture()->GetID());
-	m_gl.Uniform1i(program->m_pixelSurfaceTextureLocation, 0);
+	m_gl.Uniform4fv(program->m_pixelModulationLocation, 1, modulation);
+	m_gl.Uniform2fv(program->m_pixelFlickerAxisLocation, 1, flickerAxis);
+	m_gl.Uniform1fv(program->m_pixelFlickerStartThresholdLocation, 1, &flickerStart);
+	m_gl.Uniform1fv(program->m_pixelFlickerEndThresholdLocation, 1, &flickerEnd);
+	m_gl.Uniform1fv(program->m_pixelDesaturationLocation, 1, &desaturation);
+}
 
-	if (pixelFormat == GpPixelFormats::k8BitStandard || pixelFormat == GpPixelFormats::k8BitCustom)
+void GpDisplayDriver_SDL_GL2::EndDraws()
+{
+	const size_t numQuads = m_drawBatchQuads.size();
+	if (numQuads == 0)
+		return;
+
+	CheckGLError(m_gl, m_properties.m_logger);
+
+	std::sort(m_drawBatchQuads.begin(), m_drawBatchQuads.end(), [](const DrawBatchQuad &a, const DrawBatchQuad &b)
 	{
-		m_gl.ActiveTexture(GL_TEXTURE1);
-		m_gl.BindTexture(GL_TEXTURE_2D, m_res.m_paletteTexture->GetID());
-		m_gl.Uniform1i(program->m_pixelPaletteTextureLocation, 1);
+		if (a.m_program != b.m_program)
+			return reinterpret_cast<uintptr_t>(a.m_program) < reinterpret_cast<uintptr_t>(b.m_program);
+		if (a.m_texture != b.m_texture)
+			return reinterpret_cast<uintptr_t>(a.m_texture) < reinterpret_cast<uintptr_t>(b.m_texture);
+		if (a.m_effectsIndex != b.m_effectsIndex)
+			return a.m_effectsIndex < b.m_effectsIndex;
+		return a.m_sequence < b.m_sequence;
+	});
+
+	m_drawBatchSortedVertices.resize(numQuads * 4);
+	for (size_t i = 0; i < numQuads; i++)
+	{
+		const DrawBatchQuad &quad = m_drawBatchQuads[i];
+		for (size_t v = 0; v < 4; v++)
+			m_drawBatchSortedVertices[i * 4 + v] = m_drawBatchVertices[quad.m_sequence * 4 + v];
+
+		quad.m_surface->SetHasQueuedDraws(false);
 	}
 
+	m_gl.BindBuffer(GL_ARRAY_BUFFER, m_res.m_drawBatchVertexBuffer->GetID());
+	m_gl.BufferData(GL_ARRAY_BUFFER, sizeof(DrawBatchVertex) * numQuads * 4, m_drawBatchSortedVertices.data(), GL_STREAM_DRAW);
+	m_gl.BindBuffer(GL_ARRAY_BUFFER, 0);
+
 	m_gl.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_res.m_quadIndexBuffer->GetID());
-	m_gl.DrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, nullptr);
-	m_gl.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
-	CheckGLError(m_gl, m_properties.m_logger);
+	m_gl.Enable(GL_DEPTH_TEST);
+	m_gl.Clear(GL_DEPTH_BUFFER_BIT);
 
-	if (pixelFormat == GpPixelFormats::k8BitStandard || pixelFormat == GpPixelFormats::k8BitCustom)
+	DrawQuadProgram *program = nullptr;
+	bool usesPalette = false;
+	size_t effectsIndex = 0;
+	GLint attribLocations[2] = { -1, -1 };
+
+	size_t groupStart = 0;
+	while (groupStart < numQuads)
+	{
+		const DrawBatchQuad &firstQuad = m_drawBatchQuads[groupStart];
+
+		size_t groupEnd = groupStart + 1;
+		while (groupEnd < numQuads)
+		{
+			const DrawBatchQuad &quad = m_drawBatchQuads[groupEnd];
+			if (quad.m_program != firstQuad.m_program || quad.m_texture != firstQuad.m_texture || quad.m_effectsIndex != firstQuad.m_effectsIndex)
+				break;
+			groupEnd++;
+		}
+
+		if (firstQuad.m_program != program)
+		{
+			if (program)
+				m_res.m_drawBatchVertexArray->Deactivate(attribLocations);
+
+			program = firstQuad.m_program;
+
+			m_gl.UseProgram(program->m_program->GetID());
+
+			attribLocations[0] = program->m_vertexNDCPosLocation;
+			attribLocations[1] = program->m_vertexTexCoordLocation;
+			m_res.m_drawBatchVertexArray->Activate(attribLocations);
+
+			if (firstQuad.m_usesPalette)
+			{
+				m_gl.ActiveTexture(GL_TEXTURE1);
+				m_gl.BindTexture(GL_TEXTURE_2D, m_res.m_paletteTexture->GetID());
+				m_gl.Uniform1i(program->m_pixelPaletteTextureLocation, 1);
+				usesPalette = true;
+			}
+
+			m_gl.ActiveTexture(GL_TEXTURE0);
+			m_gl.Uniform1i(program->m_pixelSurfaceTextureLocation, 0);
+
+			ApplyDrawEffects(program, m_drawBatchEffects[firstQuad.m_effectsIndex]);
+			effectsIndex = firstQuad.m_effectsIndex;
+		}
+		else if (firstQuad.m_effectsIndex != effectsIndex)
+		{
+			ApplyDrawEffects(program, m_drawBatchEffects[firstQuad.m_effectsIndex]);
+			effectsIndex = firstQuad.m_effectsIndex;
+		}
+
+		m_gl.BindTexture(GL_TEXTURE_2D, firstQuad.m_texture->GetID());
+		m_gl.DrawElements(GL_TRIANGLES, static_cast<GLsizei>((groupEnd - groupStart) * 6), GL_UNSIGNED_SHORT, static_cast<const char*>(nullptr) + groupStart * 6 * sizeof(uint16_t));
+
+		m_frameDrawCalls++;
+
+		groupStart = groupEnd;
+	}
+
+	if (usesPalette)
 	{
 		m_gl.ActiveTexture(GL_TEXTURE1);
 		m_gl.BindTexture(GL_TEXTURE_2D, 0);
@@ -2200,11 +3142,72 @@ void GpDisplayDriver_SDL_GL2::DrawSurface(IGpDisplayDriverSurface *surface, int3
 	m_gl.ActiveTexture(GL_TEXTURE0);
 	m_gl.BindTexture(GL_TEXTURE_2D, 0);
 
-	m_res.m_quadVertexArray->Deactivate(vpos);
+	m_res.m_drawBatchVertexArray->Deactivate(attribLocations);
 
+	m_gl.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	m_gl.UseProgram(0);
 
+	m_gl.Disable(GL_DEPTH_TEST);
+
 	CheckGLError(m_gl, m_properties.m_logger);
+
+	m_drawBatchQuads.clear();
+	m_drawBatchVertices.clear();
+	m_drawBatchEffects.clear();
+}
+
+void GpDisplayDriver_SDL_GL2::FlushDrawsUsingSurface(GpDisplayDriverSurface_GL2 *surface)
+{
+	// Queued draws read the texture when the batch is drawn, not when they're queued
+	if (surface->HasQueuedDraws())
+		EndDraws();
+}
+
+GpGLTexture *GpDisplayDriver_SDL_GL2::AllocateAtlasRegion(size_t width, size_t height, GpPixelFormat_t pixelFormat, size_t &outX, size_t &outY)
+{
+	if (pixelFormat != GpPixelFormats::k8BitStandard && pixelFormat != GpPixelFormats::k8BitCustom)
+		return nullptr;
+
+	if (std::min(width, height) > kMaxAtlasSurfaceThickness)
+		return nullptr;
+
+	if (!m_surfaceAtlasTexture)
+	{
+		m_surfaceAtlasTexture = GpGLTexture::Create(this);
+		if (!m_surfaceAtlasTexture)
+			return nullptr;
+
+		const size_t dimension = GpGLSurfaceAtlas::kDimension;
+
+		m_gl.BindTexture(GL_TEXTURE_2D, m_surfaceAtlasTexture->GetID());
+		m_gl.PixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		m_gl.TexImage2D(GL_TEXTURE_2D, 0, SupportsSizedFormats() ? GL_R8 : GL_LUMINANCE, dimension, dimension, 0, SupportsSizedFormats() ? GL_RED : GL_LUMINANCE, GL_UNSIGNED_BYTE, nullptr);
+		m_gl.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		m_gl.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		m_gl.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		m_gl.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		m_gl.BindTexture(GL_TEXTURE_2D, 0);
+
+		CheckGLError(m_gl, m_properties.m_logger);
+	}
+
+	if (!m_surfaceAtlas.Allocate(width, height, outX, outY))
+	{
+		if (m_surfaceAtlas.IsEmpty())
+			m_surfaceAtlasTexture = nullptr;
+
+		return nullptr;
+	}
+
+	return m_surfaceAtlasTexture;
+}
+
+void GpDisplayDriver_SDL_GL2::ReleaseAtlasRegion(size_t x, size_t y, size_t width, size_t height)
+{
+	m_surfaceAtlas.Free(x, y, width, height);
+
+	if (m_surfaceAtlas.IsEmpty())
+		m_surfaceAtlasTexture = nullptr;
 }
 
 
@@ -2267,6 +3270,23 @@ void GpDisplayDriver_SDL_GL2::SetStandardCursor(EGpStandardCursor_t standardCurs
 
 void GpDisplayDriver_SDL_GL2::UpdatePalette(const void *paletteData)
 {
+	if (!m_isPresentThreaded)
+	{
+		ExecuteUpdatePalette(paletteData);
+		return;
+	}
+
+	// The palette storage belongs to the render thread, since it's needed to recreate the palette texture
+	GpPresentCommand *command = RecordPresentCommand(GpPresentCommandTypes::kUpdatePalette, nullptr);
+	uint8_t *packetData = RecordPresentData(command, 256 * 4);
+	memcpy(packetData, paletteData, 256 * 4);
+}
+
+void GpDisplayDriver_SDL_GL2::ExecuteUpdatePalette(const void *paletteData)
+{
+	// Queued draws that use the palette have to see the old one
+	EndDraws();
+
 	memcpy(m_paletteData, paletteData, 256 * 4);
 
 	GLenum internalFormat = SupportsSizedFormats() ? GL_RGBA8 : GL_RGBA;
@@ -2324,10 +3344,22 @@ IGpPrefsHandler *GpDisplayDriver_SDL_GL2::GetPrefsHandler() const
 	return const_cast<GpDisplayDriver_SDL_GL2*>(this);
 }
 
-bool GpDisplayDriver_SDL_GL2::SupportsSizedFormats() const
+void GpDisplayDriver_SDL_GL2::GetFrameStats(GpDisplayDriverFrameStats &outStats) const
 {
-#if GP_GL_IS_OPENGL_4_CONTEXT
-	return true;
+	if (m_isPresentThreaded)
+	{
+		m_presentMutex->Lock();
+		outStats = m_frameStats;
+		m_presentMutex->Unlock();
+	}
+	else
+		outStats = m_frameStats;
+}
+
+bool GpDisplayDriver_SDL_GL2::SupportsSizedFormats() const
+{
+#if GP_GL_IS_OPENGL_4_CONTEXT
+	return true;
 #else
 	return false;
 #endif
@@ -2364,6 +3396,100 @@ const GpGLFunctions *GpDisplayDriver_SDL_GL2::GetGLFunctions() const
 	return &m_gl;
 }
 
+bool GpDisplayDriver_SDL_GL2::StreamTextureRegion(GpGLTexture *texture, size_t x, size_t y, size_t width, size_t height, size_t pixelSize, GLenum glFormat, GLenum glType, const void *data, size_t pitch)
+{
+	if (!m_useStreamingUploads)
+		return false;
+
+	const size_t rowSize = width * pixelSize;
+	const size_t uploadSize = rowSize * height;
+	if (uploadSize == 0)
+		return true;
+
+	// Each upload goes to the next buffer in the ring, and the buffer storage is orphaned before mapping,
+	// so the driver never has to wait for a previous transfer out of the same storage to finish.
+	GpGLBuffer *buffer = m_res.m_streamingUploadBuffers[m_nextStreamingUploadBuffer];
+	m_nextStreamingUploadBuffer = (m_nextStreamingUploadBuffer + 1) % kNumStreamingUploadBuffers;
+
+	m_gl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer->GetID());
+	m_gl.BufferData(GL_PIXEL_UNPACK_BUFFER, static_cast<GLsizeiptr>(uploadSize), nullptr, GL_STREAM_DRAW);
+
+	uint8_t *mappedBytes = static_cast<uint8_t*>(m_gl.MapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, static_cast<GLsizeiptr>(uploadSize), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+	if (!mappedBytes)
+	{
+		m_gl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		return false;
+	}
+
+	// Rows are repacked tightly so the whole region goes up in one call, regardless of the source pitch
+	const uint8_t *srcBytes = static_cast<const uint8_t*>(data);
+	if (rowSize == pitch)
+		memcpy(mappedBytes, srcBytes, uploadSize);
+	else
+	{
+		for (size_t row = 0; row < height; row++)
+			memcpy(mappedBytes + row * rowSize, srcBytes + row * pitch, rowSize);
+	}
+
+	if (!m_gl.UnmapBuffer(GL_PIXEL_UNPACK_BUFFER))
+	{
+		// Buffer contents were lost, let the caller upload directly
+		m_gl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		return false;
+	}
+
+	m_gl.BindTexture(GL_TEXTURE_2D, texture->GetID());
+	m_gl.TexSubImage2D(GL_TEXTURE_2D, 0, static_cast<GLint>(x), static_cast<GLint>(y), static_cast<GLsizei>(width), static_cast<GLsizei>(height), glFormat, glType, nullptr);
+	m_gl.BindTexture(GL_TEXTURE_2D, 0);
+
+	m_gl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	return true;
+}
+
+void GpDisplayDriver_SDL_GL2::AddUploadStats(size_t numBytes, std::chrono::high_resolution_clock::duration uploadTime)
+{
+	m_frameUploadBytes += numBytes;
+	m_frameUploadCount++;
+	m_frameUploadTime += uploadTime;
+}
+
+bool GpDisplayDriver_SDL_GL2::IsPresentThreaded() const
+{
+	return m_isPresentThreaded;
+}
+
+GpPresentCommand *GpDisplayDriver_SDL_GL2::RecordPresentCommand(GpPresentCommandType_t commandType, GpDisplayDriverSurface_GL2 *surface)
+{
+	std::vector<GpPresentCommand> &commands = m_presentPackets[m_presentWriteIndex].m_commands;
+
+	commands.push_back(GpPresentCommand());
+
+	GpPresentCommand &command = commands.back();
+	command.m_type = commandType;
+	command.m_surface = surface;
+	command.m_x = 0;
+	command.m_y = 0;
+	command.m_width = 0;
+	command.m_height = 0;
+	command.m_pitch = 0;
+	command.m_dataOffset = 0;
+	command.m_dataSize = 0;
+
+	return &command;
+}
+
+uint8_t *GpDisplayDriver_SDL_GL2::RecordPresentData(GpPresentCommand *command, size_t size)
+{
+	std::vector<uint8_t> &data = m_presentPackets[m_presentWriteIndex].m_data;
+
+	command->m_dataOffset = data.size();
+	command->m_dataSize = size;
+	data.resize(command->m_dataOffset + size);
+
+	return data.data() + command->m_dataOffset;
+}
+
 
 
 template<GLuint TShaderType>
@@ -2402,7 +3528,7 @@ GpComPtr<GpGLShader<TShaderType>> GpDisplayDriver_SDL_GL2::CreateShader(const ch
 
 void GpDisplayDriver_SDL_GL2::StartOpenGLForWindow(IGpLogDriver *logger)
 {
-	SDL_GLContext context = SDL_GL_CreateContext(m_window);
+	m_glContext = SDL_GL_CreateContext(m_window);
 	SDL_GL_SetSwapInterval(1);
 }
 
@@ -2418,9 +3544,19 @@ bool GpDisplayDriver_SDL_GL2::InitResources(uint32_t physicalWidth, uint32_t phy
 	if (!InitBackBuffer(virtualWidth, virtualHeight))
 		return false;
 
-	// Quad index buffer
+	// Quad index buffer.  Blits use the first quad, batched draws use as many as they need.
 	{
-		const uint16_t indexBufferData[] = { 0, 1, 2, 1, 3, 2 };
+		std::vector<uint16_t> indexBufferData;
+		indexBufferData.resize(kMaxDrawBatchQuads * 6);
+
+		for (size_t i = 0; i < kMaxDrawBatchQuads; i++)
+		{
+			const uint16_t firstVertex = static_cast<uint16_t>(i * 4);
+			const uint16_t quadIndexes[] = { 0, 1, 2, 1, 3, 2 };
+
+			for (size_t j = 0; j < 6; j++)
+				indexBufferData[i * 6 + j] = firstVertex + quadIndexes[j];
+		}
 
 		m_res.m_quadIndexBuffer = GpGLBuffer::Create(this);
 		if (!m_res.m_quadIndexBuffer)
@@ -2432,10 +3568,32 @@ bool GpDisplayDriver_SDL_GL2::InitResources(uint32_t physicalWidth, uint32_t phy
 		}
 
 		m_gl.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_res.m_quadIndexBuffer->GetID());
-		m_gl.BufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indexBufferData), indexBufferData, GL_STATIC_DRAW);
+		m_gl.BufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint16_t) * indexBufferData.size(), indexBufferData.data(), GL_STATIC_DRAW);
 		m_gl.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	}
 
+	// Streaming upload buffers
+	if (m_useStreamingUploads)
+	{
+		for (size_t i = 0; i < kNumStreamingUploadBuffers; i++)
+		{
+			m_res.m_streamingUploadBuffers[i] = GpGLBuffer::Create(this);
+			if (!m_res.m_streamingUploadBuffers[i])
+			{
+				if (logger)
+					logger->Printf(IGpLogDriver::Category_Warning, "GpDisplayDriver_SDL_GL2::InitResources: GpGLBuffer::Create for streaming upload buffer failed, using direct uploads");
+
+				for (size_t j = 0; j < i; j++)
+					m_res.m_streamingUploadBuffers[j] = nullptr;
+
+				m_useStreamingUploads = false;
+				break;
+			}
+		}
+
+		m_nextStreamingUploadBuffer = 0;
+	}
+
 	// Quad vertex buffer
 	{
 		const float vertexBufferData[] =
@@ -2488,7 +3646,59 @@ bool GpDisplayDriver_SDL_GL2::InitResources(uint32_t physicalWidth, uint32_t phy
 		}
 	}
 
+	// Draw batch vertex buffer, refilled every time the batch is drawn
+	{
+		m_res.m_drawBatchVertexBuffer = GpGLBuffer::Create(this);
+		if (!m_res.m_drawBatchVertexBuffer)
+		{
+			if (logger)
+				logger->Printf(IGpLogDriver::Category_Error, "GpDisplayDriver_SDL_GL2::InitResources: GpGLBuffer::Create for draw batch vertex buffer failed");
+
+			return false;
+		}
+
+		m_res.m_drawBatchVertexArray = GpGLVertexArray::Create(this);
+		if (!m_res.m_drawBatchVertexArray)
+		{
+			if (logger)
+				logger->Printf(IGpLogDriver::Category_Error, "GpDisplayDriver_SDL_GL2::InitResources: GpGLVertexArray::Create for draw batch vertex buffer failed");
+
+			return false;
+		}
+
+		GpGLVertexArraySpec specs[] =
+		{
+			{
+				m_res.m_drawBatchVertexBuffer,
+				0,							// index
+				3,							// size
+				GL_FLOAT,					// type
+				GL_FALSE,					// normalized
+				sizeof(DrawBatchVertex),	// stride
+				0
+			},
+			{
+				m_res.m_drawBatchVertexBuffer,
+				1,							// index
+				4,							// size
+				GL_FLOAT,					// type
+				GL_FALSE,					// normalized
+				sizeof(DrawBatchVertex),	// stride
+				sizeof(GLfloat) * 3
+			},
+		};
+
+		if (!m_res.m_drawBatchVertexArray->InitWithSpecs(specs, sizeof(specs) / sizeof(specs[0])))
+		{
+			if (logger)
+				logger->Printf(IGpLogDriver::Category_Error, "GpDisplayDriver_SDL_GL2::InitResources: InitWithSpecs for draw batch vertex buffer failed");
+
+			return false;
+		}
+	}
+
 	GpComPtr<GpGLShader<GL_VERTEX_SHADER>> drawQuadVertexShader = CreateShader<GL_VERTEX_SHADER>(GpBinarizedShaders::g_drawQuadV_GL2);
+	GpComPtr<GpGLShader<GL_VERTEX_SHADER>> drawQuadBatchVertexShader = CreateShader<GL_VERTEX_SHADER>(GpBinarizedShaders::g_drawQuadBatchV_GL2);
 	GpComPtr<GpGLShader<GL_FRAGMENT_SHADER>> drawQuadPaletteFlickerPixelShader = CreateShader<GL_FRAGMENT_SHADER>(GpBinarizedShaders::g_drawQuadPalettePF_GL2);
 	GpComPtr<GpGLShader<GL_FRAGMENT_SHADER>> drawQuadPaletteNoFlickerPixelShader = CreateShader<GL_FRAGMENT_SHADER>(GpBinarizedShaders::g_drawQuadPalettePNF_GL2);
 	GpComPtr<GpGLShader<GL_FRAGMENT_SHADER>> drawQuad32FlickerPixelShader = CreateShader<GL_FRAGMENT_SHADER>(GpBinarizedShaders::g_drawQuad32PF_GL2);
@@ -2501,14 +3711,14 @@ bool GpDisplayDriver_SDL_GL2::InitResources(uint32_t physicalWidth, uint32_t phy
 	GpComPtr<GpGLShader<GL_FRAGMENT_SHADER>> copyQuadPixelShader = CreateShader<GL_FRAGMENT_SHADER>(GpBinarizedShaders::g_copyQuadP_GL2);
 
 		
-	if (!m_res.m_drawQuadPaletteFlickerProgram.Link(this, drawQuadVertexShader, drawQuadPaletteFlickerPixelShader) ||
-		!m_res.m_drawQuadPaletteNoFlickerProgram.Link(this, drawQuadVertexShader, drawQuadPaletteNoFlickerPixelShader)
-		|| !m_res.m_drawQuad32FlickerProgram.Link(this, drawQuadVertexShader, drawQuad32FlickerPixelShader)
-		|| !m_res.m_drawQuad32NoFlickerProgram.Link(this, drawQuadVertexShader, drawQuad32NoFlickerPixelShader)
-		|| !m_res.m_drawQuadPaletteICCFlickerProgram.Link(this, drawQuadVertexShader, drawQuadPaletteICCFPixelShader)
-		|| !m_res.m_drawQuadPaletteICCNoFlickerProgram.Link(this, drawQuadVertexShader, drawQuadPaletteICCNFPixelShader)
-		|| !m_res.m_drawQuad32ICCFlickerProgram.Link(this, drawQuadVertexShader, drawQuad32ICCFPixelShader)
-		|| !m_res.m_drawQuad32ICCNoFlickerProgram.Link(this, drawQuadVertexShader, drawQuad32ICCNFPixelShader)
+	if (!m_res.m_drawQuadPaletteFlickerProgram.Link(this, drawQuadBatchVertexShader, drawQuadPaletteFlickerPixelShader) ||
+		!m_res.m_drawQuadPaletteNoFlickerProgram.Link(this, drawQuadBatchVertexShader, drawQuadPaletteNoFlickerPixelShader)
+		|| !m_res.m_drawQuad32FlickerProgram.Link(this, drawQuadBatchVertexShader, drawQuad32FlickerPixelShader)
+		|| !m_res.m_drawQuad32NoFlickerProgram.Link(this, drawQuadBatchVertexShader, drawQuad32NoFlickerPixelShader)
+		|| !m_res.m_drawQuadPaletteICCFlickerProgram.Link(this, drawQuadBatchVertexShader, drawQuadPaletteICCFPixelShader)
+		|| !m_res.m_drawQuadPaletteICCNoFlickerProgram.Link(this, drawQuadBatchVertexShader, drawQuadPaletteICCNFPixelShader)
+		|| !m_res.m_drawQuad32ICCFlickerProgram.Link(this, drawQuadBatchVertexShader, drawQuad32ICCFPixelShader)
+		|| !m_res.m_drawQuad32ICCNoFlickerProgram.Link(this, drawQuadBatchVertexShader, drawQuad32ICCNFPixelShader)
 
 //		|| !m_drawQuadRGBICCProgram.Link(this, drawQuadVertexShader, drawQuadRGBICCPixelShader)
 //		|| !m_drawQuad15BitICCProgram.Link(this, drawQuadVertexShader, drawQuad15BitICCPixelShader)
@@ -2711,8 +3921,26 @@ bool GpDisplayDriver_SDL_GL2::InitBackBuffer(uint32_t width, uint32_t height)
 			return false;
 		}
 
+		// Batched draws are depth tested so that they can be drawn out of order
+		m_res.m_virtualScreenDepthBuffer = GpGLRenderbuffer::Create(this);
+
+		if (!m_res.m_virtualScreenDepthBuffer)
+		{
+			if (logger)
+				logger->Printf(IGpLogDriver::Category_Error, "GpDisplayDriver_SDL_GL2::InitBackBuffer: GpGLRenderbuffer::Create for virtual screen depth buffer failed");
+
+			return false;
+		}
+
+		m_gl.BindRenderbuffer(GL_RENDERBUFFER, m_res.m_virtualScreenDepthBuffer->GetID());
+		m_gl.RenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, width, height);
+		m_gl.BindRenderbuffer(GL_RENDERBUFFER, 0);
+
+		CheckGLError(m_gl, logger);
+
 		m_gl.BindFramebuffer(GL_FRAMEBUFFER, m_res.m_virtualScreenTextureRTV->GetID());
 		m_gl.FramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_res.m_virtualScreenTexture->GetID(), 0);
+		m_gl.FramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_res.m_virtualScreenDepthBuffer->GetID());
 		GLenum status = m_gl.CheckFramebufferStatus(GL_FRAMEBUFFER);
 
 		if (status != GL_FRAMEBUFFER_COMPLETE)
@@ -2726,12 +3954,15 @@ bool GpDisplayDriver_SDL_GL2::InitBackBuffer(uint32_t width, uint32_t height)
 		m_gl.BindFramebuffer(GL_FRAMEBUFFER, 0);
 	}
 
-	m_useUpscaleFilter = (m_pixelScaleX == 1.5f || m_pixelScaleX == 2.5f || m_pixelScaleY == 1.5f || m_pixelScaleY == 2.5f);
+	const float pixelScaleX = m_presentState.m_pixelScaleX;
+	const float pixelScaleY = m_presentState.m_pixelScaleY;
+
+	m_useUpscaleFilter = (pixelScaleX == 1.5f || pixelScaleX == 2.5f || pixelScaleY == 1.5f || pixelScaleY == 2.5f);
 
 	if (m_useUpscaleFilter)
 	{
-		uint32_t upscaleX = ceil(m_pixelScaleX);
-		uint32_t upscaleY = ceil(m_pixelScaleY);
+		uint32_t upscaleX = ceil(pixelScaleX);
+		uint32_t upscaleY = ceil(pixelScaleY);
 
 		{
 			m_res.m_upscaleTexture = GpGLTexture::Create(this);
@@ -2813,8 +4044,8 @@ void GpDisplayDriver_SDL_GL2::ScaleVirtualScreen()
 
 		float surfaceDimensions_TextureRegion[4] =
 		{
-			static_cast<float>(m_windowWidthVirtual),
-			static_cast<float>(m_windowHeightVirtual),
+			static_cast<float>(m_presentState.m_windowWidthVirtual),
+			static_cast<float>(m_presentState.m_windowHeightVirtual),
 			1.f,
 			1.f
 		};
@@ -2825,10 +4056,10 @@ void GpDisplayDriver_SDL_GL2::ScaleVirtualScreen()
 
 		float dxdy_dimensions[4] =
 		{
-			static_cast<float>(1.0 / m_windowWidthVirtual),
-			static_cast<float>(1.0 / m_windowHeightVirtual),
-			static_cast<float>(m_windowWidthVirtual),
-			static_cast<float>(m_windowHeightVirtual)
+			static_cast<float>(1.0 / m_presentState.m_windowWidthVirtual),
+			static_cast<float>(1.0 / m_presentState.m_windowHeightVirtual),
+			static_cast<float>(m_presentState.m_windowWidthVirtual),
+			static_cast<float>(m_presentState.m_windowHeightVirtual)
 		};
 
 		m_gl.Uniform4fv(program.m_pixelDXDYDimensionsLocation, 1, reinterpret_cast<const GLfloat*>(dxdy_dimensions));
@@ -2856,17 +4087,17 @@ void GpDisplayDriver_SDL_GL2::ScaleVirtualScreen()
 
 	m_gl.BindFramebuffer(GL_FRAMEBUFFER, 0);
 
-	m_gl.Viewport(0, 0, m_windowWidthPhysical, m_windowHeightPhysical);
+	m_gl.Viewport(0, 0, m_presentState.m_windowWidthPhysical, m_presentState.m_windowHeightPhysical);
 
 	const BlitQuadProgram &program = m_res.m_copyQuadProgram;
 
 	{
-		const float twoDivWidth = 2.0f / static_cast<float>(m_windowWidthPhysical);
-		const float twoDivHeight = 2.0f / static_cast<float>(m_windowHeightPhysical);
+		const float twoDivWidth = 2.0f / static_cast<float>(m_presentState.m_windowWidthPhysical);
+		const float twoDivHeight = 2.0f / static_cast<float>(m_presentState.m_windowHeightPhysical);
 
 		// Use the scaled virtual width instead of the physical width to correctly handle cases where the window boundary is in the middle of a pixel
-		float fWidth = static_cast<float>(m_windowWidthVirtual) * m_pixelScaleX;
-		float fHeight = static_cast<float>(m_windowHeightVirtual) * m_pixelScaleY;
+		float fWidth = static_cast<float>(m_presentState.m_windowWidthVirtual) * m_presentState.m_pixelScaleX;
+		float fHeight = static_cast<float>(m_presentState.m_windowHeightVirtual) * m_presentState.m_pixelScaleY;
 
 		float ndcOriginsAndDimensions[4] =
 		{
@@ -2878,8 +4109,8 @@ void GpDisplayDriver_SDL_GL2::ScaleVirtualScreen()
 
 		float surfaceDimensions_TextureRegion[4] =
 		{
-			static_cast<float>(m_windowWidthVirtual),
-			static_cast<float>(m_windowHeightVirtual),
+			static_cast<float>(m_presentState.m_windowWidthVirtual),
+			static_cast<float>(m_presentState.m_windowHeightVirtual),
 			1.f,
 			1.f
 		};
@@ -2890,10 +4121,10 @@ void GpDisplayDriver_SDL_GL2::ScaleVirtualScreen()
 
 		float dxdy_dimensions[4] =
 		{
-			static_cast<float>(1.0 / m_windowWidthVirtual),
-			static_cast<float>(1.0 / m_windowHeightVirtual),
-			static_cast<float>(m_windowWidthVirtual),
-			static_cast<float>(m_windowHeightVirtual)
+			static_cast<float>(1.0 / m_presentState.m_windowWidthVirtual),
+			static_cast<float>(1.0 / m_presentState.m_windowHeightVirtual),
+			static_cast<float>(m_presentState.m_windowWidthVirtual),
+			static_cast<float>(m_presentState.m_windowHeightVirtual)
 		};
 
 		m_gl.Uniform4fv(program.m_pixelDXDYDimensionsLocation, 1, reinterpret_cast<const GLfloat*>(dxdy_dimensions));
@@ -2952,9 +4183,8 @@ bool GpDisplayDriver_SDL_GL2::DrawQuadProgram::Link(GpDisplayDriver_SDL_GL2 *dri
 		return false;
 	}
 
-	m_vertexNDCOriginAndDimensionsLocation = gl->GetUniformLocation(m_program->GetID(), "ndcOriginAndDimensions");
-	m_vertexSurfaceDimensionsLocation = gl->GetUniformLocation(m_program->GetID(), "surfaceDimensions_TextureRegion");
-	m_vertexPosUVLocation = gl->GetAttribLocation(m_program->GetID(), "posUV");
+	m_vertexNDCPosLocation = gl->GetAttribLocation(m_program->GetID(), "ndcPos");
+	m_vertexTexCoordLocation = gl->GetAttribLocation(m_program->GetID(), "surfaceTexCoord");
 
 	m_pixelModulationLocation = gl->GetUniformLocation(m_program->GetID(), "constants_Modulation");
 	m_pixelFlickerAxisLocation = gl->GetUniformLocation(m_program->GetID(), "constants_FlickerAxis");
@@ -3007,44 +4237,40 @@ bool GpDisplayDriver_SDL_GL2::BlitQuadProgram::Link(GpDisplayDriver_SDL_GL2 *dri
 
 bool GpDisplayDriver_SDL_GL2::SyncRender()
 {
+	if (m_isPresentThreaded)
+		return SyncRenderThreaded();
+
 	if (m_frameTimeAccumulated >= m_frameTimeSliceSize)
 	{
 		m_frameTimeAccumulated -= m_frameTimeSliceSize;
 
+		// Any tick after the first since the last present is running behind the display
+		RecordTickStats(m_ticksSincePresent > 0);
+		m_ticksSincePresent++;
+
 		return true;
 	}
 
 	SynchronizeCursors();
 
-	float bgColor[4];
-
-	for (int i = 0; i < 4; i++)
-		bgColor[i] = m_bgColor[i];
-
-	if (m_bgIsDark)
-	{
-		for (int i = 0; i < 3; i++)
-			bgColor[i] *= 0.25f;
-	}
-
-	//ID3D11RenderTargetView *const rtv = m_backBufferRTV;
-	GpGLRenderTargetView *const vsRTV = m_res.m_virtualScreenTextureRTV;
-
-	m_gl.BindFramebuffer(GL_FRAMEBUFFER, vsRTV->GetID());
+	CapturePresentState(m_presentState);
 
-	m_gl.Viewport(0, 0, m_windowWidthVirtual, m_windowHeightVirtual);
-
-	m_gl.ClearColor(m_bgColor[0], m_bgColor[1], m_bgColor[2], m_bgColor[3]);
-	m_gl.Clear(GL_COLOR_BUFFER_BIT);
+	BeginFrame();
+	ResetFrameUploadStats();
 
 	m_properties.m_renderFunc(m_properties.m_renderFuncContext);
 
+	EndDraws();
+	LogFrameUploadStats();
+
 	ScaleVirtualScreen();
 
 	CheckGLError(m_gl, m_properties.m_logger);
 
 	SDL_GL_SwapWindow(m_window);
 
+	RecordPresentStats();
+
 #ifdef __EMSCRIPTEN__
 	emscripten_sleep(1);
 #endif
@@ -3128,6 +4354,8 @@ bool GpDisplayDriver_SDL_GL2::SyncRender()
 			isInFrameTimeLock = true;
 		}
 
+		m_frameStats.m_isInFrameTimeLock = isInFrameTimeLock;
+
 		std::chrono::high_resolution_clock::duration frameTimeStep = m_frameTimeSliceSize;
 		if (!isInFrameTimeLock)
 		{
@@ -3144,6 +4372,380 @@ bool GpDisplayDriver_SDL_GL2::SyncRender()
 	return false;
 }
 
+bool GpDisplayDriver_SDL_GL2::SyncRenderThreaded()
+{
+	// Ticks are paced by the clock instead of by the swap, since the swap happens on the render thread
+	const std::chrono::high_resolution_clock::time_point now = std::chrono::high_resolution_clock::now();
+	if (now < m_presentNextTickTime)
+	{
+		// Wait for the tick to be due, but wake up if an event arrives.  This doesn't remove the event from the queue.
+		const int waitMSec = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(m_presentNextTickTime - now).count());
+		if (waitMSec > 0)
+			SDL_WaitEventTimeout(nullptr, waitMSec);
+
+		return false;
+	}
+
+	// A tick that was already due a whole tick ago is catching up
+	RecordTickStats(now - m_presentNextTickTime >= m_frameTimeSliceSize);
+
+	m_presentNextTickTime += m_frameTimeSliceSize;
+
+	// If the game fell far behind, don't try to catch up on all of the missed ticks
+	if (now - m_presentNextTickTime > m_frameTimeSliceSize * kMaxPresentTicksBehind)
+		m_presentNextTickTime = now + m_frameTimeSliceSize;
+
+	SynchronizeCursors();
+
+	m_properties.m_renderFunc(m_properties.m_renderFuncContext);
+
+	PublishPresentPacket();
+
+	return true;
+}
+
+void GpDisplayDriver_SDL_GL2::CapturePresentState(GpPresentState &state) const
+{
+	state.m_windowWidthPhysical = m_windowWidthPhysical;
+	state.m_windowHeightPhysical = m_windowHeightPhysical;
+	state.m_windowWidthVirtual = m_windowWidthVirtual;
+	state.m_windowHeightVirtual = m_windowHeightVirtual;
+	state.m_pixelScaleX = m_pixelScaleX;
+	state.m_pixelScaleY = m_pixelScaleY;
+	for (int i = 0; i < 4; i++)
+		state.m_bgColor[i] = m_bgColor[i];
+	state.m_useICCProfile = m_useICCProfile;
+}
+
+void GpDisplayDriver_SDL_GL2::BeginFrame()
+{
+	GpGLRenderTargetView *const vsRTV = m_res.m_virtualScreenTextureRTV;
+
+	m_gl.BindFramebuffer(GL_FRAMEBUFFER, vsRTV->GetID());
+
+	m_gl.Viewport(0, 0, m_presentState.m_windowWidthVirtual, m_presentState.m_windowHeightVirtual);
+
+	const float *bgColor = m_presentState.m_bgColor;
+	m_gl.ClearColor(bgColor[0], bgColor[1], bgColor[2], bgColor[3]);
+	m_gl.Clear(GL_COLOR_BUFFER_BIT);
+}
+
+void GpDisplayDriver_SDL_GL2::ResetFrameUploadStats()
+{
+	m_frameUploadBytes = 0;
+	m_frameUploadCount = 0;
+	m_frameUploadTime = std::chrono::high_resolution_clock::duration::zero();
+	m_frameDrawCalls = 0;
+}
+
+void GpDisplayDriver_SDL_GL2::LogFrameUploadStats()
+{
+	if (m_frameUploadCount > 0)
+	{
+		if (IGpLogDriver *logger = m_properties.m_logger)
+		{
+			const long long uploadMicroseconds = static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(m_frameUploadTime).count());
+			logger->Printf(IGpLogDriver::Category_Information, "Frame uploads: %u uploads, %llu bytes, %lli us%s", m_frameUploadCount, static_cast<unsigned long long>(m_frameUploadBytes), uploadMicroseconds, m_useStreamingUploads ? " (streaming)" : "");
+		}
+	}
+}
+
+void GpDisplayDriver_SDL_GL2::RecordTickStats(bool isCatchUp)
+{
+	if (m_isPresentThreaded)
+	{
+		m_presentMutex->Lock();
+		m_frameStats.RecordTick(isCatchUp);
+		m_presentMutex->Unlock();
+	}
+	else
+		m_frameStats.RecordTick(isCatchUp);
+}
+
+void GpDisplayDriver_SDL_GL2::RecordPresentStats()
+{
+	const std::chrono::high_resolution_clock::time_point now = std::chrono::high_resolution_clock::now();
+	const long long intervalUSec = static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(now - m_lastPresentTime).count());
+	const uint32_t clampedIntervalUSec = static_cast<uint32_t>(std::max<long long>(0, std::min<long long>(intervalUSec, UINT32_MAX)));
+
+	m_lastPresentTime = now;
+
+	if (m_isPresentThreaded)
+	{
+		// The render thread only presents frames that were published after a tick, so frames are never doubled
+		m_presentMutex->Lock();
+		m_frameStats.RecordPresent(clampedIntervalUSec, false);
+		m_frameStats.RecordFrameWork(m_frameUploadBytes, m_frameUploadCount, m_frameDrawCalls);
+		m_presentMutex->Unlock();
+	}
+	else
+	{
+		m_frameStats.RecordPresent(clampedIntervalUSec, m_frameStats.m_numPresents > 0 && m_ticksSincePresent == 0);
+		m_frameStats.RecordFrameWork(m_frameUploadBytes, m_frameUploadCount, m_frameDrawCalls);
+		m_ticksSincePresent = 0;
+	}
+}
+
+bool GpDisplayDriver_SDL_GL2::StartPresentThread()
+{
+	IGpSystemServices *sysServices = m_properties.m_systemServices;
+
+	m_presentMutex = sysServices->CreateMutex();
+	m_presentWakeEvent = sysServices->CreateThreadEvent(true, false);
+	m_presentTakenEvent = sysServices->CreateThreadEvent(true, false);
+	m_presentExitEvent = sysServices->CreateThreadEvent(true, false);
+
+	if (!m_presentMutex || !m_presentWakeEvent || !m_presentTakenEvent || !m_presentExitEvent)
+	{
+		DestroyPresentThreadObjects();
+		return false;
+	}
+
+	// The render thread makes the context current for itself, and a context can only be current on one thread
+	SDL_GL_MakeCurrent(m_window, nullptr);
+
+	m_isPresentThreaded = true;
+	m_presentNextTickTime = std::chrono::high_resolution_clock::now();
+
+	if (!sysServices->CreateThread(PresentThreadFunc, this))
+	{
+		m_isPresentThreaded = false;
+		SDL_GL_MakeCurrent(m_window, m_glContext);
+		DestroyPresentThreadObjects();
+		return false;
+	}
+
+	if (IGpLogDriver *logger = m_properties.m_logger)
+		logger->Printf(IGpLogDriver::Category_Information, "Presenting on a render thread");
+
+	return true;
+}
+
+void GpDisplayDriver_SDL_GL2::StopPresentThread()
+{
+	if (m_isPresentThreaded)
+	{
+		m_presentMutex->Lock();
+		m_presentQuit = true;
+		m_presentMutex->Unlock();
+
+		m_presentWakeEvent->Signal();
+		m_presentExitEvent->Wait();
+
+		m_isPresentThreaded = false;
+
+		// Take the context back so the GL resources can be released
+		SDL_GL_MakeCurrent(m_window, m_glContext);
+	}
+
+	DestroyPresentThreadObjects();
+}
+
+void GpDisplayDriver_SDL_GL2::DestroyPresentThreadObjects()
+{
+	if (m_presentMutex)
+	{
+		m_presentMutex->Destroy();
+		m_presentMutex = nullptr;
+	}
+
+	if (m_presentWakeEvent)
+	{
+		m_presentWakeEvent->Destroy();
+		m_presentWakeEvent = nullptr;
+	}
+
+	if (m_presentTakenEvent)
+	{
+		m_presentTakenEvent->Destroy();
+		m_presentTakenEvent = nullptr;
+	}
+
+	if (m_presentExitEvent)
+	{
+		m_presentExitEvent->Destroy();
+		m_presentExitEvent = nullptr;
+	}
+}
+
+void GpDisplayDriver_SDL_GL2::PublishPresentPacket()
+{
+	GpPresentPacket &packet = m_presentPackets[m_presentWriteIndex];
+	CapturePresentState(packet.m_state);
+
+	m_presentMutex->Lock();
+
+	if (m_presentHasReady)
+	{
+		// The render thread hasn't picked up the last frame yet, so this one replaces it instead of waiting
+		m_presentPackets[m_presentReadyIndex].MergeNewer(packet);
+		m_frameStats.m_numFramesDropped++;
+
+		// Uploads that don't cover each other still pile up while the render thread is stalled, so past a point,
+		// wait for it to take the packet instead of growing it further
+		while (m_presentHasReady && m_presentPackets[m_presentReadyIndex].m_data.size() > kMaxMergedPresentDataSize)
+		{
+			m_presentMutex->Unlock();
+			m_presentTakenEvent->Wait();
+			m_presentMutex->Lock();
+		}
+	}
+	else
+	{
+		std::swap(m_presentWriteIndex, m_presentReadyIndex);
+		m_presentHasReady = true;
+	}
+
+	m_presentMutex->Unlock();
+
+	// The write packet is now either merged or one that the render thread is done with
+	m_presentPackets[m_presentWriteIndex].Clear();
+
+	m_presentWakeEvent->Signal();
+}
+
+bool GpDisplayDriver_SDL_GL2::IsPresentThreadFailed()
+{
+	m_presentMutex->Lock();
+	const bool failed = m_presentFailed;
+	m_presentMutex->Unlock();
+
+	return failed;
+}
+
+void GpDisplayDriver_SDL_GL2::PresentThreadMain()
+{
+	SDL_GL_MakeCurrent(m_window, m_glContext);
+
+	bool failed = false;
+
+	for (;;)
+	{
+		m_presentWakeEvent->Wait();
+
+		m_presentMutex->Lock();
+
+		const bool quit = m_presentQuit;
+		const bool hasPacket = m_presentHasReady;
+		if (hasPacket)
+		{
+			std::swap(m_presentReadyIndex, m_presentRenderIndex);
+			m_presentHasReady = false;
+		}
+
+		m_presentMutex->Unlock();
+
+		if (hasPacket)
+			m_presentTakenEvent->Signal();
+
+		if (quit)
+			break;
+
+		if (hasPacket && !failed && !ExecutePresentPacket(m_presentPackets[m_presentRenderIndex]))
+		{
+			failed = true;
+
+			m_presentMutex->Lock();
+			m_presentFailed = true;
+			m_presentMutex->Unlock();
+		}
+	}
+
+	SDL_GL_MakeCurrent(m_window, nullptr);
+
+	m_presentExitEvent->Signal();
+}
+
+bool GpDisplayDriver_SDL_GL2::ExecutePresentPacket(const GpPresentPacket &packet)
+{
+	IGpLogDriver *logger = m_properties.m_logger;
+
+	m_presentState = packet.m_state;
+
+	ResetFrameUploadStats();
+
+	// The frame is cleared right before the first draw, since a reset in the middle of the packet replaces the back buffer
+	bool frameStarted = false;
+
+	const size_t numCommands = packet.m_commands.size();
+	for (size_t i = 0; i < numCommands; i++)
+	{
+		const GpPresentCommand &command = packet.m_commands[i];
+		const uint8_t *data = packet.m_data.data() + command.m_dataOffset;
+
+		switch (command.m_type)
+		{
+		case GpPresentCommandTypes::kCreateSurface:
+		case GpPresentCommandTypes::kRecreateSurface:
+			if (!command.m_surface->RecreateSingle())
+			{
+				if (logger)
+					logger->Printf(IGpLogDriver::Category_Error, "GpDisplayDriver_SDL_GL2::ExecutePresentPacket: Failed to create surface texture");
+			}
+			break;
+		case GpPresentCommandTypes::kDestroySurface:
+			command.m_surface->Delete();
+			break;
+		case GpPresentCommandTypes::kUpload:
+			command.m_surface->ExecuteUpload(data, command.m_x, command.m_y, command.m_width, command.m_height, command.m_pitch);
+			break;
+		case GpPresentCommandTypes::kUploadEntire:
+			command.m_surface->ExecuteUploadEntire(data, command.m_pitch);
+			break;
+		case GpPresentCommandTypes::kUpdatePalette:
+			ExecuteUpdatePalette(data);
+			break;
+		case GpPresentCommandTypes::kResetResources:
+			EndDraws();
+			m_res = InstancedResources();
+
+			if (!InitResources(m_presentState.m_windowWidthPhysical, m_presentState.m_windowHeightPhysical, m_presentState.m_windowWidthVirtual, m_presentState.m_windowHeightVirtual))
+			{
+				if (logger)
+					logger->Printf(IGpLogDriver::Category_Information, "Stopping render thread due to InitResources failing");
+
+				return false;
+			}
+
+			frameStarted = false;
+			break;
+		case GpPresentCommandTypes::kDrawSurface:
+			if (!frameStarted)
+			{
+				BeginFrame();
+				frameStarted = true;
+			}
+
+			ExecuteDrawSurface(command.m_surface, command.m_x, command.m_y, command.m_width, command.m_height, &command.m_effects);
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (!frameStarted)
+		BeginFrame();
+
+	EndDraws();
+	LogFrameUploadStats();
+
+	ScaleVirtualScreen();
+
+	CheckGLError(m_gl, logger);
+
+	SDL_GL_SwapWindow(m_window);
+
+	RecordPresentStats();
+
+	return true;
+}
+
+int GpDisplayDriver_SDL_GL2::PresentThreadFunc(void *context)
+{
+	static_cast<GpDisplayDriver_SDL_GL2*>(context)->PresentThreadMain();
+	return 0;
+}
+
 IGpDisplayDriver *GpDriver_CreateDisplayDriver_SDL_GL2(const GpDisplayDriverProperties &properties)
 {
 	GpDisplayDriver_SDL_GL2 *driver = static_cast<GpDisplayDriver_SDL_GL2*>(malloc(sizeof(GpDisplayDriver_SDL_GL2)));
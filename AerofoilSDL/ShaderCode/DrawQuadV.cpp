@@ -11,7 +11,18 @@
 "	texCoord = vec4(posUV.xyxy * surfaceDimensions_TextureRegion.zwxy);\n"\
 "}\n"
 
+#define GP_GL_SHADER_CODE_DRAWQUADBATCHV_GLSL	"attribute vec3 ndcPos;\n"\
+"attribute vec4 surfaceTexCoord;\n"\
+"varying vec4 texCoord;\n"\
+"\n"\
+"void main()\n"\
+"{\n"\
+"	gl_Position = vec4(ndcPos, 1.0);\n"\
+"	texCoord = surfaceTexCoord;\n"\
+"}\n"
+
 namespace GpBinarizedShaders
 {
 	const char *g_drawQuadV_GL2 = GP_GL_SHADER_CODE_DRAWQUADV_GLSL;
+	const char *g_drawQuadBatchV_GL2 = GP_GL_SHADER_CODE_DRAWQUADBATCHV_GLSL;
 }
@@ -19,8 +19,11 @@
 
 #include <string>
 #include <vector>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <fcntl.h>
+#include <string.h>
 #include <unistd.h>
 #include <errno.h>
 #include <dirent.h>
@@ -158,6 +161,177 @@ void GpFileStream_X_File::Flush()
 	fflush(m_f);
 }
 
+
+// Read-only stream over a memory-mapped file.  This is only used for packaged data that the game never
+// writes, since truncating a file while it's mapped would fault any reader.
+class GpFileStream_X_Mapped final : public GpIOStream
+{
+public:
+	GpFileStream_X_Mapped(const uint8_t *data, size_t size);
+	~GpFileStream_X_Mapped();
+
+	size_t Read(void *bytesOut, size_t size) override;
+	size_t Write(const void *bytes, size_t size) override;
+	bool IsSeekable() const override;
+	bool IsReadOnly() const override;
+	bool IsWriteOnly() const override;
+	bool SeekStart(GpUFilePos_t loc) override;
+	bool SeekCurrent(GpFilePos_t loc) override;
+	bool SeekEnd(GpUFilePos_t loc) override;
+	GpUFilePos_t Size() const override;
+	GpUFilePos_t Tell() const override;
+	void Close() override;
+	void Flush() override;
+	const void *GetMappedContents() const override;
+
+	static GpFileStream_X_Mapped *Open(const char *path);
+
+private:
+	const uint8_t *m_data;
+	size_t m_size;
+	size_t m_position;
+};
+
+GpFileStream_X_Mapped::GpFileStream_X_Mapped(const uint8_t *data, size_t size)
+	: m_data(data)
+	, m_size(size)
+	, m_position(0)
+{
+}
+
+GpFileStream_X_Mapped::~GpFileStream_X_Mapped()
+{
+	munmap(const_cast<uint8_t*>(m_data), m_size);
+}
+
+size_t GpFileStream_X_Mapped::Read(void *bytesOut, size_t size)
+{
+	const size_t available = m_size - m_position;
+	if (size > available)
+		size = available;
+
+	memcpy(bytesOut, m_data + m_position, size);
+	m_position += size;
+
+	return size;
+}
+
+size_t GpFileStream_X_Mapped::Write(const void *bytes, size_t size)
+{
+	return 0;
+}
+
+bool GpFileStream_X_Mapped::IsSeekable() const
+{
+	return true;
+}
+
+bool GpFileStream_X_Mapped::IsReadOnly() const
+{
+	return true;
+}
+
+bool GpFileStream_X_Mapped::IsWriteOnly() const
+{
+	return false;
+}
+
+bool GpFileStream_X_Mapped::SeekStart(GpUFilePos_t loc)
+{
+	if (loc > m_size)
+		return false;
+
+	m_position = static_cast<size_t>(loc);
+	return true;
+}
+
+bool GpFileStream_X_Mapped::SeekCurrent(GpFilePos_t loc)
+{
+	if (loc < 0)
+	{
+		if (static_cast<GpUFilePos_t>(-loc) > m_position)
+			return false;
+	}
+	else if (static_cast<GpUFilePos_t>(loc) > m_size - m_position)
+		return false;
+
+	m_position = static_cast<size_t>(static_cast<GpFilePos_t>(m_position) + loc);
+	return true;
+}
+
+bool GpFileStream_X_Mapped::SeekEnd(GpUFilePos_t loc)
+{
+	if (loc > m_size)
+		return false;
+
+	m_position = m_size - static_cast<size_t>(loc);
+	return true;
+}
+
+GpUFilePos_t GpFileStream_X_Mapped::Size() const
+{
+	return m_size;
+}
+
+GpUFilePos_t GpFileStream_X_Mapped::Tell() const
+{
+	return m_position;
+}
+
+void GpFileStream_X_Mapped::Close()
+{
+	this->~GpFileStream_X_Mapped();
+	free(this);
+}
+
+void GpFileStream_X_Mapped::Flush()
+{
+}
+
+const void *GpFileStream_X_Mapped::GetMappedContents() const
+{
+	return m_data;
+}
+
+GpFileStream_X_Mapped *GpFileStream_X_Mapped::Open(const char *path)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return nullptr;
+
+	struct stat64 s;
+	if (fstat64(fd, &s) < 0 || !S_ISREG(s.st_mode) || s.st_size <= 0 || static_cast<GpUFilePos_t>(s.st_size) > SIZE_MAX)
+	{
+		close(fd);
+		return nullptr;
+	}
+
+	const size_t size = static_cast<size_t>(s.st_size);
+	void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	// The mapping holds its own reference to the file
+	close(fd);
+
+	if (mapping == MAP_FAILED)
+		return nullptr;
+
+	void *objStorage = malloc(sizeof(GpFileStream_X_Mapped));
+	if (!objStorage)
+	{
+		munmap(mapping, size);
+		return nullptr;
+	}
+
+	return new (objStorage) GpFileStream_X_Mapped(static_cast<const uint8_t*>(mapping), size);
+}
+
+bool GpFileSystem_X::IsPackagedDirectory(PortabilityLayer::VirtualDirectory_t virtualDirectory)
+{
+	return virtualDirectory == PortabilityLayer::VirtualDirectories::kApplicationData
+		|| virtualDirectory == PortabilityLayer::VirtualDirectories::kGameData
+		|| virtualDirectory == PortabilityLayer::VirtualDirectories::kFonts;
+}
+
 bool GpFileSystem_X::ResolvePath(PortabilityLayer::VirtualDirectory_t virtualDirectory, char const* const* paths, size_t numPaths, std::string &resolution)
 {
 	const char *prefsAppend = nullptr;
@@ -298,6 +472,13 @@ GpIOStream *GpFileSystem_X::OpenFileNested(PortabilityLayer::VirtualDirectory_t
 	if (!ResolvePath(virtualDirectory, subPaths, numSubPaths, resolvedPath))
 		return nullptr;
 
+	if (!writeAccess && createDisposition == GpFileCreationDispositions::kOpenExisting && IsPackagedDirectory(virtualDirectory))
+	{
+		GpIOStream *mappedStream = GpFileStream_X_Mapped::Open(resolvedPath.c_str());
+		if (mappedStream)
+			return mappedStream;
+	}
+
 	void *objStorage = malloc(sizeof(GpFileStream_X_File));
 	if (!objStorage)
 		return nullptr;
@@ -31,6 +31,7 @@ public:
 	static GpFileSystem_X *GetInstance();
 
 private:
+	static bool IsPackagedDirectory(PortabilityLayer::VirtualDirectory_t virtualDirectory);
 	bool ResolvePath(PortabilityLayer::VirtualDirectory_t virtualDirectory, char const* const* paths, size_t numPaths, std::string &resolution);
 
 	DelayCallback_t m_delayCallback;
@@ -20,6 +20,7 @@
 #include "IGpVOSEventQueue.h"
 
 #include <string>
+#include <stdlib.h>
 #ifdef __MACOS__
 #include "MacInit.h"
 #endif
@@ -27,7 +28,9 @@
 GpXGlobals g_gpXGlobals;
 
 IGpDisplayDriver *GpDriver_CreateDisplayDriver_SDL_GL2(const GpDisplayDriverProperties &properties);
+IGpDisplayDriver *GpDriver_CreateDisplayDriver_Headless(const GpDisplayDriverProperties &properties);
 IGpAudioDriver *GpDriver_CreateAudioDriver_SDL(const GpAudioDriverProperties &properties);
+IGpAudioDriver *GpDriver_CreateAudioDriver_Null(const GpAudioDriverProperties &properties);
 IGpInputDriver *GpDriver_CreateInputDriver_SDL2_Gamepad(const GpInputDriverProperties &properties);
 
 #ifndef _WIN32
@@ -37,14 +40,47 @@ SDLMAIN_DECLSPEC int SDL_main(int argc, char *argv[])
 #endif
 {
 	bool enableLogging = false;
+	bool streamTextureUploads = false;
+	bool threadedPresent = false;
+	bool headless = false;
+	bool benchmark = false;
+	bool nullAudio = false;
+	const char *audioWavPath = nullptr;
+	const char *frameDumpPath = nullptr;
+	unsigned int frameDumpInterval = 1;
+	unsigned int frameLimit = 0;
 	for (int i = 1; i < argc; i++)
 	{
 		if (!strcmp(argv[i], "-diagnostics"))
 			enableLogging = true;
+		else if (!strcmp(argv[i], "-streamuploads"))
+			streamTextureUploads = true;
+		else if (!strcmp(argv[i], "-threadedpresent"))
+			threadedPresent = true;
+		else if (!strcmp(argv[i], "-headless"))
+			headless = true;
+		else if (!strcmp(argv[i], "-benchmark"))
+			benchmark = true;
+		else if (!strcmp(argv[i], "-nullaudio"))
+			nullAudio = true;
+		else if (!strcmp(argv[i], "-audiowav") && i + 1 < argc)
+		{
+			// Writing the mix out needs the null audio driver
+			audioWavPath = argv[++i];
+			nullAudio = true;
+		}
+		else if (!strcmp(argv[i], "-dumpframes") && i + 1 < argc)
+			frameDumpPath = argv[++i];
+		else if (!strcmp(argv[i], "-dumpinterval") && i + 1 < argc)
+			frameDumpInterval = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10));
+		else if (!strcmp(argv[i], "-framelimit") && i + 1 < argc)
+			frameLimit = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10));
 	}
 
 #ifndef __MACOS__
-	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_GAMECONTROLLER) < 0)
+	// The headless display driver doesn't need a video subsystem, so don't require one
+	const Uint32 sdlSubsystems = headless ? SDL_INIT_GAMECONTROLLER : (SDL_INIT_VIDEO | SDL_INIT_GAMECONTROLLER);
+	if (SDL_Init(sdlSubsystems) < 0)
 #else
 	if (MacInit())
 #endif
@@ -53,8 +89,9 @@ SDLMAIN_DECLSPEC int SDL_main(int argc, char *argv[])
 	GpFileSystem_X::GetInstance()->Init();
 
 	IGpLogDriver *logger = nullptr;
-	
-	if (enableLogging)
+
+	// Benchmark results are reported through the log
+	if (enableLogging || benchmark)
 	{
 		GpLogDriver_X::Init();
 		logger = GpLogDriver_X::GetInstance();
@@ -62,14 +99,27 @@ SDLMAIN_DECLSPEC int SDL_main(int argc, char *argv[])
 
 	GpDriverCollection *drivers = GpAppInterface_Get()->PL_GetDriverCollection();
 
+	if (benchmark)
+		GpAppInterface_Get()->SetBenchmarkMode(true);
+
 	drivers->SetDriver<GpDriverIDs::kFileSystem>(GpFileSystem_X::GetInstance());
 	drivers->SetDriver<GpDriverIDs::kSystemServices>(GpSystemServices_X::GetInstance());
 	drivers->SetDriver<GpDriverIDs::kLog>(GpLogDriver_X::GetInstance());
 	drivers->SetDriver<GpDriverIDs::kAlloc>(GpAllocator_C::GetInstance());
 
-	g_gpGlobalConfig.m_displayDriverType = EGpDisplayDriverType_SDL_GL2;
-	g_gpGlobalConfig.m_audioDriverType = EGpAudioDriverType_SDL2;
+	g_gpGlobalConfig.m_displayDriverType = headless ? EGpDisplayDriverType_Headless : EGpDisplayDriverType_SDL_GL2;
+	g_gpGlobalConfig.m_audioDriverType = nullAudio ? EGpAudioDriverType_Null : EGpAudioDriverType_SDL2;
 	g_gpGlobalConfig.m_fontHandlerType = EGpFontHandlerType_None;
+	g_gpGlobalConfig.m_streamTextureUploads = streamTextureUploads;
+	g_gpGlobalConfig.m_threadedPresent = threadedPresent;
+	g_gpGlobalConfig.m_frameDumpPath = frameDumpPath;
+	g_gpGlobalConfig.m_frameDumpInterval = frameDumpInterval;
+	g_gpGlobalConfig.m_frameLimit = frameLimit;
+	g_gpGlobalConfig.m_audioWavPath = audioWavPath;
+
+	// A written mix should be reproducible, so it plays on the game's tick clock.  -nullaudio alone keeps wall
+	// clock pacing for soak runs.
+	g_gpGlobalConfig.m_audioVirtualClock = (audioWavPath != nullptr);
 
 	EGpInputDriverType inputDrivers[] =
 	{
@@ -85,7 +135,9 @@ SDLMAIN_DECLSPEC int SDL_main(int argc, char *argv[])
 	g_gpGlobalConfig.m_allocator = GpAllocator_C::GetInstance();
 
 	GpDisplayDriverFactory::RegisterDisplayDriverFactory(EGpDisplayDriverType_SDL_GL2, GpDriver_CreateDisplayDriver_SDL_GL2);
+	GpDisplayDriverFactory::RegisterDisplayDriverFactory(EGpDisplayDriverType_Headless, GpDriver_CreateDisplayDriver_Headless);
 	GpAudioDriverFactory::RegisterAudioDriverFactory(EGpAudioDriverType_SDL2, GpDriver_CreateAudioDriver_SDL);
+	GpAudioDriverFactory::RegisterAudioDriverFactory(EGpAudioDriverType_Null, GpDriver_CreateAudioDriver_Null);
 	GpInputDriverFactory::RegisterInputDriverFactory(EGpInputDriverType_SDL2_Gamepad, GpDriver_CreateInputDriver_SDL2_Gamepad);
 
 	if (logger)
@@ -0,0 +1,219 @@
+//============================================================================
+//----------------------------------------------------------------------------
+//								Benchmark.cpp
+//----------------------------------------------------------------------------
+//============================================================================
+
+// Benchmark mode replays the built-in demo with the frame cap removed and
+// records how long each frame spends in each phase of the game loop.
+
+#include "Benchmark.h"
+#include "DecodedImageCache.h"
+#include "MemoryManager.h"
+#include "SoundCache.h"
+#include "TextRunCache.h"
+
+#include "IGpLogDriver.h"
+#include "PLDrivers.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock BenchmarkClock_t;
+
+	struct BenchmarkFrameSample
+	{
+		uint64_t m_phaseNanoseconds[BenchmarkPhases::kCount];
+	};
+
+	struct BenchmarkState
+	{
+		BenchmarkState();
+
+		bool m_isEnabled;
+		bool m_isInFrame;
+		BenchmarkClock_t::time_point m_lastMarkTime;
+		BenchmarkFrameSample m_currentFrame;
+		std::vector<BenchmarkFrameSample> m_frames;
+	};
+
+	BenchmarkState::BenchmarkState()
+		: m_isEnabled(false)
+		, m_isInFrame(false)
+	{
+	}
+
+	BenchmarkState gs_benchmarkState;
+
+	const char *gs_benchmarkPhaseNames[BenchmarkPhases::kCount] =
+	{
+		"Logic",
+		"Reflections",
+		"Grease",
+		"Pendulums",
+		"Flames/Stars",
+		"Dynamics",
+		"FlyingPoints",
+		"Sparkles",
+		"Gliders",
+		"Shreds",
+		"Bands",
+		"TouchControls",
+		"CopyRectsQD",
+		"Present",
+	};
+
+	double PercentileMicroseconds(const std::vector<uint64_t> &sortedSamples, unsigned int percentile)
+	{
+		const size_t index = (sortedSamples.size() - 1) * percentile / 100;
+		return static_cast<double>(sortedSamples[index]) / 1000.0;
+	}
+
+	void ReportSamples(IGpLogDriver *logger, const char *name, std::vector<uint64_t> &samples)
+	{
+		std::sort(samples.begin(), samples.end());
+
+		uint64_t total = 0;
+		for (size_t i = 0; i < samples.size(); i++)
+			total += samples[i];
+
+		const double meanMicroseconds = static_cast<double>(total) / static_cast<double>(samples.size()) / 1000.0;
+
+		logger->Printf(IGpLogDriver::Category_Information, "Benchmark: %-14s mean %9.1f  p50 %9.1f  p90 %9.1f  p99 %9.1f  max %9.1f", name, meanMicroseconds,
+			PercentileMicroseconds(samples, 50), PercentileMicroseconds(samples, 90), PercentileMicroseconds(samples, 99), PercentileMicroseconds(samples, 100));
+	}
+}
+
+//==============================================================  Functions
+//--------------------------------------------------------------  BenchmarkSetEnabled
+
+void BenchmarkSetEnabled(bool enabled)
+{
+	gs_benchmarkState.m_isEnabled = enabled;
+}
+
+//--------------------------------------------------------------  BenchmarkIsEnabled
+
+bool BenchmarkIsEnabled()
+{
+	return gs_benchmarkState.m_isEnabled;
+}
+
+//--------------------------------------------------------------  BenchmarkBeginFrame
+
+void BenchmarkBeginFrame()
+{
+	if (!gs_benchmarkState.m_isEnabled)
+		return;
+
+	for (int i = 0; i < BenchmarkPhases::kCount; i++)
+		gs_benchmarkState.m_currentFrame.m_phaseNanoseconds[i] = 0;
+
+	gs_benchmarkState.m_isInFrame = true;
+	gs_benchmarkState.m_lastMarkTime = BenchmarkClock_t::now();
+}
+
+//--------------------------------------------------------------  BenchmarkEndPhase
+// Charges the time since the last mark to a phase.
+
+void BenchmarkEndPhase(BenchmarkPhase_t phase)
+{
+	if (!gs_benchmarkState.m_isInFrame)
+		return;
+
+	const BenchmarkClock_t::time_point now = BenchmarkClock_t::now();
+	const uint64_t elapsed = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - gs_benchmarkState.m_lastMarkTime).count());
+
+	gs_benchmarkState.m_currentFrame.m_phaseNanoseconds[phase] += elapsed;
+	gs_benchmarkState.m_lastMarkTime = now;
+}
+
+//--------------------------------------------------------------  BenchmarkEndFrame
+// Anything after the last render phase (scoreboard, game over countdown) counts as logic.
+
+void BenchmarkEndFrame()
+{
+	if (!gs_benchmarkState.m_isInFrame)
+		return;
+
+	BenchmarkEndPhase(BenchmarkPhases::kLogic);
+
+	gs_benchmarkState.m_frames.push_back(gs_benchmarkState.m_currentFrame);
+	gs_benchmarkState.m_isInFrame = false;
+}
+
+//--------------------------------------------------------------  BenchmarkReport
+
+void BenchmarkReport()
+{
+	IGpLogDriver *logger = PLDrivers::GetLogDriver();
+	if (!logger)
+		return;
+
+	const std::vector<BenchmarkFrameSample> &frames = gs_benchmarkState.m_frames;
+	const size_t numFrames = frames.size();
+
+	if (numFrames == 0)
+	{
+		logger->Printf(IGpLogDriver::Category_Warning, "Benchmark: No frames were recorded");
+		return;
+	}
+
+	std::vector<uint64_t> samples;
+	std::vector<uint64_t> frameTotals;
+	samples.resize(numFrames);
+	frameTotals.resize(numFrames, 0);
+
+	uint64_t totalTime = 0;
+	for (size_t i = 0; i < numFrames; i++)
+	{
+		for (int phase = 0; phase < BenchmarkPhases::kCount; phase++)
+			frameTotals[i] += frames[i].m_phaseNanoseconds[phase];
+
+		totalTime += frameTotals[i];
+	}
+
+	const double totalSeconds = static_cast<double>(totalTime) / 1000000000.0;
+	logger->Printf(IGpLogDriver::Category_Information, "Benchmark: %u frames in %.3f s, %.1f frames/s (times in microseconds)", static_cast<unsigned int>(numFrames), totalSeconds, static_cast<double>(numFrames) / totalSeconds);
+
+	for (int phase = 0; phase < BenchmarkPhases::kCount; phase++)
+	{
+		for (size_t i = 0; i < numFrames; i++)
+			samples[i] = frames[i].m_phaseNanoseconds[phase];
+
+		ReportSamples(logger, gs_benchmarkPhaseNames[phase], samples);
+	}
+
+	ReportSamples(logger, "Frame", frameTotals);
+
+	PortabilityLayer::DecodedImageCacheStats imageCacheStats;
+	PortabilityLayer::DecodedImageCache::GetInstance()->GetStats(imageCacheStats);
+	logger->Printf(IGpLogDriver::Category_Information, "Benchmark: Image cache %u hits, %u misses, %u evictions, %u entries using %u/%u bytes",
+		static_cast<unsigned int>(imageCacheStats.m_numHits), static_cast<unsigned int>(imageCacheStats.m_numMisses), static_cast<unsigned int>(imageCacheStats.m_numEvictions),
+		static_cast<unsigned int>(imageCacheStats.m_numEntries), static_cast<unsigned int>(imageCacheStats.m_bytesUsed), static_cast<unsigned int>(imageCacheStats.m_byteBudget));
+	logger->Printf(IGpLogDriver::Category_Information, "Benchmark: Image cache %u prefetches, %u prefetch hits",
+		static_cast<unsigned int>(imageCacheStats.m_numPrefetches), static_cast<unsigned int>(imageCacheStats.m_numPrefetchHits));
+
+	PortabilityLayer::SoundCacheStats soundCacheStats;
+	PortabilityLayer::SoundCache::GetInstance()->GetStats(soundCacheStats);
+	logger->Printf(IGpLogDriver::Category_Information, "Benchmark: Sound cache %u hits, %u misses, %u evictions, %u entries using %u/%u bytes",
+		static_cast<unsigned int>(soundCacheStats.m_numHits), static_cast<unsigned int>(soundCacheStats.m_numMisses), static_cast<unsigned int>(soundCacheStats.m_numEvictions),
+		static_cast<unsigned int>(soundCacheStats.m_numEntries), static_cast<unsigned int>(soundCacheStats.m_bytesUsed), static_cast<unsigned int>(soundCacheStats.m_byteBudget));
+
+	PortabilityLayer::TextRunCacheStats textRunCacheStats;
+	PortabilityLayer::TextRunCache::GetInstance()->GetStats(textRunCacheStats);
+	logger->Printf(IGpLogDriver::Category_Information, "Benchmark: Text run cache %u hits, %u misses, %u evictions, %u entries using %u/%u bytes",
+		static_cast<unsigned int>(textRunCacheStats.m_numHits), static_cast<unsigned int>(textRunCacheStats.m_numMisses), static_cast<unsigned int>(textRunCacheStats.m_numEvictions),
+		static_cast<unsigned int>(textRunCacheStats.m_numEntries), static_cast<unsigned int>(textRunCacheStats.m_bytesUsed), static_cast<unsigned int>(textRunCacheStats.m_byteBudget));
+
+	PortabilityLayer::MemoryManagerStats memStats;
+	PortabilityLayer::MemoryManager::GetInstance()->GetStats(memStats);
+	logger->Printf(IGpLogDriver::Category_Information, "Benchmark: Memory %u live bytes in %u allocations and %u handles, %u peak bytes, %u bytes reserved by pools, %u allocations last frame",
+		static_cast<unsigned int>(memStats.m_liveBytes), static_cast<unsigned int>(memStats.m_numLiveAllocations), static_cast<unsigned int>(memStats.m_numLiveHandles),
+		static_cast<unsigned int>(memStats.m_peakBytes), static_cast<unsigned int>(memStats.m_reservedBytes), static_cast<unsigned int>(memStats.m_numAllocationsLastFrame));
+}
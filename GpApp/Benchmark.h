@@ -0,0 +1,36 @@
+#pragma once
+
+namespace BenchmarkPhases
+{
+	enum BenchmarkPhase
+	{
+		kLogic,
+		kReflections,
+		kGrease,
+		kPendulums,
+		kFlamesAndStars,
+		kDynamics,
+		kFlyingPoints,
+		kSparkles,
+		kGliders,
+		kShreds,
+		kRubberBands,
+		kTouchScreenControls,
+		kCopyRects,
+		kPresent,
+
+		kCount,
+	};
+}
+
+typedef BenchmarkPhases::BenchmarkPhase BenchmarkPhase_t;
+
+void BenchmarkSetEnabled(bool enabled);
+bool BenchmarkIsEnabled();
+
+void BenchmarkBeginFrame();
+void BenchmarkEndPhase(BenchmarkPhase_t phase);
+void BenchmarkEndFrame();
+void BenchmarkReport();
+
+bool BenchmarkSubsystems();
@@ -0,0 +1,1922 @@
+//============================================================================
+//----------------------------------------------------------------------------
+//							BenchmarkSubsystems.cpp
+//----------------------------------------------------------------------------
+//============================================================================
+
+// Subsystem benchmarks run at the start of benchmark mode, before the demo
+// replay.  Each one checks the fast path against its reference on the same
+// input first, then times both, so a regression in either correctness or
+// speed shows up in the log.  The audio channel churn is a stress run
+// instead: channels are fed, stopped, created and destroyed while the mixer
+// is running, and every callback has to run exactly once.  The house movies
+// are played through once streamed and once fully loaded, and the frames
+// and the memory each way uses are compared.
+
+#include "Benchmark.h"
+#include "AntiAliasTable.h"
+#include "BlitKernels.h"
+#include "DeflateCodec.h"
+#include "Externs.h"
+#include "FileManager.h"
+#include "GpAudioMixKernels.h"
+#include "GPArchive.h"
+#include "InflateStream.h"
+#include "MemoryManager.h"
+#include "MemReaderStream.h"
+#include "PLMovies.h"
+#include "ResourceManager.h"
+#include "ResTypeID.h"
+#include "ZipFile.h"
+#include "ZipFileProxy.h"
+
+#include "IGpAudioBuffer.h"
+#include "IGpAudioDriver.h"
+#include "IGpLogDriver.h"
+#include "IGpSystemServices.h"
+#include "PLCore.h"
+#include "PLDrivers.h"
+#include "PLSound.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+extern short numberRooms;
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock BenchmarkClock_t;
+
+	// Same chunk size as the audio drivers
+	static const size_t kAudioMixChunkSamples = 512;
+
+	// Fixed seed so that every run sees the same data
+	class BenchmarkRandom
+	{
+	public:
+		BenchmarkRandom();
+
+		uint32_t Next();
+		void Fill(uint8_t *bytes, size_t size);
+
+	private:
+		uint32_t m_state;
+	};
+
+	BenchmarkRandom::BenchmarkRandom()
+		: m_state(0x9E3779B9)
+	{
+	}
+
+	uint32_t BenchmarkRandom::Next()
+	{
+		m_state ^= m_state << 13;
+		m_state ^= m_state >> 17;
+		m_state ^= m_state << 5;
+		return m_state;
+	}
+
+	void BenchmarkRandom::Fill(uint8_t *bytes, size_t size)
+	{
+		for (size_t i = 0; i < size; i++)
+			bytes[i] = static_cast<uint8_t>(Next() >> 24);
+	}
+
+	double ElapsedNanoseconds(const BenchmarkClock_t::time_point &startTime)
+	{
+		return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(BenchmarkClock_t::now() - startTime).count());
+	}
+
+	namespace BlitMaskPatterns
+	{
+		enum BlitMaskPattern
+		{
+			kTransparent,
+			kOpaque,
+			kMixed,
+			kRuns,
+
+			kCount,
+		};
+	}
+
+	typedef BlitMaskPatterns::BlitMaskPattern BlitMaskPattern_t;
+
+	// Builds a per-pixel mask where nonzero is opaque.  Runs look like sprite rows, where whole blocks are
+	// usually all one way or the other.
+	void GenerateBlitMask(BenchmarkRandom &rng, uint8_t *mask, size_t numPixels, BlitMaskPattern_t pattern)
+	{
+		bool runIsOpaque = false;
+		size_t runRemaining = 0;
+
+		for (size_t i = 0; i < numPixels; i++)
+		{
+			switch (pattern)
+			{
+			case BlitMaskPatterns::kTransparent:
+				mask[i] = 0;
+				break;
+			case BlitMaskPatterns::kOpaque:
+				mask[i] = 1;
+				break;
+			case BlitMaskPatterns::kMixed:
+				mask[i] = static_cast<uint8_t>(rng.Next() & 1);
+				break;
+			case BlitMaskPatterns::kRuns:
+			default:
+				if (runRemaining == 0)
+				{
+					runIsOpaque = !runIsOpaque;
+					runRemaining = 1 + (rng.Next() % 48);
+				}
+				mask[i] = runIsOpaque ? 1 : 0;
+				runRemaining--;
+				break;
+			}
+		}
+	}
+
+	// Glyph coverage uses level 0 for transparent, 15 for solid, and anything in between as partial
+	void MaskToCoverage(BenchmarkRandom &rng, const uint8_t *mask, uint8_t *coverage, size_t numPixels, bool addPartials)
+	{
+		for (size_t i = 0; i < numPixels; i++)
+		{
+			coverage[i] = mask[i] ? 15 : 0;
+			if (addPartials && (rng.Next() & 3) == 0)
+				coverage[i] = static_cast<uint8_t>(1 + rng.Next() % 14);
+		}
+	}
+
+	// Pixel sizes are expanded from the 8-bit mask.  32-bit masks are white where transparent.
+	void ExpandMask32(BenchmarkRandom &rng, const uint8_t *mask, uint8_t *mask32, size_t numPixels)
+	{
+		for (size_t i = 0; i < numPixels; i++)
+		{
+			if (mask[i])
+			{
+				rng.Fill(mask32 + i * 4, 4);
+				if (memcmp(mask32 + i * 4, "\xff\xff\xff\xff", 4) == 0)
+					mask32[i * 4] = 0;
+			}
+			else
+				memset(mask32 + i * 4, 0xff, 4);
+		}
+	}
+
+	struct BlitKernelTestBuffers
+	{
+		static const size_t kGuardBytes = 64;
+
+		// Room for the widest row plus an offset to misalign it and guard bytes to catch overruns
+		void Resize(size_t numPixels);
+
+		std::vector<uint8_t> m_src;
+		std::vector<uint8_t> m_mask;
+		std::vector<uint8_t> m_mask32;
+		std::vector<uint8_t> m_coverage;
+		std::vector<uint8_t> m_destInitial;
+		std::vector<uint8_t> m_destReference;
+		std::vector<uint8_t> m_destTest;
+	};
+
+	void BlitKernelTestBuffers::Resize(size_t numPixels)
+	{
+		const size_t size = numPixels * 4 + kGuardBytes;
+
+		m_src.resize(size);
+		m_mask.resize(size);
+		m_mask32.resize(size);
+		m_coverage.resize(size);
+		m_destInitial.resize(size);
+		m_destReference.resize(size);
+		m_destTest.resize(size);
+	}
+
+	namespace BlitKernelIDs
+	{
+		enum BlitKernelID
+		{
+			kCopyMask8Row8,
+			kCopyMask8Row32,
+			kCopyMask32Row32,
+			kBlendGlyphRow8,
+			kBlendGlyphRow32,
+
+			kCount,
+		};
+	}
+
+	typedef BlitKernelIDs::BlitKernelID BlitKernelID_t;
+
+	const char *gs_blitKernelNames[BlitKernelIDs::kCount] =
+	{
+		"CopyMask8Row8",
+		"CopyMask8Row32",
+		"CopyMask32Row32",
+		"BlendGlyphRow8",
+		"BlendGlyphRow32",
+	};
+
+	struct BlitKernelTables
+	{
+		PortabilityLayer::AntiAliasTable m_tables[3];
+		const PortabilityLayer::AntiAliasTable *m_tablePtrs[3];
+		uint8_t m_solidRGB[3];
+	};
+
+	void RunBlitKernel(const PortabilityLayer::BlitKernels *kernels, BlitKernelID_t kernelID, const BlitKernelTables &tables,
+		uint8_t *dest, const BlitKernelTestBuffers &buffers, size_t offset, size_t numPixels)
+	{
+		switch (kernelID)
+		{
+		case BlitKernelIDs::kCopyMask8Row8:
+			kernels->m_copyMask8Row8(dest + offset, &buffers.m_src[offset], &buffers.m_mask[offset], numPixels);
+			break;
+		case BlitKernelIDs::kCopyMask8Row32:
+			kernels->m_copyMask8Row32(dest + offset, &buffers.m_src[offset], &buffers.m_mask[offset], numPixels);
+			break;
+		case BlitKernelIDs::kCopyMask32Row32:
+			kernels->m_copyMask32Row32(dest + offset, &buffers.m_src[offset], &buffers.m_mask32[offset], numPixels);
+			break;
+		case BlitKernelIDs::kBlendGlyphRow8:
+			kernels->m_blendGlyphRow8(dest + offset, &buffers.m_coverage[offset], numPixels, &tables.m_tables[0], tables.m_solidRGB[0]);
+			break;
+		case BlitKernelIDs::kBlendGlyphRow32:
+			kernels->m_blendGlyphRow32(dest + offset, &buffers.m_coverage[offset], numPixels, tables.m_tablePtrs, tables.m_solidRGB);
+			break;
+		default:
+			break;
+		}
+	}
+
+	// Compares every kernel variant against the scalar one for every row length up to a few blocks past the
+	// widest vector, at each misalignment, so that all of the tail paths are covered
+	bool CheckBlitKernels(IGpLogDriver *logger, BenchmarkRandom &rng, BlitKernelTestBuffers &buffers, const BlitKernelTables &tables)
+	{
+		const size_t kMaxCheckedLength = 100;
+		const size_t kMaxOffset = 4;
+
+		const PortabilityLayer::BlitKernels *reference = PortabilityLayer::BlitKernels::GetVariant(0);
+		const size_t numVariants = PortabilityLayer::BlitKernels::GetNumVariants();
+
+		size_t numMismatches = 0;
+
+		for (size_t numPixels = 0; numPixels <= kMaxCheckedLength; numPixels++)
+		{
+			for (size_t offset = 0; offset < kMaxOffset; offset++)
+			{
+				for (int pattern = 0; pattern < BlitMaskPatterns::kCount; pattern++)
+				{
+					rng.Fill(&buffers.m_src[0], buffers.m_src.size());
+					rng.Fill(&buffers.m_destInitial[0], buffers.m_destInitial.size());
+					memset(&buffers.m_mask[0], 0, buffers.m_mask.size());
+					memset(&buffers.m_mask32[0], 0xff, buffers.m_mask32.size());
+					memset(&buffers.m_coverage[0], 0, buffers.m_coverage.size());
+
+					GenerateBlitMask(rng, &buffers.m_mask[offset], numPixels, static_cast<BlitMaskPattern_t>(pattern));
+					ExpandMask32(rng, &buffers.m_mask[offset], &buffers.m_mask32[offset], numPixels);
+					MaskToCoverage(rng, &buffers.m_mask[offset], &buffers.m_coverage[offset], numPixels, pattern == BlitMaskPatterns::kMixed || pattern == BlitMaskPatterns::kRuns);
+
+					for (int kernelID = 0; kernelID < BlitKernelIDs::kCount; kernelID++)
+					{
+						buffers.m_destReference = buffers.m_destInitial;
+						RunBlitKernel(reference, static_cast<BlitKernelID_t>(kernelID), tables, &buffers.m_destReference[0], buffers, offset, numPixels);
+
+						for (size_t variant = 1; variant < numVariants; variant++)
+						{
+							const PortabilityLayer::BlitKernels *kernels = PortabilityLayer::BlitKernels::GetVariant(variant);
+
+							buffers.m_destTest = buffers.m_destInitial;
+							RunBlitKernel(kernels, static_cast<BlitKernelID_t>(kernelID), tables, &buffers.m_destTest[0], buffers, offset, numPixels);
+
+							if (buffers.m_destTest != buffers.m_destReference)
+							{
+								if (numMismatches < 10)
+									logger->Printf(IGpLogDriver::Category_Error, "Benchmark: %s %s doesn't match the scalar kernel for %u pixels at offset %u",
+										kernels->m_name, gs_blitKernelNames[kernelID], static_cast<unsigned int>(numPixels), static_cast<unsigned int>(offset));
+								numMismatches++;
+							}
+						}
+					}
+				}
+			}
+		}
+
+		if (numMismatches != 0)
+		{
+			logger->Printf(IGpLogDriver::Category_Error, "Benchmark: %u blit kernel mismatches", static_cast<unsigned int>(numMismatches));
+			return false;
+		}
+
+		logger->Printf(IGpLogDriver::Category_Information, "Benchmark: All %u blit kernel variants match the scalar kernels for rows of 0-%u pixels",
+			static_cast<unsigned int>(numVariants), static_cast<unsigned int>(kMaxCheckedLength));
+		return true;
+	}
+
+	// Times a screen-width row with sprite-like runs
+	void TimeBlitKernels(IGpLogDriver *logger, BenchmarkRandom &rng, BlitKernelTestBuffers &buffers, const BlitKernelTables &tables)
+	{
+		const size_t kRowPixels = 640;
+		const unsigned int kNumRows = 20000;
+
+		GenerateBlitMask(rng, &buffers.m_mask[0], kRowPixels, BlitMaskPatterns::kRuns);
+		ExpandMask32(rng, &buffers.m_mask[0], &buffers.m_mask32[0], kRowPixels);
+		MaskToCoverage(rng, &buffers.m_mask[0], &buffers.m_coverage[0], kRowPixels, true);
+
+		const size_t numVariants = PortabilityLayer::BlitKernels::GetNumVariants();
+
+		for (int kernelID = 0; kernelID < BlitKernelIDs::kCount; kernelID++)
+		{
+			double scalarNanoseconds = 0.0;
+
+			for (size_t variant = 0; variant < numVariants; variant++)
+			{
+				const PortabilityLayer::BlitKernels *kernels = PortabilityLayer::BlitKernels::GetVariant(variant);
+
+				buffers.m_destTest = buffers.m_destInitial;
+
+				const BenchmarkClock_t::time_point startTime = BenchmarkClock_t::now();
+				for (unsigned int row = 0; row < kNumRows; row++)
+					RunBlitKernel(kernels, static_cast<BlitKernelID_t>(kernelID), tables, &buffers.m_destTest[0], buffers, 0, kRowPixels);
+				const double nanosecondsPerRow = ElapsedNanoseconds(startTime) / kNumRows;
+
+				if (variant == 0)
+					scalarNanoseconds = nanosecondsPerRow;
+
+				logger->Printf(IGpLogDriver::Category_Information, "Benchmark: Blit %-16s %-6s %9.1f ns per %u pixel row, %5.2fx scalar", gs_blitKernelNames[kernelID], kernels->m_name,
+					nanosecondsPerRow, static_cast<unsigned int>(kRowPixels), scalarNanoseconds / nanosecondsPerRow);
+			}
+		}
+	}
+
+	bool BenchmarkBlitKernels(IGpLogDriver *logger)
+	{
+		BenchmarkRandom rng;
+
+		BlitKernelTables tables;
+		for (int ch = 0; ch < 3; ch++)
+		{
+			rng.Fill(&tables.m_tables[ch].m_aaTranslate[0][0], sizeof(tables.m_tables[ch].m_aaTranslate));
+			tables.m_tablePtrs[ch] = &tables.m_tables[ch];
+			tables.m_solidRGB[ch] = static_cast<uint8_t>(rng.Next() >> 24);
+		}
+
+		BlitKernelTestBuffers buffers;
+		buffers.Resize(640);
+
+		if (!CheckBlitKernels(logger, rng, buffers, tables))
+			return false;
+
+		TimeBlitKernels(logger, rng, buffers, tables);
+		return true;
+	}
+
+	// Write-only memory stream for DeflateContext to compress into
+	class BenchmarkWriteStream final : public GpIOStream
+	{
+	public:
+		size_t Read(void *bytesOut, size_t size) override;
+		size_t Write(const void *bytes, size_t size) override;
+		bool IsSeekable() const override;
+		bool IsReadOnly() const override;
+		bool IsWriteOnly() const override;
+		bool SeekStart(GpUFilePos_t loc) override;
+		bool SeekCurrent(GpFilePos_t loc) override;
+		bool SeekEnd(GpUFilePos_t loc) override;
+		GpUFilePos_t Size() const override;
+		GpUFilePos_t Tell() const override;
+		void GP_ASYNCIFY_PARANOID_NAMED(Close)() override;
+		void Flush() override;
+
+		std::vector<uint8_t> m_bytes;
+	};
+
+	size_t BenchmarkWriteStream::Read(void *bytesOut, size_t size)
+	{
+		return 0;
+	}
+
+	size_t BenchmarkWriteStream::Write(const void *bytes, size_t size)
+	{
+		m_bytes.insert(m_bytes.end(), static_cast<const uint8_t*>(bytes), static_cast<const uint8_t*>(bytes) + size);
+		return size;
+	}
+
+	bool BenchmarkWriteStream::IsSeekable() const
+	{
+		return false;
+	}
+
+	bool BenchmarkWriteStream::IsReadOnly() const
+	{
+		return false;
+	}
+
+	bool BenchmarkWriteStream::IsWriteOnly() const
+	{
+		return true;
+	}
+
+	bool BenchmarkWriteStream::SeekStart(GpUFilePos_t loc)
+	{
+		return false;
+	}
+
+	bool BenchmarkWriteStream::SeekCurrent(GpFilePos_t loc)
+	{
+		return false;
+	}
+
+	bool BenchmarkWriteStream::SeekEnd(GpUFilePos_t loc)
+	{
+		return false;
+	}
+
+	GpUFilePos_t BenchmarkWriteStream::Size() const
+	{
+		return m_bytes.size();
+	}
+
+	GpUFilePos_t BenchmarkWriteStream::Tell() const
+	{
+		return m_bytes.size();
+	}
+
+	void BenchmarkWriteStream::GP_ASYNCIFY_PARANOID_NAMED(Close)()
+	{
+	}
+
+	void BenchmarkWriteStream::Flush()
+	{
+	}
+
+	// Builds raw deflate data by hand, for block layouts zlib's compressor doesn't produce on its own
+	class BenchmarkBitWriter
+	{
+	public:
+		BenchmarkBitWriter();
+
+		void PutBits(uint32_t value, unsigned int numBits);
+		void AlignToByte();
+
+		void PutEmptyFixedBlock();
+		void PutStoredBlock(const uint8_t *data, uint16_t size, bool isFinal);
+
+		std::vector<uint8_t> m_bytes;
+
+	private:
+		uint32_t m_bits;
+		unsigned int m_numBits;
+	};
+
+	BenchmarkBitWriter::BenchmarkBitWriter()
+		: m_bits(0)
+		, m_numBits(0)
+	{
+	}
+
+	void BenchmarkBitWriter::PutBits(uint32_t value, unsigned int numBits)
+	{
+		m_bits |= value << m_numBits;
+		m_numBits += numBits;
+
+		while (m_numBits >= 8)
+		{
+			m_bytes.push_back(static_cast<uint8_t>(m_bits & 0xff));
+			m_bits >>= 8;
+			m_numBits -= 8;
+		}
+	}
+
+	void BenchmarkBitWriter::AlignToByte()
+	{
+		if (m_numBits > 0)
+			PutBits(0, 8 - m_numBits);
+	}
+
+	void BenchmarkBitWriter::PutEmptyFixedBlock()
+	{
+		// Not final, fixed Huffman codes, then the 7-bit end-of-block code, which is all zeroes.  This is what a
+		// Z_PARTIAL_FLUSH emits, and it's short enough to end inside zlib's bit buffer.
+		PutBits(0, 1);
+		PutBits(1, 2);
+		PutBits(0, 7);
+	}
+
+	void BenchmarkBitWriter::PutStoredBlock(const uint8_t *data, uint16_t size, bool isFinal)
+	{
+		PutBits(isFinal ? 1 : 0, 1);
+		PutBits(0, 2);
+		AlignToByte();
+
+		PutBits(size, 16);
+		PutBits(static_cast<uint16_t>(~size), 16);
+		m_bytes.insert(m_bytes.end(), data, data + size);
+	}
+
+	void GenerateInflateText(BenchmarkRandom &rng, std::vector<uint8_t> &text, size_t size)
+	{
+		static const char *kWords[] = { "glider ", "house ", "room ", "candle ", "vent ", "band ", "battery ", "clock ",
+			"star ", "foil ", "helium ", "cupboard ", "shelf ", "window ", "mirror ", "basket " };
+
+		text.clear();
+		while (text.size() < size)
+		{
+			const char *word = kWords[rng.Next() % (sizeof(kWords) / sizeof(kWords[0]))];
+			text.insert(text.end(), word, word + strlen(word));
+
+			if (rng.Next() % 16 == 0)
+				text.push_back(static_cast<uint8_t>('0' + rng.Next() % 10));
+		}
+
+		text.resize(size);
+	}
+
+	bool CheckInflateRead(IGpLogDriver *logger, const char *name, GpIOStream *stream, const std::vector<uint8_t> &expected, size_t pos, size_t size)
+	{
+		uint8_t readBuffer[256];
+
+		if (stream->Read(readBuffer, size) != size || memcmp(readBuffer, &expected[pos], size) != 0)
+		{
+			logger->Printf(IGpLogDriver::Category_Error, "Benchmark: Inflate %s read the wrong data at %u", name, static_cast<unsigned int>(pos));
+			return false;
+		}
+
+		return true;
+	}
+
+	bool BenchmarkInflateSeeks(IGpLogDriver *logger, BenchmarkRandom &rng, const char *name, const std::vector<uint8_t> &compressed, const std::vector<uint8_t> &decompressed)
+	{
+		static const unsigned int kNumSeeks = 256;
+		static const size_t kReadSize = 256;
+
+		const size_t size = decompressed.size();
+
+		PortabilityLayer::MemReaderStream memStream(&compressed[0], compressed.size());
+		GpIOStream *stream = PortabilityLayer::InflateStream::Create(&memStream, 0, compressed.size(), size);
+		if (!stream)
+		{
+			logger->Printf(IGpLogDriver::Category_Error, "Benchmark: Inflate %s couldn't open its stream", name);
+			return false;
+		}
+
+		bool passed = true;
+
+		// Straight through first, which is what a seek costs without checkpoints
+		const BenchmarkClock_t::time_point fullStartTime = BenchmarkClock_t::now();
+		for (size_t pos = 0; passed && pos < size; pos += kReadSize)
+		{
+			const size_t readSize = (size - pos < kReadSize) ? (size - pos) : kReadSize;
+			passed = CheckInflateRead(logger, name, stream, decompressed, pos, readSize);
+		}
+		const double fullMilliseconds = ElapsedNanoseconds(fullStartTime) / 1000000.0;
+
+		// The ends of the stream, and short hops both ways
+		uint8_t byte = 0;
+		passed = passed && stream->SeekStart(size) && stream->Read(&byte, 1) == 0;
+		passed = passed && stream->SeekStart(size - 1) && CheckInflateRead(logger, name, stream, decompressed, size - 1, 1);
+		passed = passed && stream->SeekStart(0) && CheckInflateRead(logger, name, stream, decompressed, 0, kReadSize);
+		passed = passed && stream->SeekCurrent(-16) && CheckInflateRead(logger, name, stream, decompressed, kReadSize - 16, 16);
+		passed = passed && stream->SeekEnd(kReadSize) && CheckInflateRead(logger, name, stream, decompressed, size - kReadSize, kReadSize);
+		passed = passed && !stream->SeekStart(size + 1);
+
+		if (!passed)
+			logger->Printf(IGpLogDriver::Category_Error, "Benchmark: Inflate %s failed to seek to the ends of the stream", name);
+
+		const BenchmarkClock_t::time_point seekStartTime = BenchmarkClock_t::now();
+		for (unsigned int i = 0; passed && i < kNumSeeks; i++)
+		{
+			const size_t pos = rng.Next() % size;
+			const size_t readSize = (size - pos < kReadSize) ? (size - pos) : kReadSize;
+
+			passed = stream->SeekStart(pos) && CheckInflateRead(logger, name, stream, decompressed, pos, readSize);
+		}
+		const double seekMilliseconds = ElapsedNanoseconds(seekStartTime) / 1000000.0;
+
+		stream->Close();
+
+		if (passed)
+			logger->Printf(IGpLogDriver::Category_Information, "Benchmark: Inflate %-12s %u KB, %7.3f ms per random seek, %7.1f ms to inflate all of it", name,
+				static_cast<unsigned int>(size / 1024), seekMilliseconds / kNumSeeks, fullMilliseconds);
+
+		return passed;
+	}
+
+	bool BenchmarkInflateStream(IGpLogDriver *logger)
+	{
+		BenchmarkRandom rng;
+
+		// Large enough for the stream to spread its checkpoints out instead of using the minimum spacing
+		std::vector<uint8_t> text;
+		GenerateInflateText(rng, text, 8 * 1024 * 1024);
+
+		BenchmarkWriteStream compressedText;
+		PortabilityLayer::DeflateContext *deflateContext = PortabilityLayer::DeflateContext::Create(&compressedText, 6);
+		if (!deflateContext)
+			return false;
+
+		const bool compressedOK = deflateContext->Append(&text[0], text.size()) && deflateContext->Flush();
+		deflateContext->Destroy();
+
+		if (!compressedOK)
+		{
+			logger->Printf(IGpLogDriver::Category_Error, "Benchmark: Inflate couldn't compress its test data");
+			return false;
+		}
+
+		// Stored blocks separated by runs of empty blocks, so that block boundaries land inside zlib's bit buffer
+		std::vector<uint8_t> storedData;
+		BenchmarkBitWriter storedWriter;
+		for (unsigned int block = 0; block < 8; block++)
+		{
+			for (unsigned int i = 0; i <= block % 4; i++)
+				storedWriter.PutEmptyFixedBlock();
+
+			uint8_t blockData[60000];
+			rng.Fill(blockData, sizeof(blockData));
+			storedWriter.PutStoredBlock(blockData, sizeof(blockData), block == 7);
+			storedData.insert(storedData.end(), blockData, blockData + sizeof(blockData));
+		}
+
+		bool passed = true;
+
+		if (!BenchmarkInflateSeeks(logger, rng, "text", compressedText.m_bytes, text))
+			passed = false;
+
+		if (!BenchmarkInflateSeeks(logger, rng, "flush blocks", storedWriter.m_bytes, storedData))
+			passed = false;
+
+		return passed;
+	}
+
+	// Resource types that aren't validated on load, so the contents can be noise
+	static const int32_t kArchiveResTypes[] = { 'STR#', 'DITL', 'ALRT', 'MENU' };
+
+	struct BenchmarkArchiveEntry
+	{
+		PortabilityLayer::ResTypeID m_resTypeID;
+		int16_t m_resID;
+		size_t m_contentsOffset;
+		size_t m_contentsSize;
+	};
+
+	size_t FormatArchiveResourceName(char *name, size_t nameCapacity, const PortabilityLayer::ResTypeID &resTypeID, int id)
+	{
+		int validationRule = 0;
+		const char *extension = PortabilityLayer::ResourceArchiveBase::GetFileExtensionForResType(resTypeID, validationRule);
+		const PortabilityLayer::GpArcResourceTypeTag resTag = PortabilityLayer::GpArcResourceTypeTag::Encode(resTypeID);
+
+		const int nameLength = snprintf(name, nameCapacity, "%s/%i%s", resTag.m_id, id, extension);
+		return (nameLength < 0) ? 0 : static_cast<size_t>(nameLength);
+	}
+
+	void AppendArchiveBytes(std::vector<uint8_t> &zipBytes, const void *bytes, size_t size)
+	{
+		zipBytes.insert(zipBytes.end(), static_cast<const uint8_t*>(bytes), static_cast<const uint8_t*>(bytes) + size);
+	}
+
+	// Builds an uncompressed zip in memory, with every ID a multiple of 3 apart so that the IDs in between can
+	// be looked up as missing.  The zip proxy doesn't check CRCs, so they're left at zero.
+	void GenerateArchive(BenchmarkRandom &rng, std::vector<uint8_t> &zipBytes, std::vector<BenchmarkArchiveEntry> &entries, std::vector<uint8_t> &contents, size_t numIDsPerType)
+	{
+		static const size_t kNumTypes = sizeof(kArchiveResTypes) / sizeof(kArchiveResTypes[0]);
+
+		std::vector<uint8_t> centralDir;
+
+		for (size_t typeIndex = 0; typeIndex < kNumTypes; typeIndex++)
+		{
+			for (size_t i = 0; i < numIDsPerType; i++)
+			{
+				BenchmarkArchiveEntry entry;
+				entry.m_resTypeID = PortabilityLayer::ResTypeID(kArchiveResTypes[typeIndex]);
+				entry.m_resID = static_cast<int16_t>(static_cast<int>(i * 3 + typeIndex * 7) - 1000);
+				entry.m_contentsOffset = contents.size();
+				entry.m_contentsSize = 8 + rng.Next() % 64;
+
+				contents.resize(entry.m_contentsOffset + entry.m_contentsSize);
+				rng.Fill(&contents[entry.m_contentsOffset], entry.m_contentsSize);
+
+				char name[64];
+				const size_t nameLength = FormatArchiveResourceName(name, sizeof(name), entry.m_resTypeID, entry.m_resID);
+
+				PortabilityLayer::ZipFileLocalHeader lHeader;
+				lHeader.m_signature = PortabilityLayer::ZipFileLocalHeader::kSignature;
+				lHeader.m_versionRequired = PortabilityLayer::ZipConstants::kStoredRequiredVersion;
+				lHeader.m_flags = 0;
+				lHeader.m_method = PortabilityLayer::ZipConstants::kStoredMethod;
+				lHeader.m_modificationTime = 0;
+				lHeader.m_modificationDate = 0;
+				lHeader.m_crc = 0;
+				lHeader.m_compressedSize = static_cast<uint32_t>(entry.m_contentsSize);
+				lHeader.m_uncompressedSize = static_cast<uint32_t>(entry.m_contentsSize);
+				lHeader.m_fileNameLength = static_cast<uint16_t>(nameLength);
+				lHeader.m_extraFieldLength = 0;
+
+				PortabilityLayer::ZipCentralDirectoryFileHeader cdirHeader;
+				cdirHeader.m_signature = PortabilityLayer::ZipCentralDirectoryFileHeader::kSignature;
+				cdirHeader.m_versionCreated = PortabilityLayer::ZipConstants::kStoredRequiredVersion;
+				cdirHeader.m_versionRequired = lHeader.m_versionRequired;
+				cdirHeader.m_flags = 0;
+				cdirHeader.m_method = lHeader.m_method;
+				cdirHeader.m_modificationTime = 0;
+				cdirHeader.m_modificationDate = 0;
+				cdirHeader.m_crc = 0;
+				cdirHeader.m_compressedSize = lHeader.m_compressedSize;
+				cdirHeader.m_uncompressedSize = lHeader.m_uncompressedSize;
+				cdirHeader.m_fileNameLength = lHeader.m_fileNameLength;
+				cdirHeader.m_extraFieldLength = 0;
+				cdirHeader.m_commentLength = 0;
+				cdirHeader.m_diskNumber = 0;
+				cdirHeader.m_internalAttributes = 0;
+				cdirHeader.m_externalAttributes = PortabilityLayer::ZipConstants::kArchivedAttributes;
+				cdirHeader.m_localHeaderOffset = static_cast<uint32_t>(zipBytes.size());
+
+				AppendArchiveBytes(zipBytes, &lHeader, sizeof(lHeader));
+				AppendArchiveBytes(zipBytes, name, nameLength);
+				AppendArchiveBytes(zipBytes, &contents[entry.m_contentsOffset], entry.m_contentsSize);
+
+				AppendArchiveBytes(centralDir, &cdirHeader, sizeof(cdirHeader));
+				AppendArchiveBytes(centralDir, name, nameLength);
+
+				entries.push_back(entry);
+			}
+		}
+
+		PortabilityLayer::ZipEndOfCentralDirectoryRecord eocd;
+		eocd.m_signature = PortabilityLayer::ZipEndOfCentralDirectoryRecord::kSignature;
+		eocd.m_thisDiskNumber = 0;
+		eocd.m_centralDirDisk = 0;
+		eocd.m_numCentralDirRecordsThisDisk = static_cast<uint16_t>(entries.size());
+		eocd.m_numCentralDirRecords = static_cast<uint16_t>(entries.size());
+		eocd.m_centralDirectorySizeBytes = static_cast<uint32_t>(centralDir.size());
+		eocd.m_centralDirStartOffset = static_cast<uint32_t>(zipBytes.size());
+		eocd.m_commentLength = 0;
+
+		AppendArchiveBytes(zipBytes, &centralDir[0], centralDir.size());
+		AppendArchiveBytes(zipBytes, &eocd, sizeof(eocd));
+	}
+
+	// The lookups the way the archive did them before it had an index: format the file name, then binary search
+	// the central directory for it
+	void *ScanLoadResource(PortabilityLayer::ZipFileProxy *proxy, const PortabilityLayer::ResTypeID &resTypeID, int id, size_t &outSize)
+	{
+		char name[64];
+		FormatArchiveResourceName(name, sizeof(name), resTypeID, id);
+
+		size_t index = 0;
+		if (!proxy->IndexFile(name, index))
+			return nullptr;
+
+		PortabilityLayer::MemoryManager *mm = PortabilityLayer::MemoryManager::GetInstance();
+
+		const size_t size = proxy->GetFileSize(index);
+		void *contents = mm->Alloc(size);
+		if (!contents)
+			return nullptr;
+
+		if (!proxy->LoadFile(index, contents))
+		{
+			mm->Release(contents);
+			return nullptr;
+		}
+
+		outSize = size;
+		return contents;
+	}
+
+	// Walks every file name under the type's directory, parsing each one
+	bool ScanFindFirstResourceOfType(PortabilityLayer::ZipFileProxy *proxy, const PortabilityLayer::ResTypeID &resTypeID, int16_t &outID)
+	{
+		char prefix[16];
+		const PortabilityLayer::GpArcResourceTypeTag resTag = PortabilityLayer::GpArcResourceTypeTag::Encode(resTypeID);
+		const int prefixLength = snprintf(prefix, sizeof(prefix), "%s/", resTag.m_id);
+
+		size_t firstFileIndex = 0;
+		if (prefixLength < 0 || !proxy->FindFirstWithPrefix(prefix, firstFileIndex))
+			return false;
+
+		bool haveAny = false;
+		int16_t lowestID = 0;
+
+		const size_t numFiles = proxy->NumFiles();
+		for (size_t fileIndex = firstFileIndex; fileIndex < numFiles; fileIndex++)
+		{
+			const char *name = nullptr;
+			size_t nameLength = 0;
+			proxy->GetFileName(fileIndex, name, nameLength);
+
+			if (nameLength < static_cast<size_t>(prefixLength) || memcmp(name, prefix, prefixLength) != 0)
+				break;
+
+			PortabilityLayer::ResTypeID fileResTypeID;
+			int16_t resID = 0;
+			if (!PortabilityLayer::ResourceArchiveZipFile::ParseResFromName(name, nameLength, fileResTypeID, resID))
+				continue;
+
+			if (!haveAny || resID < lowestID)
+			{
+				lowestID = resID;
+				haveAny = true;
+			}
+		}
+
+		if (haveAny)
+			outID = lowestID;
+
+		return haveAny;
+	}
+
+	uint64_t ArchiveResourceKey(const PortabilityLayer::ResTypeID &resTypeID, int16_t id)
+	{
+		return (static_cast<uint64_t>(static_cast<uint32_t>(resTypeID.ExportAsInt32())) << 16) | static_cast<uint16_t>(id);
+	}
+
+	void ScanEnumerateResources(PortabilityLayer::ZipFileProxy *proxy, std::vector<uint64_t> &outKeys)
+	{
+		const size_t numFiles = proxy->NumFiles();
+		for (size_t fileIndex = 0; fileIndex < numFiles; fileIndex++)
+		{
+			const char *name = nullptr;
+			size_t nameLength = 0;
+			proxy->GetFileName(fileIndex, name, nameLength);
+
+			PortabilityLayer::ResTypeID resTypeID;
+			int16_t resID = 0;
+			if (PortabilityLayer::ResourceArchiveZipFile::ParseResFromName(name, nameLength, resTypeID, resID))
+				outKeys.push_back(ArchiveResourceKey(resTypeID, resID));
+		}
+	}
+
+	bool IndexedEnumerateResources(PortabilityLayer::IResourceArchive *archive, std::vector<uint64_t> &outKeys)
+	{
+		PortabilityLayer::IResourceIterator *iterator = archive->EnumerateResources();
+		if (!iterator)
+			return false;
+
+		PortabilityLayer::ResTypeID resTypeID;
+		int16_t resID = 0;
+		while (iterator->GetOne(resTypeID, resID))
+			outKeys.push_back(ArchiveResourceKey(resTypeID, resID));
+
+		iterator->Destroy();
+		return true;
+	}
+
+	bool CheckArchiveLookups(IGpLogDriver *logger, PortabilityLayer::IResourceArchive *archive, PortabilityLayer::ZipFileProxy *proxy, const std::vector<BenchmarkArchiveEntry> &entries, const std::vector<uint8_t> &contents)
+	{
+		PortabilityLayer::MemoryManager *mm = PortabilityLayer::MemoryManager::GetInstance();
+
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			const BenchmarkArchiveEntry &entry = entries[i];
+			const uint8_t *expected = &contents[entry.m_contentsOffset];
+
+			size_t scanSize = 0;
+			void *scanContents = ScanLoadResource(proxy, entry.m_resTypeID, entry.m_resID, scanSize);
+			const bool scanMatches = (scanContents != nullptr && scanSize == entry.m_contentsSize && memcmp(scanContents, expected, scanSize) == 0);
+			if (scanContents)
+				mm->Release(scanContents);
+
+			THandle<void> indexedHandle = archive->LoadResource(entry.m_resTypeID, entry.m_resID);
+			const bool indexedMatches = (archive->HasResource(entry.m_resTypeID, entry.m_resID) && indexedHandle != nullptr && indexedHandle.MMBlock()->m_size == entry.m_contentsSize && memcmp(*indexedHandle, expected, entry.m_contentsSize) == 0);
+			indexedHandle.Dispose();
+
+			// The IDs in between the stored ones have to be missing both ways
+			size_t missingSize = 0;
+			void *scanMissing = ScanLoadResource(proxy, entry.m_resTypeID, entry.m_resID + 1, missingSize);
+			if (scanMissing)
+				mm->Release(scanMissing);
+
+			THandle<void> indexedMissing = archive->LoadResource(entry.m_resTypeID, entry.m_resID + 1);
+			const bool missingMatches = (scanMissing == nullptr && indexedMissing == nullptr && !archive->HasResource(entry.m_resTypeID, entry.m_resID + 1));
+			indexedMissing.Dispose();
+
+			if (!scanMatches || !indexedMatches || !missingMatches)
+			{
+				logger->Printf(IGpLogDriver::Category_Error, "Benchmark: Archive load of resource %i doesn't match between the index and the filename scan", static_cast<int>(entry.m_resID));
+				return false;
+			}
+		}
+
+		for (size_t typeIndex = 0; typeIndex <= sizeof(kArchiveResTypes) / sizeof(kArchiveResTypes[0]); typeIndex++)
+		{
+			// One past the end is a type that isn't in the archive
+			const PortabilityLayer::ResTypeID resTypeID = (typeIndex == sizeof(kArchiveResTypes) / sizeof(kArchiveResTypes[0])) ? PortabilityLayer::ResTypeID('LICS') : PortabilityLayer::ResTypeID(kArchiveResTypes[typeIndex]);
+
+			int16_t scanID = 0;
+			int16_t indexedID = 0;
+			const bool scanFound = ScanFindFirstResourceOfType(proxy, resTypeID, scanID);
+			const bool indexedFound = archive->FindFirstResourceOfType(resTypeID, indexedID);
+
+			if (scanFound != indexedFound || (scanFound && scanID != indexedID) || scanFound != archive->HasAnyResourcesOfType(resTypeID))
+			{
+				logger->Printf(IGpLogDriver::Category_Error, "Benchmark: Archive first resource of a type doesn't match between the index and the filename scan");
+				return false;
+			}
+		}
+
+		std::vector<uint64_t> scanKeys;
+		std::vector<uint64_t> indexedKeys;
+		ScanEnumerateResources(proxy, scanKeys);
+		if (!IndexedEnumerateResources(archive, indexedKeys))
+			return false;
+
+		std::sort(scanKeys.begin(), scanKeys.end());
+		std::sort(indexedKeys.begin(), indexedKeys.end());
+
+		if (scanKeys.size() != entries.size() || scanKeys != indexedKeys)
+		{
+			logger->Printf(IGpLogDriver::Category_Error, "Benchmark: Archive enumeration doesn't match between the index and the filename scan");
+			return false;
+		}
+
+		return true;
+	}
+
+	bool BenchmarkResourceArchive(IGpLogDriver *logger)
+	{
+		static const size_t kNumIDsPerType = 1280;
+		static const unsigned int kNumPasses = 4;
+		static const unsigned int kNumFindPasses = 256;
+		static const size_t kNumTypes = sizeof(kArchiveResTypes) / sizeof(kArchiveResTypes[0]);
+
+		BenchmarkRandom rng;
+
+		std::vector<uint8_t> zipBytes;
+		std::vector<BenchmarkArchiveEntry> entries;
+		std::vector<uint8_t> contents;
+		GenerateArchive(rng, zipBytes, entries, contents, kNumIDsPerType);
+
+		PortabilityLayer::MemReaderStream zipStream(&zipBytes[0], zipBytes.size());
+
+		PortabilityLayer::ZipFileProxy *proxy = PortabilityLayer::ZipFileProxy::Create(&zipStream);
+		if (!proxy)
+		{
+			logger->Printf(IGpLogDriver::Category_Error, "Benchmark: Archive couldn't open its test zip");
+			return false;
+		}
+
+		// The archive owns the proxy from here on, but the stream stays ours
+		PortabilityLayer::ResourceArchiveZipFile *archive = PortabilityLayer::ResourceArchiveZipFile::Create(proxy, false, nullptr);
+		if (!archive)
+		{
+			proxy->Destroy();
+			logger->Printf(IGpLogDriver::Category_Error, "Benchmark: Archive couldn't index its test zip");
+			return false;
+		}
+
+		if (!CheckArchiveLookups(logger, archive, proxy, entries, contents))
+		{
+			archive->Destroy();
+			return false;
+		}
+
+		PortabilityLayer::MemoryManager *mm = PortabilityLayer::MemoryManager::GetInstance();
+
+		// Handles are disposed right away so that every load reads the file again instead of reusing the cached one
+		const BenchmarkClock_t::time_point scanLoadStartTime = BenchmarkClock_t::now();
+		for (unsigned int pass = 0; pass < kNumPasses; pass++)
+		{
+			for (size_t i = 0; i < entries.size(); i++)
+			{
+				size_t size = 0;
+				void *loaded = ScanLoadResource(proxy, entries[i].m_resTypeID, entries[i].m_resID, size);
+				if (loaded)
+					mm->Release(loaded);
+			}
+		}
+		const double scanLoadNanoseconds = ElapsedNanoseconds(scanLoadStartTime) / (kNumPasses * entries.size());
+
+		const BenchmarkClock_t::time_point indexedLoadStartTime = BenchmarkClock_t::now();
+		for (unsigned int pass = 0; pass < kNumPasses; pass++)
+		{
+			for (size_t i = 0; i < entries.size(); i++)
+				archive->LoadResource(entries[i].m_resTypeID, entries[i].m_resID).Dispose();
+		}
+		const double indexedLoadNanoseconds = ElapsedNanoseconds(indexedLoadStartTime) / (kNumPasses * entries.size());
+
+		int16_t firstID = 0;
+
+		const BenchmarkClock_t::time_point scanFindStartTime = BenchmarkClock_t::now();
+		for (unsigned int pass = 0; pass < kNumFindPasses; pass++)
+		{
+			for (size_t typeIndex = 0; typeIndex < kNumTypes; typeIndex++)
+				ScanFindFirstResourceOfType(proxy, PortabilityLayer::ResTypeID(kArchiveResTypes[typeIndex]), firstID);
+		}
+		const double scanFindNanoseconds = ElapsedNanoseconds(scanFindStartTime) / (kNumFindPasses * kNumTypes);
+
+		const BenchmarkClock_t::time_point indexedFindStartTime = BenchmarkClock_t::now();
+		for (unsigned int pass = 0; pass < kNumFindPasses; pass++)
+		{
+			for (size_t typeIndex = 0; typeIndex < kNumTypes; typeIndex++)
+				archive->FindFirstResourceOfType(PortabilityLayer::ResTypeID(kArchiveResTypes[typeIndex]), firstID);
+		}
+		const double indexedFindNanoseconds = ElapsedNanoseconds(indexedFindStartTime) / (kNumFindPasses * kNumTypes);
+
+		std::vector<uint64_t> keys;
+		keys.reserve(entries.size());
+
+		const BenchmarkClock_t::time_point scanEnumerateStartTime = BenchmarkClock_t::now();
+		for (unsigned int pass = 0; pass < kNumPasses; pass++)
+		{
+			keys.clear();
+			ScanEnumerateResources(proxy, keys);
+		}
+		const double scanEnumerateNanoseconds = ElapsedNanoseconds(scanEnumerateStartTime) / kNumPasses;
+
+		const BenchmarkClock_t::time_point indexedEnumerateStartTime = BenchmarkClock_t::now();
+		for (unsigned int pass = 0; pass < kNumPasses; pass++)
+		{
+			keys.clear();
+			IndexedEnumerateResources(archive, keys);
+		}
+		const double indexedEnumerateNanoseconds = ElapsedNanoseconds(indexedEnumerateStartTime) / kNumPasses;
+
+		archive->Destroy();
+
+		const unsigned int numEntries = static_cast<unsigned int>(entries.size());
+		logger->Printf(IGpLogDriver::Category_Information, "Benchmark: Archive %u entries LoadResource %8.1f ns indexed, %8.1f ns scan, %5.2fx", numEntries,
+			indexedLoadNanoseconds, scanLoadNanoseconds, scanLoadNanoseconds / indexedLoadNanoseconds);
+		logger->Printf(IGpLogDriver::Category_Information, "Benchmark: Archive %u entries FindFirstResourceOfType %8.1f ns indexed, %8.1f ns scan, %5.2fx", numEntries,
+			indexedFindNanoseconds, scanFindNanoseconds, scanFindNanoseconds / indexedFindNanoseconds);
+		logger->Printf(IGpLogDriver::Category_Information, "Benchmark: Archive %u entries EnumerateResources %8.1f us indexed, %8.1f us scan, %5.2fx", numEntries,
+			indexedEnumerateNanoseconds / 1000.0, scanEnumerateNanoseconds / 1000.0, scanEnumerateNanoseconds / indexedEnumerateNanoseconds);
+
+		return true;
+	}
+
+	// Fills every room with noise, then puts the suite, floor and object types into range so that most of
+	// the rooms and objects reach the per-type checks instead of being emptied straight away
+	void GenerateLegalizeHouse(BenchmarkRandom &rng, houseType *house, size_t numRooms)
+	{
+		memset(house, 0, sizeof(houseType) - sizeof(roomType));
+		house->version = kHouseVersion;
+		house->nRooms = static_cast<int16_t>(numRooms);
+
+		for (size_t i = 0; i < numRooms; i++)
+		{
+			roomType *room = house->rooms + i;
+			rng.Fill(reinterpret_cast<uint8_t*>(room), sizeof(roomType));
+
+			if (rng.Next() % 8 == 0)
+				room->suite = kRoomIsEmpty;
+			else
+			{
+				room->suite = static_cast<int16_t>(i % kMaxNumRoomsH);
+				room->floor = static_cast<int16_t>(i / kMaxNumRoomsH) - kNumUndergroundFloors + 1;
+			}
+
+			for (size_t j = 0; j < kMaxRoomObs; j++)
+				room->objects[j].what = static_cast<int16_t>(rng.Next() % (kNumSrcRects + 1)) - 1;
+		}
+	}
+
+	// Legalizes copies of sourceHouse serially and on numThreads threads, and checks that both passes make the
+	// same repairs
+	bool CheckLegalizeHouse(IGpLogDriver *logger, const char *houseName, const houseType *sourceHouse, size_t houseSize, unsigned int numThreads, unsigned int numPasses)
+	{
+		houseType *serialHouse = static_cast<houseType*>(NewPtr(houseSize));
+		houseType *threadedHouse = static_cast<houseType*>(NewPtr(houseSize));
+
+		bool passed = (serialHouse && threadedHouse);
+		double serialNanoseconds = 0.0;
+		double threadedNanoseconds = 0.0;
+
+		if (!passed)
+			logger->Printf(IGpLogDriver::Category_Error, "Benchmark: Legalize couldn't allocate copies of %s", houseName);
+
+		for (unsigned int pass = 0; passed && pass < numPasses; pass++)
+		{
+			bool serialRepairs = false;
+			bool threadedRepairs = false;
+
+			memcpy(serialHouse, sourceHouse, houseSize);
+			memcpy(threadedHouse, sourceHouse, houseSize);
+
+			const BenchmarkClock_t::time_point serialStartTime = BenchmarkClock_t::now();
+			const bool serialOK = LegalizeRooms(serialHouse, 1, serialRepairs);
+			serialNanoseconds += ElapsedNanoseconds(serialStartTime);
+
+			const BenchmarkClock_t::time_point threadedStartTime = BenchmarkClock_t::now();
+			const bool threadedOK = LegalizeRooms(threadedHouse, numThreads, threadedRepairs);
+			threadedNanoseconds += ElapsedNanoseconds(threadedStartTime);
+
+			if (serialOK != threadedOK || serialRepairs != threadedRepairs || memcmp(serialHouse, threadedHouse, houseSize) != 0)
+			{
+				logger->Printf(IGpLogDriver::Category_Error, "Benchmark: Legalize %s on %u threads doesn't match the serial pass", houseName, numThreads);
+				passed = false;
+			}
+		}
+
+		if (serialHouse)
+			DisposePtr(serialHouse);
+		if (threadedHouse)
+			DisposePtr(threadedHouse);
+
+		if (passed)
+			logger->Printf(IGpLogDriver::Category_Information, "Benchmark: Legalize %s, %u rooms %8.1f us serial, %8.1f us on %u threads, %5.2fx serial", houseName, static_cast<unsigned int>(sourceHouse->nRooms),
+				serialNanoseconds / numPasses / 1000.0, threadedNanoseconds / numPasses / 1000.0, numThreads, serialNanoseconds / threadedNanoseconds);
+
+		return passed;
+	}
+
+	bool CheckSyntheticLegalizeHouse(IGpLogDriver *logger, const char *houseName, size_t numRooms, unsigned int numThreads, unsigned int numPasses)
+	{
+		const size_t houseSize = sizeof(houseType) + (numRooms - 1) * sizeof(roomType);
+		houseType *sourceHouse = static_cast<houseType*>(NewPtr(houseSize));
+		if (!sourceHouse)
+		{
+			logger->Printf(IGpLogDriver::Category_Error, "Benchmark: Legalize couldn't allocate %s", houseName);
+			return false;
+		}
+
+		BenchmarkRandom rng;
+		GenerateLegalizeHouse(rng, sourceHouse, numRooms);
+
+		const bool passed = CheckLegalizeHouse(logger, houseName, sourceHouse, houseSize, numThreads, numPasses);
+
+		DisposePtr(sourceHouse);
+
+		return passed;
+	}
+
+	// Same houses that the house list picks up from the game data directory
+	bool CheckShippedLegalizeHouses(IGpLogDriver *logger, unsigned int numThreads, unsigned int numPasses)
+	{
+		const PortabilityLayer::VirtualDirectory_t houseDir = PortabilityLayer::VirtualDirectories::kGameData;
+
+		PortabilityLayer::FileManager *fm = PortabilityLayer::FileManager::GetInstance();
+		DirectoryFileListEntry *firstFile = GetDirectoryFiles(houseDir);
+
+		bool passed = true;
+		unsigned int numHouses = 0;
+
+		for (DirectoryFileListEntry *f = firstFile; f; f = f->nextEntry)
+		{
+			if (f->finderInfo.fdType != 'gliH' || f->finderInfo.fdCreator != 'ozm5' || !fm->CompositeFileExists(houseDir, f->name))
+				continue;
+
+			const PLPasStr fileName(f->name);
+			char houseName[256];
+			memcpy(houseName, fileName.Chars(), fileName.Length());
+			houseName[fileName.Length()] = '\0';
+
+			houseType *house = nullptr;
+			size_t houseSize = 0;
+
+			PortabilityLayer::CompositeFile *cfile = fm->OpenCompositeFile(houseDir, f->name);
+			if (cfile)
+			{
+				GpIOStream *houseStream = nullptr;
+				if (cfile->OpenData(PortabilityLayer::EFilePermission_Read, GpFileCreationDispositions::kOpenExisting, houseStream) == PLErrors::kNone)
+				{
+					house = ReadHouseForLegalize(houseStream, houseSize);
+					houseStream->Close();
+				}
+
+				cfile->Close();
+			}
+
+			if (!house)
+			{
+				logger->Printf(IGpLogDriver::Category_Error, "Benchmark: Legalize couldn't read %s", houseName);
+				passed = false;
+				continue;
+			}
+
+			if (!CheckLegalizeHouse(logger, houseName, house, houseSize, numThreads, numPasses))
+				passed = false;
+
+			DisposePtr(house);
+			numHouses++;
+		}
+
+		DisposeDirectoryFiles(firstFile);
+
+		if (numHouses == 0)
+			logger->Printf(IGpLogDriver::Category_Information, "Benchmark: Legalize found no houses in the game data");
+
+		return passed;
+	}
+
+	bool BenchmarkLegalizeRooms(IGpLogDriver *logger)
+	{
+		static const size_t kNumRooms = 1024;
+		static const size_t kNumLargeHouseRooms = kMaxNumRoomsH * kMaxNumRoomsV;	// Every floor and suite taken
+		static const unsigned int kNumPasses = 4;
+		static const unsigned int kMaxThreads = 8;
+
+		// Force the pool on single-core machines too, so that the threaded path still gets checked
+		unsigned int numThreads = PLDrivers::GetSystemServices()->GetCPUCount();
+		if (numThreads < 2)
+			numThreads = 2;
+		if (numThreads > kMaxThreads)
+			numThreads = kMaxThreads;
+
+		bool passed = true;
+
+		if (!CheckSyntheticLegalizeHouse(logger, "synthetic house", kNumRooms, numThreads, kNumPasses))
+			passed = false;
+
+		if (!CheckSyntheticLegalizeHouse(logger, "large synthetic house", kNumLargeHouseRooms, numThreads, kNumPasses))
+			passed = false;
+
+		if (!CheckShippedLegalizeHouses(logger, numThreads, kNumPasses))
+			passed = false;
+
+		return passed;
+	}
+
+	// Places most rooms on their own floor and suite, in a random order, then stacks some on top of rooms that
+	// are already placed, pushes some outside the range the room index covers, and empties some.  Those are the
+	// cases that the index has to resolve the same way as the scan.
+	void GenerateRoomIndexHouse(BenchmarkRandom &rng, houseType *house, size_t numRooms)
+	{
+		static const size_t kNumFloors = kMaxNumRoomsV;
+		static const size_t kNumCells = kNumFloors * kMaxNumRoomsH;
+
+		memset(house, 0, sizeof(houseType) + (numRooms - 1) * sizeof(roomType));
+		house->version = kHouseVersion;
+		house->nRooms = static_cast<int16_t>(numRooms);
+
+		std::vector<uint16_t> cells;
+		cells.resize(kNumCells);
+		for (size_t i = 0; i < kNumCells; i++)
+			cells[i] = static_cast<uint16_t>(i);
+
+		for (size_t i = kNumCells - 1; i > 0; i--)
+			std::swap(cells[i], cells[rng.Next() % (i + 1)]);
+
+		for (size_t i = 0; i < numRooms; i++)
+		{
+			roomType *room = house->rooms + i;
+			const uint32_t roll = rng.Next() % 64;
+
+			if (roll == 0)
+			{
+				room->suite = kRoomIsEmpty;
+				room->floor = static_cast<int16_t>(rng.Next() % kNumFloors) - kNumUndergroundFloors + 1;
+			}
+			else if (roll == 1 && i > 0)
+				*room = house->rooms[rng.Next() % i];
+			else if (roll == 2)
+			{
+				room->suite = static_cast<int16_t>(kMaxNumRoomsH + rng.Next() % 4);
+				room->floor = static_cast<int16_t>(kMaxNumRoomsV - kNumUndergroundFloors + 1 + rng.Next() % 4);
+			}
+			else
+			{
+				const uint16_t cell = cells[i % kNumCells];
+				room->suite = static_cast<int16_t>(cell % kMaxNumRoomsH);
+				room->floor = static_cast<int16_t>(cell / kMaxNumRoomsH) - kNumUndergroundFloors + 1;
+			}
+		}
+	}
+
+	// The lookups the way Room.cpp did them before it had an index: a scan of every room in the house.  Empty
+	// rooms are skipped, since the scan could match one for a neighbor past the left edge of the house.
+	short ScanRoomNumber(const houseType *house, short numRooms, short floor, short suite)
+	{
+		if (suite == kRoomIsEmpty)
+			return kRoomIsEmpty;
+
+		for (short i = 0; i < numRooms; i++)
+		{
+			if (house->rooms[i].suite == suite && house->rooms[i].floor == floor)
+				return i;
+		}
+
+		return kRoomIsEmpty;
+	}
+
+	short ScanDoesNeighborRoomExist(const houseType *house, short numRooms, const roomType *room, short whichNeighbor)
+	{
+		static const short kNeighborDeltaH[] = { 0, 0, 0, 1, -1 };
+		static const short kNeighborDeltaV[] = { 0, 1, -1, 0, 0 };
+
+		const short suite = room->suite + kNeighborDeltaH[whichNeighbor];
+		const short floor = room->floor + kNeighborDeltaV[whichNeighbor];
+
+		if (suite < 0)
+			return -1;
+
+		return ScanRoomNumber(house, numRooms, floor, suite);
+	}
+
+	short ScanGetNeighborRoomNumber(const houseType *house, short numRooms, short roomNum, short which)
+	{
+		static const short kNeighborDeltaH[] = { 0, 0, 1, 1, 1, 0, -1, -1, -1 };
+		static const short kNeighborDeltaV[] = { 0, 1, 1, 0, -1, -1, -1, 0, 1 };
+
+		const roomType *room = house->rooms + roomNum;
+		return ScanRoomNumber(house, numRooms, room->floor + kNeighborDeltaV[which], room->suite + kNeighborDeltaH[which]);
+	}
+
+	void LogRoomIndexTiming(IGpLogDriver *logger, const char *name, size_t numRooms, size_t numLookups, double indexedNanoseconds, double scanNanoseconds)
+	{
+		logger->Printf(IGpLogDriver::Category_Information, "Benchmark: Room index %u rooms %-21s %7.1f ns indexed, %9.1f ns scan, %7.1fx", static_cast<unsigned int>(numRooms), name,
+			indexedNanoseconds / numLookups, scanNanoseconds / numLookups, scanNanoseconds / indexedNanoseconds);
+	}
+
+	// Room.cpp's lookups work on the current house, so the synthetic house is swapped in for the duration
+	bool BenchmarkRoomIndex(IGpLogDriver *logger)
+	{
+		static const short kNumRooms = 5000;
+
+		const size_t houseSize = sizeof(houseType) + (kNumRooms - 1) * sizeof(roomType);
+		houseHand benchmarkHouse = NewHandle(houseSize).StaticCast<houseType>();
+		if (!benchmarkHouse)
+		{
+			logger->Printf(IGpLogDriver::Category_Error, "Benchmark: Room index couldn't allocate its house");
+			return false;
+		}
+
+		BenchmarkRandom rng;
+		GenerateRoomIndexHouse(rng, *benchmarkHouse, kNumRooms);
+
+		const houseHand savedHouse = thisHouse;
+		const roomPtr savedRoom = thisRoom;
+		const short savedNumberRooms = numberRooms;
+		const short savedRoomNumber = thisRoomNumber;
+		const short savedMode = theMode;
+
+		roomType benchmarkRoom;
+		memset(&benchmarkRoom, 0, sizeof(benchmarkRoom));
+
+		thisHouse = benchmarkHouse;
+		thisRoom = &benchmarkRoom;
+		numberRooms = kNumRooms;
+		theMode = kEditMode;	// DoesNeighborRoomExist only answers in edit mode
+		RebuildRoomIndex();
+
+		const houseType *house = *benchmarkHouse;
+
+		std::vector<short> indexedResults;
+		std::vector<short> scanResults;
+
+		// Every floor and suite that the index covers, and a border around it that falls back to the scan
+		const BenchmarkClock_t::time_point indexedRoomStartTime = BenchmarkClock_t::now();
+		for (short floor = -kNumUndergroundFloors - 1; floor <= kMaxNumRoomsV - kNumUndergroundFloors + 2; floor++)
+		{
+			for (short suite = 0; suite <= kMaxNumRoomsH + 2; suite++)
+				indexedResults.push_back(GetRoomNumber(floor, suite));
+		}
+		const double indexedRoomNanoseconds = ElapsedNanoseconds(indexedRoomStartTime);
+
+		const BenchmarkClock_t::time_point scanRoomStartTime = BenchmarkClock_t::now();
+		for (short floor = -kNumUndergroundFloors - 1; floor <= kMaxNumRoomsV - kNumUndergroundFloors + 2; floor++)
+		{
+			for (short suite = 0; suite <= kMaxNumRoomsH + 2; suite++)
+				scanResults.push_back(ScanRoomNumber(house, kNumRooms, floor, suite));
+		}
+		const double scanRoomNanoseconds = ElapsedNanoseconds(scanRoomStartTime);
+
+		const size_t numRoomLookups = indexedResults.size();
+		bool passed = (indexedResults == scanResults);
+
+		if (!passed)
+			logger->Printf(IGpLogDriver::Category_Error, "Benchmark: Room index GetRoomNumber doesn't match the scan");
+
+		indexedResults.clear();
+		scanResults.clear();
+
+		const BenchmarkClock_t::time_point indexedExistsStartTime = BenchmarkClock_t::now();
+		for (short i = 0; i < kNumRooms; i++)
+		{
+			benchmarkRoom.floor = house->rooms[i].floor;
+			benchmarkRoom.suite = house->rooms[i].suite;
+
+			for (short which = kRoomAbove; which <= kRoomToLeft; which++)
+				indexedResults.push_back(DoesNeighborRoomExist(which));
+		}
+		const double indexedExistsNanoseconds = ElapsedNanoseconds(indexedExistsStartTime);
+
+		const BenchmarkClock_t::time_point scanExistsStartTime = BenchmarkClock_t::now();
+		for (short i = 0; i < kNumRooms; i++)
+		{
+			benchmarkRoom.floor = house->rooms[i].floor;
+			benchmarkRoom.suite = house->rooms[i].suite;
+
+			for (short which = kRoomAbove; which <= kRoomToLeft; which++)
+				scanResults.push_back(ScanDoesNeighborRoomExist(house, kNumRooms, &benchmarkRoom, which));
+		}
+		const double scanExistsNanoseconds = ElapsedNanoseconds(scanExistsStartTime);
+
+		const size_t numExistsLookups = indexedResults.size();
+		if (indexedResults != scanResults)
+		{
+			logger->Printf(IGpLogDriver::Category_Error, "Benchmark: Room index DoesNeighborRoomExist doesn't match the scan");
+			passed = false;
+		}
+
+		indexedResults.clear();
+		scanResults.clear();
+
+		const BenchmarkClock_t::time_point indexedNeighborStartTime = BenchmarkClock_t::now();
+		for (short i = 0; i < kNumRooms; i++)
+		{
+			thisRoomNumber = i;
+
+			for (short which = kCentralRoom; which <= kNorthWestRoom; which++)
+				indexedResults.push_back(GetNeighborRoomNumber(which));
+		}
+		const double indexedNeighborNanoseconds = ElapsedNanoseconds(indexedNeighborStartTime);
+
+		const BenchmarkClock_t::time_point scanNeighborStartTime = BenchmarkClock_t::now();
+		for (short i = 0; i < kNumRooms; i++)
+		{
+			for (short which = kCentralRoom; which <= kNorthWestRoom; which++)
+				scanResults.push_back(ScanGetNeighborRoomNumber(house, kNumRooms, i, which));
+		}
+		const double scanNeighborNanoseconds = ElapsedNanoseconds(scanNeighborStartTime);
+
+		const size_t numNeighborLookups = indexedResults.size();
+		if (indexedResults != scanResults)
+		{
+			logger->Printf(IGpLogDriver::Category_Error, "Benchmark: Room index GetNeighborRoomNumber doesn't match the scan");
+			passed = false;
+		}
+
+		thisHouse = savedHouse;
+		thisRoom = savedRoom;
+		numberRooms = savedNumberRooms;
+		thisRoomNumber = savedRoomNumber;
+		theMode = savedMode;
+		RebuildRoomIndex();
+
+		benchmarkHouse.Dispose();
+
+		if (passed)
+		{
+			LogRoomIndexTiming(logger, "GetRoomNumber", kNumRooms, numRoomLookups, indexedRoomNanoseconds, scanRoomNanoseconds);
+			LogRoomIndexTiming(logger, "DoesNeighborRoomExist", kNumRooms, numExistsLookups, indexedExistsNanoseconds, scanExistsNanoseconds);
+			LogRoomIndexTiming(logger, "GetNeighborRoomNumber", kNumRooms, numNeighborLookups, indexedNeighborNanoseconds, scanNeighborNanoseconds);
+		}
+
+		return passed;
+	}
+
+	// Mixes the channels the way the audio drivers do: the first channel is scaled into the mix, the rest are
+	// scaled and added with saturation
+	void MixAudioChannels(int16_t *mix, const std::vector<int16_t> &channelSamples, size_t numChannels, size_t numSamples, int16_t volumeScale, bool useReference)
+	{
+		for (size_t chunkStart = 0; chunkStart < numSamples; chunkStart += kAudioMixChunkSamples)
+		{
+			size_t chunkSize = numSamples - chunkStart;
+			if (chunkSize > kAudioMixChunkSamples)
+				chunkSize = kAudioMixChunkSamples;
+
+			for (size_t ch = 0; ch < numChannels; ch++)
+			{
+				const int16_t *src = &channelSamples[ch * numSamples + chunkStart];
+
+				if (useReference)
+				{
+					if (ch == 0)
+						GpAudioMixKernels::ScaleSamplesScalar(mix + chunkStart, src, chunkSize, volumeScale);
+					else
+						GpAudioMixKernels::MixScaledSamplesScalar(mix + chunkStart, src, chunkSize, volumeScale);
+				}
+				else
+				{
+					if (ch == 0)
+						GpAudioMixKernels::ScaleSamples(mix + chunkStart, src, chunkSize, volumeScale);
+					else
+						GpAudioMixKernels::MixScaledSamples(mix + chunkStart, src, chunkSize, volumeScale);
+				}
+			}
+		}
+	}
+
+	bool BenchmarkAudioMix(IGpLogDriver *logger)
+	{
+		static const size_t kMaxChannels = 16;
+		static const size_t kNumSamples = 22050 * 4;	// 4 seconds
+		static const unsigned int kNumPasses = 8;
+		static const size_t kChannelCounts[] = { 1, 4, 16 };
+		static const int16_t kVolumeScales[] = { 64, 37, 0 };
+
+		// Channels alternate between converted 8-bit sounds, which is what the game plays, and full-range noise,
+		// which saturates at any volume above 1
+		std::vector<int16_t> channelSamples;
+		channelSamples.resize(kMaxChannels * kNumSamples);
+
+		BenchmarkRandom rng;
+		for (size_t ch = 0; ch < kMaxChannels; ch++)
+		{
+			int16_t *samples = &channelSamples[ch * kNumSamples];
+			for (size_t i = 0; i < kNumSamples; i++)
+			{
+				if (ch % 2 == 0)
+					samples[i] = static_cast<int16_t>(static_cast<int32_t>(rng.Next() >> 24) - 0x80);
+				else
+					samples[i] = static_cast<int16_t>(rng.Next() >> 16);
+			}
+		}
+
+		// An odd length so that the scalar tail runs too
+		const size_t numSamplesChecked = kNumSamples - 3;
+
+		std::vector<int16_t> referenceMix;
+		std::vector<int16_t> fastMix;
+		referenceMix.resize(kNumSamples);
+		fastMix.resize(kNumSamples);
+
+		bool passed = true;
+
+		for (size_t countIndex = 0; countIndex < sizeof(kChannelCounts) / sizeof(kChannelCounts[0]); countIndex++)
+		{
+			const size_t numChannels = kChannelCounts[countIndex];
+
+			for (size_t volumeIndex = 0; volumeIndex < sizeof(kVolumeScales) / sizeof(kVolumeScales[0]); volumeIndex++)
+			{
+				const int16_t volumeScale = kVolumeScales[volumeIndex];
+
+				MixAudioChannels(&referenceMix[0], channelSamples, numChannels, numSamplesChecked, volumeScale, true);
+				MixAudioChannels(&fastMix[0], channelSamples, numChannels, numSamplesChecked, volumeScale, false);
+
+				if (memcmp(&referenceMix[0], &fastMix[0], numSamplesChecked * sizeof(int16_t)) != 0)
+				{
+					logger->Printf(IGpLogDriver::Category_Error, "Benchmark: Audio mix of %u channels at volume %i doesn't match the scalar mix", static_cast<unsigned int>(numChannels), static_cast<int>(volumeScale));
+					passed = false;
+				}
+			}
+
+			if (!passed)
+				continue;
+
+			const int16_t volumeScale = kVolumeScales[1];
+
+			const BenchmarkClock_t::time_point referenceStartTime = BenchmarkClock_t::now();
+			for (unsigned int pass = 0; pass < kNumPasses; pass++)
+				MixAudioChannels(&referenceMix[0], channelSamples, numChannels, kNumSamples, volumeScale, true);
+			const double referenceNanoseconds = ElapsedNanoseconds(referenceStartTime);
+
+			const BenchmarkClock_t::time_point fastStartTime = BenchmarkClock_t::now();
+			for (unsigned int pass = 0; pass < kNumPasses; pass++)
+				MixAudioChannels(&fastMix[0], channelSamples, numChannels, kNumSamples, volumeScale, false);
+			const double fastNanoseconds = ElapsedNanoseconds(fastStartTime);
+
+			const double numMixedSamples = static_cast<double>(kNumPasses) * kNumSamples;
+			logger->Printf(IGpLogDriver::Category_Information, "Benchmark: Audio mix %2u channels %7.3f ns/sample scalar, %7.3f ns/sample %s, %5.2fx", static_cast<unsigned int>(numChannels),
+				referenceNanoseconds / numMixedSamples, fastNanoseconds / numMixedSamples, (GP_AUDIO_MIX_SSE2 ? "SSE2" : (GP_AUDIO_MIX_NEON ? "NEON" : "scalar")), referenceNanoseconds / fastNanoseconds);
+		}
+
+		return passed;
+	}
+
+	struct AudioChurnChannel
+	{
+		PortabilityLayer::AudioChannel *m_channel;
+		uint32_t m_numCallbacksQueued;
+		uint32_t m_numCallbacksRun;
+		bool m_ranExtraCallback;
+	};
+
+	void AudioChurnCallback(PortabilityLayer::AudioChannel *channel)
+	{
+		AudioChurnChannel *state = static_cast<AudioChurnChannel*>(channel->GetCallbackContext());
+
+		if (state->m_numCallbacksRun == state->m_numCallbacksQueued)
+			state->m_ranExtraCallback = true;
+		else
+			state->m_numCallbacksRun++;
+	}
+
+	bool OpenAudioChurnChannel(AudioChurnChannel &state)
+	{
+		state.m_channel = PortabilityLayer::SoundSystem::GetInstance()->CreateChannel();
+		state.m_numCallbacksQueued = 0;
+		state.m_numCallbacksRun = 0;
+
+		if (!state.m_channel)
+			return false;
+
+		state.m_channel->SetCallbackContext(&state);
+		return true;
+	}
+
+	bool BenchmarkAudioChurn(IGpLogDriver *logger)
+	{
+		static const size_t kNumChannels = 4;
+		static const size_t kNumBuffers = 4;
+		static const unsigned int kNumOps = 2000;
+		static const unsigned int kDrainTimeoutMSec = 5000;
+
+		IGpAudioDriver *audioDriver = PLDrivers::GetAudioDriver();
+		if (!audioDriver)
+		{
+			logger->Printf(IGpLogDriver::Category_Information, "Benchmark: Audio churn skipped, no audio driver");
+			return true;
+		}
+
+		// Silent 8-bit buffers, from a single sample up to a couple of mixer chunks
+		static const size_t kBufferSizes[kNumBuffers] = { 1, 37, 256, 1024 };
+		uint8_t silence[1024];
+		memset(silence, 0x80, sizeof(silence));
+
+		IGpAudioBuffer *buffers[kNumBuffers];
+		for (size_t i = 0; i < kNumBuffers; i++)
+			buffers[i] = audioDriver->CreateBuffer(silence, kBufferSizes[i]);
+
+		AudioChurnChannel channels[kNumChannels];
+		memset(channels, 0, sizeof(channels));
+
+		PortabilityLayer::SoundSystem *soundSystem = PortabilityLayer::SoundSystem::GetInstance();
+		BenchmarkRandom rng;
+		bool passed = true;
+		uint32_t numCallbacksRun = 0;
+
+		for (size_t i = 0; i < kNumBuffers; i++)
+		{
+			if (!buffers[i])
+				passed = false;
+		}
+
+		for (size_t i = 0; i < kNumChannels; i++)
+		{
+			if (!OpenAudioChurnChannel(channels[i]))
+				passed = false;
+		}
+
+		if (!passed)
+			logger->Printf(IGpLogDriver::Category_Error, "Benchmark: Audio churn couldn't create its channels and buffers");
+
+		const BenchmarkClock_t::time_point startTime = BenchmarkClock_t::now();
+
+		for (unsigned int op = 0; passed && op < kNumOps; op++)
+		{
+			AudioChurnChannel &state = channels[rng.Next() % kNumChannels];
+			const uint32_t action = rng.Next() % 64;
+
+			if (action < 2)
+			{
+				numCallbacksRun += state.m_numCallbacksRun;
+				state.m_channel->Destroy(action == 1);
+				passed = OpenAudioChurnChannel(state);
+			}
+			else if (action < 3)
+			{
+				state.m_channel->ClearAllCommands();
+				state.m_channel->Stop();
+
+				// Callbacks for the buffers that were cut off are dropped
+				state.m_numCallbacksQueued = state.m_numCallbacksRun;
+			}
+			else
+			{
+				if (state.m_channel->AddBuffer(buffers[rng.Next() % kNumBuffers], false) && state.m_channel->AddCallback(AudioChurnCallback, false))
+					state.m_numCallbacksQueued++;
+			}
+
+			// Stands in for the once-per-frame dispatch, but much more often
+			if (op % 8 == 0)
+				soundSystem->DispatchCallbacks();
+		}
+
+		// Everything still queued has to play out and call back exactly once
+		const BenchmarkClock_t::time_point drainStartTime = BenchmarkClock_t::now();
+		for (;;)
+		{
+			soundSystem->DispatchCallbacks();
+
+			bool drained = true;
+			for (size_t i = 0; i < kNumChannels; i++)
+			{
+				if (channels[i].m_channel && channels[i].m_numCallbacksRun != channels[i].m_numCallbacksQueued)
+					drained = false;
+			}
+
+			if (drained || !passed)
+				break;
+
+			if (ElapsedNanoseconds(drainStartTime) > kDrainTimeoutMSec * 1000000.0)
+			{
+				logger->Printf(IGpLogDriver::Category_Error, "Benchmark: Audio churn timed out waiting for queued callbacks");
+				passed = false;
+				break;
+			}
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+			// Stands in for the host loop, which is what plays the queue out on a driver on the tick clock
+			audioDriver->ServeTicks(1);
+		}
+
+		const double elapsedMilliseconds = ElapsedNanoseconds(startTime) / 1000000.0;
+
+		for (size_t i = 0; i < kNumChannels; i++)
+		{
+			if (channels[i].m_ranExtraCallback)
+			{
+				logger->Printf(IGpLogDriver::Category_Error, "Benchmark: Audio churn channel %u ran a callback more than once", static_cast<unsigned int>(i));
+				passed = false;
+			}
+
+			if (channels[i].m_channel)
+			{
+				numCallbacksRun += channels[i].m_numCallbacksRun;
+				channels[i].m_channel->Destroy(false);
+			}
+		}
+
+		for (size_t i = 0; i < kNumBuffers; i++)
+		{
+			if (buffers[i])
+				buffers[i]->Release();
+		}
+
+		if (passed)
+			logger->Printf(IGpLogDriver::Category_Information, "Benchmark: Audio churn %u ops on %u channels ran %u callbacks in %.1f ms", kNumOps, static_cast<unsigned int>(kNumChannels), numCallbacksRun, elapsedMilliseconds);
+
+		return passed;
+	}
+
+	struct MoviePassResult
+	{
+		double m_firstFrameMilliseconds;
+		double m_playMilliseconds;
+		size_t m_numFrames;
+		size_t m_residentBytes;	// Live after loading, which is what the movie holds while it isn't playing
+		size_t m_peakBytes;		// Highest live while loading and playing every frame
+		uint32_t m_frameHash;
+	};
+
+	// FNV-1a
+	uint32_t HashMovieFrame(uint32_t hash, const void *data, size_t size)
+	{
+		const uint8_t *bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; i++)
+			hash = (hash ^ bytes[i]) * 16777619u;
+
+		return hash;
+	}
+
+	// Sizes are from the memory manager's live bytes, so they count everything the movie allocates, not just
+	// the frames
+	bool RunMoviePass(const PLPasStr &name, bool streamFrames, MoviePassResult &result)
+	{
+		PortabilityLayer::MemoryManager *mm = PortabilityLayer::MemoryManager::GetInstance();
+
+		PortabilityLayer::MemoryManagerStats baseStats;
+		mm->ResetPeak();
+		mm->GetStats(baseStats);
+
+		AnimationPackage *anim = AnimationPackage::Create();
+		if (!anim)
+			return false;
+
+		// Load has the first frame ready by the time it returns
+		const BenchmarkClock_t::time_point loadStartTime = BenchmarkClock_t::now();
+		if (anim->Load(PortabilityLayer::VirtualDirectories::kGameData, name, streamFrames) != PLErrors::kNone)
+		{
+			anim->Destroy();
+			return false;
+		}
+		result.m_firstFrameMilliseconds = ElapsedNanoseconds(loadStartTime) / 1000000.0;
+
+		PortabilityLayer::MemoryManagerStats stats;
+		mm->GetStats(stats);
+		result.m_residentBytes = (stats.m_liveBytes > baseStats.m_liveBytes) ? stats.m_liveBytes - baseStats.m_liveBytes : 0;
+
+		bool passed = true;
+
+		result.m_numFrames = anim->NumFrames();
+		result.m_frameHash = 2166136261u;
+
+		const BenchmarkClock_t::time_point playStartTime = BenchmarkClock_t::now();
+		for (size_t i = 0; i < result.m_numFrames && passed; i++)
+		{
+			THandle<BitmapImage> frame = anim->GetFrame(i);
+			if (!frame)
+				passed = false;
+			else
+				result.m_frameHash = HashMovieFrame(result.m_frameHash, frame.MMBlock()->m_contents, frame.MMBlock()->m_size);
+		}
+		result.m_playMilliseconds = ElapsedNanoseconds(playStartTime) / 1000000.0;
+
+		mm->GetStats(stats);
+		result.m_peakBytes = (stats.m_peakBytes > baseStats.m_liveBytes) ? stats.m_peakBytes - baseStats.m_liveBytes : 0;
+
+		anim->Destroy();
+
+		return passed;
+	}
+
+	// Same movies that OpenHouseMovie streams from the game data directory
+	bool BenchmarkMovieLoading(IGpLogDriver *logger)
+	{
+		const PortabilityLayer::VirtualDirectory_t movieDir = PortabilityLayer::VirtualDirectories::kGameData;
+
+		PortabilityLayer::FileManager *fm = PortabilityLayer::FileManager::GetInstance();
+		DirectoryFileListEntry *firstFile = GetDirectoryFiles(movieDir);
+
+		bool passed = true;
+		unsigned int numMovies = 0;
+
+		char longestMovieName[256];
+		MoviePassResult longestStreamed;
+		MoviePassResult longestLoaded;
+		longestStreamed.m_numFrames = 0;
+
+		for (DirectoryFileListEntry *f = firstFile; f; f = f->nextEntry)
+		{
+			if (f->finderInfo.fdType != 'MooV' || f->finderInfo.fdCreator != 'ozm5' || !fm->CompositeFileExists(movieDir, f->name))
+				continue;
+
+			const PLPasStr fileName(f->name);
+			char movieName[256];
+			memcpy(movieName, fileName.Chars(), fileName.Length());
+			movieName[fileName.Length()] = '\0';
+
+			MoviePassResult streamed;
+			MoviePassResult loaded;
+
+			if (!RunMoviePass(fileName, true, streamed) || !RunMoviePass(fileName, false, loaded))
+			{
+				logger->Printf(IGpLogDriver::Category_Error, "Benchmark: Movie %s couldn't be played through", movieName);
+				passed = false;
+				continue;
+			}
+
+			numMovies++;
+
+			if (streamed.m_numFrames != loaded.m_numFrames || streamed.m_frameHash != loaded.m_frameHash)
+			{
+				logger->Printf(IGpLogDriver::Category_Error, "Benchmark: Movie %s streamed frames don't match the loaded frames", movieName);
+				passed = false;
+				continue;
+			}
+
+			logger->Printf(IGpLogDriver::Category_Information, "Benchmark: Movie %-24s %4u frames, first frame %7.2f ms streamed, %8.2f ms loaded, %9u / %9u bytes resident, %9u / %9u bytes peak",
+				movieName, static_cast<unsigned int>(streamed.m_numFrames), streamed.m_firstFrameMilliseconds, loaded.m_firstFrameMilliseconds,
+				static_cast<unsigned int>(streamed.m_residentBytes), static_cast<unsigned int>(loaded.m_residentBytes),
+				static_cast<unsigned int>(streamed.m_peakBytes), static_cast<unsigned int>(loaded.m_peakBytes));
+
+			if (streamed.m_numFrames > longestStreamed.m_numFrames)
+			{
+				memcpy(longestMovieName, movieName, sizeof(longestMovieName));
+				longestStreamed = streamed;
+				longestLoaded = loaded;
+			}
+		}
+
+		DisposeDirectoryFiles(firstFile);
+
+		if (numMovies == 0)
+			logger->Printf(IGpLogDriver::Category_Information, "Benchmark: Movie found no movies in the game data");
+		else if (longestStreamed.m_numFrames > 0)
+		{
+			// The long movies are the ones where loading everything up front stalls the most
+			logger->Printf(IGpLogDriver::Category_Information, "Benchmark: Movie longest is %s, %u frames, first frame %.1fx sooner streamed, played through in %.1f ms streamed, %.1f ms loaded",
+				longestMovieName, static_cast<unsigned int>(longestStreamed.m_numFrames), longestLoaded.m_firstFrameMilliseconds / longestStreamed.m_firstFrameMilliseconds,
+				longestStreamed.m_playMilliseconds, longestLoaded.m_playMilliseconds);
+		}
+
+		return passed;
+	}
+}
+
+//==============================================================  Functions
+//--------------------------------------------------------------  BenchmarkSubsystems
+// Returns false if any fast path doesn't match its reference.
+
+bool BenchmarkSubsystems()
+{
+	IGpLogDriver *logger = PLDrivers::GetLogDriver();
+	if (!logger)
+		return true;
+
+	bool allPassed = true;
+
+	if (!BenchmarkBlitKernels(logger))
+		allPassed = false;
+
+	if (!BenchmarkInflateStream(logger))
+		allPassed = false;
+
+	if (!BenchmarkResourceArchive(logger))
+		allPassed = false;
+
+	if (!BenchmarkLegalizeRooms(logger))
+		allPassed = false;
+
+	if (!BenchmarkRoomIndex(logger))
+		allPassed = false;
+
+	if (!BenchmarkAudioMix(logger))
+		allPassed = false;
+
+	if (!BenchmarkAudioChurn(logger))
+		allPassed = false;
+
+	if (!BenchmarkMovieLoading(logger))
+		allPassed = false;
+
+	return allPassed;
+}
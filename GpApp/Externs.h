@@ -11,6 +11,8 @@
 
 #include "PLMenus.h"
 
+struct IGpAudioBuffer;
+
 namespace PortabilityLayer
 {
 	class ResolveCachingColor;
@@ -181,6 +183,10 @@ void HandleDepthSwitching (void);
 Boolean CheckFileError (short, const PLPasStr &);				// --- File Error.c
 
 THandle<void> LoadHouseResource(const PortabilityLayer::ResTypeID &resTypeID, int16_t resID);	// --- HouseIO.c
+IGpAudioBuffer *LoadHouseSound (int16_t resID);
+DrawSurface *LoadHousePicture (const PortabilityLayer::ResTypeID &resTypeID, int16_t resID, DrawSurface *targetSurface);
+void DrawDecodedPicture (DrawSurface *surface, DrawSurface *picture, const Rect &bounds);
+void PrefetchHousePicture (const PortabilityLayer::ResTypeID &resTypeID, int16_t resID, DrawSurface *targetSurface);
 
 Boolean SavePrefs (prefsInfo *, THandle<void> *modulePrefs, short);					// --- Prefs.c
 Boolean LoadPrefs (prefsInfo *, THandle<void> *modulePrefs, short);
@@ -128,6 +128,8 @@ void DoHouseInfo (void);								// --- HouseInfo.c
 Boolean OpenHouse (Boolean load);						// --- HouseIO.c
 Boolean OpenSpecificHouse (const VFileSpec &);
 Boolean ReadHouse (GpIOStream *houseStream, bool untrusted);
+houseType *ReadHouseForLegalize (GpIOStream *houseStream, size_t &houseSize);
+bool LegalizeRooms (houseType *house, unsigned int maxThreads, bool &anyRepairs);
 Boolean WriteHouse (Boolean);
 Boolean CloseHouse (void);
 void OpenHouseResFork (void);
@@ -342,6 +344,9 @@ SInt16 VerticalRoomOffset (SInt16);
 void OffsetRectRoomRelative (Rect *, SInt16);
 SInt16 GetUpStairsRightEdge (void);
 SInt16 GetDownStairsLeftEdge (void);
+void ClearHotSpotGrid (void);
+void GridActiveRect (SInt16);
+uint64_t QueryHotSpotGrid (const Rect *);
 
 SInt16 GetRoomLinked (objectType *);						// --- Objects.c
 Boolean ObjectIsLinkTransport (objectType *);
@@ -410,6 +415,7 @@ void SelectNeighborRoom (SInt16);
 SInt16 GetNeighborRoomNumber (SInt16);
 Boolean GetRoomFloorSuite (SInt16, SInt16 *, SInt16 *);
 SInt16 GetRoomNumber (SInt16, SInt16);
+void RebuildRoomIndex (void);
 Boolean	IsRoomAStructure (SInt16);
 void DetermineRoomOpenings (void);
 SInt16 GetOriginalBounding (SInt16);
@@ -1,7 +1,10 @@
 #include "GpAppInterface.h"
 
+#include "Benchmark.h"
 #include "DisplayDeviceManager.h"
+#include "MemoryManager.h"
 #include "MenuManager.h"
+#include "PerformanceOverlay.h"
 #include "WindowManager.h"
 
 #include "PLDrivers.h"
@@ -21,6 +24,8 @@ public:
 	void PL_Render(IGpDisplayDriver *displayDriver) override;
 	GpDriverCollection *PL_GetDriverCollection() override;
 	bool PL_AdjustRequestedResolution(uint32_t &physicalWidth, uint32_t &physicalHeight, uint32_t &virtualWidth, uint32_t &virtualheight, float &pixelScaleX, float &pixelScaleY) override;
+
+	void SetBenchmarkMode(bool benchmarkMode) override;
 };
 
 void GpAppInterfaceImpl::ApplicationInit()
@@ -46,6 +51,8 @@ void GpAppInterfaceImpl::PL_Render(IGpDisplayDriver *displayDriver)
 {
 	PortabilityLayer::WindowManager::GetInstance()->RenderFrame(displayDriver);
 	PortabilityLayer::MenuManager::GetInstance()->RenderFrame(displayDriver);
+	PortabilityLayer::PerformanceOverlay::GetInstance()->RenderFrame(displayDriver);
+	PortabilityLayer::MemoryManager::GetInstance()->MarkFrame();
 }
 
 GpDriverCollection *GpAppInterfaceImpl::PL_GetDriverCollection()
@@ -65,6 +72,11 @@ bool GpAppInterfaceImpl::PL_AdjustRequestedResolution(uint32_t &physicalWidth, u
 	return true;
 }
 
+void GpAppInterfaceImpl::SetBenchmarkMode(bool benchmarkMode)
+{
+	BenchmarkSetEnabled(benchmarkMode);
+}
+
 
 static GpAppInterfaceImpl gs_application;
 
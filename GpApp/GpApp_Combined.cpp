@@ -2,6 +2,8 @@
 #include "AnimCursor.cpp"
 #include "AppleEvents.cpp"
 #include "Banner.cpp"
+#include "Benchmark.cpp"
+#include "BenchmarkSubsystems.cpp"
 #include "ColorUtils.cpp"
 #include "Coordinates.cpp"
 #include "DialogUtils.cpp"
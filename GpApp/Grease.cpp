@@ -67,6 +67,7 @@ void HandleGrease (void)
 				QOffsetRect(&src, -playOriginH, -playOriginV);
 				QOffsetRect(&src, grease[i].start, grease[i].dest.bottom);
 				hotSpots[grease[i].hotNum].bounds = src;
+				GridActiveRect(grease[i].hotNum);
 			}
 			
 			QSetRect(&src, 0, 0, 32, 27);
@@ -94,6 +95,7 @@ void HandleGrease (void)
 				QOffsetRect(&src, grease[i].start, grease[i].dest.bottom);
 				grease[i].start += 2;
 				hotSpots[grease[i].hotNum].bounds.right += 2;
+				GridActiveRect(grease[i].hotNum);
 			}
 			else
 			{
@@ -101,6 +103,7 @@ void HandleGrease (void)
 				QOffsetRect(&src, grease[i].start, grease[i].dest.bottom);
 				grease[i].start -= 2;
 				hotSpots[grease[i].hotNum].bounds.left -= 2;
+				GridActiveRect(grease[i].hotNum);
 			}
 			
 			{
@@ -245,6 +245,7 @@ Boolean InitializeEmptyHouse (void)
 	phoneBitSet = false;
 
 	numberRooms = 0;
+	RebuildRoomIndex();
 	mapLeftRoom = 60;
 	mapTopRoom = 50;
 	thisRoomNumber = kRoomIsEmpty;
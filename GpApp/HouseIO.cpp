@@ -6,6 +6,7 @@
 //============================================================================
 
 #include "BitmapImage.h"
+#include "DecodedImageCache.h"
 #include "DialogManager.h"
 #include "Externs.h"
 #include "Environ.h"
@@ -17,6 +18,8 @@
 #include "ObjectEdit.h"
 #include "RectUtils.h"
 #include "ResourceManager.h"
+#include "SoundCache.h"
+#include "WorkerThreadPool.h"
 
 #include "PLDialogs.h"
 #include "PLDrivers.h"
@@ -37,6 +40,8 @@
 #include "PLStandardColors.h"
 #include "ZipFile.h"
 
+#include <chrono>
+
 #define kSaveChangesAlert		1002
 #define kSaveChanges			1
 #define kDiscardChanges			2
@@ -83,7 +88,7 @@ void OpenHouseMovie (void)
 		if (!anim)
 			return;
 
-		PLError_t theErr = anim->Load(theSpec.m_dir, theSpec.m_name);
+		PLError_t theErr = anim->Load(theSpec.m_dir, theSpec.m_name, true);
 
 		if (theErr != PLErrors::kNone)
 		{
@@ -95,7 +100,7 @@ void OpenHouseMovie (void)
 			return;
 		}
 
-		movieRect = (*anim->GetFrame(0))->GetRect();
+		movieRect = anim->GetFrameRect();
 		
 		hasMovie = true;
 		theMovie.SetPackage(anim);
@@ -1901,8 +1906,109 @@ static bool LegalizeRoom(houseType *house, size_t roomNum, bool &anyRepairs)
 	return true;
 }
 
+// Rooms only reference each other through links, and link repairs only depend on the house version, so
+// once the layout has been repaired, each room can be legalized independently of the others.
+struct LegalizeRoomsContext
+{
+	houseType *m_house;
+	uint8_t *m_roomRepaired;
+	uint8_t *m_roomOK;
+};
+
+static void LegalizeRoomsWorker(void *context, size_t roomNum)
+{
+	const LegalizeRoomsContext *ctx = static_cast<const LegalizeRoomsContext*>(context);
+
+	bool roomRepairs = false;
+	ctx->m_roomOK[roomNum] = LegalizeRoom(ctx->m_house, roomNum, roomRepairs) ? 1 : 0;
+	ctx->m_roomRepaired[roomNum] = roomRepairs ? 1 : 0;
+}
+
+// The room layout has to be legalized first.  Uses up to maxThreads threads, including the caller, if the
+// house is big enough for that to pay off.
+bool LegalizeRooms(houseType *house, unsigned int maxThreads, bool &anyRepairs)
+{
+	// Below this, starting threads costs more than legalizing the rooms
+	const size_t kMinRoomsForThreads = 64;
+
+	const size_t nRooms = house->nRooms;
+
+	PortabilityLayer::WorkerThreadPool *pool = nullptr;
+	uint8_t *roomFlags = nullptr;
+
+	if (nRooms >= kMinRoomsForThreads && maxThreads > 1)
+	{
+		roomFlags = static_cast<uint8_t*>(NewPtr(nRooms * 2));
+		if (roomFlags)
+			pool = PortabilityLayer::WorkerThreadPool::Create(maxThreads);
+	}
+
+	if (!pool)
+	{
+		if (roomFlags)
+			DisposePtr(roomFlags);
+
+		for (size_t i = 0; i < nRooms; i++)
+		{
+			if (!LegalizeRoom(house, i, anyRepairs))
+				return LCheck(false);
+		}
+
+		return true;
+	}
+
+	const std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+
+	LegalizeRoomsContext ctx;
+	ctx.m_house = house;
+	ctx.m_roomRepaired = roomFlags;
+	ctx.m_roomOK = roomFlags + nRooms;
+
+	pool->ParallelFor(nRooms, LegalizeRoomsWorker, &ctx);
+
+	const unsigned int numThreads = pool->GetNumThreads();
+	pool->Destroy();
+
+	bool allOK = true;
+	for (size_t i = 0; i < nRooms; i++)
+	{
+		if (ctx.m_roomRepaired[i])
+			anyRepairs = true;
+		if (!ctx.m_roomOK[i])
+			allOK = false;
+	}
+
+	DisposePtr(roomFlags);
+
+	const int64_t elapsedMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - startTime).count();
+
+	IGpLogDriver *logger = PLDrivers::GetLogDriver();
+	if (logger)
+		logger->Printf(IGpLogDriver::Category_Information, "Legalized %u rooms on %u threads in %u us", static_cast<unsigned int>(nRooms), numThreads, static_cast<unsigned int>(elapsedMicroseconds));
+
+	if (!allOK)
+		return LCheck(false);
+
+	return true;
+}
+
+static bool LegalizeRoomLayouts(houseType *house, bool &anyRepairs)
+{
+	const size_t nRooms = house->nRooms;
+
+	for (size_t i = 0; i < nRooms; i++)
+	{
+		if (!LegalizeRoomLayout(house, i, anyRepairs))
+			return LCheck(false);
+	}
+
+	return true;
+}
+
 static bool LegalizeHouse(houseType *house, bool &anyRepairs)
 {
+	const unsigned int kMaxThreads = 8;
+
 	size_t nRooms = house->nRooms;
 
 	if (!LegalizeScores(&house->highScores, anyRepairs))
@@ -1911,11 +2017,8 @@ static bool LegalizeHouse(houseType *house, bool &anyRepairs)
 	PL_NotYetImplemented_TODO("Validate initial pos");
 
 	// Repair room layout
-	for (size_t i = 0; i < nRooms; i++)
-	{
-		if (!LegalizeRoomLayout(house, i, anyRepairs))
-			return LCheck(false);
-	}
+	if (!LegalizeRoomLayouts(house, anyRepairs))
+		return false;
 
 	// Repair firstRoom
 	if (house->firstRoom < 0 || house->firstRoom >= house->nRooms || house->rooms[house->firstRoom].suite == kRoomIsEmpty)
@@ -1938,12 +2041,39 @@ static bool LegalizeHouse(houseType *house, bool &anyRepairs)
 		}
 	}
 
-	for (size_t i = 0; i < nRooms; i++)
+	unsigned int numThreads = PLDrivers::GetSystemServices()->GetCPUCount();
+	if (numThreads > kMaxThreads)
+		numThreads = kMaxThreads;
+
+	if (!LegalizeRooms(house, numThreads, anyRepairs))
+		return false;
+
+	return true;
+}
+
+// Reads byteCount bytes of house data into house, which has room for the alignment padding, and swaps it
+// to native byte order
+static bool ReadHouseData(GpIOStream *houseStream, GpUFilePos_t byteCount, houseType *house)
+{
+	if (!houseStream->SeekStart(0))
+		return false;
+
+	const size_t readByteCount = houseStream->Read(house, byteCount);
+	if (readByteCount != byteCount || readByteCount < houseType::kBinaryDataSize)
+		return false;
+
+	// GP: Correct for padding
+	const size_t alignmentPadding = sizeof(houseType) - sizeof(roomType) - houseType::kBinaryDataSize;
+	if (alignmentPadding != 0)
 	{
-		if (!LegalizeRoom(house, i, anyRepairs))
-			return LCheck(false);
+		const size_t roomDataSize = byteCount - houseType::kBinaryDataSize;
+
+		uint8_t *houseDataBytes = reinterpret_cast<uint8_t*>(house);
+		memmove(house->rooms, houseDataBytes + houseType::kBinaryDataSize, roomDataSize);
 	}
 
+	ByteSwapHouse(house, static_cast<size_t>(byteCount), false);
+
 	return true;
 }
 
@@ -1998,30 +2128,12 @@ Boolean ReadHouse (GpIOStream *houseStream, bool untrusted)
 		return(false);
 	}
 	
-	if (!houseStream->SeekStart(0))
+	if (!ReadHouseData(houseStream, byteCount, *thisHouse))
 	{
 		CheckFileError(PLErrors::kIOError, thisHouseName);
 		return(false);
 	}
 	
-	const size_t readByteCount = houseStream->Read(*thisHouse, byteCount);
-	if (readByteCount != byteCount || readByteCount < houseType::kBinaryDataSize)
-	{
-		CheckFileError(PLErrors::kIOError, thisHouseName);
-		return(false);
-	}
-
-	if (alignmentPadding != 0)
-	{
-		// GP: Correct for padding
-		const size_t roomDataSize = byteCount - houseType::kBinaryDataSize;
-
-		uint8_t *houseDataBytes = reinterpret_cast<uint8_t*>(*thisHouse);
-		memmove((*thisHouse)->rooms, houseDataBytes + houseType::kBinaryDataSize, roomDataSize);
-	}
-
-	ByteSwapHouse(*thisHouse, static_cast<size_t>(byteCount), false);
-	
 	numberRooms = (*thisHouse)->nRooms;
 	if (numberRooms < 0 || static_cast<size_t>(numberRooms) > roomCountFromDataSize)
 	{
@@ -2053,6 +2165,8 @@ Boolean ReadHouse (GpIOStream *houseStream, bool untrusted)
 		YellowAlert(kYellowNoRooms, 0);
 	}
 	
+	RebuildRoomIndex();
+	
 	wasHouseVersion = (*thisHouse)->version;
 	if (wasHouseVersion >= kNewHouseVersion)
 	{
@@ -2100,6 +2214,41 @@ Boolean ReadHouse (GpIOStream *houseStream, bool untrusted)
 	return (true);
 }
 
+//--------------------------------------------------------------  ReadHouseForLegalize
+// Reads a house into a new pointer block of houseSize bytes the same way as ReadHouse, without making it
+// the current house, and legalizes its room layout so that LegalizeRooms can run on it.  Returns nil if
+// the house is damaged.
+
+houseType *ReadHouseForLegalize (GpIOStream *houseStream, size_t &houseSize)
+{
+	const GpUFilePos_t byteCount = houseStream->Size();
+	if (byteCount < houseType::kBinaryDataSize)
+		return nil;
+
+	const size_t roomDataSize = static_cast<size_t>(byteCount) - houseType::kBinaryDataSize;
+	if (roomDataSize % sizeof(roomType) != 0)
+		return nil;
+
+	const size_t roomCountFromDataSize = roomDataSize / sizeof(roomType);
+	const size_t alignmentPadding = sizeof(houseType) - sizeof(roomType) - houseType::kBinaryDataSize;
+
+	houseSize = static_cast<size_t>(byteCount) + alignmentPadding;
+
+	houseType *house = static_cast<houseType*>(NewPtr(houseSize));
+	if (!house)
+		return nil;
+
+	bool anyRepairs = false;
+	if (!ReadHouseData(houseStream, byteCount, house) || house->nRooms < 0 || static_cast<size_t>(house->nRooms) > roomCountFromDataSize
+		|| !LegalizeRoomLayouts(house, anyRepairs))
+	{
+		DisposePtr(house);
+		return nil;
+	}
+
+	return house;
+}
+
 //--------------------------------------------------------------  WriteHouse
 // This function writes out the house data to disk.
 
@@ -2328,6 +2477,64 @@ THandle<void> LoadHouseResource(const PortabilityLayer::ResTypeID &resTypeID, in
 	return PortabilityLayer::ResourceManager::GetInstance()->GetAppResource(resTypeID, resID);
 }
 
+//--------------------------------------------------------------  LoadHouseSound
+// Same lookup as LoadHouseResource, but returns the sound already converted
+// for the audio driver.  The sound comes from the sound cache, the caller
+// must release it.  Like LoadHouseResource, the application's sound is only
+// used if the house doesn't have one, so a house sound that fails to convert
+// is an error rather than a reason to play a different sound.
+
+IGpAudioBuffer *LoadHouseSound (int16_t resID)
+{
+	PortabilityLayer::SoundCache *soundCache = PortabilityLayer::SoundCache::GetInstance();
+
+	IGpAudioBuffer *sound = soundCache->GetSound(houseResFork, resID);
+	if (sound != nil)
+		return sound;
+
+	if (houseResFork->HasResource('snd ', resID))
+		return nil;
+
+	return soundCache->GetSound(PortabilityLayer::ResourceManager::GetInstance()->GetAppResourceArchive(), resID);
+}
+
+//--------------------------------------------------------------  LoadHousePicture
+// Same lookup as LoadHouseResource, but returns the picture already decoded
+// for the target surface.  The picture belongs to the decoded image cache and
+// is only valid until the next picture is loaded.
+
+DrawSurface *LoadHousePicture (const PortabilityLayer::ResTypeID &resTypeID, int16_t resID, DrawSurface *targetSurface)
+{
+	PortabilityLayer::DecodedImageCache *imageCache = PortabilityLayer::DecodedImageCache::GetInstance();
+	const GpPixelFormat_t pixelFormat = targetSurface->m_port.GetPixelFormat();
+
+	DrawSurface *picture = imageCache->GetPicture(houseResFork, resTypeID, resID, pixelFormat);
+	if (picture != nil)
+		return picture;
+
+	return imageCache->GetPicture(PortabilityLayer::ResourceManager::GetInstance()->GetAppResourceArchive(), resTypeID, resID, pixelFormat);
+}
+
+//--------------------------------------------------------------  PrefetchHousePicture
+// Starts decoding a picture that LoadHousePicture is likely to be asked for
+// soon, on the worker thread.
+
+void PrefetchHousePicture (const PortabilityLayer::ResTypeID &resTypeID, int16_t resID, DrawSurface *targetSurface)
+{
+	PortabilityLayer::DecodedImageCache *imageCache = PortabilityLayer::DecodedImageCache::GetInstance();
+	const GpPixelFormat_t pixelFormat = targetSurface->m_port.GetPixelFormat();
+
+	if (!imageCache->Prefetch(houseResFork, resTypeID, resID, pixelFormat))
+		imageCache->Prefetch(PortabilityLayer::ResourceManager::GetInstance()->GetAppResourceArchive(), resTypeID, resID, pixelFormat);
+}
+
+//--------------------------------------------------------------  DrawDecodedPicture
+
+void DrawDecodedPicture (DrawSurface *surface, DrawSurface *picture, const Rect &bounds)
+{
+	PortabilityLayer::DecodedImageCache::GetInstance()->DrawPicture(surface, picture, bounds);
+}
+
 //--------------------------------------------------------------  ExportHouse
 
 namespace ExportHouseResults
@@ -1030,6 +1030,8 @@ void CheckHouseForProblems (void)
 		}
 	}
 	
+	RebuildRoomIndex();					// rooms were moved and deleted above
+	
 	if (isHouseChecks)
 	{
 		SpinCursor(3);
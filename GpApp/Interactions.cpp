@@ -46,6 +46,7 @@ extern	short		nHotSpots, leftThresh, rightThresh, thisTiles[];
 extern	short		localNumbers[], thisBackground, numStarsRemaining;
 extern	Boolean		leftOpen, rightOpen, topOpen, bottomOpen, evenFrame;
 extern	Boolean		twoPlayerGame, newState, onePlayerLeft, playerDead;
+extern	uint32_t	hotSpotGridVersion;
 
 
 //==============================================================  Functions
@@ -1630,14 +1631,30 @@ void HandleHotSpotCollision (gliderPtr thisGlider, hotPtr who, short index)
 
 void CheckForHotSpots (void)
 {
+	Rect		gliderDest, glider2Dest;
+	uint64_t	candidates;
+	uint32_t	gridVersion;
 	short		i;
 	Boolean		hitObject;
 	
+	// Only hot spots in the grid cells under the gliders can be hit.  The
+	// rest still get walked in order so stillOver is cleared just as if
+	// they'd been tested and missed.
+	gliderDest = theGlider.dest;
+	glider2Dest = theGlider2.dest;
+	gridVersion = hotSpotGridVersion;
+	
+	candidates = QueryHotSpotGrid(&gliderDest);
+	if (twoPlayerGame)
+		candidates |= QueryHotSpotGrid(&glider2Dest);
+	
 	for (i = 0; i < nHotSpots; i++)
 	{
 		if (hotSpots[i].isOn)
 		{
-			if (twoPlayerGame)
+			if ((candidates & ((uint64_t)1 << i)) == 0)
+				hotSpots[i].stillOver = false;
+			else if (twoPlayerGame)
 			{
 				hitObject = false;
 				if (SectGlider(&theGlider, &hotSpots[i].bounds, 
@@ -1686,6 +1703,13 @@ void CheckForHotSpots (void)
 				else
 					hotSpots[i].stillOver = false;
 			}
+			
+			// A collision can move a glider or change the room, in which
+			// case the rest have to be tested the long way.
+			if ((gridVersion != hotSpotGridVersion) || 
+					(gliderDest != theGlider.dest) || 
+					(glider2Dest != theGlider2.dest))
+				candidates = ~(uint64_t)0;
 		}
 	}
 }
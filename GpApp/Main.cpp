@@ -10,6 +10,7 @@
 #include "BitmapImage.h"
 #include "FileManager.h"
 #include "Externs.h"
+#include "Benchmark.h"
 #include "Environ.h"
 #include "FontFamily.h"
 #include "FontManager.h"
@@ -27,6 +28,7 @@
 #include "MenuManager.h"
 #include "QDPixMap.h"
 #include "QDStandardPalette.h"
+#include "RandomNumberGenerator.h"
 #include "RenderedFont.h"
 #include "ResolveCachingColor.h"
 #include "ResourceManager.h"
@@ -45,11 +47,13 @@
 #include <atomic>
 
 #define kPrefsVersion			0x003a
+#define kBenchmarkRandomSeed	0x243F6A88
 
 
 void ReadInPrefs (void);
 void WriteOutPrefs (void);
 void HandleSplashResolutionChange (void);
+void RunBenchmark (void);
 int main(int argc, const char **argv);
 
 
@@ -69,6 +73,7 @@ extern short		isEditH, isEditV, isMapH, isMapV;
 extern short		isToolsH, isToolsV, isCoordH, isCoordV;
 extern short		isLinkH, isLinkV, toolMode, mapLeftRoom, mapTopRoom;
 extern short		mapRoomsWide, mapRoomsHigh, wasFloor, wasSuite;
+extern short		demoHouseIndex;
 extern Boolean		isMusicOn, isSoundOn, isPlayMusicIdle, isHouseChecks;
 extern Boolean		houseOpen, isDoColorFade, isEscPauseKey;
 extern Boolean		autoRoomEdit, doAutoDemo, doBackground;
@@ -596,7 +601,8 @@ int AppStartup()
 			FlushResolutionChange();
 		}
 
-		ShowInitialLaunchDisclaimer();
+		if (!BenchmarkIsEnabled())
+			ShowInitialLaunchDisclaimer();
 	}
 
 	if (thisMac.isResolutionDirty)
@@ -673,12 +679,47 @@ int AppShutdown()
 	return 0;
 }
 
+//--------------------------------------------------------------  RunBenchmark
+// Checks and times the subsystem fast paths, then replays the demo uncapped
+// with a fixed random seed, reports and quits.
+
+void RunBenchmark (void)
+{
+	IGpLogDriver *logger = PLDrivers::GetLogDriver();
+
+	if (!BenchmarkSubsystems())
+	{
+		if (logger)
+			logger->Printf(IGpLogDriver::Category_Error, "Benchmark: Subsystem checks failed");
+	}
+
+	if (demoHouseIndex == -1)
+	{
+		if (logger)
+			logger->Printf(IGpLogDriver::Category_Error, "Benchmark: Demo house wasn't found");
+	}
+	else
+	{
+		if (logger)
+			logger->Printf(IGpLogDriver::Category_Information, "Benchmark: Starting demo replay");
+
+		PortabilityLayer::RandomNumberGenerator::GetInstance()->Seed(kBenchmarkRandomSeed);
+		DoDemoGame();
+		BenchmarkReport();
+	}
+
+	quitting = true;
+}
+
 int gpAppMain()
 {
 	int returnCode = AppStartup();
 	if (returnCode != 0)
 		return returnCode;
 
+	if (BenchmarkIsEnabled())
+		RunBenchmark();
+
 	while (!quitting)		// this is the main loop
 		HandleEvent();
 
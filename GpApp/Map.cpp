@@ -167,19 +167,18 @@ void FindNewActiveRoomRect (void)
 
 void LoadGraphicPlus (DrawSurface *surface, short resID, const Rect &theRect)
 {
-	THandle<BitmapImage>	thePicture;
+	DrawSurface		*thePicture;
 	
-	thePicture = LoadHouseResource('PICT', resID).StaticCast<BitmapImage>();
+	thePicture = LoadHousePicture('PICT', resID, surface);
 	if (thePicture == nil)
 	{
-		thePicture = LoadHouseResource('Date', resID).StaticCast<BitmapImage>();
+		thePicture = LoadHousePicture('Date', resID, surface);
 		if (thePicture == nil)
 		{
 			return;
 		}
 	}
-	surface->DrawPicture(thePicture, theRect);
-	thePicture.Dispose();
+	DrawDecodedPicture(surface, thePicture, theRect);
 }
 
 //--------------------------------------------------------------  RedrawMapContents
@@ -802,6 +801,7 @@ void MoveRoom (Point wherePt)
 	{
 		thisRoom->floor = roomV;
 		thisRoom->suite = roomH;
+		CopyThisRoomToRoom();			// keeps the room index current
 		fileDirty = true;
 		UpdateMenus(false);
 		RedrawMapContents();
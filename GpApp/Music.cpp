@@ -13,6 +13,7 @@
 #include "IGpSystemServices.h"
 #include "MemoryManager.h"
 #include "ResourceManager.h"
+#include "SoundStreamer.h"
 
 #include "PLDrivers.h"
 #include "PLResources.h"
@@ -24,7 +25,9 @@
 #define kLastGamePiece				6
 
 
+short NextMusicPiece (void);
 void MusicCallBack (PortabilityLayer::AudioChannel *channel);
+size_t StreamerNextMusicPiece (void *context);
 PLError_t LoadMusicSounds (void);
 PLError_t DumpMusicSounds (void);
 PLError_t OpenMusicChannel (void);
@@ -34,6 +37,7 @@ IGpAudioBuffer *ParseAndConvertSound(const THandle<void> &handle);
 
 
 PortabilityLayer::AudioChannel	*musicChannel;
+PortabilityLayer::SoundStreamer	*musicStreamer;	// If null, the pieces are loaded into theMusicData instead
 IGpAudioBuffer	*theMusicData[kMaxMusic];
 short			musicScore[kLastMusicPiece];
 short			gameScore[kLastGamePiece];
@@ -74,7 +78,7 @@ PLError_t StartMusic (void)
 
 	if ((soundVolume != 0) && (!failedMusic))
 	{
-		musicChannel->AddBuffer(theMusicData[musicState.musicSoundID], true);
+		short firstPiece = musicState.musicSoundID;
 
 		// Don't need to lock here because the callback should not trigger until queued
 		musicState.musicCursor++;
@@ -82,8 +86,25 @@ PLError_t StartMusic (void)
 			musicState.musicCursor = 0;
 		musicState.musicSoundID = musicScore[musicState.musicCursor];
 
-		musicChannel->AddBuffer(theMusicData[musicState.musicSoundID], true);
-		musicChannel->AddCallback(MusicCallBack, true);
+		short secondPiece = musicState.musicSoundID;
+
+		if (musicStreamer != nil)
+		{
+			size_t leadInPieces[2];
+			leadInPieces[0] = firstPiece;
+			leadInPieces[1] = secondPiece;
+
+			if (!musicStreamer->Start(leadInPieces, 2))
+				return PLErrors::kAudioError;
+		}
+		else
+		{
+			// The callback runs when the first piece finishes and queues the third, so one piece is always queued
+			// behind the one that is playing
+			musicChannel->AddBuffer(theMusicData[firstPiece], true);
+			musicChannel->AddCallback(MusicCallBack, true);
+			musicChannel->AddBuffer(theMusicData[secondPiece], true);
+		}
 
 		isMusicOn = true;
 	}
@@ -103,8 +124,13 @@ void StopTheMusic (void)
 	theErr = PLErrors::kNone;
 	if ((isMusicOn) && (!failedMusic))
 	{
-		musicChannel->ClearAllCommands();
-		musicChannel->Stop();
+		if (musicStreamer != nil)
+			musicStreamer->Stop();
+		else
+		{
+			musicChannel->ClearAllCommands();
+			musicChannel->Stop();
+		}
 
 		isMusicOn = false;
 	}
@@ -157,12 +183,10 @@ void SetMusicalMode (short newMode)
 	musicMutex->Unlock();
 }
 
-//--------------------------------------------------------------  MusicCallBack
+//--------------------------------------------------------------  NextMusicPiece
 
-void MusicCallBack (PortabilityLayer::AudioChannel *theChannel)
+short NextMusicPiece (void)
 {
-	PLError_t		theErr;
-
 	musicMutex->Lock();
 	switch (musicState.musicMode)
 	{
@@ -193,8 +217,26 @@ void MusicCallBack (PortabilityLayer::AudioChannel *theChannel)
 	short musicSoundID = musicState.musicSoundID;
 	musicMutex->Unlock();
 
-	theChannel->AddBuffer(theMusicData[musicSoundID], true);
+	return (musicSoundID);
+}
+
+//--------------------------------------------------------------  MusicCallBack
+
+void MusicCallBack (PortabilityLayer::AudioChannel *theChannel)
+{
+	short musicSoundID = NextMusicPiece();
+
 	theChannel->AddCallback(MusicCallBack, true);
+	theChannel->AddBuffer(theMusicData[musicSoundID], true);
+}
+
+//--------------------------------------------------------------  StreamerNextMusicPiece
+
+// Called on the streamer's worker thread, a few chunks before the current piece ends
+
+size_t StreamerNextMusicPiece (void *context)
+{
+	return (NextMusicPiece());
 }
 
 //--------------------------------------------------------------  LoadMusicSounds
@@ -293,22 +335,29 @@ void InitMusic (void)
 		return;
 
 	musicChannel = nil;
+	musicStreamer = nil;
 
 	failedMusic = false;
 	isMusicOn = false;
-	theErr = LoadMusicSounds();
+	theErr = OpenMusicChannel();
 	if (theErr != PLErrors::kNone)
 	{
 		YellowAlert(kYellowNoMusic, theErr);
 		failedMusic = true;
 		return;
 	}
-	theErr = OpenMusicChannel();
-	if (theErr != PLErrors::kNone)
+
+	// Stream the music if possible, so only a few chunks of it are resident at a time
+	musicStreamer = PortabilityLayer::SoundStreamer::Create(musicChannel, kBaseBufferMusicID, kMaxMusic, StreamerNextMusicPiece, nil);
+	if (musicStreamer == nil)
 	{
-		YellowAlert(kYellowNoMusic, theErr);
-		failedMusic = true;
-		return;
+		theErr = LoadMusicSounds();
+		if (theErr != PLErrors::kNone)
+		{
+			YellowAlert(kYellowNoMusic, theErr);
+			failedMusic = true;
+			return;
+		}
 	}
 
 	musicScore[0] = 0;
@@ -363,6 +412,10 @@ void KillMusic (void)
 	if (dontLoadMusic)
 		return;
 
+	if (musicStreamer != nil)
+		musicStreamer->Destroy();
+	musicStreamer = nil;
+
 	theErr = CloseMusicChannel();
 	theErr = DumpMusicSounds();
 
@@ -703,7 +703,7 @@ void DrawARoomsObjects (short neighbor, Boolean redraw)
 						whoCares = tvScreen1;
 						ZeroRectCorner(&whoCares);
 						OffsetRect(&whoCares, itsRect.left + 17, itsRect.top + 10);
-						movieRect = (*theMovie.m_animPackage->GetFrame(0))->GetRect();
+						movieRect = theMovie.m_animPackage->GetFrameRect();
 						CenterRectInRect(&movieRect, &whoCares);
 						theMovie.m_renderRect = movieRect;
 						theMovie.m_constrainRect = whoCares;
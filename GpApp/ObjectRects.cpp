@@ -9,6 +9,8 @@
 #include "Externs.h"
 #include "RectUtils.h"
 
+#include <string.h>
+
 
 #define kFloorColumnWide		4
 #define kCeilingColumnWide		24
@@ -18,13 +20,28 @@
 #define kStoolThick				25
 #define kShredderActiveHigh		40
 
+// Hot spots are bucketed in a grid covering the room and its neighbors,
+// each cell holding a mask of the hot spots that overlap it.  Anything
+// further out is clamped to the edge cells.
+#define kHotSpotCellSize		64
+#define kHotSpotGridLeft		(-kRoomWide)
+#define kHotSpotGridTop			(-kTileHigh)
+#define kHotSpotGridCols		((kRoomWide * 3) / kHotSpotCellSize)
+#define kHotSpotGridRows		((kTileHigh * 3 + kHotSpotCellSize - 1) / kHotSpotCellSize)
+
 
 short AddActiveRect (Rect *, short, short, Boolean, Boolean);
+static void GetHotSpotCells (const Rect *, short *, short *, short *, short *);
 
 
+uint64_t	hotSpotGrid[kHotSpotGridRows][kHotSpotGridCols];
+uint32_t	hotSpotGridVersion;
+
 extern	hotPtr		hotSpots;
 extern	short		nHotSpots, numChimes;
 
+GP_STATIC_ASSERT(kMaxHotSpots <= 64);
+
 
 //==============================================================  Functions
 //--------------------------------------------------------------  GetObjectRect
@@ -287,9 +304,99 @@ short AddActiveRect (Rect *bounds, short action, short who, Boolean isOn,
 	hotSpots[nHotSpots].doScrutinize = doScrutinize;
 	nHotSpots++;
 	
+	GridActiveRect(nHotSpots - 1);
+	
 	return (nHotSpots - 1);
 }
 
+//--------------------------------------------------------------  GetHotSpotCells
+
+static void GetHotSpotCells (const Rect *bounds, short *firstCol, short *lastCol, 
+		short *firstRow, short *lastRow)
+{
+	short		minH, maxH, minV, maxV;
+	
+	// Collision tests are inclusive of the edges and don't care which
+	// way around they are, so neither does this.
+	minH = (bounds->left < bounds->right) ? bounds->left : bounds->right;
+	maxH = (bounds->left < bounds->right) ? bounds->right : bounds->left;
+	minV = (bounds->top < bounds->bottom) ? bounds->top : bounds->bottom;
+	maxV = (bounds->top < bounds->bottom) ? bounds->bottom : bounds->top;
+	
+	*firstCol = (short)((minH - kHotSpotGridLeft) / kHotSpotCellSize);
+	*lastCol = (short)((maxH - kHotSpotGridLeft) / kHotSpotCellSize);
+	*firstRow = (short)((minV - kHotSpotGridTop) / kHotSpotCellSize);
+	*lastRow = (short)((maxV - kHotSpotGridTop) / kHotSpotCellSize);
+	
+	if (*firstCol < 0)
+		*firstCol = 0;
+	if (*lastCol < 0)
+		*lastCol = 0;
+	if (*firstRow < 0)
+		*firstRow = 0;
+	if (*lastRow < 0)
+		*lastRow = 0;
+	
+	if (*firstCol >= kHotSpotGridCols)
+		*firstCol = kHotSpotGridCols - 1;
+	if (*lastCol >= kHotSpotGridCols)
+		*lastCol = kHotSpotGridCols - 1;
+	if (*firstRow >= kHotSpotGridRows)
+		*firstRow = kHotSpotGridRows - 1;
+	if (*lastRow >= kHotSpotGridRows)
+		*lastRow = kHotSpotGridRows - 1;
+}
+
+//--------------------------------------------------------------  ClearHotSpotGrid
+
+void ClearHotSpotGrid (void)
+{
+	memset(hotSpotGrid, 0, sizeof(hotSpotGrid));
+	hotSpotGridVersion++;
+}
+
+//--------------------------------------------------------------  GridActiveRect
+// Adds a hot spot to the cells under its bounds.  This has to be called
+// again whenever the bounds change.  Cells it no longer covers keep it
+// until the grid is cleared, which only costs a wasted collision test.
+
+void GridActiveRect (short who)
+{
+	uint64_t	mask;
+	short		firstCol, lastCol, firstRow, lastRow, col, row;
+	
+	if ((who < 0) || (who >= nHotSpots))
+		return;
+	
+	GetHotSpotCells(&hotSpots[who].bounds, &firstCol, &lastCol, 
+			&firstRow, &lastRow);
+	
+	mask = (uint64_t)1 << who;
+	for (row = firstRow; row <= lastRow; row++)
+		for (col = firstCol; col <= lastCol; col++)
+			hotSpotGrid[row][col] |= mask;
+	
+	hotSpotGridVersion++;
+}
+
+//--------------------------------------------------------------  QueryHotSpotGrid
+// Returns a mask of every hot spot that might intersect the bounds.
+
+uint64_t QueryHotSpotGrid (const Rect *bounds)
+{
+	uint64_t	mask;
+	short		firstCol, lastCol, firstRow, lastRow, col, row;
+	
+	GetHotSpotCells(bounds, &firstCol, &lastCol, &firstRow, &lastRow);
+	
+	mask = 0;
+	for (row = firstRow; row <= lastRow; row++)
+		for (col = firstCol; col <= lastCol; col++)
+			mask |= hotSpotGrid[row][col];
+	
+	return (mask);
+}
+
 //--------------------------------------------------------------  CreateActiveRects
 
 short CreateActiveRects (short who)
@@ -299,6 +299,7 @@ void ListAllLocalObjects (void)
 	numMasterObjects = 0;
 	numLocalMasterObjects = 0;
 	nHotSpots = 0;
+	ClearHotSpotGrid();
 	
 	ListOneRoomsObjects(kCentralRoom);
 	
@@ -10,6 +10,7 @@
 #include "PLStandardColors.h"
 #include "DisplayDeviceManager.h"
 #include "Externs.h"
+#include "Benchmark.h"
 #include "Environ.h"
 #include "House.h"
 #include "MainMenuUI.h"
@@ -648,6 +649,8 @@ void PlayGame (void)
 
 	while ((playing) && (!quitting))
 	{
+		BenchmarkBeginFrame();
+
 		HandleInGameEvents();
 
 		if (thisMac.isResolutionDirty)
@@ -717,6 +720,8 @@ void PlayGame (void)
 				HandleDynamicScoreboard();
 			}
 		}
+
+		BenchmarkEndFrame();
 		
 		if (quitting) {
 			DoEndGame();
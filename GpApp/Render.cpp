@@ -7,6 +7,7 @@
 
 
 #include "Externs.h"
+#include "Benchmark.h"
 #include "Environ.h"
 #include "MainWindow.h"
 #include "Objects.h"
@@ -699,8 +700,6 @@ void CopyRectsQD (void)
 				&work2MainRects[i], &work2MainRects[i], 
 				srcCopy);
 	}
-
-	mainWindowGraf->m_port.SetDirty(PortabilityLayer::QDPortDirtyFlag_Contents);
 	
 	for (i = 0; i < numBack2Work; i++)
 	{
@@ -715,36 +714,63 @@ void CopyRectsQD (void)
 
 void RenderFrame (void)
 {
+	BenchmarkEndPhase(BenchmarkPhases::kLogic);
 	if (hasMirror)
 	{
 		DrawReflection(&theGlider, true);
 		if (twoPlayerGame)
 			DrawReflection(&theGlider2, false);
 	}
+	BenchmarkEndPhase(BenchmarkPhases::kReflections);
 	HandleGrease();
+	BenchmarkEndPhase(BenchmarkPhases::kGrease);
 	RenderPendulums();
+	BenchmarkEndPhase(BenchmarkPhases::kPendulums);
 	if (evenFrame)
 		RenderFlames();
 	else
 		RenderStars();
+	BenchmarkEndPhase(BenchmarkPhases::kFlamesAndStars);
 	RenderDynamics();
+	BenchmarkEndPhase(BenchmarkPhases::kDynamics);
 	RenderFlyingPoints();
+	BenchmarkEndPhase(BenchmarkPhases::kFlyingPoints);
 	RenderSparkles();
+	BenchmarkEndPhase(BenchmarkPhases::kSparkles);
 	RenderGlider(&theGlider, true);
 	if (twoPlayerGame)
 		RenderGlider(&theGlider2, false);
+	BenchmarkEndPhase(BenchmarkPhases::kGliders);
 	RenderShreds();
+	BenchmarkEndPhase(BenchmarkPhases::kShreds);
 	RenderBands();
+	BenchmarkEndPhase(BenchmarkPhases::kRubberBands);
 	RenderTouchScreenControls();
+	BenchmarkEndPhase(BenchmarkPhases::kTouchScreenControls);
 	
-	while (TickCount() < nextFrame)
+	if (BenchmarkIsEnabled())
 	{
-		PL_ASYNCIFY_PARANOID_DISARM_FOR_SCOPE();
-		Delay(1, nullptr);
+		// Uncapped: copy to the window and present every frame without waiting on the frame timer
+		CopyRectsQD();
+		BenchmarkEndPhase(BenchmarkPhases::kCopyRects);
+
+		{
+			PL_ASYNCIFY_PARANOID_DISARM_FOR_SCOPE();
+			Delay(1, nullptr);
+		}
+		BenchmarkEndPhase(BenchmarkPhases::kPresent);
+	}
+	else
+	{
+		while (TickCount() < nextFrame)
+		{
+			PL_ASYNCIFY_PARANOID_DISARM_FOR_SCOPE();
+			Delay(1, nullptr);
+		}
+		nextFrame = TickCount() + kTicksPerFrame;
+		
+		CopyRectsQD();
 	}
-	nextFrame = TickCount() + kTicksPerFrame;
-	
-	CopyRectsQD();
 	
 	numWork2Main = 0;
 	numBack2Work = 0;
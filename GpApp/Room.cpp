@@ -26,6 +26,9 @@
 
 Boolean QueryDeleteRoom (void);
 void SetToNearestNeighborRoom (short, short);
+static short *RoomIndexSlot (short, short);
+static void IndexRoom (short);
+static void UnindexRoom (short);
 
 
 roomPtr		thisRoom;
@@ -37,6 +40,9 @@ Boolean		autoRoomEdit, newRoomNow, noRoomAtAll;
 Boolean		leftOpen, rightOpen, topOpen, bottomOpen;
 Boolean		doComplainDialogs;
 
+static short	roomIndex[kMaxNumRoomsV][kMaxNumRoomsH];
+static short	numStrayRooms, numStackedRooms;
+
 extern	short		tempTiles[];
 
 
@@ -211,6 +217,7 @@ Boolean CreateNewRoom (short h, short v)
 		numberRooms = (*thisHouse)->nRooms;
 		previousRoom = thisRoomNumber;
 		thisRoomNumber = numberRooms - 1;
+		IndexRoom(thisRoomNumber);
 	}
 	else
 	{
@@ -243,7 +250,7 @@ Boolean CreateNewRoom (short h, short v)
 void ReadyBackground (short theID, short *theTiles)
 {
 	Rect					src, dest;
-	THandle<BitmapImage>	thePicture;
+	DrawSurface				*thePicture;
 	short					i;
 	
 	if ((noRoomAtAll) || (!houseUnlocked))
@@ -267,10 +274,10 @@ void ReadyBackground (short theID, short *theTiles)
 		return;
 	}
 	
-	thePicture = LoadHouseResource('PICT', theID).StaticCast<BitmapImage>();
+	thePicture = LoadHousePicture('PICT', theID, workSrcMap);
 	if (thePicture == nil)
 	{
-		thePicture = LoadHouseResource('Date', theID).StaticCast<BitmapImage>();
+		thePicture = LoadHousePicture('Date', theID, workSrcMap);
 		if (thePicture == nil)
 		{
 			YellowAlert(kYellowNoBackground, 0);
@@ -278,10 +285,9 @@ void ReadyBackground (short theID, short *theTiles)
 		}
 	}
 	
-	dest = (*thePicture)->GetRect();
+	dest = thePicture->m_port.GetRect();
 	QOffsetRect(&dest, -dest.left, -dest.top);
-	workSrcMap->DrawPicture(thePicture, dest);
-	thePicture.Dispose();
+	DrawDecodedPicture(workSrcMap, thePicture, dest);
 	
 	QSetRect(&src, 0, 0, kTileWide, kTileHigh);
 	QSetRect(&dest, 0, 0, kTileWide, kTileHigh);
@@ -353,12 +359,21 @@ void CopyRoomToThisRoom (short roomNumber)
 
 void CopyThisRoomToRoom (void)
 {
-	char		tagByte;
+	roomType	*houseRoom;
 	
 	if ((noRoomAtAll) || (thisRoomNumber == -1))
 		return;
 	
-	(*thisHouse)->rooms[thisRoomNumber] = *thisRoom;	// copy back to house
+	houseRoom = &(*thisHouse)->rooms[thisRoomNumber];
+	if ((houseRoom->floor != thisRoom->floor) || 
+			(houseRoom->suite != thisRoom->suite))
+	{											// room was moved (or created)
+		UnindexRoom(thisRoomNumber);
+		*houseRoom = *thisRoom;					// copy back to house
+		IndexRoom(thisRoomNumber);
+	}
+	else
+		*houseRoom = *thisRoom;					// copy back to house
 }
 
 //--------------------------------------------------------------  ForceThisRoom
@@ -384,30 +399,17 @@ void ForceThisRoom (short roomNumber)
 Boolean RoomExists (short suite, short floor, short *roomNum)
 {
 	// pass in a suite and floor; returns true is it is a legitimate room
-	houseType	*thisHousePtr;
-	short		i;
-	char		wasState;
-	Boolean		foundIt;
-	
-	foundIt = false;
+	short		foundNum;
 	
 	if (suite < 0)
-		return (foundIt);
-	
-	thisHousePtr = *thisHouse;
+		return (false);
 	
-	for (i = 0; i < numberRooms; i++)
-	{
-		if ((thisHousePtr->rooms[i].floor == floor) && 
-				(thisHousePtr->rooms[i].suite == suite))
-		{
-			foundIt = true;
-			*roomNum = i;
-			break;
-		}
-	}
+	foundNum = GetRoomNumber(floor, suite);
+	if (foundNum == kRoomIsEmpty)
+		return (false);
 	
-	return (foundIt);
+	*roomNum = foundNum;
+	return (true);
 }
 
 //--------------------------------------------------------------  RoomNumExists
@@ -447,6 +449,7 @@ void DeleteRoom (Boolean doWarn)
 	wasFloor = (*thisHouse)->rooms[thisRoomNumber].floor;
 	wasSuite = (*thisHouse)->rooms[thisRoomNumber].suite;
 	firstDeleted = ((*thisHouse)->firstRoom == thisRoomNumber);	// is room "first"
+	UnindexRoom(thisRoomNumber);
 	thisRoom->suite = kRoomIsEmpty;
 	(*thisHouse)->rooms[thisRoomNumber].suite = kRoomIsEmpty;
 	
@@ -545,10 +548,8 @@ void SelectNeighborRoom (short whichNeighbor)
 
 short GetNeighborRoomNumber (short which)
 {
-	short		hDelta, vDelta, i;
+	short		hDelta, vDelta;
 	short		roomH, roomV;
-	short		roomNum;
-	char		wasState;
 	
 	switch (which)
 	{
@@ -598,21 +599,10 @@ short GetNeighborRoomNumber (short which)
 		break;
 	}
 	
-	roomNum = kRoomIsEmpty;
 	roomH = (*thisHouse)->rooms[thisRoomNumber].suite + hDelta;
 	roomV = (*thisHouse)->rooms[thisRoomNumber].floor + vDelta;
 	
-	for (i = 0; i < numberRooms; i++)
-	{
-		if (((*thisHouse)->rooms[i].suite == roomH) && 
-				((*thisHouse)->rooms[i].floor == roomV))
-		{
-			roomNum = i;
-			break;
-		}
-	}
-	
-	return (roomNum);
+	return (GetRoomNumber(roomV, roomH));
 }
 
 //--------------------------------------------------------------  SetToNearestNeighborRoom
@@ -710,12 +700,19 @@ Boolean GetRoomFloorSuite (short room, short *floor, short *suite)
 short GetRoomNumber (short floor, short suite)
 {
 	// pass in a floor and suite; returns the room index into the house file
+	short		*slot;
 	short		roomNum, i;
-	char		wasState;
+	
+	slot = RoomIndexSlot(floor, suite);
+	if (slot != nil)
+		return (*slot);
 	
 	roomNum = kRoomIsEmpty;
 	
-	for (i = 0; i < numberRooms; i++)
+	if ((numStrayRooms == 0) || (suite == kRoomIsEmpty))
+		return (roomNum);
+	
+	for (i = 0; i < numberRooms; i++)	// only unchecked houses get here
 	{
 		if (((*thisHouse)->rooms[i].suite == suite) && 
 				((*thisHouse)->rooms[i].floor == floor))
@@ -728,6 +725,113 @@ short GetRoomNumber (short floor, short suite)
 	return (roomNum);
 }
 
+//--------------------------------------------------------------  RoomIndexSlot
+// Returns the room index entry for a floor and suite, or nil if they're
+// outside the range of floors and suites a legal house can use.
+
+static short *RoomIndexSlot (short floor, short suite)
+{
+	if ((suite < 0) || (suite >= kMaxNumRoomsH))
+		return (nil);
+	if ((floor <= -kNumUndergroundFloors) || 
+			(floor > (kMaxNumRoomsV - kNumUndergroundFloors)))
+		return (nil);
+	
+	return (&roomIndex[floor + kNumUndergroundFloors - 1][suite]);
+}
+
+//--------------------------------------------------------------  IndexRoom
+// Adds a house room to the room index.  If several rooms are stacked on
+// the same floor and suite, the lowest numbered one is found, as before.
+
+static void IndexRoom (short roomNum)
+{
+	roomType	*theRoom;
+	short		*slot;
+	
+	theRoom = &(*thisHouse)->rooms[roomNum];
+	if (theRoom->suite == kRoomIsEmpty)
+		return;
+	
+	slot = RoomIndexSlot(theRoom->floor, theRoom->suite);
+	if (slot == nil)
+		numStrayRooms++;
+	else if (*slot == kRoomIsEmpty)
+		*slot = roomNum;
+	else
+	{
+		numStackedRooms++;
+		if (roomNum < *slot)
+			*slot = roomNum;
+	}
+}
+
+//--------------------------------------------------------------  UnindexRoom
+// Removes a house room from the room index.  Call it before the room's
+// floor or suite in the house changes.
+
+static void UnindexRoom (short roomNum)
+{
+	roomType	*theRoom;
+	short		*slot;
+	short		i;
+	
+	theRoom = &(*thisHouse)->rooms[roomNum];
+	if (theRoom->suite == kRoomIsEmpty)
+		return;
+	
+	slot = RoomIndexSlot(theRoom->floor, theRoom->suite);
+	if (slot == nil)
+	{
+		numStrayRooms--;
+		return;
+	}
+	
+	if (*slot != roomNum)
+	{
+		numStackedRooms--;
+		return;
+	}
+	
+	*slot = kRoomIsEmpty;
+	if (numStackedRooms == 0)
+		return;
+	
+	for (i = 0; i < numberRooms; i++)	// bring up a room stacked under it
+	{
+		if ((i != roomNum) && 
+				((*thisHouse)->rooms[i].suite == theRoom->suite) && 
+				((*thisHouse)->rooms[i].floor == theRoom->floor))
+		{
+			*slot = i;
+			numStackedRooms--;
+			break;
+		}
+	}
+}
+
+//--------------------------------------------------------------  RebuildRoomIndex
+// Rebuilds the floor/suite to room number index from the house.  Call it
+// whenever rooms in the house are replaced wholesale (new house, house
+// read in, house compressed).
+
+void RebuildRoomIndex (void)
+{
+	short		h, v, i;
+	
+	for (v = 0; v < kMaxNumRoomsV; v++)
+	{
+		for (h = 0; h < kMaxNumRoomsH; h++)
+			roomIndex[v][h] = kRoomIsEmpty;
+	}
+	
+	numStrayRooms = 0;
+	numStackedRooms = 0;
+	
+	for (i = 0; i < numberRooms; i++)
+		IndexRoom(i);
+}
+
 //--------------------------------------------------------------  IsRoomAStructure
 
 Boolean	IsRoomAStructure (short roomNum)
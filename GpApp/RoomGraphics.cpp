@@ -25,6 +25,7 @@ void DrawFloorSupport (void);
 void ReadyBackMap (void);
 void RestoreWorkMap (void);
 void DrawLighting (void);
+void PrefetchOuterRooms (void);
 
 
 Rect		suppSrcRect;
@@ -37,7 +38,7 @@ Boolean		isStructure[9], wardBitSet;
 
 extern	Rect		tempManholes[];
 extern	short		numTempManholes, tvWithMovieNumber;
-extern	Boolean		shadowVisible, takingTheStairs;
+extern	Boolean		shadowVisible, takingTheStairs, noRoomAtAll;
 
 
 //==============================================================  Functions
@@ -144,25 +145,23 @@ void ResetLocale (Boolean soft)
 void LoadGraphicSpecial (DrawSurface *surface, short resID)
 {
 	Rect		bounds;
-	THandle<BitmapImage>	thePicture;
+	DrawSurface	*thePicture;
 	
-	thePicture = LoadHouseResource('PICT', resID).StaticCast<BitmapImage>();
+	thePicture = LoadHousePicture('PICT', resID, surface);
 	if (thePicture == nil)
 	{
-		thePicture = LoadHouseResource('Date', resID).StaticCast<BitmapImage>();
+		thePicture = LoadHousePicture('Date', resID, surface);
 		if (thePicture == nil)
 		{
-			thePicture = LoadHouseResource('PICT', 2000).StaticCast<BitmapImage>();
+			thePicture = LoadHousePicture('PICT', 2000, surface);
 			if (thePicture == nil)
 				RedAlert(kErrFailedGraphicLoad);
 		}
 	}
 	
-	bounds = (*thePicture)->GetRect();
+	bounds = thePicture->m_port.GetRect();
 	OffsetRect(&bounds, -bounds.left, -bounds.top);
-	surface->DrawPicture(thePicture, bounds);
-
-	thePicture.Dispose();
+	DrawDecodedPicture(surface, thePicture, bounds);
 }
 
 //--------------------------------------------------------------  DrawRoomBackground
@@ -399,6 +398,43 @@ void ReadyLevel (void)
 	DetermineRoomOpenings();
 	ResetLocale(false);
 	InitGarbageRects();
+	PrefetchOuterRooms();
+}
+
+//--------------------------------------------------------------  PrefetchOuterRooms
+// Starts decoding the backgrounds of the ring of rooms just outside the
+// local rooms, since the next ResetLocale will draw some of them.
+
+void PrefetchOuterRooms (void)
+{
+	short		roomH, roomV, roomNum, h, v, pictID;
+	
+	if (noRoomAtAll)
+		return;
+	
+	roomH = (*thisHouse)->rooms[thisRoomNumber].suite;
+	roomV = (*thisHouse)->rooms[thisRoomNumber].floor;
+	
+	for (v = -2; v <= 2; v++)
+	{
+		for (h = -2; h <= 2; h++)
+		{
+			if ((v > -2) && (v < 2) && (h > -2) && (h < 2))
+				continue;
+			
+			roomNum = GetRoomNumber(roomV + v, roomH + h);
+			if (roomNum != kRoomIsEmpty)
+				pictID = (*thisHouse)->rooms[roomNum].background;
+			else if (roomV + v > 1)		// same choice DrawRoomBackground makes
+				pictID = kSky;
+			else if (roomV + v == 1)
+				pictID = kMeadow;
+			else
+				pictID = kDirt;
+			
+			PrefetchHousePicture('PICT', pictID, workSrcMap);
+		}
+	}
 }
 
 //--------------------------------------------------------------  DrawLighting
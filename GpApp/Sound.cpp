@@ -15,9 +15,9 @@
 #include "IGpLogDriver.h"
 #include "MemoryManager.h"
 #include "ResourceManager.h"
+#include "SoundCache.h"
 #include "SoundSync.h"
 #include "VirtualDirectory.h"
-#include "WaveFormat.h"
 
 #include "PLDrivers.h"
 
@@ -182,8 +182,6 @@ void PlayExclusiveSoundChannel(short channelIndex, short soundID, short oldPrior
 
 PLError_t LoadTriggerSound (short soundID)
 {
-	Handle		theSound;
-	long		soundDataSize;
 	PLError_t		theErr;
 	
 	if ((dontLoadSounds) || (theSoundData[kMaxSounds - 1] != nil))
@@ -194,21 +192,13 @@ PLError_t LoadTriggerSound (short soundID)
 		
 		theErr = PLErrors::kNone;
 		
-		theSound = LoadHouseResource('snd ', soundID);
-		if (theSound == nil)
+		IGpAudioBuffer *buffer = LoadHouseSound(soundID);
+		if (buffer == nil)
 			theErr = PLErrors::kResourceError;
 		else
 		{
-			IGpAudioBuffer *buffer = ParseAndConvertSound(theSound);
-			theSound.Dispose();
-
-			if (buffer == nil)
-				theErr = PLErrors::kResourceError;
-			else
-			{
-				assert(theSoundData[kMaxSounds - 1] == nil);
-				theSoundData[kMaxSounds - 1] = buffer;
-			}
+			assert(theSoundData[kMaxSounds - 1] == nil);
+			theSoundData[kMaxSounds - 1] = buffer;
 		}
 	}
 	
@@ -228,22 +218,16 @@ void DumpTriggerSound (void)
 
 PLError_t LoadBufferSounds (void)
 {
-	Handle		theSound;
-	long		soundDataSize;
 	PLError_t		theErr;
 	short		i;
 	
 	theErr = PLErrors::kNone;
+
+	PortabilityLayer::IResourceArchive *appArchive = PortabilityLayer::ResourceManager::GetInstance()->GetAppResourceArchive();
 	
 	for (i = 0; i < kMaxSounds - 1; i++)
 	{
-		theSound = PortabilityLayer::ResourceManager::GetInstance()->GetAppResource('snd ', i + kBaseBufferSoundID);
-		if (theSound == nil)
-			return (PLErrors::kResourceError);
-
-		IGpAudioBuffer *buffer = ParseAndConvertSound(theSound);
-		theSound.Dispose();
-
+		IGpAudioBuffer *buffer = PortabilityLayer::SoundCache::GetInstance()->GetSound(appArchive, i + kBaseBufferSoundID);
 		if (!buffer)
 			return PLErrors::kResourceError;
 
@@ -397,6 +381,9 @@ void KillSound (void)
 	
 	CloseSoundChannels();
 	DumpBufferSounds();
+
+	// The cache holds references to driver buffers, so it has to let go of them before the audio driver shuts down
+	PortabilityLayer::SoundCache::GetInstance()->PurgeAll();
 }
 
 //--------------------------------------------------------------  TellHerNoSounds
@@ -416,124 +403,7 @@ void TellHerNoSounds (void)
 
 bool ParseAndConvertSoundChecked(const THandle<void> &handle, void const*& outDataContents, size_t &outDataSize)
 {
-	const uint8_t *dataStart = static_cast<const uint8_t*>(*handle);
-	const size_t size = handle.MMBlock()->m_size;
-
-	if (size < sizeof(PortabilityLayer::RIFFTag))
-		return false;
-
-	PortabilityLayer::RIFFTag mainRiffTag;
-	memcpy(&mainRiffTag, dataStart, sizeof(PortabilityLayer::RIFFTag));
-
-	if (mainRiffTag.m_tag != PortabilityLayer::WaveConstants::kRiffChunkID)
-		return false;
-
-	const uint32_t riffSize = mainRiffTag.m_chunkSize;
-	if (riffSize < 4 || riffSize - 4 > size - sizeof(PortabilityLayer::RIFFTag))
-		return false;
-
-	const uint8_t *riffStart = dataStart + sizeof(PortabilityLayer::RIFFTag);
-	const uint8_t *riffEnd = riffStart + riffSize;
-
-	const uint8_t *formatTagLoc = nullptr;
-	const uint8_t *dataTagLoc = nullptr;
-
-	LEUInt32_t waveMarker;
-	memcpy(&waveMarker, riffStart, 4);
-
-	if (waveMarker != PortabilityLayer::WaveConstants::kWaveChunkID)
-		return false;
-
-	const uint8_t *tagSearchLoc = riffStart + 4;
-
-	// Find tags
-	while (tagSearchLoc != riffEnd)
-	{
-		if (riffEnd - tagSearchLoc < sizeof(PortabilityLayer::RIFFTag))
-			return false;
-
-		PortabilityLayer::RIFFTag riffTag;
-		memcpy(&riffTag, tagSearchLoc, sizeof(PortabilityLayer::RIFFTag));
-
-		if (riffTag.m_tag == PortabilityLayer::WaveConstants::kFormatChunkID)
-			formatTagLoc = tagSearchLoc;
-		else if (riffTag.m_tag == PortabilityLayer::WaveConstants::kDataChunkID)
-			dataTagLoc = tagSearchLoc;
-
-		const uint32_t riffTagSizeUnpadded = riffTag.m_chunkSize;
-
-		if (riffTagSizeUnpadded == 0xffffffffU)
-			return false;
-
-		const uint32_t riffTagSizePadded = riffTagSizeUnpadded + (riffTagSizeUnpadded & 1);
-
-		tagSearchLoc += sizeof(PortabilityLayer::RIFFTag);
-
-		if (riffEnd - tagSearchLoc < riffTagSizePadded)
-			return false;
-
-		tagSearchLoc += riffTagSizePadded;
-	}
-
-	if (formatTagLoc == nullptr || dataTagLoc == nullptr)
-		return false;
-
-	PortabilityLayer::RIFFTag fmtTag;
-	memcpy(&fmtTag, formatTagLoc, sizeof(PortabilityLayer::RIFFTag));
-
-	const uint8_t *formatContents = formatTagLoc + sizeof(PortabilityLayer::RIFFTag);
-
-	PortabilityLayer::RIFFTag dataTag;
-	memcpy(&dataTag, dataTagLoc, sizeof(PortabilityLayer::RIFFTag));
-
-	const uint8_t *dataContents = dataTagLoc + sizeof(PortabilityLayer::RIFFTag);
-
-	PortabilityLayer::WaveFormatChunkV3 formatChunkV3;
-
-	memset(&formatChunkV3, 0, sizeof(formatChunkV3));
-
-	int formatChunkVersion = 0;
-	size_t copyableSize = 0;
-	if (fmtTag.m_chunkSize >= sizeof(PortabilityLayer::WaveFormatChunkV3))
-	{
-		formatChunkVersion = 3;
-		copyableSize = sizeof(PortabilityLayer::WaveFormatChunkV3);
-	}
-	else if (fmtTag.m_chunkSize >= sizeof(PortabilityLayer::WaveFormatChunkV2))
-	{
-		formatChunkVersion = 2;
-		copyableSize = sizeof(PortabilityLayer::WaveFormatChunkV2);
-	}
-	else if (fmtTag.m_chunkSize >= sizeof(PortabilityLayer::WaveFormatChunkV1))
-	{
-		formatChunkVersion = 1;
-		copyableSize = sizeof(PortabilityLayer::WaveFormatChunkV1);
-	}
-	else
-		return false;
-
-	memcpy(&formatChunkV3, formatContents, copyableSize);
-
-	const PortabilityLayer::WaveFormatChunkV2 formatChunkV2 = formatChunkV3.m_v2;
-	const PortabilityLayer::WaveFormatChunkV1 formatChunkV1 = formatChunkV2.m_v1;
-
-	if (formatChunkV1.m_bitsPerSample != 8)
-		return false;
-
-	if (formatChunkV1.m_formatCode != PortabilityLayer::WaveConstants::kFormatPCM ||
-		formatChunkV1.m_numChannels != 1 ||
-		formatChunkV1.m_blockAlignmentBytes != 1 ||
-		formatChunkV1.m_bitsPerSample != 8)
-		return false;
-
-	uint32_t dataSize = dataTag.m_chunkSize;
-	if (dataSize > 0x1000000 || dataSize < 1)
-		return false;
-
-	outDataContents = dataContents;
-	outDataSize = dataSize;
-
-	return true;
+	return PortabilityLayer::SoundCache::ParseSound(*handle, handle.MMBlock()->m_size, outDataContents, outDataSize);
 }
 
 IGpAudioBuffer *ParseAndConvertSound(const THandle<void> &handle)
@@ -4,6 +4,7 @@ enum EGpDisplayDriverType
 {
 	EGpDisplayDriverType_D3D11,
 	EGpDisplayDriverType_SDL_GL2,
+	EGpDisplayDriverType_Headless,
 
 	EGpDisplayDriverType_Count,
 };
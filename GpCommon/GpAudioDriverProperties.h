@@ -14,6 +14,13 @@ struct GpAudioDriverProperties
 	unsigned int m_sampleRate;
 	bool m_debug;
 
+	// Null driver only: WAV file to write the mix to (or null to discard it)
+	const char *m_wavOutputPath;
+
+	// Null driver only: advance the sample clock from ServeTicks instead of the wall clock, so the same input
+	// always produces the same mix
+	bool m_virtualClock;
+
 	IGpLogDriver *m_logger;
 	IGpSystemServices *m_systemServices;
 	IGpAllocator *m_alloc;
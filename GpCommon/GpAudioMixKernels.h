@@ -0,0 +1,105 @@
+#pragma once
+
+#include "CoreDefs.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GP_AUDIO_MIX_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define GP_AUDIO_MIX_NEON 1
+#include <arm_neon.h>
+#endif
+
+#ifndef GP_AUDIO_MIX_SSE2
+#define GP_AUDIO_MIX_SSE2 0
+#endif
+
+#ifndef GP_AUDIO_MIX_NEON
+#define GP_AUDIO_MIX_NEON 0
+#endif
+
+// Mono s16 mixing kernels shared by the audio drivers.  The scalar versions are the reference that the
+// vector versions have to match exactly, and are what the vector versions use for the leftover samples.
+namespace GpAudioMixKernels
+{
+	inline int16_t SaturateSample(int32_t sample)
+	{
+		if (sample > 32767)
+			return 32767;
+		if (sample < -32768)
+			return -32768;
+		return static_cast<int16_t>(sample);
+	}
+
+	// dest = saturate(src * volumeScale)
+	inline void ScaleSamplesScalar(int16_t *GP_RESTRICT dest, const int16_t *GP_RESTRICT src, size_t nSamples, int16_t volumeScale)
+	{
+		for (size_t i = 0; i < nSamples; i++)
+			dest[i] = SaturateSample(static_cast<int32_t>(src[i]) * volumeScale);
+	}
+
+	// dest = saturate(dest + saturate(src * volumeScale))
+	inline void MixScaledSamplesScalar(int16_t *GP_RESTRICT dest, const int16_t *GP_RESTRICT src, size_t nSamples, int16_t volumeScale)
+	{
+		for (size_t i = 0; i < nSamples; i++)
+			dest[i] = SaturateSample(static_cast<int32_t>(dest[i]) + SaturateSample(static_cast<int32_t>(src[i]) * volumeScale));
+	}
+
+	inline void ScaleSamples(int16_t *GP_RESTRICT dest, const int16_t *GP_RESTRICT src, size_t nSamples, int16_t volumeScale)
+	{
+		size_t i = 0;
+
+#if GP_AUDIO_MIX_SSE2
+		const __m128i volume = _mm_set1_epi16(volumeScale);
+		for (; i + 8 <= nSamples; i += 8)
+		{
+			const __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			const __m128i productLo = _mm_mullo_epi16(samples, volume);
+			const __m128i productHi = _mm_mulhi_epi16(samples, volume);
+			const __m128i scaled = _mm_packs_epi32(_mm_unpacklo_epi16(productLo, productHi), _mm_unpackhi_epi16(productLo, productHi));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), scaled);
+		}
+#elif GP_AUDIO_MIX_NEON
+		const int16x4_t volume = vdup_n_s16(volumeScale);
+		for (; i + 8 <= nSamples; i += 8)
+		{
+			const int16x8_t samples = vld1q_s16(src + i);
+			const int16x8_t scaled = vcombine_s16(vqmovn_s32(vmull_s16(vget_low_s16(samples), volume)), vqmovn_s32(vmull_s16(vget_high_s16(samples), volume)));
+			vst1q_s16(dest + i, scaled);
+		}
+#endif
+
+		ScaleSamplesScalar(dest + i, src + i, nSamples - i, volumeScale);
+	}
+
+	inline void MixScaledSamples(int16_t *GP_RESTRICT dest, const int16_t *GP_RESTRICT src, size_t nSamples, int16_t volumeScale)
+	{
+		size_t i = 0;
+
+#if GP_AUDIO_MIX_SSE2
+		const __m128i volume = _mm_set1_epi16(volumeScale);
+		for (; i + 8 <= nSamples; i += 8)
+		{
+			const __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			const __m128i productLo = _mm_mullo_epi16(samples, volume);
+			const __m128i productHi = _mm_mulhi_epi16(samples, volume);
+			const __m128i scaled = _mm_packs_epi32(_mm_unpacklo_epi16(productLo, productHi), _mm_unpackhi_epi16(productLo, productHi));
+			const __m128i mixed = _mm_adds_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(dest + i)), scaled);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), mixed);
+		}
+#elif GP_AUDIO_MIX_NEON
+		const int16x4_t volume = vdup_n_s16(volumeScale);
+		for (; i + 8 <= nSamples; i += 8)
+		{
+			const int16x8_t samples = vld1q_s16(src + i);
+			const int16x8_t scaled = vcombine_s16(vqmovn_s32(vmull_s16(vget_low_s16(samples), volume)), vqmovn_s32(vmull_s16(vget_high_s16(samples), volume)));
+			vst1q_s16(dest + i, vqaddq_s16(vld1q_s16(dest + i), scaled));
+		}
+#endif
+
+		MixScaledSamplesScalar(dest + i, src + i, nSamples - i, volumeScale);
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+// Frame pacing counters kept by a display driver.  Counters are totals since the driver started, so callers
+// can take two snapshots and diff them to get the rates over any window.
+struct GpDisplayDriverFrameStats
+{
+	static const unsigned int kNumPresentIntervalBuckets = 16;
+	static const unsigned int kPresentIntervalBucketUSec = 4000;	// The last bucket also counts all longer intervals
+
+	GpDisplayDriverFrameStats();
+
+	void RecordTick(bool isCatchUp);
+	void RecordPresent(uint32_t intervalUSec, bool isDoubled);
+	void RecordFrameWork(uint64_t uploadBytes, uint32_t uploadCount, uint32_t drawCalls);
+
+	uint32_t m_tickIntervalUSec;
+	bool m_isInFrameTimeLock;
+
+	uint64_t m_numTicks;
+	uint64_t m_numPresents;
+	uint64_t m_presentIntervalHistogram[kNumPresentIntervalBuckets];
+	uint32_t m_lastPresentIntervalUSec;
+
+	uint64_t m_numFramesDropped;	// Display refreshes missed, going by presents that came 1.5 ticks or more apart, plus frames replaced before they were shown
+	uint64_t m_numFramesDoubled;	// Presents that showed the same game frame as the previous present
+	uint64_t m_numCatchUpSteps;	// Extra ticks run without a present in between, to catch up with the display
+
+	uint64_t m_lastFrameUploadBytes;
+	uint32_t m_lastFrameUploadCount;
+	uint32_t m_lastFrameDrawCalls;
+
+	uint64_t m_totalUploadBytes;
+	uint64_t m_totalUploadCount;
+	uint64_t m_totalDrawCalls;
+};
+
+inline GpDisplayDriverFrameStats::GpDisplayDriverFrameStats()
+{
+	memset(this, 0, sizeof(*this));
+}
+
+inline void GpDisplayDriverFrameStats::RecordTick(bool isCatchUp)
+{
+	m_numTicks++;
+	if (isCatchUp)
+		m_numCatchUpSteps++;
+}
+
+inline void GpDisplayDriverFrameStats::RecordPresent(uint32_t intervalUSec, bool isDoubled)
+{
+	if (m_numPresents > 0)
+	{
+		unsigned int bucket = intervalUSec / kPresentIntervalBucketUSec;
+		if (bucket >= kNumPresentIntervalBuckets)
+			bucket = kNumPresentIntervalBuckets - 1;
+
+		m_presentIntervalHistogram[bucket]++;
+		m_lastPresentIntervalUSec = intervalUSec;
+
+		if (m_tickIntervalUSec > 0 && static_cast<uint64_t>(intervalUSec) * 2 >= static_cast<uint64_t>(m_tickIntervalUSec) * 3)
+			m_numFramesDropped += (intervalUSec + m_tickIntervalUSec / 2) / m_tickIntervalUSec - 1;
+	}
+
+	if (isDoubled)
+		m_numFramesDoubled++;
+
+	m_numPresents++;
+}
+
+inline void GpDisplayDriverFrameStats::RecordFrameWork(uint64_t uploadBytes, uint32_t uploadCount, uint32_t drawCalls)
+{
+	m_lastFrameUploadBytes = uploadBytes;
+	m_lastFrameUploadCount = uploadCount;
+	m_lastFrameDrawCalls = drawCalls;
+
+	m_totalUploadBytes += uploadBytes;
+	m_totalUploadCount += uploadCount;
+	m_totalDrawCalls += drawCalls;
+}
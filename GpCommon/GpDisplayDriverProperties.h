@@ -31,6 +31,19 @@ struct GpDisplayDriverProperties
 
 	void *m_osGlobals;
 
+	// If set, texture uploads go through a ring of streaming buffers instead of directly from client memory, if the driver supports it
+	bool m_streamTextureUploads;
+
+	// If set, frames are recorded into packets and presented on a separate render thread that owns the GL context,
+	// so that a slow swap doesn't stall the tick function.  Ignored by drivers that don't support it.
+	bool m_threadedPresent;
+
+	// Headless driver only: directory to write frame dumps to (or null to disable), dump every N frames,
+	// and number of frames to render before posting a quit event (0 = unlimited)
+	const char *m_frameDumpPath;
+	unsigned int m_frameDumpInterval;
+	unsigned int m_frameLimit;
+
 	// Tick function and context to call when a frame needs to be served.
 	TickFunc_t m_tickFunc;
 	void *m_tickFuncContext;
@@ -21,6 +21,10 @@ public:
 	virtual void GP_ASYNCIFY_PARANOID_NAMED(Close)() = 0;
 	virtual void Flush() = 0;
 
+	// Returns the entire stream contents if they are directly addressable (i.e. the file is memory-mapped),
+	// or nullptr otherwise.  The contents are read-only and remain valid until the stream is closed.
+	virtual const void *GetMappedContents() const;
+
 	bool ReadExact(void *bytesOut, size_t size);
 	bool WriteExact(const void *bytesOut, size_t size);
 
@@ -29,6 +33,11 @@ public:
 #endif
 };
 
+inline const void *GpIOStream::GetMappedContents() const
+{
+	return nullptr;
+}
+
 inline bool GpIOStream::ReadExact(void *bytesOut, size_t size)
 {
 	const size_t nRead = this->Read(bytesOut, size);
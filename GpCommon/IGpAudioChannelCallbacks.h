@@ -2,5 +2,6 @@
 
 struct IGpAudioChannelCallbacks
 {
+	// May be called from the audio thread, so this must not block
 	virtual void NotifyBufferFinished() = 0;
 };
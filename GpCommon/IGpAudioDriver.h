@@ -17,4 +17,12 @@ public:
 	virtual void Shutdown() = 0;
 
 	virtual IGpPrefsHandler *GetPrefsHandler() const = 0;
+
+	// Advances drivers that play on the game's tick clock instead of the wall clock by tickCount ticks.  Called
+	// for every tick the host serves, and while the application is blocked waiting for audio to play out.
+	virtual void ServeTicks(int tickCount);
 };
+
+inline void IGpAudioDriver::ServeTicks(int tickCount)
+{
+}
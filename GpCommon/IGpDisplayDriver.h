@@ -11,6 +11,7 @@ struct IGpDisplayDriverSurface;
 struct IGpCursor;
 struct IGpPrefsHandler;
 struct GpDisplayDriverProperties;
+struct GpDisplayDriverFrameStats;
 
 struct GpDisplayDriverSurfaceEffects
 {
@@ -61,6 +62,8 @@ struct IGpDisplayDriver
 
 	virtual const GpDisplayDriverProperties &GetProperties() const = 0;
 	virtual IGpPrefsHandler *GetPrefsHandler() const = 0;
+
+	virtual void GetFrameStats(GpDisplayDriverFrameStats &outStats) const = 0;
 };
 
 inline GpDisplayDriverSurfaceEffects::GpDisplayDriverSurfaceEffects()
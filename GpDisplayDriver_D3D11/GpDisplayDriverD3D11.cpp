@@ -629,6 +629,10 @@ bool GpDisplayDriverD3D11::SyncRender()
 	{
 		m_frameTimeAccumulated -= m_frameTimeSliceSize;
 
+		// Any tick after the first since the last present is running behind the display
+		m_frameStats.RecordTick(m_ticksSincePresent > 0);
+		m_ticksSincePresent++;
+
 		return true;
 	}
 
@@ -663,6 +667,8 @@ bool GpDisplayDriverD3D11::SyncRender()
 		m_deviceContext->RSSetViewports(1, &viewport);
 	}
 
+	m_frameDrawCalls = 0;
+
 	m_properties.m_renderFunc(m_properties.m_renderFuncContext);
 
 	ScaleVirtualScreen();
@@ -679,6 +685,22 @@ bool GpDisplayDriverD3D11::SyncRender()
 	if (FAILED(m_swapChain->Present1(1, 0, &presentParams)))
 		return GpDisplayDriverTickStatuses::kNonFatalFault;
 
+	{
+		LARGE_INTEGER presentTime;
+		QueryPerformanceCounter(&presentTime);
+
+		LONGLONG intervalUSec = (presentTime.QuadPart - m_lastPresentTime.QuadPart) * 1000000 / m_QPFrequency.QuadPart;
+		if (intervalUSec > 0xffffffff)
+			intervalUSec = 0xffffffff;
+
+		m_lastPresentTime = presentTime;
+
+		// Texture uploads aren't tracked by this driver
+		m_frameStats.RecordPresent(static_cast<uint32_t>(intervalUSec), m_frameStats.m_numPresents > 0 && m_ticksSincePresent == 0);
+		m_frameStats.RecordFrameWork(0, 0, m_frameDrawCalls);
+		m_ticksSincePresent = 0;
+	}
+
 	//DebugPrintf("r: %i\n", static_cast<int>(r));
 
 	DXGI_FRAME_STATISTICS stats;
@@ -760,6 +782,8 @@ bool GpDisplayDriverD3D11::SyncRender()
 			isInFrameTimeLock = true;
 		}
 
+		m_frameStats.m_isInFrameTimeLock = isInFrameTimeLock;
+
 		LONGLONG frameTimeStep = m_frameTimeSliceSize;
 		if (!isInFrameTimeLock)
 		{
@@ -1274,6 +1298,8 @@ void GpDisplayDriverD3D11::DrawSurface(IGpDisplayDriverSurface *surface, int32_t
 
 	GpDisplayDriverSurfaceD3D11 *d3d11Surface = static_cast<GpDisplayDriverSurfaceD3D11*>(surface);
 
+	m_frameDrawCalls++;
+
 	//m_deviceContext->OMSetDepthStencilState(m_drawQuadDepthStencilState, 0);
 
 	{
@@ -1491,6 +1517,11 @@ IGpPrefsHandler *GpDisplayDriverD3D11::GetPrefsHandler() const
 	return const_cast<IGpPrefsHandler*>(cPrefsHandler);
 }
 
+void GpDisplayDriverD3D11::GetFrameStats(GpDisplayDriverFrameStats &outStats) const
+{
+	outStats = m_frameStats;
+}
+
 void GpDisplayDriverD3D11::ApplyPrefs(const void *identifier, size_t identifierSize, const void *contents, size_t contentsSize, uint32_t version)
 {
 	if (version == kPrefsVersion && identifierSize == strlen(kPrefsIdentifier) && !memcmp(identifier, kPrefsIdentifier, identifierSize))
@@ -1540,13 +1571,17 @@ GpDisplayDriverD3D11::GpDisplayDriverD3D11(const GpDisplayDriverProperties &prop
 	, m_lastFullScreenToggleTimeStamp(0)
 	, m_bgIsDark(false)
 	, m_useICCProfile(false)
+	, m_ticksSincePresent(0)
+	, m_frameDrawCalls(0)
 {
 	memset(&m_syncTimeBase, 0, sizeof(m_syncTimeBase));
+	memset(&m_lastPresentTime, 0, sizeof(m_lastPresentTime));
 	memset(&m_windowModeRevertRect, 0, sizeof(m_windowModeRevertRect));
 
 	QueryPerformanceFrequency(&m_QPFrequency);
 
 	m_frameTimeSliceSize = m_QPFrequency.QuadPart * static_cast<LONGLONG>(properties.m_frameTimeLockNumerator) / static_cast<LONGLONG>(properties.m_frameTimeLockDenominator);
+	m_frameStats.m_tickIntervalUSec = static_cast<uint32_t>(static_cast<LONGLONG>(1000000) * static_cast<LONGLONG>(properties.m_frameTimeLockNumerator) / static_cast<LONGLONG>(properties.m_frameTimeLockDenominator));
 
 	m_arrowCursor = reinterpret_cast<HCURSOR>(LoadImageW(nullptr, MAKEINTRESOURCEW(OCR_NORMAL), IMAGE_CURSOR, 0, 0, LR_SHARED));
 	m_ibeamCursor = reinterpret_cast<HCURSOR>(LoadImageW(nullptr, MAKEINTRESOURCEW(OCR_IBEAM), IMAGE_CURSOR, 0, 0, LR_SHARED));
@@ -6,6 +6,7 @@
 #include "IGpDisplayDriver.h"
 #include "IGpPrefsHandler.h"
 #include "GpCoreDefs.h"
+#include "GpDisplayDriverFrameStats.h"
 #include "GpDisplayDriverProperties.h"
 #include "GpComPtr.h"
 
@@ -64,6 +65,7 @@ public:
 
 	const GpDisplayDriverProperties &GetProperties() const override;
 	IGpPrefsHandler *GetPrefsHandler() const override;
+	void GetFrameStats(GpDisplayDriverFrameStats &outStats) const override;
 
 	void ApplyPrefs(const void *identifier, size_t identifierSize, const void *contents, size_t contentsSize, uint32_t version) override;
 	bool SavePrefs(void *context, IGpPrefsHandler::WritePrefsFunc_t writeFunc) override;
@@ -200,4 +202,9 @@ private:
 	bool m_bgIsDark;
 
 	bool m_useICCProfile;
+
+	GpDisplayDriverFrameStats m_frameStats;
+	LARGE_INTEGER m_lastPresentTime;
+	unsigned int m_ticksSincePresent;
+	uint32_t m_frameDrawCalls;
 };
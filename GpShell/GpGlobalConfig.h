@@ -17,6 +17,13 @@ struct GpGlobalConfig
 	EGpDisplayDriverType m_displayDriverType;
 	EGpAudioDriverType m_audioDriverType;
 	EGpFontHandlerType m_fontHandlerType;
+	bool m_streamTextureUploads;
+	bool m_threadedPresent;
+	const char *m_frameDumpPath;
+	unsigned int m_frameDumpInterval;
+	unsigned int m_frameLimit;
+	const char *m_audioWavPath;
+	bool m_audioVirtualClock;
 
 	const EGpInputDriverType *m_inputDriverTypes;
 	size_t m_numInputDrivers;
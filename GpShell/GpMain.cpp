@@ -60,6 +60,11 @@ int GpMain::Run()
 
 	ddProps.m_type = g_gpGlobalConfig.m_displayDriverType;
 	ddProps.m_osGlobals = g_gpGlobalConfig.m_osGlobals;
+	ddProps.m_streamTextureUploads = g_gpGlobalConfig.m_streamTextureUploads;
+	ddProps.m_threadedPresent = g_gpGlobalConfig.m_threadedPresent;
+	ddProps.m_frameDumpPath = g_gpGlobalConfig.m_frameDumpPath;
+	ddProps.m_frameDumpInterval = g_gpGlobalConfig.m_frameDumpInterval;
+	ddProps.m_frameLimit = g_gpGlobalConfig.m_frameLimit;
 	ddProps.m_eventQueue = eventQueue;
 	ddProps.m_logger = g_gpGlobalConfig.m_logger;
 	ddProps.m_systemServices = g_gpGlobalConfig.m_systemServices;
@@ -83,6 +88,8 @@ int GpMain::Run()
 #else
 	adProps.m_debug = true;
 #endif
+	adProps.m_wavOutputPath = g_gpGlobalConfig.m_audioWavPath;
+	adProps.m_virtualClock = g_gpGlobalConfig.m_audioVirtualClock;
 	adProps.m_logger = g_gpGlobalConfig.m_logger;
 	adProps.m_systemServices = g_gpGlobalConfig.m_systemServices;
 	adProps.m_alloc = g_gpGlobalConfig.m_allocator;
@@ -0,0 +1,794 @@
+#include "BlitKernels.h"
+
+#include "AntiAliasTable.h"
+#include "IGpLogDriver.h"
+#include "PLDrivers.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__)) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PL_BLIT_KERNELS_SSE2 1
+#if defined(_MSC_VER) || ((defined(__GNUC__) || defined(__clang__)) && !defined(__EMSCRIPTEN__))
+#define PL_BLIT_KERNELS_AVX2 1
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define PL_BLIT_KERNELS_NEON 1
+#endif
+
+#ifndef PL_BLIT_KERNELS_SSE2
+#define PL_BLIT_KERNELS_SSE2 0
+#endif
+
+#ifndef PL_BLIT_KERNELS_AVX2
+#define PL_BLIT_KERNELS_AVX2 0
+#endif
+
+#ifndef PL_BLIT_KERNELS_NEON
+#define PL_BLIT_KERNELS_NEON 0
+#endif
+
+#if PL_BLIT_KERNELS_SSE2
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if PL_BLIT_KERNELS_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define PL_BLIT_KERNELS_AVX2_TARGET
+#else
+#define PL_BLIT_KERNELS_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+#if PL_BLIT_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+namespace PortabilityLayer
+{
+	namespace BlitKernelsScalar
+	{
+		static void CopyMask8Row8(uint8_t *dest, const uint8_t *src, const uint8_t *mask, size_t numPixels)
+		{
+			for (size_t i = 0; i < numPixels; i++)
+			{
+				if (mask[i] != 0)
+					dest[i] = src[i];
+			}
+		}
+
+		static void CopyMask8Row32(uint8_t *dest, const uint8_t *src, const uint8_t *mask, size_t numPixels)
+		{
+			for (size_t i = 0; i < numPixels; i++)
+			{
+				if (mask[i] != 0)
+					memcpy(dest + i * 4, src + i * 4, 4);
+			}
+		}
+
+		static void CopyMask32Row32(uint8_t *dest, const uint8_t *src, const uint8_t *mask, size_t numPixels)
+		{
+			for (size_t i = 0; i < numPixels; i++)
+			{
+				uint32_t maskPixel;
+				memcpy(&maskPixel, mask + i * 4, 4);
+
+				if (maskPixel != 0xffffffffU)
+					memcpy(dest + i * 4, src + i * 4, 4);
+			}
+		}
+
+		static void BlendGlyphRow8(uint8_t *dest, const uint8_t *coverage, size_t numPixels, const AntiAliasTable *aaTable, uint8_t solidColor)
+		{
+			for (size_t i = 0; i < numPixels; i++)
+			{
+				const uint8_t level = coverage[i];
+				if (level == 15)
+					dest[i] = solidColor;
+				else if (level != 0)
+					dest[i] = aaTable->m_aaTranslate[dest[i]][level];
+			}
+		}
+
+		static void BlendGlyphRow32(uint8_t *dest, const uint8_t *coverage, size_t numPixels, const AntiAliasTable *const *aaTables, const uint8_t *solidRGB)
+		{
+			for (size_t i = 0; i < numPixels; i++)
+			{
+				const uint8_t level = coverage[i];
+				uint8_t *pixel = dest + i * 4;
+
+				if (level == 15)
+				{
+					for (int ch = 0; ch < 3; ch++)
+						pixel[ch] = solidRGB[ch];
+				}
+				else if (level != 0)
+				{
+					for (int ch = 0; ch < 3; ch++)
+						pixel[ch] = aaTables[ch]->m_aaTranslate[pixel[ch]][level];
+				}
+			}
+		}
+	}
+
+#if PL_BLIT_KERNELS_SSE2
+	namespace BlitKernelsSSE2
+	{
+		// transparent lanes are all 1s
+		static inline void BlendStore(uint8_t *dest, __m128i srcPixels, __m128i transparent)
+		{
+			const __m128i destPixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dest));
+			const __m128i blended = _mm_or_si128(_mm_andnot_si128(transparent, srcPixels), _mm_and_si128(transparent, destPixels));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dest), blended);
+		}
+
+		static inline void BlendStore(uint8_t *dest, const uint8_t *src, __m128i transparent)
+		{
+			BlendStore(dest, _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)), transparent);
+		}
+
+		static inline unsigned int LowestSetBit(uint32_t bits)
+		{
+#ifdef _MSC_VER
+			unsigned long index;
+			_BitScanForward(&index, bits);
+			return static_cast<unsigned int>(index);
+#else
+			return static_cast<unsigned int>(__builtin_ctz(bits));
+#endif
+		}
+
+		// Blends 16 pixels.  Solid lanes are written with one masked store, and only partially covered lanes
+		// are looked up in the AA table.
+		static inline void BlendGlyphBlock8(uint8_t *dest, const uint8_t *coverage, const AntiAliasTable *aaTable, __m128i solid)
+		{
+			const __m128i levels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(coverage));
+			const __m128i solidLanes = _mm_cmpeq_epi8(levels, _mm_set1_epi8(15));
+			const uint32_t emptyBits = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(levels, _mm_setzero_si128())));
+			const uint32_t solidBits = static_cast<uint32_t>(_mm_movemask_epi8(solidLanes));
+
+			if (emptyBits == 0xffff)
+				return;
+
+			if (solidBits == 0xffff)
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dest), solid);
+			else if (solidBits != 0)
+				BlendStore(dest, solid, _mm_cmpeq_epi8(solidLanes, _mm_setzero_si128()));
+
+			uint32_t partialBits = ~(emptyBits | solidBits) & 0xffff;
+			while (partialBits)
+			{
+				const unsigned int lane = LowestSetBit(partialBits);
+				dest[lane] = aaTable->m_aaTranslate[dest[lane]][coverage[lane]];
+				partialBits &= partialBits - 1;
+			}
+		}
+
+		// Same as BlendGlyphBlock8 for 16 32-bit pixels.  Solid is the RGB color in every lane with zero alpha.
+		static inline void BlendGlyphBlock32(uint8_t *dest, const uint8_t *coverage, const AntiAliasTable *const *aaTables, __m128i solid)
+		{
+			const __m128i levels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(coverage));
+			const __m128i solidLanes = _mm_cmpeq_epi8(levels, _mm_set1_epi8(15));
+			const uint32_t emptyBits = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(levels, _mm_setzero_si128())));
+			const uint32_t solidBits = static_cast<uint32_t>(_mm_movemask_epi8(solidLanes));
+
+			if (emptyBits == 0xffff)
+				return;
+
+			if (solidBits != 0)
+			{
+				const __m128i rgbMask = _mm_set1_epi32(0x00ffffff);
+				const __m128i solid16Lo = _mm_unpacklo_epi8(solidLanes, solidLanes);
+				const __m128i solid16Hi = _mm_unpackhi_epi8(solidLanes, solidLanes);
+
+				const __m128i solid32[4] =
+				{
+					_mm_unpacklo_epi16(solid16Lo, solid16Lo),
+					_mm_unpackhi_epi16(solid16Lo, solid16Lo),
+					_mm_unpacklo_epi16(solid16Hi, solid16Hi),
+					_mm_unpackhi_epi16(solid16Hi, solid16Hi),
+				};
+
+				// Alpha is preserved, so the alpha byte of every lane counts as transparent
+				for (int block = 0; block < 4; block++)
+					BlendStore(dest + block * 16, solid, _mm_andnot_si128(_mm_and_si128(solid32[block], rgbMask), _mm_set1_epi8(-1)));
+			}
+
+			uint32_t partialBits = ~(emptyBits | solidBits) & 0xffff;
+			while (partialBits)
+			{
+				const unsigned int lane = LowestSetBit(partialBits);
+				const uint8_t level = coverage[lane];
+				uint8_t *pixel = dest + lane * 4;
+
+				for (int ch = 0; ch < 3; ch++)
+					pixel[ch] = aaTables[ch]->m_aaTranslate[pixel[ch]][level];
+
+				partialBits &= partialBits - 1;
+			}
+		}
+
+		static void CopyMask8Row8(uint8_t *dest, const uint8_t *src, const uint8_t *mask, size_t numPixels)
+		{
+			const __m128i zero = _mm_setzero_si128();
+
+			size_t i = 0;
+			for (; i + 16 <= numPixels; i += 16)
+			{
+				const __m128i transparent = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(mask + i)), zero);
+				const int transparentBits = _mm_movemask_epi8(transparent);
+
+				if (transparentBits == 0xffff)
+					continue;
+				else if (transparentBits == 0)
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+				else
+					BlendStore(dest + i, src + i, transparent);
+			}
+
+			BlitKernelsScalar::CopyMask8Row8(dest + i, src + i, mask + i, numPixels - i);
+		}
+
+		static void CopyMask8Row32(uint8_t *dest, const uint8_t *src, const uint8_t *mask, size_t numPixels)
+		{
+			const __m128i zero = _mm_setzero_si128();
+
+			size_t i = 0;
+			for (; i + 16 <= numPixels; i += 16)
+			{
+				const __m128i transparent8 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(mask + i)), zero);
+				const int transparentBits = _mm_movemask_epi8(transparent8);
+
+				if (transparentBits == 0xffff)
+					continue;
+
+				uint8_t *destPixels = dest + i * 4;
+				const uint8_t *srcPixels = src + i * 4;
+
+				if (transparentBits == 0)
+				{
+					for (int block = 0; block < 4; block++)
+						_mm_storeu_si128(reinterpret_cast<__m128i*>(destPixels + block * 16), _mm_loadu_si128(reinterpret_cast<const __m128i*>(srcPixels + block * 16)));
+					continue;
+				}
+
+				const __m128i transparent16Lo = _mm_unpacklo_epi8(transparent8, transparent8);
+				const __m128i transparent16Hi = _mm_unpackhi_epi8(transparent8, transparent8);
+
+				BlendStore(destPixels + 0, srcPixels + 0, _mm_unpacklo_epi16(transparent16Lo, transparent16Lo));
+				BlendStore(destPixels + 16, srcPixels + 16, _mm_unpackhi_epi16(transparent16Lo, transparent16Lo));
+				BlendStore(destPixels + 32, srcPixels + 32, _mm_unpacklo_epi16(transparent16Hi, transparent16Hi));
+				BlendStore(destPixels + 48, srcPixels + 48, _mm_unpackhi_epi16(transparent16Hi, transparent16Hi));
+			}
+
+			BlitKernelsScalar::CopyMask8Row32(dest + i * 4, src + i * 4, mask + i, numPixels - i);
+		}
+
+		static void CopyMask32Row32(uint8_t *dest, const uint8_t *src, const uint8_t *mask, size_t numPixels)
+		{
+			const __m128i white = _mm_set1_epi32(-1);
+
+			size_t i = 0;
+			for (; i + 4 <= numPixels; i += 4)
+			{
+				const __m128i transparent = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(mask + i * 4)), white);
+				const int transparentBits = _mm_movemask_epi8(transparent);
+
+				if (transparentBits == 0xffff)
+					continue;
+				else if (transparentBits == 0)
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i * 4), _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4)));
+				else
+					BlendStore(dest + i * 4, src + i * 4, transparent);
+			}
+
+			BlitKernelsScalar::CopyMask32Row32(dest + i * 4, src + i * 4, mask + i * 4, numPixels - i);
+		}
+
+		static void BlendGlyphRow8(uint8_t *dest, const uint8_t *coverage, size_t numPixels, const AntiAliasTable *aaTable, uint8_t solidColor)
+		{
+			const __m128i solid = _mm_set1_epi8(static_cast<char>(solidColor));
+
+			size_t i = 0;
+			for (; i + 16 <= numPixels; i += 16)
+				BlendGlyphBlock8(dest + i, coverage + i, aaTable, solid);
+
+			// Glyph rows are usually narrower than a block, so the tail goes through a padded copy instead of
+			// falling back to the scalar kernel.  Padding lanes have zero coverage and are never written back.
+			if (i < numPixels)
+			{
+				const size_t numTailPixels = numPixels - i;
+				uint8_t tailCoverage[16] = { 0 };
+				uint8_t tailPixels[16] = { 0 };
+
+				memcpy(tailCoverage, coverage + i, numTailPixels);
+				memcpy(tailPixels, dest + i, numTailPixels);
+				BlendGlyphBlock8(tailPixels, tailCoverage, aaTable, solid);
+				memcpy(dest + i, tailPixels, numTailPixels);
+			}
+		}
+
+		static void BlendGlyphRow32(uint8_t *dest, const uint8_t *coverage, size_t numPixels, const AntiAliasTable *const *aaTables, const uint8_t *solidRGB)
+		{
+			const __m128i solid = _mm_set1_epi32(static_cast<int>(solidRGB[0] | (solidRGB[1] << 8) | (solidRGB[2] << 16)));
+
+			size_t i = 0;
+			for (; i + 16 <= numPixels; i += 16)
+				BlendGlyphBlock32(dest + i * 4, coverage + i, aaTables, solid);
+
+			if (i < numPixels)
+			{
+				const size_t numTailPixels = numPixels - i;
+				uint8_t tailCoverage[16] = { 0 };
+				uint8_t tailPixels[16 * 4] = { 0 };
+
+				memcpy(tailCoverage, coverage + i, numTailPixels);
+				memcpy(tailPixels, dest + i * 4, numTailPixels * 4);
+				BlendGlyphBlock32(tailPixels, tailCoverage, aaTables, solid);
+				memcpy(dest + i * 4, tailPixels, numTailPixels * 4);
+			}
+		}
+	}
+#endif
+
+#if PL_BLIT_KERNELS_AVX2
+	namespace BlitKernelsAVX2
+	{
+		static inline PL_BLIT_KERNELS_AVX2_TARGET void BlendStore(uint8_t *dest, const uint8_t *src, __m256i transparent)
+		{
+			const __m256i srcPixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+			const __m256i destPixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dest));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dest), _mm256_blendv_epi8(srcPixels, destPixels, transparent));
+		}
+
+		static PL_BLIT_KERNELS_AVX2_TARGET void CopyMask8Row8(uint8_t *dest, const uint8_t *src, const uint8_t *mask, size_t numPixels)
+		{
+			const __m256i zero = _mm256_setzero_si256();
+
+			size_t i = 0;
+			for (; i + 32 <= numPixels; i += 32)
+			{
+				const __m256i transparent = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(mask + i)), zero);
+				const uint32_t transparentBits = static_cast<uint32_t>(_mm256_movemask_epi8(transparent));
+
+				if (transparentBits == 0xffffffffU)
+					continue;
+				else if (transparentBits == 0)
+					_mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i)));
+				else
+					BlendStore(dest + i, src + i, transparent);
+			}
+
+			BlitKernelsSSE2::CopyMask8Row8(dest + i, src + i, mask + i, numPixels - i);
+		}
+
+		static PL_BLIT_KERNELS_AVX2_TARGET void CopyMask8Row32(uint8_t *dest, const uint8_t *src, const uint8_t *mask, size_t numPixels)
+		{
+			const __m256i zero = _mm256_setzero_si256();
+
+			size_t i = 0;
+			for (; i + 8 <= numPixels; i += 8)
+			{
+				const __m256i maskPixels = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(mask + i)));
+				const __m256i transparent = _mm256_cmpeq_epi32(maskPixels, zero);
+				const uint32_t transparentBits = static_cast<uint32_t>(_mm256_movemask_epi8(transparent));
+
+				if (transparentBits == 0xffffffffU)
+					continue;
+				else if (transparentBits == 0)
+					_mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i * 4), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4)));
+				else
+					BlendStore(dest + i * 4, src + i * 4, transparent);
+			}
+
+			BlitKernelsSSE2::CopyMask8Row32(dest + i * 4, src + i * 4, mask + i, numPixels - i);
+		}
+
+		static PL_BLIT_KERNELS_AVX2_TARGET void CopyMask32Row32(uint8_t *dest, const uint8_t *src, const uint8_t *mask, size_t numPixels)
+		{
+			const __m256i white = _mm256_set1_epi32(-1);
+
+			size_t i = 0;
+			for (; i + 8 <= numPixels; i += 8)
+			{
+				const __m256i transparent = _mm256_cmpeq_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(mask + i * 4)), white);
+				const uint32_t transparentBits = static_cast<uint32_t>(_mm256_movemask_epi8(transparent));
+
+				if (transparentBits == 0xffffffffU)
+					continue;
+				else if (transparentBits == 0)
+					_mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i * 4), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4)));
+				else
+					BlendStore(dest + i * 4, src + i * 4, transparent);
+			}
+
+			BlitKernelsSSE2::CopyMask32Row32(dest + i * 4, src + i * 4, mask + i * 4, numPixels - i);
+		}
+
+		static PL_BLIT_KERNELS_AVX2_TARGET void BlendGlyphRow8(uint8_t *dest, const uint8_t *coverage, size_t numPixels, const AntiAliasTable *aaTable, uint8_t solidColor)
+		{
+			const __m256i zero = _mm256_setzero_si256();
+			const __m256i full = _mm256_set1_epi8(15);
+			const __m256i solid = _mm256_set1_epi8(static_cast<char>(solidColor));
+
+			size_t i = 0;
+			for (; i + 32 <= numPixels; i += 32)
+			{
+				const __m256i levels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(coverage + i));
+				const __m256i solidLanes = _mm256_cmpeq_epi8(levels, full);
+				const uint32_t emptyBits = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(levels, zero)));
+				const uint32_t solidBits = static_cast<uint32_t>(_mm256_movemask_epi8(solidLanes));
+
+				if (emptyBits == 0xffffffffU)
+					continue;
+
+				uint8_t *destPixels = dest + i;
+				if (solidBits != 0)
+				{
+					const __m256i existing = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(destPixels));
+					_mm256_storeu_si256(reinterpret_cast<__m256i*>(destPixels), _mm256_blendv_epi8(existing, solid, solidLanes));
+				}
+
+				uint32_t partialBits = ~(emptyBits | solidBits);
+				while (partialBits)
+				{
+					const unsigned int lane = BlitKernelsSSE2::LowestSetBit(partialBits);
+					destPixels[lane] = aaTable->m_aaTranslate[destPixels[lane]][coverage[i + lane]];
+					partialBits &= partialBits - 1;
+				}
+			}
+
+			BlitKernelsSSE2::BlendGlyphRow8(dest + i, coverage + i, numPixels - i, aaTable, solidColor);
+		}
+
+		static PL_BLIT_KERNELS_AVX2_TARGET void BlendGlyphRow32(uint8_t *dest, const uint8_t *coverage, size_t numPixels, const AntiAliasTable *const *aaTables, const uint8_t *solidRGB)
+		{
+			const __m256i zero = _mm256_setzero_si256();
+			const __m256i full = _mm256_set1_epi32(15);
+			const __m256i rgbMask = _mm256_set1_epi32(0x00ffffff);
+			const __m256i solid = _mm256_set1_epi32(static_cast<int>(solidRGB[0] | (solidRGB[1] << 8) | (solidRGB[2] << 16)));
+
+			size_t i = 0;
+			for (; i + 8 <= numPixels; i += 8)
+			{
+				const __m256i levels = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(coverage + i)));
+				const __m256i solidLanes = _mm256_cmpeq_epi32(levels, full);
+				const uint32_t emptyBits = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(levels, zero))));
+				const uint32_t solidBits = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(solidLanes)));
+
+				if (emptyBits == 0xff)
+					continue;
+
+				uint8_t *destPixels = dest + i * 4;
+				if (solidBits != 0)
+				{
+					const __m256i existing = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(destPixels));
+					_mm256_storeu_si256(reinterpret_cast<__m256i*>(destPixels), _mm256_blendv_epi8(existing, solid, _mm256_and_si256(solidLanes, rgbMask)));
+				}
+
+				uint32_t partialBits = ~(emptyBits | solidBits) & 0xff;
+				while (partialBits)
+				{
+					const unsigned int lane = BlitKernelsSSE2::LowestSetBit(partialBits);
+					const uint8_t level = coverage[i + lane];
+					uint8_t *pixel = destPixels + lane * 4;
+
+					for (int ch = 0; ch < 3; ch++)
+						pixel[ch] = aaTables[ch]->m_aaTranslate[pixel[ch]][level];
+
+					partialBits &= partialBits - 1;
+				}
+			}
+
+			BlitKernelsSSE2::BlendGlyphRow32(dest + i * 4, coverage + i, numPixels - i, aaTables, solidRGB);
+		}
+
+		static bool IsSupported()
+		{
+#ifdef _MSC_VER
+			int cpuInfo[4];
+			__cpuid(cpuInfo, 0);
+			if (cpuInfo[0] < 7)
+				return false;
+
+			// Check for OSXSAVE and AVX, then that the OS saves YMM state
+			__cpuid(cpuInfo, 1);
+			if ((cpuInfo[2] & (1 << 27)) == 0 || (cpuInfo[2] & (1 << 28)) == 0)
+				return false;
+
+			if ((_xgetbv(0) & 6) != 6)
+				return false;
+
+			__cpuidex(cpuInfo, 7, 0);
+			return (cpuInfo[1] & (1 << 5)) != 0;
+#else
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("avx2") != 0;
+#endif
+		}
+	}
+#endif
+
+#if PL_BLIT_KERNELS_NEON
+	namespace BlitKernelsNEON
+	{
+		static inline bool AnyLaneSet(uint8x16_t lanes)
+		{
+			const uint64x2_t lanes64 = vreinterpretq_u64_u8(lanes);
+			return (vgetq_lane_u64(lanes64, 0) | vgetq_lane_u64(lanes64, 1)) != 0;
+		}
+
+		// Blends 16 pixels.  Solid lanes are written with one select, and only partially covered lanes
+		// are looked up in the AA table.
+		static inline void BlendGlyphBlock8(uint8_t *dest, const uint8_t *coverage, const AntiAliasTable *aaTable, uint8x16_t solid)
+		{
+			const uint8x16_t levels = vld1q_u8(coverage);
+			const uint8x16_t solidLanes = vceqq_u8(levels, vdupq_n_u8(15));
+			const uint8x16_t emptyLanes = vceqq_u8(levels, vdupq_n_u8(0));
+
+			if (!AnyLaneSet(vmvnq_u8(emptyLanes)))
+				return;
+
+			if (AnyLaneSet(solidLanes))
+				vst1q_u8(dest, vbslq_u8(solidLanes, solid, vld1q_u8(dest)));
+
+			if (AnyLaneSet(vmvnq_u8(vorrq_u8(solidLanes, emptyLanes))))
+			{
+				for (int lane = 0; lane < 16; lane++)
+				{
+					const uint8_t level = coverage[lane];
+					if (level != 0 && level != 15)
+						dest[lane] = aaTable->m_aaTranslate[dest[lane]][level];
+				}
+			}
+		}
+
+		// Same as BlendGlyphBlock8 for 16 32-bit pixels.  Solid is the RGB color in every lane with zero alpha.
+		static inline void BlendGlyphBlock32(uint8_t *dest, const uint8_t *coverage, const AntiAliasTable *const *aaTables, uint8x16_t solid)
+		{
+			const uint8x16_t levels = vld1q_u8(coverage);
+			const uint8x16_t solidLanes = vceqq_u8(levels, vdupq_n_u8(15));
+			const uint8x16_t emptyLanes = vceqq_u8(levels, vdupq_n_u8(0));
+
+			if (!AnyLaneSet(vmvnq_u8(emptyLanes)))
+				return;
+
+			if (AnyLaneSet(solidLanes))
+			{
+				const uint8x16_t rgbMask = vreinterpretq_u8_u32(vdupq_n_u32(0x00ffffffU));
+
+				const uint8x16x2_t solid16 = vzipq_u8(solidLanes, solidLanes);
+				const uint16x8x2_t lo32 = vzipq_u16(vreinterpretq_u16_u8(solid16.val[0]), vreinterpretq_u16_u8(solid16.val[0]));
+				const uint16x8x2_t hi32 = vzipq_u16(vreinterpretq_u16_u8(solid16.val[1]), vreinterpretq_u16_u8(solid16.val[1]));
+
+				const uint8x16_t solid32[4] =
+				{
+					vreinterpretq_u8_u16(lo32.val[0]),
+					vreinterpretq_u8_u16(lo32.val[1]),
+					vreinterpretq_u8_u16(hi32.val[0]),
+					vreinterpretq_u8_u16(hi32.val[1]),
+				};
+
+				for (int block = 0; block < 4; block++)
+				{
+					uint8_t *destPixels = dest + block * 16;
+					vst1q_u8(destPixels, vbslq_u8(vandq_u8(solid32[block], rgbMask), solid, vld1q_u8(destPixels)));
+				}
+			}
+
+			if (AnyLaneSet(vmvnq_u8(vorrq_u8(solidLanes, emptyLanes))))
+			{
+				for (int lane = 0; lane < 16; lane++)
+				{
+					const uint8_t level = coverage[lane];
+					if (level != 0 && level != 15)
+					{
+						uint8_t *pixel = dest + lane * 4;
+						for (int ch = 0; ch < 3; ch++)
+							pixel[ch] = aaTables[ch]->m_aaTranslate[pixel[ch]][level];
+					}
+				}
+			}
+		}
+
+		static void BlendGlyphRow8(uint8_t *dest, const uint8_t *coverage, size_t numPixels, const AntiAliasTable *aaTable, uint8_t solidColor)
+		{
+			const uint8x16_t solid = vdupq_n_u8(solidColor);
+
+			size_t i = 0;
+			for (; i + 16 <= numPixels; i += 16)
+				BlendGlyphBlock8(dest + i, coverage + i, aaTable, solid);
+
+			// Padded tail, see BlitKernelsSSE2::BlendGlyphRow8
+			if (i < numPixels)
+			{
+				const size_t numTailPixels = numPixels - i;
+				uint8_t tailCoverage[16] = { 0 };
+				uint8_t tailPixels[16] = { 0 };
+
+				memcpy(tailCoverage, coverage + i, numTailPixels);
+				memcpy(tailPixels, dest + i, numTailPixels);
+				BlendGlyphBlock8(tailPixels, tailCoverage, aaTable, solid);
+				memcpy(dest + i, tailPixels, numTailPixels);
+			}
+		}
+
+		static void BlendGlyphRow32(uint8_t *dest, const uint8_t *coverage, size_t numPixels, const AntiAliasTable *const *aaTables, const uint8_t *solidRGB)
+		{
+			const uint8x16_t solid = vreinterpretq_u8_u32(vdupq_n_u32(solidRGB[0] | (solidRGB[1] << 8) | (solidRGB[2] << 16)));
+
+			size_t i = 0;
+			for (; i + 16 <= numPixels; i += 16)
+				BlendGlyphBlock32(dest + i * 4, coverage + i, aaTables, solid);
+
+			if (i < numPixels)
+			{
+				const size_t numTailPixels = numPixels - i;
+				uint8_t tailCoverage[16] = { 0 };
+				uint8_t tailPixels[16 * 4] = { 0 };
+
+				memcpy(tailCoverage, coverage + i, numTailPixels);
+				memcpy(tailPixels, dest + i * 4, numTailPixels * 4);
+				BlendGlyphBlock32(tailPixels, tailCoverage, aaTables, solid);
+				memcpy(dest + i * 4, tailPixels, numTailPixels * 4);
+			}
+		}
+
+		static void CopyMask8Row8(uint8_t *dest, const uint8_t *src, const uint8_t *mask, size_t numPixels)
+		{
+			size_t i = 0;
+			for (; i + 16 <= numPixels; i += 16)
+			{
+				const uint8x16_t transparent = vceqq_u8(vld1q_u8(mask + i), vdupq_n_u8(0));
+				vst1q_u8(dest + i, vbslq_u8(transparent, vld1q_u8(dest + i), vld1q_u8(src + i)));
+			}
+
+			BlitKernelsScalar::CopyMask8Row8(dest + i, src + i, mask + i, numPixels - i);
+		}
+
+		static void CopyMask8Row32(uint8_t *dest, const uint8_t *src, const uint8_t *mask, size_t numPixels)
+		{
+			size_t i = 0;
+			for (; i + 16 <= numPixels; i += 16)
+			{
+				const uint8x16_t transparent8 = vceqq_u8(vld1q_u8(mask + i), vdupq_n_u8(0));
+
+				// Widen the byte mask to 32-bit lanes by zipping it with itself twice
+				const uint8x16x2_t transparent16 = vzipq_u8(transparent8, transparent8);
+				const uint16x8x2_t lo32 = vzipq_u16(vreinterpretq_u16_u8(transparent16.val[0]), vreinterpretq_u16_u8(transparent16.val[0]));
+				const uint16x8x2_t hi32 = vzipq_u16(vreinterpretq_u16_u8(transparent16.val[1]), vreinterpretq_u16_u8(transparent16.val[1]));
+
+				const uint8x16_t transparent32[4] =
+				{
+					vreinterpretq_u8_u16(lo32.val[0]),
+					vreinterpretq_u8_u16(lo32.val[1]),
+					vreinterpretq_u8_u16(hi32.val[0]),
+					vreinterpretq_u8_u16(hi32.val[1]),
+				};
+
+				for (int block = 0; block < 4; block++)
+				{
+					uint8_t *destPixels = dest + i * 4 + block * 16;
+					const uint8_t *srcPixels = src + i * 4 + block * 16;
+					vst1q_u8(destPixels, vbslq_u8(transparent32[block], vld1q_u8(destPixels), vld1q_u8(srcPixels)));
+				}
+			}
+
+			BlitKernelsScalar::CopyMask8Row32(dest + i * 4, src + i * 4, mask + i, numPixels - i);
+		}
+
+		static void CopyMask32Row32(uint8_t *dest, const uint8_t *src, const uint8_t *mask, size_t numPixels)
+		{
+			size_t i = 0;
+			for (; i + 4 <= numPixels; i += 4)
+			{
+				const uint32x4_t transparent = vceqq_u32(vreinterpretq_u32_u8(vld1q_u8(mask + i * 4)), vdupq_n_u32(0xffffffffU));
+				vst1q_u8(dest + i * 4, vbslq_u8(vreinterpretq_u8_u32(transparent), vld1q_u8(dest + i * 4), vld1q_u8(src + i * 4)));
+			}
+
+			BlitKernelsScalar::CopyMask32Row32(dest + i * 4, src + i * 4, mask + i * 4, numPixels - i);
+		}
+	}
+#endif
+
+	struct BlitKernelVariants
+	{
+		static const size_t kMaxVariants = 4;
+
+		BlitKernelVariants();
+
+		BlitKernels m_variants[kMaxVariants];
+		size_t m_numVariants;
+	};
+
+	BlitKernelVariants::BlitKernelVariants()
+		: m_numVariants(0)
+	{
+		BlitKernels *kernels = m_variants;
+
+		kernels->m_copyMask8Row8 = BlitKernelsScalar::CopyMask8Row8;
+		kernels->m_copyMask8Row32 = BlitKernelsScalar::CopyMask8Row32;
+		kernels->m_copyMask32Row32 = BlitKernelsScalar::CopyMask32Row32;
+		kernels->m_blendGlyphRow8 = BlitKernelsScalar::BlendGlyphRow8;
+		kernels->m_blendGlyphRow32 = BlitKernelsScalar::BlendGlyphRow32;
+		kernels->m_name = "Scalar";
+		kernels++;
+
+#if PL_BLIT_KERNELS_SSE2
+		kernels->m_copyMask8Row8 = BlitKernelsSSE2::CopyMask8Row8;
+		kernels->m_copyMask8Row32 = BlitKernelsSSE2::CopyMask8Row32;
+		kernels->m_copyMask32Row32 = BlitKernelsSSE2::CopyMask32Row32;
+		kernels->m_blendGlyphRow8 = BlitKernelsSSE2::BlendGlyphRow8;
+		kernels->m_blendGlyphRow32 = BlitKernelsSSE2::BlendGlyphRow32;
+		kernels->m_name = "SSE2";
+		kernels++;
+#endif
+
+#if PL_BLIT_KERNELS_AVX2
+		if (BlitKernelsAVX2::IsSupported())
+		{
+			kernels->m_copyMask8Row8 = BlitKernelsAVX2::CopyMask8Row8;
+			kernels->m_copyMask8Row32 = BlitKernelsAVX2::CopyMask8Row32;
+			kernels->m_copyMask32Row32 = BlitKernelsAVX2::CopyMask32Row32;
+			kernels->m_blendGlyphRow8 = BlitKernelsAVX2::BlendGlyphRow8;
+			kernels->m_blendGlyphRow32 = BlitKernelsAVX2::BlendGlyphRow32;
+			kernels->m_name = "AVX2";
+			kernels++;
+		}
+#endif
+
+#if PL_BLIT_KERNELS_NEON
+		kernels->m_copyMask8Row8 = BlitKernelsNEON::CopyMask8Row8;
+		kernels->m_copyMask8Row32 = BlitKernelsNEON::CopyMask8Row32;
+		kernels->m_copyMask32Row32 = BlitKernelsNEON::CopyMask32Row32;
+		kernels->m_blendGlyphRow8 = BlitKernelsNEON::BlendGlyphRow8;
+		kernels->m_blendGlyphRow32 = BlitKernelsNEON::BlendGlyphRow32;
+		kernels->m_name = "NEON";
+		kernels++;
+#endif
+
+		m_numVariants = static_cast<size_t>(kernels - m_variants);
+	}
+
+	static const BlitKernelVariants &GetBlitKernelVariants()
+	{
+		static BlitKernelVariants variants;
+		return variants;
+	}
+
+	// The last variant is the fastest one available
+	static const BlitKernels *ResolveBlitKernels()
+	{
+		const BlitKernelVariants &variants = GetBlitKernelVariants();
+		const BlitKernels *kernels = &variants.m_variants[variants.m_numVariants - 1];
+
+		if (IGpLogDriver *logger = PLDrivers::GetLogDriver())
+			logger->Printf(IGpLogDriver::Category_Information, "Using %s blit kernels", kernels->m_name);
+
+		return kernels;
+	}
+
+	const BlitKernels *BlitKernels::GetInstance()
+	{
+		static const BlitKernels *kernels = ResolveBlitKernels();
+		return kernels;
+	}
+
+	size_t BlitKernels::GetNumVariants()
+	{
+		return GetBlitKernelVariants().m_numVariants;
+	}
+
+	const BlitKernels *BlitKernels::GetVariant(size_t index)
+	{
+		const BlitKernelVariants &variants = GetBlitKernelVariants();
+		if (index >= variants.m_numVariants)
+			return nullptr;
+
+		return &variants.m_variants[index];
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace PortabilityLayer
+{
+	struct AntiAliasTable;
+
+	// Row kernels for masked blits.  Pixels are copied from src to dest where the mask is opaque.
+	// All pointers may be unaligned.
+	//
+	// Glyph kernels blend a row of coverage levels (one byte per pixel, 0..15) into dest.  Level 0 leaves the
+	// pixel alone, level 15 writes the solid color, and other levels go through the AA table(s), which may be
+	// null if the row only contains levels 0 and 15.
+	struct BlitKernels
+	{
+		typedef void (*MaskedRowFunc_t)(uint8_t *dest, const uint8_t *src, const uint8_t *mask, size_t numPixels);
+		typedef void (*GlyphRow8Func_t)(uint8_t *dest, const uint8_t *coverage, size_t numPixels, const AntiAliasTable *aaTable, uint8_t solidColor);
+		typedef void (*GlyphRow32Func_t)(uint8_t *dest, const uint8_t *coverage, size_t numPixels, const AntiAliasTable *const *aaTables, const uint8_t *solidRGB);
+
+		// 8-bit pixels, 8-bit mask, zero is transparent
+		MaskedRowFunc_t m_copyMask8Row8;
+
+		// 32-bit pixels, 8-bit mask, zero is transparent
+		MaskedRowFunc_t m_copyMask8Row32;
+
+		// 32-bit pixels, 32-bit mask, white (0xffffffff) is transparent
+		MaskedRowFunc_t m_copyMask32Row32;
+
+		// 8-bit pixels, one palette AA table
+		GlyphRow8Func_t m_blendGlyphRow8;
+
+		// 32-bit pixels, one AA table per color channel.  Alpha is left untouched.
+		GlyphRow32Func_t m_blendGlyphRow32;
+
+		const char *m_name;
+
+		// Selected once on first use based on CPU features
+		static const BlitKernels *GetInstance();
+
+		// Every kernel set this CPU can run, starting with the scalar reference, so they can be checked and
+		// timed against each other
+		static size_t GetNumVariants();
+		static const BlitKernels *GetVariant(size_t index);
+	};
+}
@@ -58,6 +58,11 @@ bool PortabilityLayer::CompositeRenderedFont::IsAntiAliased() const
 	return m_font->IsAntiAliased();
 }
 
+bool PortabilityLayer::CompositeRenderedFont::CanCacheTextRuns() const
+{
+	return false;
+}
+
 void PortabilityLayer::CompositeRenderedFont::Destroy()
 {
 	assert(false);
@@ -14,6 +14,7 @@ namespace PortabilityLayer
 		const GpRenderedFontMetrics &GetMetrics() const override;
 		size_t MeasureString(const uint8_t *chars, size_t len) const override;
 		bool IsAntiAliased() const override;
+		bool CanCacheTextRuns() const override;
 
 		void Destroy() override;
 
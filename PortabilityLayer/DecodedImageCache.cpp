@@ -0,0 +1,631 @@
+#include "DecodedImageCache.h"
+
+#include "BitmapImage.h"
+#include "MemoryManager.h"
+#include "MMHandleBlock.h"
+#include "QDGraf.h"
+#include "QDManager.h"
+#include "QDPixMap.h"
+#include "ResourceManager.h"
+#include "ResTypeID.h"
+#include "WorkerSlots.h"
+
+#include "PLDrivers.h"
+#include "PLQDraw.h"
+
+#include <assert.h>
+#include <new>
+
+namespace PortabilityLayer
+{
+	class DecodedImageCacheImpl final : public DecodedImageCache
+	{
+	public:
+		DecodedImageCacheImpl();
+
+		void Init() override;
+		void Shutdown() override;
+
+		DrawSurface *GetPicture(IResourceArchive *archive, const ResTypeID &resTypeID, int16_t resID, GpPixelFormat_t pixelFormat) override;
+		bool Prefetch(IResourceArchive *archive, const ResTypeID &resTypeID, int16_t resID, GpPixelFormat_t pixelFormat) override;
+		void DrawPicture(DrawSurface *surface, DrawSurface *picture, const Rect &bounds) override;
+
+		void PurgeArchive(const IResourceArchive *archive) override;
+		void PurgeAll() override;
+
+		void SetByteBudget(size_t byteBudget) override;
+		void GetStats(DecodedImageCacheStats &outStats) const override;
+
+		static DecodedImageCacheImpl *GetInstance();
+
+	private:
+		struct Entry
+		{
+			const IResourceArchive *m_archive;
+			ResTypeID m_resTypeID;
+			int16_t m_resID;
+			GpPixelFormat_t m_pixelFormat;
+
+			DrawSurface *m_surface;
+			size_t m_size;
+
+			Entry *m_nextInBucket;
+			Entry *m_lruPrev;	// More recently used
+			Entry *m_lruNext;	// Less recently used
+		};
+
+		// Owned by whoever owns its slot in m_prefetchSlots
+		struct PrefetchJob
+		{
+			const IResourceArchive *m_archive;
+			ResTypeID m_resTypeID;
+			int16_t m_resID;
+			GpPixelFormat_t m_pixelFormat;
+
+			void *m_storedData;
+			size_t m_storedSize;
+			size_t m_size;
+			bool m_isDeflated;
+
+			DrawSurface *m_surface;
+		};
+
+		static const size_t kNumBuckets = 64;
+		static const size_t kDefaultByteBudget = 8 * 1024 * 1024;
+		static const size_t kMaxPrefetchJobs = 16;
+
+		static size_t HashKey(const IResourceArchive *archive, const ResTypeID &resTypeID, int16_t resID, GpPixelFormat_t pixelFormat);
+
+		Entry *FindEntry(const IResourceArchive *archive, const ResTypeID &resTypeID, int16_t resID, GpPixelFormat_t pixelFormat) const;
+		Entry *InsertEntry(const IResourceArchive *archive, const ResTypeID &resTypeID, int16_t resID, GpPixelFormat_t pixelFormat, DrawSurface *surface);
+
+		DrawSurface *DecodePicture(IResourceArchive *archive, const ResTypeID &resTypeID, int16_t resID, GpPixelFormat_t pixelFormat) const;
+		static DrawSurface *DecodePictureHandle(THandle<BitmapImage> pictHdl, GpPixelFormat_t pixelFormat);
+
+		bool StartPrefetching();
+		size_t FindPrefetchJob(const IResourceArchive *archive, const ResTypeID &resTypeID, int16_t resID, GpPixelFormat_t pixelFormat) const;
+		void ReleasePrefetchJob(size_t jobIndex);
+		DrawSurface *AdoptPrefetch(const IResourceArchive *archive, const ResTypeID &resTypeID, int16_t resID, GpPixelFormat_t pixelFormat);
+		void CollectPrefetches();
+		void DiscardPrefetches(const IResourceArchive *archive);
+
+		static void StaticDecodePrefetchJob(void *context, size_t jobIndex);
+		static void DecodePrefetchJob(PrefetchJob &job);
+
+		void LinkMostRecent(Entry *entry);
+		void UnlinkLRU(Entry *entry);
+		void RemoveEntry(Entry *entry);
+		void EnforceBudget(const Entry *keepEntry);
+
+		Entry *m_buckets[kNumBuckets];
+		Entry *m_lruFirst;
+		Entry *m_lruLast;
+
+		size_t m_byteBudget;
+		size_t m_bytesUsed;
+		size_t m_numEntries;
+		size_t m_numHits;
+		size_t m_numMisses;
+		size_t m_numEvictions;
+		size_t m_numPrefetches;
+		size_t m_numPrefetchHits;
+
+		PrefetchJob m_prefetchJobs[kMaxPrefetchJobs];
+		WorkerSlots *m_prefetchSlots;	// Slot i is the state of m_prefetchJobs[i]
+		bool m_prefetchUnavailable;
+
+		static DecodedImageCacheImpl ms_instance;
+	};
+
+	DecodedImageCacheImpl::DecodedImageCacheImpl()
+		: m_lruFirst(nullptr)
+		, m_lruLast(nullptr)
+		, m_byteBudget(kDefaultByteBudget)
+		, m_bytesUsed(0)
+		, m_numEntries(0)
+		, m_numHits(0)
+		, m_numMisses(0)
+		, m_numEvictions(0)
+		, m_numPrefetches(0)
+		, m_numPrefetchHits(0)
+		, m_prefetchSlots(nullptr)
+		, m_prefetchUnavailable(false)
+	{
+		for (size_t i = 0; i < kNumBuckets; i++)
+			m_buckets[i] = nullptr;
+
+		for (size_t i = 0; i < kMaxPrefetchJobs; i++)
+		{
+			m_prefetchJobs[i].m_storedData = nullptr;
+			m_prefetchJobs[i].m_surface = nullptr;
+		}
+	}
+
+	void DecodedImageCacheImpl::Init()
+	{
+	}
+
+	void DecodedImageCacheImpl::Shutdown()
+	{
+		PurgeAll();
+
+		if (m_prefetchSlots)
+		{
+			m_prefetchSlots->Destroy();
+			m_prefetchSlots = nullptr;
+		}
+	}
+
+	DrawSurface *DecodedImageCacheImpl::GetPicture(IResourceArchive *archive, const ResTypeID &resTypeID, int16_t resID, GpPixelFormat_t pixelFormat)
+	{
+		if (!archive)
+			return nullptr;
+
+		Entry *entry = FindEntry(archive, resTypeID, resID, pixelFormat);
+		if (entry)
+		{
+			m_numHits++;
+
+			UnlinkLRU(entry);
+			LinkMostRecent(entry);
+
+			return entry->m_surface;
+		}
+
+		DrawSurface *surface = AdoptPrefetch(archive, resTypeID, resID, pixelFormat);
+		if (surface)
+			m_numPrefetchHits++;
+		else
+		{
+			surface = DecodePicture(archive, resTypeID, resID, pixelFormat);
+			if (!surface)
+				return nullptr;
+
+			m_numMisses++;
+		}
+
+		if (!InsertEntry(archive, resTypeID, resID, pixelFormat, surface))
+		{
+			QDManager::GetInstance()->DisposeGWorld(surface);
+			return nullptr;
+		}
+
+		return surface;
+	}
+
+	bool DecodedImageCacheImpl::Prefetch(IResourceArchive *archive, const ResTypeID &resTypeID, int16_t resID, GpPixelFormat_t pixelFormat)
+	{
+		if (!archive)
+			return false;
+
+		if (!StartPrefetching())
+			return true;
+
+		CollectPrefetches();
+
+		if (FindEntry(archive, resTypeID, resID, pixelFormat))
+			return true;
+
+		m_prefetchSlots->Lock();
+		const bool isPending = (FindPrefetchJob(archive, resTypeID, resID, pixelFormat) != kMaxPrefetchJobs);
+		const size_t freeJobIndex = m_prefetchSlots->FindFreeSlot();
+		m_prefetchSlots->Unlock();
+
+		if (isPending || freeJobIndex == kMaxPrefetchJobs)
+			return true;
+
+		// The stored data is read here, since archives can only be accessed from the main thread
+		void *storedData = nullptr;
+		size_t storedSize = 0;
+		size_t size = 0;
+		bool isDeflated = false;
+		if (!archive->LoadStoredResource(resTypeID, resID, storedData, storedSize, size, isDeflated))
+			return false;
+
+		m_numPrefetches++;
+
+		PrefetchJob &job = m_prefetchJobs[freeJobIndex];
+		job.m_archive = archive;
+		job.m_resTypeID = resTypeID;
+		job.m_resID = resID;
+		job.m_pixelFormat = pixelFormat;
+		job.m_storedData = storedData;
+		job.m_storedSize = storedSize;
+		job.m_size = size;
+		job.m_isDeflated = isDeflated;
+		job.m_surface = nullptr;
+
+		m_prefetchSlots->QueueSlot(freeJobIndex);
+
+		return true;
+	}
+
+	DecodedImageCacheImpl::Entry *DecodedImageCacheImpl::FindEntry(const IResourceArchive *archive, const ResTypeID &resTypeID, int16_t resID, GpPixelFormat_t pixelFormat) const
+	{
+		const size_t bucket = HashKey(archive, resTypeID, resID, pixelFormat) % kNumBuckets;
+
+		for (Entry *entry = m_buckets[bucket]; entry; entry = entry->m_nextInBucket)
+		{
+			if (entry->m_archive == archive && entry->m_resTypeID == resTypeID && entry->m_resID == resID && entry->m_pixelFormat == pixelFormat)
+				return entry;
+		}
+
+		return nullptr;
+	}
+
+	DecodedImageCacheImpl::Entry *DecodedImageCacheImpl::InsertEntry(const IResourceArchive *archive, const ResTypeID &resTypeID, int16_t resID, GpPixelFormat_t pixelFormat, DrawSurface *surface)
+	{
+		const size_t bucket = HashKey(archive, resTypeID, resID, pixelFormat) % kNumBuckets;
+
+		void *storage = MemoryManager::GetInstance()->Alloc(sizeof(Entry));
+		if (!storage)
+			return nullptr;
+
+		const PixMapImpl *pixMap = static_cast<const PixMapImpl*>(*surface->m_port.GetPixMap());
+
+		Entry *entry = new (storage) Entry();
+		entry->m_archive = archive;
+		entry->m_resTypeID = resTypeID;
+		entry->m_resID = resID;
+		entry->m_pixelFormat = pixelFormat;
+		entry->m_surface = surface;
+		entry->m_size = pixMap->GetPitch() * static_cast<size_t>(pixMap->m_rect.Height());
+		entry->m_nextInBucket = m_buckets[bucket];
+		m_buckets[bucket] = entry;
+
+		LinkMostRecent(entry);
+
+		m_bytesUsed += entry->m_size;
+		m_numEntries++;
+
+		// The new entry is always kept, even if it exceeds the budget by itself, since the caller is about to use it
+		EnforceBudget(entry);
+
+		return entry;
+	}
+
+	void DecodedImageCacheImpl::DrawPicture(DrawSurface *surface, DrawSurface *picture, const Rect &bounds)
+	{
+		if (!bounds.IsValid() || bounds.Width() == 0 || bounds.Height() == 0)
+			return;
+
+		PixMapImpl *srcPixMap = static_cast<PixMapImpl*>(*picture->m_port.GetPixMap());
+		const Rect srcRect = srcPixMap->m_rect;
+
+		if (srcRect.Width() == bounds.Width() && srcRect.Height() == bounds.Height())
+			CopyBits(srcPixMap, *surface->m_port.GetPixMap(), &srcRect, &bounds, srcCopy);
+		else
+		{
+			THandle<PixMapImpl> scaled = srcPixMap->ScaleTo(bounds.Width(), bounds.Height());
+			if (!scaled)
+				return;
+
+			CopyBits(*scaled, *surface->m_port.GetPixMap(), &(*scaled)->m_rect, &bounds, srcCopy);
+			PixMapImpl::Destroy(scaled);
+		}
+
+		surface->m_port.SetDirtyRect(bounds);
+	}
+
+	void DecodedImageCacheImpl::PurgeArchive(const IResourceArchive *archive)
+	{
+		// Archives may be reallocated at the same address, so prefetches for this one can't be kept either
+		DiscardPrefetches(archive);
+
+		Entry *entry = m_lruFirst;
+		while (entry)
+		{
+			Entry *nextEntry = entry->m_lruNext;
+			if (entry->m_archive == archive)
+				RemoveEntry(entry);
+
+			entry = nextEntry;
+		}
+	}
+
+	void DecodedImageCacheImpl::PurgeAll()
+	{
+		DiscardPrefetches(nullptr);
+
+		while (m_lruFirst)
+			RemoveEntry(m_lruFirst);
+	}
+
+	void DecodedImageCacheImpl::SetByteBudget(size_t byteBudget)
+	{
+		m_byteBudget = byteBudget;
+		EnforceBudget(nullptr);
+	}
+
+	void DecodedImageCacheImpl::GetStats(DecodedImageCacheStats &outStats) const
+	{
+		outStats.m_numHits = m_numHits;
+		outStats.m_numMisses = m_numMisses;
+		outStats.m_numEvictions = m_numEvictions;
+		outStats.m_numEntries = m_numEntries;
+		outStats.m_bytesUsed = m_bytesUsed;
+		outStats.m_byteBudget = m_byteBudget;
+		outStats.m_numPrefetches = m_numPrefetches;
+		outStats.m_numPrefetchHits = m_numPrefetchHits;
+	}
+
+	size_t DecodedImageCacheImpl::HashKey(const IResourceArchive *archive, const ResTypeID &resTypeID, int16_t resID, GpPixelFormat_t pixelFormat)
+	{
+		size_t hash = reinterpret_cast<uintptr_t>(archive) / sizeof(void*);
+		hash = hash * 31 + static_cast<uint32_t>(resTypeID.ExportAsInt32());
+		hash = hash * 31 + static_cast<uint16_t>(resID);
+		hash = hash * 31 + static_cast<size_t>(pixelFormat);
+
+		return hash;
+	}
+
+	DrawSurface *DecodedImageCacheImpl::DecodePicture(IResourceArchive *archive, const ResTypeID &resTypeID, int16_t resID, GpPixelFormat_t pixelFormat) const
+	{
+		// Uncompressed pictures in mapped archives are decoded in place, through a temporary handle that isn't owned by the memory manager
+		const void *mappedContents = nullptr;
+		size_t mappedSize = 0;
+		if (archive->MapResource(resTypeID, resID, mappedContents, mappedSize))
+		{
+			MMHandleBlock mappedBlock(const_cast<void*>(mappedContents), mappedSize);
+			return DecodePictureHandle(THandle<BitmapImage>(&mappedBlock), pixelFormat);
+		}
+
+		THandle<BitmapImage> pictHdl = archive->LoadResource(resTypeID, resID).StaticCast<BitmapImage>();
+		if (!pictHdl)
+			return nullptr;
+
+		DrawSurface *surface = DecodePictureHandle(pictHdl, pixelFormat);
+		pictHdl.Dispose();
+
+		return surface;
+	}
+
+	DrawSurface *DecodedImageCacheImpl::DecodePictureHandle(THandle<BitmapImage> pictHdl, GpPixelFormat_t pixelFormat)
+	{
+		if (pictHdl.MMBlock()->m_size < sizeof(BitmapImage))
+			return nullptr;
+
+		const Rect picRect = (*pictHdl)->GetRect();
+		const Rect decodedRect = Rect::Create(0, 0, picRect.Height(), picRect.Width());
+
+		DrawSurface *surface = nullptr;
+		if (!decodedRect.IsValid() || decodedRect.Width() == 0 || decodedRect.Height() == 0 || QDManager::GetInstance()->NewGWorld(&surface, pixelFormat, decodedRect) != PLErrors::kNone)
+			return nullptr;
+
+		surface->DrawPicture(pictHdl, decodedRect);
+
+		return surface;
+	}
+
+	bool DecodedImageCacheImpl::StartPrefetching()
+	{
+		if (m_prefetchSlots)
+			return true;
+
+		if (m_prefetchUnavailable)
+			return false;
+
+		m_prefetchSlots = WorkerSlots::Create(kMaxPrefetchJobs, StaticDecodePrefetchJob, this);
+
+		if (!m_prefetchSlots || !m_prefetchSlots->HasWorker())
+		{
+			// Platforms without threads just decode everything on demand
+			if (m_prefetchSlots)
+				m_prefetchSlots->Destroy();
+
+			m_prefetchSlots = nullptr;
+			m_prefetchUnavailable = true;
+			return false;
+		}
+
+		return true;
+	}
+
+	size_t DecodedImageCacheImpl::FindPrefetchJob(const IResourceArchive *archive, const ResTypeID &resTypeID, int16_t resID, GpPixelFormat_t pixelFormat) const
+	{
+		// Called with the prefetch slots locked
+		for (size_t i = 0; i < kMaxPrefetchJobs; i++)
+		{
+			const PrefetchJob &job = m_prefetchJobs[i];
+			if (m_prefetchSlots->GetState(i) != WorkerSlotStates::kFree && job.m_archive == archive && job.m_resTypeID == resTypeID && job.m_resID == resID && job.m_pixelFormat == pixelFormat)
+				return i;
+		}
+
+		return kMaxPrefetchJobs;
+	}
+
+	void DecodedImageCacheImpl::ReleasePrefetchJob(size_t jobIndex)
+	{
+		// Called with the prefetch slots locked
+		PrefetchJob &job = m_prefetchJobs[jobIndex];
+
+		if (job.m_storedData)
+		{
+			MemoryManager::GetInstance()->Release(job.m_storedData);
+			job.m_storedData = nullptr;
+		}
+
+		if (job.m_surface)
+		{
+			QDManager::GetInstance()->DisposeGWorld(job.m_surface);
+			job.m_surface = nullptr;
+		}
+
+		m_prefetchSlots->SetState(jobIndex, WorkerSlotStates::kFree);
+	}
+
+	DrawSurface *DecodedImageCacheImpl::AdoptPrefetch(const IResourceArchive *archive, const ResTypeID &resTypeID, int16_t resID, GpPixelFormat_t pixelFormat)
+	{
+		if (!m_prefetchSlots)
+			return nullptr;
+
+		DrawSurface *surface = nullptr;
+
+		m_prefetchSlots->Lock();
+
+		const size_t jobIndex = FindPrefetchJob(archive, resTypeID, resID, pixelFormat);
+		if (jobIndex != kMaxPrefetchJobs)
+		{
+			// A job that hasn't started yet is cancelled, since decoding it here is no slower than waiting for it
+			m_prefetchSlots->WaitForSlot(jobIndex);
+
+			if (m_prefetchSlots->GetState(jobIndex) == WorkerSlotStates::kDone)
+			{
+				surface = m_prefetchJobs[jobIndex].m_surface;
+				m_prefetchJobs[jobIndex].m_surface = nullptr;
+			}
+
+			ReleasePrefetchJob(jobIndex);
+		}
+
+		m_prefetchSlots->Unlock();
+
+		return surface;
+	}
+
+	void DecodedImageCacheImpl::CollectPrefetches()
+	{
+		for (size_t i = 0; i < kMaxPrefetchJobs; i++)
+		{
+			PrefetchJob &job = m_prefetchJobs[i];
+
+			m_prefetchSlots->Lock();
+			const bool isDone = (m_prefetchSlots->GetState(i) == WorkerSlotStates::kDone);
+			m_prefetchSlots->Unlock();
+
+			if (!isDone)
+				continue;
+
+			if (job.m_surface && !FindEntry(job.m_archive, job.m_resTypeID, job.m_resID, job.m_pixelFormat))
+			{
+				if (InsertEntry(job.m_archive, job.m_resTypeID, job.m_resID, job.m_pixelFormat, job.m_surface))
+					job.m_surface = nullptr;
+			}
+
+			m_prefetchSlots->Lock();
+			ReleasePrefetchJob(i);
+			m_prefetchSlots->Unlock();
+		}
+	}
+
+	void DecodedImageCacheImpl::DiscardPrefetches(const IResourceArchive *archive)
+	{
+		if (!m_prefetchSlots)
+			return;
+
+		m_prefetchSlots->Lock();
+
+		for (size_t i = 0; i < kMaxPrefetchJobs; i++)
+		{
+			if (m_prefetchSlots->GetState(i) != WorkerSlotStates::kFree && (archive == nullptr || m_prefetchJobs[i].m_archive == archive))
+			{
+				m_prefetchSlots->WaitForSlot(i);
+				ReleasePrefetchJob(i);
+			}
+		}
+
+		m_prefetchSlots->Unlock();
+	}
+
+	void DecodedImageCacheImpl::StaticDecodePrefetchJob(void *context, size_t jobIndex)
+	{
+		DecodePrefetchJob(static_cast<DecodedImageCacheImpl*>(context)->m_prefetchJobs[jobIndex]);
+	}
+
+	void DecodedImageCacheImpl::DecodePrefetchJob(PrefetchJob &job)
+	{
+		MemoryManager *mm = MemoryManager::GetInstance();
+
+		DrawSurface *surface = nullptr;
+
+		void *contents = mm->Alloc(job.m_size);
+		if (contents)
+		{
+			if (ResourceArchiveBase::DecodeStoredResource(job.m_resTypeID, job.m_storedData, job.m_storedSize, job.m_isDeflated, contents, job.m_size))
+			{
+				MMHandleBlock pictBlock(contents, job.m_size);
+				surface = DecodePictureHandle(THandle<BitmapImage>(&pictBlock), job.m_pixelFormat);
+			}
+
+			mm->Release(contents);
+		}
+
+		mm->Release(job.m_storedData);
+
+		job.m_storedData = nullptr;
+		job.m_surface = surface;
+	}
+
+	void DecodedImageCacheImpl::LinkMostRecent(Entry *entry)
+	{
+		entry->m_lruPrev = nullptr;
+		entry->m_lruNext = m_lruFirst;
+
+		if (m_lruFirst)
+			m_lruFirst->m_lruPrev = entry;
+		else
+			m_lruLast = entry;
+
+		m_lruFirst = entry;
+	}
+
+	void DecodedImageCacheImpl::UnlinkLRU(Entry *entry)
+	{
+		if (entry->m_lruPrev)
+			entry->m_lruPrev->m_lruNext = entry->m_lruNext;
+		else
+			m_lruFirst = entry->m_lruNext;
+
+		if (entry->m_lruNext)
+			entry->m_lruNext->m_lruPrev = entry->m_lruPrev;
+		else
+			m_lruLast = entry->m_lruPrev;
+
+		entry->m_lruPrev = nullptr;
+		entry->m_lruNext = nullptr;
+	}
+
+	void DecodedImageCacheImpl::RemoveEntry(Entry *entry)
+	{
+		const size_t bucket = HashKey(entry->m_archive, entry->m_resTypeID, entry->m_resID, entry->m_pixelFormat) % kNumBuckets;
+
+		Entry **bucketLink = &m_buckets[bucket];
+		while (*bucketLink != entry)
+		{
+			assert(*bucketLink != nullptr);
+			bucketLink = &(*bucketLink)->m_nextInBucket;
+		}
+		*bucketLink = entry->m_nextInBucket;
+
+		UnlinkLRU(entry);
+
+		m_bytesUsed -= entry->m_size;
+		m_numEntries--;
+
+		QDManager::GetInstance()->DisposeGWorld(entry->m_surface);
+
+		entry->~Entry();
+		MemoryManager::GetInstance()->Release(entry);
+	}
+
+	void DecodedImageCacheImpl::EnforceBudget(const Entry *keepEntry)
+	{
+		while (m_bytesUsed > m_byteBudget && m_lruLast != nullptr && m_lruLast != keepEntry)
+		{
+			RemoveEntry(m_lruLast);
+			m_numEvictions++;
+		}
+	}
+
+	DecodedImageCacheImpl *DecodedImageCacheImpl::GetInstance()
+	{
+		return &ms_instance;
+	}
+
+	DecodedImageCacheImpl DecodedImageCacheImpl::ms_instance;
+
+	DecodedImageCache *DecodedImageCache::GetInstance()
+	{
+		return DecodedImageCacheImpl::GetInstance();
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "GpPixelFormat.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct DrawSurface;
+struct Rect;
+
+namespace PortabilityLayer
+{
+	struct IResourceArchive;
+	class ResTypeID;
+
+	struct DecodedImageCacheStats
+	{
+		size_t m_numHits;
+		size_t m_numMisses;
+		size_t m_numEvictions;
+		size_t m_numEntries;
+		size_t m_bytesUsed;
+		size_t m_byteBudget;
+		size_t m_numPrefetches;
+		size_t m_numPrefetchHits;
+	};
+
+	// Keeps recently used pictures decoded to a destination pixel format, so that redrawing them
+	// (i.e. when re-entering a room) doesn't inflate and decode the BMP again.  Entries are evicted
+	// least-recently-used first once the byte budget is exceeded.
+	class DecodedImageCache
+	{
+	public:
+		virtual void Init() = 0;
+		virtual void Shutdown() = 0;
+
+		// Returns a decoded picture, or nullptr if the archive doesn't contain it or it failed to decode.
+		// The surface is owned by the cache and is only valid until the next call to GetPicture.
+		virtual DrawSurface *GetPicture(IResourceArchive *archive, const ResTypeID &resTypeID, int16_t resID, GpPixelFormat_t pixelFormat) = 0;
+
+		// Starts decoding a picture on the worker thread, so a later GetPicture for it doesn't have to.
+		// Returns false if the archive doesn't contain the picture.  Prefetches that can't be queued are dropped.
+		virtual bool Prefetch(IResourceArchive *archive, const ResTypeID &resTypeID, int16_t resID, GpPixelFormat_t pixelFormat) = 0;
+
+		// Draws a picture returned by GetPicture, scaling it if the bounds don't match its size
+		virtual void DrawPicture(DrawSurface *surface, DrawSurface *picture, const Rect &bounds) = 0;
+
+		virtual void PurgeArchive(const IResourceArchive *archive) = 0;
+		virtual void PurgeAll() = 0;
+
+		virtual void SetByteBudget(size_t byteBudget) = 0;
+		virtual void GetStats(DecodedImageCacheStats &outStats) const = 0;
+
+		static DecodedImageCache *GetInstance();
+	};
+}
@@ -86,6 +86,32 @@ bool PortabilityLayer::DeflateCodec::DecompressStream(GpIOStream *stream, size_t
 	return !failed;
 }
 
+bool PortabilityLayer::DeflateCodec::DecompressBuffer(const void *inBuffer, size_t inSize, void *outBuffer, size_t outSize)
+{
+	if (static_cast<uInt>(inSize) != inSize || static_cast<uInt>(outSize) != outSize)
+		return false;
+
+	z_stream zstream;
+	zstream.zalloc = ZlibAllocShim;
+	zstream.zfree = ZlibFreeShim;
+	zstream.opaque = MemoryManager::GetInstance();
+
+	if (inflateInit2(&zstream, -15) != Z_OK)
+		return false;
+
+	zstream.avail_in = static_cast<uInt>(inSize);
+	zstream.next_in = static_cast<Bytef*>(const_cast<void*>(inBuffer));
+	zstream.avail_out = static_cast<uInt>(outSize);
+	zstream.next_out = static_cast<Bytef*>(outBuffer);
+
+	const int result = inflate(&zstream, Z_FINISH);
+	const bool succeeded = (result == Z_STREAM_END && zstream.avail_out == 0);
+
+	inflateEnd(&zstream);
+
+	return succeeded;
+}
+
 namespace PortabilityLayer
 {
 	class DeflateContextImpl final : public DeflateContext
@@ -122,16 +148,30 @@ namespace PortabilityLayer
 
 		bool Reset() override;
 
+		void SetStopAtBlockBoundaries(bool stopAtBlockBoundaries) override;
+		bool IsAtBlockBoundary(size_t &outDecompressedPos) const override;
+
+		bool SaveCheckpoint(InflateCheckpoint &checkpoint) override;
+		bool RestoreCheckpoint(const InflateCheckpoint &checkpoint) override;
+
 		bool Init();
 
 	private:
 		InflateContextImpl();
 		~InflateContextImpl();
 
+		bool CheckBlockBoundary() const;
+
 		bool m_streamInitialized;
 		bool m_isEndOfStream;
+		bool m_stopAtBlockBoundaries;
 		z_stream m_zStream;
 
+		// Positions of the last reset or restored checkpoint, since zlib's counters restart from zero
+		size_t m_compressedBase;
+		size_t m_decompressedBase;
+		uint8_t m_lastByte;
+
 		uint8_t m_flushBuffer[1024];
 		const uint8_t *m_readPos;
 	};
@@ -269,13 +309,34 @@ bool PortabilityLayer::InflateContextImpl::Append(const void *buffer, size_t siz
 
 		size_t lastAvailIn = m_zStream.avail_in;
 
-		int result = inflate(&m_zStream, Z_NO_FLUSH);
+		int result = inflate(&m_zStream, m_stopAtBlockBoundaries ? Z_BLOCK : Z_NO_FLUSH);
 		if (result == Z_STREAM_END)
 			m_isEndOfStream = true;
+		else if (result == Z_BUF_ERROR)
+		{
+			// Not an error, just no input consumed and no output produced.  With Z_BLOCK that happens when a
+			// block that was entirely in the bit buffer (such as an empty flush block) ends, and the next call
+			// carries on past the boundary.  Otherwise, more input is needed.
+			if (!CheckBlockBoundary())
+			{
+				sizeConsumed = consumed;
+				return true;
+			}
+		}
 		else if (result != Z_OK)
 			return false;
 
-		consumed += lastAvailIn - m_zStream.avail_in;
+		const size_t consumedThisCall = lastAvailIn - m_zStream.avail_in;
+		if (consumedThisCall > 0)
+			m_lastByte = m_zStream.next_in[-1];
+
+		consumed += consumedThisCall;
+
+		if (m_stopAtBlockBoundaries && consumed > 0 && CheckBlockBoundary())
+		{
+			sizeConsumed = consumed;
+			return true;
+		}
 	}
 }
 
@@ -314,6 +375,71 @@ bool PortabilityLayer::InflateContextImpl::Reset()
 	m_zStream.avail_out = sizeof(m_flushBuffer);
 	m_zStream.next_out = m_flushBuffer;
 	m_readPos = m_flushBuffer;
+	m_zStream.data_type = 0;
+	m_compressedBase = 0;
+	m_decompressedBase = 0;
+
+	return true;
+}
+
+void PortabilityLayer::InflateContextImpl::SetStopAtBlockBoundaries(bool stopAtBlockBoundaries)
+{
+	m_stopAtBlockBoundaries = stopAtBlockBoundaries;
+}
+
+bool PortabilityLayer::InflateContextImpl::CheckBlockBoundary() const
+{
+	// 128 is set right after an end-of-block code, 64 is set if that was the last block
+	return !m_isEndOfStream && (m_zStream.data_type & 128) != 0 && (m_zStream.data_type & 64) == 0;
+}
+
+bool PortabilityLayer::InflateContextImpl::IsAtBlockBoundary(size_t &outDecompressedPos) const
+{
+	if (!CheckBlockBoundary())
+		return false;
+
+	outDecompressedPos = m_decompressedBase + static_cast<size_t>(m_zStream.total_out);
+	return true;
+}
+
+bool PortabilityLayer::InflateContextImpl::SaveCheckpoint(InflateCheckpoint &checkpoint)
+{
+	if (!CheckBlockBoundary())
+		return false;
+
+	uInt windowSize = static_cast<uInt>(InflateCheckpoint::kMaxWindowSize);
+	if (inflateGetDictionary(&m_zStream, checkpoint.m_window, &windowSize) != Z_OK)
+		return false;
+
+	checkpoint.m_compressedPos = m_compressedBase + static_cast<size_t>(m_zStream.total_in);
+	checkpoint.m_decompressedPos = m_decompressedBase + static_cast<size_t>(m_zStream.total_out);
+	checkpoint.m_numBits = static_cast<uint8_t>(m_zStream.data_type & 7);
+	checkpoint.m_lastByte = m_lastByte;
+	checkpoint.m_windowSize = windowSize;
+
+	return true;
+}
+
+bool PortabilityLayer::InflateContextImpl::RestoreCheckpoint(const InflateCheckpoint &checkpoint)
+{
+	if (!Reset())
+		return false;
+
+	if (checkpoint.m_numBits > 0)
+	{
+		if (inflatePrime(&m_zStream, checkpoint.m_numBits, checkpoint.m_lastByte >> (8 - checkpoint.m_numBits)) != Z_OK)
+			return false;
+	}
+
+	if (checkpoint.m_windowSize > 0)
+	{
+		if (inflateSetDictionary(&m_zStream, checkpoint.m_window, static_cast<uInt>(checkpoint.m_windowSize)) != Z_OK)
+			return false;
+	}
+
+	m_compressedBase = checkpoint.m_compressedPos;
+	m_decompressedBase = checkpoint.m_decompressedPos;
+	m_lastByte = checkpoint.m_lastByte;
 
 	return true;
 }
@@ -337,6 +463,10 @@ bool PortabilityLayer::InflateContextImpl::Init()
 PortabilityLayer::InflateContextImpl::InflateContextImpl()
 	: m_streamInitialized(false)
 	, m_isEndOfStream(false)
+	, m_stopAtBlockBoundaries(false)
+	, m_compressedBase(0)
+	, m_decompressedBase(0)
+	, m_lastByte(0)
 	, m_readPos(m_flushBuffer)
 {
 	memset(&m_zStream, 0, sizeof(m_zStream));
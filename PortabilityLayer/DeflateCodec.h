@@ -20,6 +20,19 @@ namespace PortabilityLayer
 		static uint32_t CRC32(uint32_t inputValue, const void *buffer, size_t bufferLength);
 	};
 
+	// State needed to resume inflating from a block boundary partway through a stream
+	struct InflateCheckpoint
+	{
+		static const size_t kMaxWindowSize = 32768;
+
+		size_t m_compressedPos;		// Compressed bytes consumed before the boundary
+		size_t m_decompressedPos;	// Decompressed bytes produced before the boundary
+		uint8_t m_numBits;			// Bits of the last consumed byte that belong to the next block
+		uint8_t m_lastByte;
+		size_t m_windowSize;
+		uint8_t m_window[kMaxWindowSize];
+	};
+
 	class InflateContext
 	{
 	public:
@@ -31,11 +44,20 @@ namespace PortabilityLayer
 		virtual bool Read(void *buffer, size_t size, size_t &sizeRead) = 0;
 
 		virtual bool Reset() = 0;
+
+		// Checkpoints can only be saved between blocks, so while this is enabled, Append returns early
+		// whenever it reaches a block boundary
+		virtual void SetStopAtBlockBoundaries(bool stopAtBlockBoundaries) = 0;
+		virtual bool IsAtBlockBoundary(size_t &outDecompressedPos) const = 0;
+
+		virtual bool SaveCheckpoint(InflateCheckpoint &checkpoint) = 0;
+		virtual bool RestoreCheckpoint(const InflateCheckpoint &checkpoint) = 0;
 	};
 
 	class DeflateCodec
 	{
 	public:
 		static bool DecompressStream(GpIOStream *stream, size_t inSize, void *outBuffer, size_t outSize);
+		static bool DecompressBuffer(const void *inBuffer, size_t inSize, void *outBuffer, size_t outSize);
 	};
 }
@@ -9,6 +9,7 @@
 #include "RenderedFont.h"
 #include "GpRenderedFontMetrics.h"
 #include "GpRenderedGlyphMetrics.h"
+#include "TextRunCache.h"
 
 #include "PLBigEndian.h"
 #include "PLCore.h"
@@ -30,6 +31,7 @@ namespace PortabilityLayer
 		const GpRenderedFontMetrics &GetMetrics() const override;
 		size_t MeasureString(const uint8_t *chars, size_t len) const override;
 		bool IsAntiAliased() const override;
+		bool CanCacheTextRuns() const override;
 
 		void Destroy() override;
 
@@ -165,8 +167,15 @@ namespace PortabilityLayer
 		return m_isAntiAliased;
 	}
 
+	bool RenderedFontImpl::CanCacheTextRuns() const
+	{
+		return true;
+	}
+
 	void RenderedFontImpl::Destroy()
 	{
+		TextRunCache::GetInstance()->PurgeFont(this);
+
 		this->~RenderedFontImpl();
 		DisposePtr(this);
 	}
@@ -39,6 +39,9 @@ public:
 	virtual GpDriverCollection *PL_GetDriverCollection() = 0;
 
 	virtual bool PL_AdjustRequestedResolution(uint32_t &physicalWidth, uint32_t &physicalHeight, uint32_t &virtualWidth, uint32_t &virtualheight, float &pixelScaleX, float &pixelScaleY) = 0;
+
+	// Must be called before ApplicationMain
+	virtual void SetBenchmarkMode(bool benchmarkMode) = 0;
 };
 
 GP_APP_DLL_EXPORT_API GpAppInterface *GpAppInterface_Get();
@@ -2,8 +2,10 @@
 #include "HostSuspendCallArgument.h"
 
 #include "DisplayDeviceManager.h"
+#include "PerformanceOverlay.h"
 
 #include "PLDrivers.h"
+#include "IGpAudioDriver.h"
 #include "IGpDisplayDriver.h"
 #include "IGpInputDriver.h"
 
@@ -12,7 +14,15 @@ namespace PortabilityLayer
 {
 	void RenderFrames(unsigned int ticks)
 	{
+		PerformanceOverlay *perfOverlay = PerformanceOverlay::GetInstance();
+
+		perfOverlay->BeginServeTicks();
 		PLDrivers::GetDisplayDriver()->ServeTicks(ticks);
+		perfOverlay->EndServeTicks(ticks);
+
+		if (IGpAudioDriver *audioDriver = PLDrivers::GetAudioDriver())
+			audioDriver->ServeTicks(ticks);
+
 		DisplayDeviceManager::GetInstance()->IncrementTickCount(ticks);
 
 		const size_t numInputDrivers = PLDrivers::GetNumInputDrivers();
@@ -1,6 +1,8 @@
 #include "InflateStream.h"
 #include "DeflateCodec.h"
+#include "GpVector.h"
 #include "PLCore.h"
+#include "PLDrivers.h"
 
 #include <stdlib.h>
 #include <new>
@@ -11,7 +13,7 @@ namespace PortabilityLayer
 	{
 	public:
 		InflateStreamImpl(GpIOStream *stream, GpUFilePos_t start, size_t compressedSize, size_t decompressedSize, InflateContext *inflateContext);
-		InflateStreamImpl();
+		~InflateStreamImpl();
 
 		size_t Read(void *bytesOut, size_t size) override;
 		size_t Write(const void *bytes, size_t size) override;
@@ -27,10 +29,24 @@ namespace PortabilityLayer
 		void Flush() override;
 
 	private:
+		// Checkpoints are at least this far apart, and there are at most kMaxCheckpoints of them
+		static const size_t kMinCheckpointSpacing = 64 * 1024;
+		static const size_t kMaxCheckpoints = 64;
+
+		void SaveCheckpointIfNeeded();
+		const InflateCheckpoint *FindCheckpoint(size_t decompressedPos) const;
+		bool RestoreCheckpoint(const InflateCheckpoint *checkpoint);
+
 		GpIOStream *m_stream;
 		InflateContext *m_inflateContext;
 		bool m_contextBroken;
 
+		// Checkpoints are only collected once something seeks backwards, so streams that are just
+		// read straight through don't pay for them
+		GpVector<InflateCheckpoint*> m_checkpoints;
+		size_t m_checkpointSpacing;
+		bool m_checkpointsEnabled;
+
 		GpUFilePos_t m_start;
 		GpUFilePos_t m_compressedSize;
 		GpUFilePos_t m_compressedPos;
@@ -54,11 +70,20 @@ namespace PortabilityLayer
 		, m_compressedInputReadOffset(0)
 		, m_compressedInputSize(0)
 		, m_contextBroken(false)
+		, m_checkpoints(PLDrivers::GetAlloc())
+		, m_checkpointSpacing(decompressedSize / kMaxCheckpoints)
+		, m_checkpointsEnabled(false)
 	{
+		if (m_checkpointSpacing < kMinCheckpointSpacing)
+			m_checkpointSpacing = kMinCheckpointSpacing;
 	}
 
-	InflateStreamImpl::InflateStreamImpl()
+	InflateStreamImpl::~InflateStreamImpl()
 	{
+		for (size_t i = 0; i < m_checkpoints.Count(); i++)
+			DisposePtr(m_checkpoints[i]);
+
+		m_inflateContext->Destroy();
 	}
 
 	size_t InflateStreamImpl::Read(void *bytesOut, size_t size)
@@ -127,12 +152,90 @@ namespace PortabilityLayer
 					return 0;	// This should never happen
 
 				m_compressedInputReadOffset += compressedInputConsumed;
+
+				if (m_checkpointsEnabled)
+					SaveCheckpointIfNeeded();
 			}
 		}
 
 		return totalConsumed;
 	}
 
+	void InflateStreamImpl::SaveCheckpointIfNeeded()
+	{
+		size_t boundaryPos = 0;
+		if (!m_inflateContext->IsAtBlockBoundary(boundaryPos))
+			return;
+
+		// Checkpoints are only added past the last one, so they stay sorted
+		const size_t numCheckpoints = m_checkpoints.Count();
+		size_t nextCheckpointPos = m_checkpointSpacing;
+		if (numCheckpoints > 0)
+			nextCheckpointPos = m_checkpoints[numCheckpoints - 1]->m_decompressedPos + m_checkpointSpacing;
+
+		if (boundaryPos < nextCheckpointPos || numCheckpoints == kMaxCheckpoints)
+			return;
+
+		// Running out of memory here just means seeking will be slower
+		InflateCheckpoint *checkpoint = static_cast<InflateCheckpoint*>(NewPtr(sizeof(InflateCheckpoint)));
+		if (!checkpoint)
+			return;
+
+		if (!m_inflateContext->SaveCheckpoint(*checkpoint) || !m_checkpoints.Append(checkpoint))
+			DisposePtr(checkpoint);
+	}
+
+	const InflateCheckpoint *InflateStreamImpl::FindCheckpoint(size_t decompressedPos) const
+	{
+		size_t first = 0;
+		size_t end = m_checkpoints.Count();
+
+		while (first < end)
+		{
+			const size_t mid = (first + end) / 2;
+			if (m_checkpoints[mid]->m_decompressedPos <= decompressedPos)
+				first = mid + 1;
+			else
+				end = mid;
+		}
+
+		if (first == 0)
+			return nullptr;
+
+		return m_checkpoints[first - 1];
+	}
+
+	bool InflateStreamImpl::RestoreCheckpoint(const InflateCheckpoint *checkpoint)
+	{
+		if (checkpoint)
+		{
+			if (!m_inflateContext->RestoreCheckpoint(*checkpoint))
+			{
+				m_contextBroken = true;
+				return false;
+			}
+
+			m_decompressedPos = checkpoint->m_decompressedPos;
+			m_compressedPos = m_start + checkpoint->m_compressedPos;
+		}
+		else
+		{
+			if (!m_inflateContext->Reset())
+			{
+				m_contextBroken = true;
+				return false;
+			}
+
+			m_decompressedPos = 0;
+			m_compressedPos = m_start;
+		}
+
+		m_compressedInputReadOffset = 0;
+		m_compressedInputSize = 0;
+
+		return true;
+	}
+
 	size_t InflateStreamImpl::Write(const void *bytes, size_t size)
 	{
 		return 0;
@@ -161,18 +264,24 @@ namespace PortabilityLayer
 		if (loc > m_decompressedSize)
 			return false;
 
+		const InflateCheckpoint *checkpoint = FindCheckpoint(static_cast<size_t>(loc));
+
 		if (loc < m_decompressedPos)
 		{
-			if (!m_inflateContext->Reset())
+			if (!m_checkpointsEnabled && m_decompressedSize > m_checkpointSpacing)
 			{
-				m_contextBroken = true;
-				return false;
+				m_checkpointsEnabled = true;
+				m_inflateContext->SetStopAtBlockBoundaries(true);
 			}
 
-			m_decompressedPos = 0;
-			m_compressedInputReadOffset = 0;
-			m_compressedInputSize = 0;
-			m_compressedPos = m_start;
+			if (!RestoreCheckpoint(checkpoint))
+				return false;
+		}
+		else if (checkpoint && checkpoint->m_decompressedPos > m_decompressedPos)
+		{
+			// Skip ahead instead of inflating everything in between
+			if (!RestoreCheckpoint(checkpoint))
+				return false;
 		}
 
 		size_t skipAhead = static_cast<size_t>(loc) - m_decompressedPos;
@@ -195,11 +304,11 @@ namespace PortabilityLayer
 		}
 		else if (loc > 0)
 		{
-			GpUFilePos_t positivePos = static_cast<GpUFilePos_t>(-loc);
+			GpUFilePos_t positivePos = static_cast<GpUFilePos_t>(loc);
 			if (positivePos > m_decompressedSize - m_decompressedPos)
 				return false;
 
-			return this->Read(nullptr, static_cast<size_t>(positivePos));
+			return SeekStart(m_decompressedPos + positivePos);
 		}
 		else
 			return true;
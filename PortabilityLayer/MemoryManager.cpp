@@ -3,6 +3,8 @@
 #include "ResourceCompiledRef.h"
 #include "ResourceManager.h"
 #include "IGpAllocator.h"
+#include "IGpMutex.h"
+#include "IGpSystemServices.h"
 #include "PLDrivers.h"
 
 #include <stdlib.h>
@@ -12,9 +14,61 @@
 
 namespace PortabilityLayer
 {
+	namespace MemoryManagerConstants
+	{
+		static const size_t kBlockHeaderSize = GP_SYSTEM_MEMORY_ALIGNMENT;
+		static const size_t kPageSize = 64 * 1024;
+		static const size_t kPageHeaderSize = 4 * kBlockHeaderSize;
+		static const size_t kHandlesPerSlab = 256;
+
+		static const unsigned int kNumSizeClasses = 10;
+		static const uint8_t kLargeSizeClass = 0xff;
+
+		// Payload sizes, all multiples of the block header size so blocks stay aligned
+		static const size_t kSizeClassSizes[kNumSizeClasses] = { 16, 32, 48, 64, 96, 128, 192, 256, 384, 512 };
+	}
+
+	// Precedes every allocation returned by Alloc
+	struct MMBlockHeader
+	{
+		size_t m_size;
+		uint16_t m_pageOffset;		// Small blocks only, distance back to the start of the page
+		uint8_t m_sizeClass;
+	};
+
+	struct MMFreeBlock
+	{
+		MMFreeBlock *m_next;
+	};
+
+	// Start of every size class page.  Pages with room left are linked into their class's available list,
+	// and each keeps its own free list so that it can be released once all of its blocks are.
+	struct MMSizeClassPage
+	{
+		MMSizeClassPage *m_prevAvailable;
+		MMSizeClassPage *m_nextAvailable;
+		MMFreeBlock *m_freeBlocks;
+		uint8_t *m_bumpPtr;
+		size_t m_numLiveBlocks;
+		bool m_isAvailable;
+	};
+
+	struct MMPage
+	{
+		MMPage *m_next;
+	};
+
+	union MMFreeHandle
+	{
+		MMFreeHandle *m_next;
+		uint8_t m_storage[sizeof(MMHandleBlock)];
+	};
+
 	class MemoryManagerImpl final : public MemoryManager
 	{
 	public:
+		MemoryManagerImpl();
+
 		void Init() override;
 		void Shutdown() override;
 
@@ -26,39 +80,207 @@ namespace PortabilityLayer
 		bool ResizeHandle(MMHandleBlock *hdl, size_t newSize) override;
 		void ReleaseHandle(MMHandleBlock *hdl) override;
 
+		void MarkFrame() override;
+		void GetStats(MemoryManagerStats &outStats) const override;
+		void ResetPeak() override;
+
 		static MemoryManagerImpl *GetInstance();
 
 	private:
+		static int SizeClassForSize(size_t size);
+		static MMBlockHeader *GetBlockHeader(void *buf);
+
+		void *AllocLarge(size_t size);
+		uint8_t *AllocSmallBlockLocked(unsigned int sizeClass);
+		void ReleaseSmallBlockLocked(MMBlockHeader *header);
+		MMSizeClassPage *AddPageLocked(unsigned int sizeClass);
+		void LinkAvailablePageLocked(unsigned int sizeClass, MMSizeClassPage *page);
+		void UnlinkAvailablePageLocked(unsigned int sizeClass, MMSizeClassPage *page);
+		void *AllocHandleBlock();
+		void ReleaseHandleBlock(void *block);
+
+		void CountAllocLocked(size_t size);
+		void CountReleaseLocked(size_t size);
+		void CountResizeLocked(size_t oldSize, size_t newSize);
+
+		void Lock() const;
+		void Unlock() const;
+
+		IGpMutex *m_mutex;
+
+		MMSizeClassPage *m_availablePages[MemoryManagerConstants::kNumSizeClasses];
+
+		MMFreeHandle *m_freeHandles;
+		MMPage *m_handleSlabs;
+
+		size_t m_liveBytes;
+		size_t m_peakBytes;
+		size_t m_numLiveAllocations;
+		size_t m_numLiveHandles;
+		size_t m_reservedBytes;
+		size_t m_numAllocations;
+		size_t m_numAllocationsAtFrameStart;
+		size_t m_numAllocationsLastFrame;
+
 		static MemoryManagerImpl ms_instance;
 	};
 
+	MemoryManagerImpl::MemoryManagerImpl()
+		: m_mutex(nullptr)
+		, m_freeHandles(nullptr)
+		, m_handleSlabs(nullptr)
+		, m_liveBytes(0)
+		, m_peakBytes(0)
+		, m_numLiveAllocations(0)
+		, m_numLiveHandles(0)
+		, m_reservedBytes(0)
+		, m_numAllocations(0)
+		, m_numAllocationsAtFrameStart(0)
+		, m_numAllocationsLastFrame(0)
+	{
+		GP_STATIC_ASSERT(sizeof(MMBlockHeader) <= MemoryManagerConstants::kBlockHeaderSize);
+		GP_STATIC_ASSERT(sizeof(MMPage) <= MemoryManagerConstants::kBlockHeaderSize);
+		GP_STATIC_ASSERT(sizeof(MMSizeClassPage) <= MemoryManagerConstants::kPageHeaderSize);
+		GP_STATIC_ASSERT(MemoryManagerConstants::kPageSize <= 0x10000);
+
+		for (unsigned int i = 0; i < MemoryManagerConstants::kNumSizeClasses; i++)
+			m_availablePages[i] = nullptr;
+	}
+
 	void MemoryManagerImpl::Init()
 	{
+		// Nothing can run on other threads before this, so allocations up to here don't need the lock
+		IGpSystemServices *sysServices = PLDrivers::GetSystemServices();
+		if (sysServices && !m_mutex)
+			m_mutex = sysServices->CreateMutex();
 	}
 
 	void MemoryManagerImpl::Shutdown()
 	{
+		// Remaining pages and slabs are left alone, since blocks in them may still be referenced
+		if (m_mutex)
+		{
+			m_mutex->Destroy();
+			m_mutex = nullptr;
+		}
 	}
 
 	void *MemoryManagerImpl::Realloc(void *buf, size_t newSize)
 	{
-		return PLDrivers::GetAlloc()->Realloc(buf, newSize);
+		if (buf == nullptr)
+			return Alloc(newSize);
+
+		if (newSize == 0)
+		{
+			Release(buf);
+			return nullptr;
+		}
+
+		MMBlockHeader *header = GetBlockHeader(buf);
+		if (header->m_sizeClass == MemoryManagerConstants::kLargeSizeClass)
+		{
+			const size_t oldSize = header->m_size;
+
+			if (newSize > SIZE_MAX - MemoryManagerConstants::kBlockHeaderSize)
+				return nullptr;
+
+			void *newBase = PLDrivers::GetAlloc()->Realloc(header, newSize + MemoryManagerConstants::kBlockHeaderSize);
+			if (!newBase)
+				return nullptr;
+
+			header = static_cast<MMBlockHeader*>(newBase);
+			header->m_size = newSize;
+
+			Lock();
+			CountResizeLocked(oldSize, newSize);
+			Unlock();
+
+			return static_cast<uint8_t*>(newBase) + MemoryManagerConstants::kBlockHeaderSize;
+		}
+
+		if (newSize <= MemoryManagerConstants::kSizeClassSizes[header->m_sizeClass])
+		{
+			const size_t oldSize = header->m_size;
+			header->m_size = newSize;
+
+			Lock();
+			CountResizeLocked(oldSize, newSize);
+			Unlock();
+
+			return buf;
+		}
+
+		void *newBuf = Alloc(newSize);
+		if (!newBuf)
+			return nullptr;
+
+		memcpy(newBuf, buf, header->m_size);
+		Release(buf);
+
+		return newBuf;
 	}
 
 	void *MemoryManagerImpl::Alloc(size_t size)
 	{
-		return PLDrivers::GetAlloc()->Realloc(nullptr, size);
+		if (size == 0)
+			return nullptr;
+
+		const int sizeClass = SizeClassForSize(size);
+		if (sizeClass < 0)
+			return AllocLarge(size);
+
+		Lock();
+		uint8_t *block = AllocSmallBlockLocked(static_cast<unsigned int>(sizeClass));
+		if (block)
+			CountAllocLocked(size);
+		Unlock();
+
+		if (!block)
+			return nullptr;
+
+		MMBlockHeader *header = reinterpret_cast<MMBlockHeader*>(block);
+		header->m_size = size;
+
+		return block + MemoryManagerConstants::kBlockHeaderSize;
 	}
 
 	void MemoryManagerImpl::Release(void *buf)
 	{
-		PLDrivers::GetAlloc()->Realloc(buf, 0);
+		if (!buf)
+			return;
+
+		MMBlockHeader *header = GetBlockHeader(buf);
+		const uint8_t sizeClass = header->m_sizeClass;
+
+		if (sizeClass == MemoryManagerConstants::kLargeSizeClass)
+		{
+			const size_t size = header->m_size;
+			PLDrivers::GetAlloc()->Realloc(header, 0);
+
+			Lock();
+			CountReleaseLocked(size);
+			Unlock();
+			return;
+		}
+
+		Lock();
+		CountReleaseLocked(header->m_size);
+		ReleaseSmallBlockLocked(header);
+		Unlock();
 	}
 
 	MMHandleBlock *MemoryManagerImpl::AllocHandle(size_t size)
 	{
 		void *contents = Alloc(size);
-		MMHandleBlock *handleBlock = static_cast<MMHandleBlock*>(Alloc(sizeof(MMHandleBlock)));
+		if (!contents && size != 0)
+			return nullptr;
+
+		void *handleBlock = AllocHandleBlock();
+		if (!handleBlock)
+		{
+			Release(contents);
+			return nullptr;
+		}
 
 		return new (handleBlock) MMHandleBlock(contents, size);
 	}
@@ -104,7 +326,261 @@ namespace PortabilityLayer
 
 		hdl->~MMHandleBlock();
 
-		Release(hdl);
+		ReleaseHandleBlock(hdl);
+	}
+
+	void MemoryManagerImpl::MarkFrame()
+	{
+		Lock();
+		m_numAllocationsLastFrame = m_numAllocations - m_numAllocationsAtFrameStart;
+		m_numAllocationsAtFrameStart = m_numAllocations;
+		Unlock();
+	}
+
+	void MemoryManagerImpl::GetStats(MemoryManagerStats &outStats) const
+	{
+		Lock();
+		outStats.m_liveBytes = m_liveBytes;
+		outStats.m_peakBytes = m_peakBytes;
+		outStats.m_numLiveAllocations = m_numLiveAllocations;
+		outStats.m_numLiveHandles = m_numLiveHandles;
+		outStats.m_reservedBytes = m_reservedBytes;
+		outStats.m_numAllocations = m_numAllocations;
+		outStats.m_numAllocationsLastFrame = m_numAllocationsLastFrame;
+		Unlock();
+	}
+
+	void MemoryManagerImpl::ResetPeak()
+	{
+		Lock();
+		m_peakBytes = m_liveBytes;
+		Unlock();
+	}
+
+	int MemoryManagerImpl::SizeClassForSize(size_t size)
+	{
+		for (unsigned int i = 0; i < MemoryManagerConstants::kNumSizeClasses; i++)
+		{
+			if (size <= MemoryManagerConstants::kSizeClassSizes[i])
+				return static_cast<int>(i);
+		}
+
+		return -1;
+	}
+
+	MMBlockHeader *MemoryManagerImpl::GetBlockHeader(void *buf)
+	{
+		return reinterpret_cast<MMBlockHeader*>(static_cast<uint8_t*>(buf) - MemoryManagerConstants::kBlockHeaderSize);
+	}
+
+	void *MemoryManagerImpl::AllocLarge(size_t size)
+	{
+		if (size > SIZE_MAX - MemoryManagerConstants::kBlockHeaderSize)
+			return nullptr;
+
+		void *base = PLDrivers::GetAlloc()->Realloc(nullptr, size + MemoryManagerConstants::kBlockHeaderSize);
+		if (!base)
+			return nullptr;
+
+		MMBlockHeader *header = static_cast<MMBlockHeader*>(base);
+		header->m_size = size;
+		header->m_sizeClass = MemoryManagerConstants::kLargeSizeClass;
+
+		Lock();
+		CountAllocLocked(size);
+		Unlock();
+
+		return static_cast<uint8_t*>(base) + MemoryManagerConstants::kBlockHeaderSize;
+	}
+
+	uint8_t *MemoryManagerImpl::AllocSmallBlockLocked(unsigned int sizeClass)
+	{
+		MMSizeClassPage *page = m_availablePages[sizeClass];
+		if (!page)
+		{
+			page = AddPageLocked(sizeClass);
+			if (!page)
+				return nullptr;
+		}
+
+		uint8_t *pageBytes = reinterpret_cast<uint8_t*>(page);
+		uint8_t *pageEnd = pageBytes + MemoryManagerConstants::kPageSize;
+		const size_t blockSize = MemoryManagerConstants::kBlockHeaderSize + MemoryManagerConstants::kSizeClassSizes[sizeClass];
+
+		uint8_t *block = nullptr;
+		if (page->m_freeBlocks)
+		{
+			block = reinterpret_cast<uint8_t*>(page->m_freeBlocks);
+			page->m_freeBlocks = page->m_freeBlocks->m_next;
+		}
+		else
+		{
+			block = page->m_bumpPtr;
+			page->m_bumpPtr += blockSize;
+		}
+
+		page->m_numLiveBlocks++;
+
+		if (!page->m_freeBlocks && static_cast<size_t>(pageEnd - page->m_bumpPtr) < blockSize)
+			UnlinkAvailablePageLocked(sizeClass, page);
+
+		MMBlockHeader *header = reinterpret_cast<MMBlockHeader*>(block);
+		header->m_pageOffset = static_cast<uint16_t>(block - pageBytes);
+		header->m_sizeClass = static_cast<uint8_t>(sizeClass);
+
+		return block;
+	}
+
+	void MemoryManagerImpl::ReleaseSmallBlockLocked(MMBlockHeader *header)
+	{
+		const unsigned int sizeClass = header->m_sizeClass;
+		MMSizeClassPage *page = reinterpret_cast<MMSizeClassPage*>(reinterpret_cast<uint8_t*>(header) - header->m_pageOffset);
+
+		MMFreeBlock *freeBlock = reinterpret_cast<MMFreeBlock*>(header);
+		freeBlock->m_next = page->m_freeBlocks;
+		page->m_freeBlocks = freeBlock;
+		page->m_numLiveBlocks--;
+
+		if (!page->m_isAvailable)
+			LinkAvailablePageLocked(sizeClass, page);
+
+		// Empty pages go back to the allocator, except when it's the only one with room in its class, so that
+		// a class hovering around a page boundary doesn't allocate and release a page every time
+		if (page->m_numLiveBlocks == 0 && (page->m_prevAvailable || page->m_nextAvailable))
+		{
+			UnlinkAvailablePageLocked(sizeClass, page);
+			PLDrivers::GetAlloc()->Realloc(page, 0);
+			m_reservedBytes -= MemoryManagerConstants::kPageSize;
+		}
+	}
+
+	MMSizeClassPage *MemoryManagerImpl::AddPageLocked(unsigned int sizeClass)
+	{
+		uint8_t *pageBytes = static_cast<uint8_t*>(PLDrivers::GetAlloc()->Realloc(nullptr, MemoryManagerConstants::kPageSize));
+		if (!pageBytes)
+			return nullptr;
+
+		MMSizeClassPage *page = reinterpret_cast<MMSizeClassPage*>(pageBytes);
+		page->m_prevAvailable = nullptr;
+		page->m_nextAvailable = nullptr;
+		page->m_freeBlocks = nullptr;
+		page->m_bumpPtr = pageBytes + MemoryManagerConstants::kPageHeaderSize;
+		page->m_numLiveBlocks = 0;
+		page->m_isAvailable = false;
+
+		LinkAvailablePageLocked(sizeClass, page);
+		m_reservedBytes += MemoryManagerConstants::kPageSize;
+
+		return page;
+	}
+
+	void MemoryManagerImpl::LinkAvailablePageLocked(unsigned int sizeClass, MMSizeClassPage *page)
+	{
+		page->m_prevAvailable = nullptr;
+		page->m_nextAvailable = m_availablePages[sizeClass];
+		if (page->m_nextAvailable)
+			page->m_nextAvailable->m_prevAvailable = page;
+
+		m_availablePages[sizeClass] = page;
+		page->m_isAvailable = true;
+	}
+
+	void MemoryManagerImpl::UnlinkAvailablePageLocked(unsigned int sizeClass, MMSizeClassPage *page)
+	{
+		if (page->m_prevAvailable)
+			page->m_prevAvailable->m_nextAvailable = page->m_nextAvailable;
+		else
+			m_availablePages[sizeClass] = page->m_nextAvailable;
+
+		if (page->m_nextAvailable)
+			page->m_nextAvailable->m_prevAvailable = page->m_prevAvailable;
+
+		page->m_prevAvailable = nullptr;
+		page->m_nextAvailable = nullptr;
+		page->m_isAvailable = false;
+	}
+
+	void *MemoryManagerImpl::AllocHandleBlock()
+	{
+		Lock();
+
+		if (!m_freeHandles)
+		{
+			const size_t slabSize = MemoryManagerConstants::kBlockHeaderSize + sizeof(MMFreeHandle) * MemoryManagerConstants::kHandlesPerSlab;
+			uint8_t *slabBytes = static_cast<uint8_t*>(PLDrivers::GetAlloc()->Realloc(nullptr, slabSize));
+			if (!slabBytes)
+			{
+				Unlock();
+				return nullptr;
+			}
+
+			MMPage *slab = reinterpret_cast<MMPage*>(slabBytes);
+			slab->m_next = m_handleSlabs;
+			m_handleSlabs = slab;
+			m_reservedBytes += slabSize;
+
+			MMFreeHandle *handles = reinterpret_cast<MMFreeHandle*>(slabBytes + MemoryManagerConstants::kBlockHeaderSize);
+			for (size_t i = 0; i < MemoryManagerConstants::kHandlesPerSlab; i++)
+			{
+				handles[i].m_next = m_freeHandles;
+				m_freeHandles = handles + i;
+			}
+		}
+
+		MMFreeHandle *handle = m_freeHandles;
+		m_freeHandles = handle->m_next;
+		m_numLiveHandles++;
+		m_numAllocations++;
+
+		Unlock();
+
+		return handle;
+	}
+
+	void MemoryManagerImpl::ReleaseHandleBlock(void *block)
+	{
+		MMFreeHandle *handle = static_cast<MMFreeHandle*>(block);
+
+		Lock();
+		handle->m_next = m_freeHandles;
+		m_freeHandles = handle;
+		m_numLiveHandles--;
+		Unlock();
+	}
+
+	void MemoryManagerImpl::CountAllocLocked(size_t size)
+	{
+		m_liveBytes += size;
+		if (m_liveBytes > m_peakBytes)
+			m_peakBytes = m_liveBytes;
+
+		m_numLiveAllocations++;
+		m_numAllocations++;
+	}
+
+	void MemoryManagerImpl::CountReleaseLocked(size_t size)
+	{
+		m_liveBytes -= size;
+		m_numLiveAllocations--;
+	}
+
+	void MemoryManagerImpl::CountResizeLocked(size_t oldSize, size_t newSize)
+	{
+		m_liveBytes = m_liveBytes - oldSize + newSize;
+		if (m_liveBytes > m_peakBytes)
+			m_peakBytes = m_liveBytes;
+	}
+
+	void MemoryManagerImpl::Lock() const
+	{
+		if (m_mutex)
+			m_mutex->Lock();
+	}
+
+	void MemoryManagerImpl::Unlock() const
+	{
+		if (m_mutex)
+			m_mutex->Unlock();
 	}
 
 	MemoryManagerImpl *MemoryManagerImpl::GetInstance()
@@ -9,6 +9,21 @@ namespace PortabilityLayer
 {
 	struct MMHandleBlock;
 
+	struct MemoryManagerStats
+	{
+		size_t m_liveBytes;					// Requested bytes currently allocated, not counting headers or size class rounding
+		size_t m_peakBytes;
+		size_t m_numLiveAllocations;
+		size_t m_numLiveHandles;
+		size_t m_reservedBytes;				// Bytes held by size class pages and handle slabs, whether in use or not
+		size_t m_numAllocations;			// Since startup
+		size_t m_numAllocationsLastFrame;
+	};
+
+	// Small allocations are carved from size class pages and handle blocks from slabs, so that
+	// handle-heavy code doesn't churn the backing allocator.  Emptied pages are released, except
+	// for one per class; handle slabs are kept for reuse.  Everything else goes to the
+	// IGpAllocator driver.  Thread-safe after Init.
 	class MemoryManager
 	{
 	public:
@@ -23,6 +38,13 @@ namespace PortabilityLayer
 		virtual bool ResizeHandle(MMHandleBlock *hdl, size_t newSize) = 0;
 		virtual void ReleaseHandle(MMHandleBlock *hdl) = 0;
 
+		// Call once per presented frame to roll the per-frame allocation count over
+		virtual void MarkFrame() = 0;
+		virtual void GetStats(MemoryManagerStats &outStats) const = 0;
+
+		// Restarts the peak from the current live bytes, so the peak of a single pass can be measured
+		virtual void ResetPeak() = 0;
+
 		template<class T>
 		T **NewHandle();
 
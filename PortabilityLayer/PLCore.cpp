@@ -6,6 +6,7 @@
 #include "PLKeyEncoding.h"
 #include "PLQDraw.h"
 
+#include "DecodedImageCache.h"
 #include "DisplayDeviceManager.h"
 #include "FileManager.h"
 #include "FilePermission.h"
@@ -30,6 +31,9 @@
 #include "MemReaderStream.h"
 #include "MMHandleBlock.h"
 #include "RenderedFont.h"
+#include "SoundCache.h"
+#include "TextRunCache.h"
+#include "PerformanceOverlay.h"
 #include "ResTypeID.h"
 #include "RandomNumberGenerator.h"
 #include "QDManager.h"
@@ -652,6 +656,10 @@ void PL_Init()
 	PortabilityLayer::ResourceManager::GetInstance()->Init();
 	PortabilityLayer::DisplayDeviceManager::GetInstance()->Init();
 	PortabilityLayer::QDManager::GetInstance()->Init();
+	PortabilityLayer::DecodedImageCache::GetInstance()->Init();
+	PortabilityLayer::SoundCache::GetInstance()->Init();
+	PortabilityLayer::TextRunCache::GetInstance()->Init();
+	PortabilityLayer::PerformanceOverlay::GetInstance()->Init();
 	PortabilityLayer::MenuManager::GetInstance()->Init();
 	PortabilityLayer::WindowManager::GetInstance()->Init();
 
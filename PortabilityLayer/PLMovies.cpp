@@ -2,16 +2,24 @@
 
 #include "BitmapImage.h"
 #include "FileManager.h"
+#include "IGpLogDriver.h"
 #include "MemoryManager.h"
+#include "MMHandleBlock.h"
+#include "PLDrivers.h"
 #include "PLQDraw.h"
 #include "PLResources.h"
 #include "QDManager.h"
 #include "QDPixMap.h"
 #include "ResourceManager.h"
+#include "ResTypeID.h"
+#include "WorkerSlots.h"
 
 #include "rapidjson/rapidjson.h"
 #include "rapidjson/document.h"
 
+#include <chrono>
+#include <string.h>
+
 
 AnimationPlayer::AnimationPlayer()
 	: m_animPackage(nullptr)
@@ -42,6 +50,19 @@ void AnimationPlayer::Restart()
 	m_frameIndex = 0;
 }
 
+// Owned by whoever owns its slot in m_streamSlots
+struct AnimationPackage::StreamedFrame
+{
+	size_t m_frameIndex;
+
+	void *m_storedData;
+	size_t m_storedSize;
+	size_t m_size;
+	bool m_isDeflated;
+
+	void *m_contents;
+};
+
 AnimationPackage *AnimationPackage::Create()
 {
 	void *storage = PortabilityLayer::MemoryManager::GetInstance()->Alloc(sizeof(AnimationPackage));
@@ -57,8 +78,10 @@ void AnimationPackage::Destroy()
 	PortabilityLayer::MemoryManager::GetInstance()->Release(this);
 }
 
-PLError_t AnimationPackage::Load(PortabilityLayer::VirtualDirectory_t dirID, const PLPasStr &name)
+PLError_t AnimationPackage::Load(PortabilityLayer::VirtualDirectory_t dirID, const PLPasStr &name, bool streamFrames)
 {
+	const std::chrono::steady_clock::time_point loadStartTime = std::chrono::steady_clock::now();
+
 	m_compositeFile = PortabilityLayer::FileManager::GetInstance()->OpenCompositeFile(dirID, name);
 	if (!m_compositeFile)
 		return PLErrors::kFileNotFound;
@@ -102,47 +125,415 @@ PLError_t AnimationPackage::Load(PortabilityLayer::VirtualDirectory_t dirID, con
 	m_frameRateNumerator = frameRateNumerator;
 	m_frameRateDenominator = frameRateDenominator;
 
-	uint32_t numFrames = 0;
-	for (;;)
+	PLError_t err = IndexFrames();
+	if (err != PLErrors::kNone)
+		return err;
+
+	if (streamFrames)
+		err = StartStreaming();
+	else
+		err = PreloadFrames();
+
+	if (err != PLErrors::kNone)
+		return err;
+
+	THandle<BitmapImage> firstFrame = GetFrame(0);
+	if (!firstFrame)
+		return PLErrors::kResourceError;
+
+	m_frameRect = (*firstFrame)->GetRect();
+
+	if (IGpLogDriver *logger = PLDrivers::GetLogDriver())
 	{
-		if (numFrames + 1 > 0x7fff)
-			return PLErrors::kResourceError;
+		const double firstFrameMsec = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStartTime).count();
 
-		THandle<void> frameRes = m_resArchive->LoadResource('PICT', numFrames + 1);
-		if (!frameRes)
-			break;
-		else
-		{
-			if (frameRes.MMBlock()->m_size < sizeof(BitmapImage))
-				return PLErrors::kResourceError;
+		logger->Printf(IGpLogDriver::Category_Information, "AnimationPackage: %s %u frames, first frame ready in %.2f ms, %u bytes of frames resident", m_isStreaming ? "Streaming" : "Loaded",
+			static_cast<unsigned int>(m_numImages), firstFrameMsec, static_cast<unsigned int>(GetResidentFrameBytes()));
+	}
 
-			numFrames++;
-		}
+	return PLErrors::kNone;
+}
+
+PLError_t AnimationPackage::IndexFrames()
+{
+	// Frames are PICT 1 through N.  These are found from the archive directory, so nothing is loaded yet.
+	const size_t kMaxFrames = 0x7fff;
+
+	PortabilityLayer::MemoryManager *mm = PortabilityLayer::MemoryManager::GetInstance();
+
+	uint8_t *framePresent = static_cast<uint8_t*>(mm->Alloc(kMaxFrames + 1));
+	if (!framePresent)
+		return PLErrors::kOutOfMemory;
+
+	memset(framePresent, 0, kMaxFrames + 1);
+
+	PortabilityLayer::IResourceIterator *iterator = m_resArchive->EnumerateResources();
+	if (!iterator)
+	{
+		mm->Release(framePresent);
+		return PLErrors::kOutOfMemory;
+	}
+
+	PortabilityLayer::ResTypeID resTypeID;
+	int16_t resID = 0;
+	while (iterator->GetOne(resTypeID, resID))
+	{
+		if (resTypeID == PortabilityLayer::ResTypeID('PICT') && resID >= 1)
+			framePresent[resID] = 1;
 	}
 
+	iterator->Destroy();
+
+	size_t numFrames = 0;
+	while (numFrames < kMaxFrames && framePresent[numFrames + 1])
+		numFrames++;
+
+	mm->Release(framePresent);
+
 	if (numFrames == 0)
 		return PLErrors::kResourceError;
 
-	void *imageListStorage = PortabilityLayer::MemoryManager::GetInstance()->Alloc(sizeof(THandle<BitmapImage>) * numFrames);
+	m_numImages = numFrames;
+
+	return PLErrors::kNone;
+}
+
+PLError_t AnimationPackage::PreloadFrames()
+{
+	void *imageListStorage = PortabilityLayer::MemoryManager::GetInstance()->Alloc(sizeof(THandle<BitmapImage>) * m_numImages);
 	if (!imageListStorage)
 		return PLErrors::kResourceError;
 
 	m_images = static_cast<THandle<BitmapImage>*>(imageListStorage);
 
-	for (uint32_t i = 0; i < numFrames; i++)
+	for (size_t i = 0; i < m_numImages; i++)
 		new (m_images + i) THandle<BitmapImage>();
 
-	for (uint32_t i = 0; i < numFrames; i++)
-		m_images[i] = m_resArchive->LoadResource('PICT', i + 1).StaticCast<BitmapImage>();
+	for (size_t i = 0; i < m_numImages; i++)
+	{
+		m_images[i] = m_resArchive->LoadResource('PICT', static_cast<int>(i + 1)).StaticCast<BitmapImage>();
+		if (!m_images[i] || m_images[i].MMBlock()->m_size < sizeof(BitmapImage))
+			return PLErrors::kResourceError;
+	}
 
-	m_numImages = numFrames;
+	return PLErrors::kNone;
+}
+
+PLError_t AnimationPackage::StartStreaming()
+{
+	PortabilityLayer::MemoryManager *mm = PortabilityLayer::MemoryManager::GetInstance();
+
+	void *framesStorage = mm->Alloc(sizeof(StreamedFrame) * kMaxStreamedFrames);
+	if (!framesStorage)
+		return PLErrors::kOutOfMemory;
+
+	m_streamedFrames = static_cast<StreamedFrame*>(framesStorage);
+	for (size_t i = 0; i < kMaxStreamedFrames; i++)
+	{
+		StreamedFrame &frame = m_streamedFrames[i];
+		frame.m_frameIndex = 0;
+		frame.m_storedData = nullptr;
+		frame.m_storedSize = 0;
+		frame.m_size = 0;
+		frame.m_isDeflated = false;
+		frame.m_contents = nullptr;
+	}
+
+	// Without a worker thread, frames are still streamed, but decompressed on demand
+	m_streamSlots = PortabilityLayer::WorkerSlots::Create(kMaxStreamedFrames, StaticDecodeStreamedFrame, this);
+	if (!m_streamSlots)
+		return PLErrors::kOutOfMemory;
+
+	void *blockStorage = mm->Alloc(sizeof(PortabilityLayer::MMHandleBlock));
+	if (!blockStorage)
+		return PLErrors::kOutOfMemory;
+
+	m_streamedFrameBlock = new (blockStorage) PortabilityLayer::MMHandleBlock(nullptr, 0);
+
+	// Keep about half a second of frames ahead of playback
+	size_t framesAhead = (m_frameRateNumerator + m_frameRateDenominator * 2 - 1) / (m_frameRateDenominator * 2);
+	if (framesAhead < 2)
+		framesAhead = 2;
+	if (framesAhead > kMaxStreamedFrames - 1)
+		framesAhead = kMaxStreamedFrames - 1;
+
+	m_numFramesAhead = framesAhead;
+	m_isStreaming = true;
 
 	return PLErrors::kNone;
 }
 
-const THandle<BitmapImage> &AnimationPackage::GetFrame(size_t index) const
+THandle<BitmapImage> AnimationPackage::GetFrame(size_t index)
+{
+	if (!m_isStreaming)
+		return m_images[index];
+
+	if (index >= m_numImages)
+		return THandle<BitmapImage>();
+
+	RecycleStreamedFrames(index);
+
+	StreamedFrame *frame = AcquireStreamedFrame(index);
+
+	QueueStreamedFrames(index);
+
+	if (!frame || !frame->m_contents || frame->m_size < sizeof(BitmapImage))
+		return THandle<BitmapImage>();
+
+	m_streamedFrameBlock->m_contents = frame->m_contents;
+	m_streamedFrameBlock->m_size = frame->m_size;
+
+	return THandle<BitmapImage>(m_streamedFrameBlock);
+}
+
+bool AnimationPackage::IsInStreamWindow(size_t frameIndex, size_t currentIndex) const
+{
+	// Playback loops, so the window wraps around to the start
+	const size_t framesAhead = (frameIndex + m_numImages - currentIndex) % m_numImages;
+	return framesAhead <= m_numFramesAhead;
+}
+
+AnimationPackage::StreamedFrame *AnimationPackage::AcquireStreamedFrame(size_t index)
+{
+	size_t foundSlot = kMaxStreamedFrames;
+	bool decodeHere = false;
+
+	m_streamSlots->Lock();
+
+	const size_t freeSlot = m_streamSlots->FindFreeSlot();
+
+	for (size_t i = 0; i < kMaxStreamedFrames; i++)
+	{
+		if (m_streamSlots->GetState(i) != PortabilityLayer::WorkerSlotStates::kFree && m_streamedFrames[i].m_frameIndex == index)
+		{
+			foundSlot = i;
+			break;
+		}
+	}
+
+	if (foundSlot != kMaxStreamedFrames)
+	{
+		// If the worker hasn't gotten to this frame yet, it's faster to decode it here than to wait for it
+		if (m_streamSlots->GetState(foundSlot) == PortabilityLayer::WorkerSlotStates::kQueued)
+		{
+			m_streamSlots->SetState(foundSlot, PortabilityLayer::WorkerSlotStates::kWorking);
+			decodeHere = true;
+		}
+		else
+			m_streamSlots->WaitForSlot(foundSlot);
+	}
+
+	m_streamSlots->Unlock();
+
+	if (foundSlot == kMaxStreamedFrames)
+	{
+		if (freeSlot == kMaxStreamedFrames || !LoadStreamedFrame(m_streamedFrames[freeSlot], index))
+			return nullptr;
+
+		foundSlot = freeSlot;
+		decodeHere = true;
+	}
+
+	StreamedFrame *frame = m_streamedFrames + foundSlot;
+
+	if (decodeHere)
+	{
+		DecodeStreamedFrame(*frame);
+
+		m_streamSlots->Lock();
+		m_streamSlots->SetState(foundSlot, PortabilityLayer::WorkerSlotStates::kDone);
+		m_streamSlots->Unlock();
+	}
+
+	return frame;
+}
+
+void AnimationPackage::RecycleStreamedFrames(size_t currentIndex)
+{
+	m_streamSlots->Lock();
+
+	for (size_t i = 0; i < kMaxStreamedFrames; i++)
+	{
+		if (m_streamSlots->GetState(i) != PortabilityLayer::WorkerSlotStates::kFree && !IsInStreamWindow(m_streamedFrames[i].m_frameIndex, currentIndex))
+		{
+			m_streamSlots->WaitForSlot(i);
+			ReleaseStreamedFrame(i);
+		}
+	}
+
+	m_streamSlots->Unlock();
+}
+
+void AnimationPackage::QueueStreamedFrames(size_t currentIndex)
+{
+	if (!m_streamSlots->HasWorker())
+		return;
+
+	for (size_t ahead = 1; ahead <= m_numFramesAhead && ahead < m_numImages; ahead++)
+	{
+		const size_t frameIndex = (currentIndex + ahead) % m_numImages;
+
+		bool isPresent = false;
+
+		m_streamSlots->Lock();
+		const size_t freeSlot = m_streamSlots->FindFreeSlot();
+		for (size_t i = 0; i < kMaxStreamedFrames; i++)
+		{
+			if (m_streamSlots->GetState(i) != PortabilityLayer::WorkerSlotStates::kFree && m_streamedFrames[i].m_frameIndex == frameIndex)
+			{
+				isPresent = true;
+				break;
+			}
+		}
+		m_streamSlots->Unlock();
+
+		if (isPresent)
+			continue;
+
+		// The stored data is read here, since the archive can only be accessed from the main thread
+		if (freeSlot == kMaxStreamedFrames || !LoadStreamedFrame(m_streamedFrames[freeSlot], frameIndex))
+			break;
+
+		m_streamSlots->QueueSlot(freeSlot);
+	}
+}
+
+bool AnimationPackage::LoadStreamedFrame(StreamedFrame &frame, size_t index)
 {
-	return m_images[index];
+	void *storedData = nullptr;
+	size_t storedSize = 0;
+	size_t size = 0;
+	bool isDeflated = false;
+	if (!m_resArchive->LoadStoredResource('PICT', static_cast<int>(index + 1), storedData, storedSize, size, isDeflated))
+		return false;
+
+	frame.m_frameIndex = index;
+	frame.m_storedData = storedData;
+	frame.m_storedSize = storedSize;
+	frame.m_size = size;
+	frame.m_isDeflated = isDeflated;
+	frame.m_contents = nullptr;
+
+	return true;
+}
+
+void AnimationPackage::ReleaseStreamedFrame(size_t slotIndex)
+{
+	// Called with the stream slots locked
+	PortabilityLayer::MemoryManager *mm = PortabilityLayer::MemoryManager::GetInstance();
+	StreamedFrame &frame = m_streamedFrames[slotIndex];
+
+	if (frame.m_storedData)
+	{
+		mm->Release(frame.m_storedData);
+		frame.m_storedData = nullptr;
+	}
+
+	if (frame.m_contents)
+	{
+		mm->Release(frame.m_contents);
+		frame.m_contents = nullptr;
+	}
+
+	m_streamSlots->SetState(slotIndex, PortabilityLayer::WorkerSlotStates::kFree);
+}
+
+void AnimationPackage::StopStreaming()
+{
+	PortabilityLayer::MemoryManager *mm = PortabilityLayer::MemoryManager::GetInstance();
+
+	if (m_streamSlots)
+	{
+		m_streamSlots->Lock();
+
+		for (size_t i = 0; i < kMaxStreamedFrames; i++)
+		{
+			m_streamSlots->WaitForSlot(i);
+			ReleaseStreamedFrame(i);
+		}
+
+		m_streamSlots->Unlock();
+
+		m_streamSlots->Destroy();
+		m_streamSlots = nullptr;
+	}
+
+	if (m_streamedFrameBlock)
+	{
+		m_streamedFrameBlock->~MMHandleBlock();
+		mm->Release(m_streamedFrameBlock);
+	}
+
+	mm->Release(m_streamedFrames);
+}
+
+size_t AnimationPackage::GetResidentFrameBytes() const
+{
+	size_t residentBytes = 0;
+
+	if (!m_isStreaming)
+	{
+		for (size_t i = 0; i < m_numImages; i++)
+			residentBytes += m_images[i].MMBlock()->m_size;
+
+		return residentBytes;
+	}
+
+	m_streamSlots->Lock();
+
+	// Frames are held compressed until they're decoded, and decoded after that.  Frames that are being decoded
+	// belong to the worker, so they're counted from the sizes, which it doesn't change.
+	for (size_t i = 0; i < kMaxStreamedFrames; i++)
+	{
+		const StreamedFrame &frame = m_streamedFrames[i];
+
+		switch (m_streamSlots->GetState(i))
+		{
+		case PortabilityLayer::WorkerSlotStates::kQueued:
+			residentBytes += frame.m_storedSize;
+			break;
+		case PortabilityLayer::WorkerSlotStates::kWorking:
+			residentBytes += frame.m_storedSize + frame.m_size;
+			break;
+		case PortabilityLayer::WorkerSlotStates::kDone:
+			if (frame.m_contents)
+				residentBytes += frame.m_size;
+			break;
+		default:
+			break;
+		}
+	}
+
+	m_streamSlots->Unlock();
+
+	return residentBytes;
+}
+
+void AnimationPackage::DecodeStreamedFrame(StreamedFrame &frame)
+{
+	PortabilityLayer::MemoryManager *mm = PortabilityLayer::MemoryManager::GetInstance();
+
+	void *contents = mm->Alloc(frame.m_size);
+	if (contents && !PortabilityLayer::ResourceArchiveBase::DecodeStoredResource('PICT', frame.m_storedData, frame.m_storedSize, frame.m_isDeflated, contents, frame.m_size))
+	{
+		mm->Release(contents);
+		contents = nullptr;
+	}
+
+	mm->Release(frame.m_storedData);
+	frame.m_storedData = nullptr;
+	frame.m_contents = contents;
+}
+
+void AnimationPackage::StaticDecodeStreamedFrame(void *context, size_t slotIndex)
+{
+	AnimationPackage *package = static_cast<AnimationPackage*>(context);
+	DecodeStreamedFrame(package->m_streamedFrames[slotIndex]);
+}
+
+const Rect &AnimationPackage::GetFrameRect() const
+{
+	return m_frameRect;
 }
 
 size_t AnimationPackage::NumFrames() const
@@ -166,11 +557,21 @@ AnimationPackage::AnimationPackage()
 	, m_resArchive(nullptr)
 	, m_compositeFile(nullptr)
 	, m_numImages(0)
+	, m_frameRect(Rect::Create(0, 0, 0, 0))
+	, m_streamedFrames(nullptr)
+	, m_streamedFrameBlock(nullptr)
+	, m_streamSlots(nullptr)
+	, m_numFramesAhead(0)
+	, m_isStreaming(false)
+	, m_frameRateNumerator(0)
+	, m_frameRateDenominator(0)
 {
 }
 
 AnimationPackage::~AnimationPackage()
 {
+	StopStreaming();
+
 	if (m_resArchive)
 		m_resArchive->Destroy();
 
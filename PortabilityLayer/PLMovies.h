@@ -8,8 +8,10 @@
 namespace PortabilityLayer
 {
 	struct IResourceArchive;
+	struct MMHandleBlock;
 	class MultiStreamFile;
 	class CompositeFile;
+	class WorkerSlots;
 }
 
 struct DrawSurface;
@@ -42,21 +44,52 @@ public:
 	static AnimationPackage *Create();
 	void Destroy();
 
-	PLError_t Load(PortabilityLayer::VirtualDirectory_t dirID, const PLPasStr &name);
+	// If streamFrames is set, only a short run of frames ahead of playback is kept in memory, and upcoming
+	// frames are decompressed on a worker thread.  Otherwise, every frame is loaded up front.
+	PLError_t Load(PortabilityLayer::VirtualDirectory_t dirID, const PLPasStr &name, bool streamFrames);
 
-	const THandle<BitmapImage> &GetFrame(size_t index) const;
+	// When streaming, the returned frame is only valid until the next call to GetFrame
+	THandle<BitmapImage> GetFrame(size_t index);
+	const Rect &GetFrameRect() const;
 	size_t NumFrames() const;
 	uint32_t GetFrameRateNumerator() const;
 	uint32_t GetFrameRateDenominator() const;
 
 private:
+	struct StreamedFrame;
+
+	static const size_t kMaxStreamedFrames = 16;
+
 	explicit AnimationPackage();
 	~AnimationPackage();
 
+	PLError_t IndexFrames();
+	PLError_t PreloadFrames();
+	PLError_t StartStreaming();
+
+	bool IsInStreamWindow(size_t frameIndex, size_t currentIndex) const;
+	StreamedFrame *AcquireStreamedFrame(size_t index);
+	void RecycleStreamedFrames(size_t currentIndex);
+	void QueueStreamedFrames(size_t currentIndex);
+	bool LoadStreamedFrame(StreamedFrame &frame, size_t index);
+	void ReleaseStreamedFrame(size_t slotIndex);
+	void StopStreaming();
+	size_t GetResidentFrameBytes() const;
+
+	static void DecodeStreamedFrame(StreamedFrame &frame);
+	static void StaticDecodeStreamedFrame(void *context, size_t slotIndex);
+
 	THandle<BitmapImage> *m_images;
 	PortabilityLayer::IResourceArchive *m_resArchive;
 	PortabilityLayer::CompositeFile *m_compositeFile;
 	size_t m_numImages;
+	Rect m_frameRect;
+
+	StreamedFrame *m_streamedFrames;
+	PortabilityLayer::MMHandleBlock *m_streamedFrameBlock;
+	PortabilityLayer::WorkerSlots *m_streamSlots;	// Slot i is the state of m_streamedFrames[i]
+	size_t m_numFramesAhead;
+	bool m_isStreaming;
 
 	uint32_t m_frameRateNumerator;
 	uint32_t m_frameRateDenominator;
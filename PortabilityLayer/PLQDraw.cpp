@@ -1,6 +1,7 @@
 #include "PLQDraw.h"
 #include "QDManager.h"
 #include "BitmapImage.h"
+#include "BlitKernels.h"
 #include "DisplayDeviceManager.h"
 #include "EllipsePlotter.h"
 #include "FontFamily.h"
@@ -23,6 +24,7 @@
 #include "QDStandardPalette.h"
 #include "ResolveCachingColor.h"
 #include "TextPlacer.h"
+#include "TextRunCache.h"
 #include "WindowManager.h"
 #include "QDGraf.h"
 #include "QDPixMap.h"
@@ -48,6 +50,14 @@ static inline void InvertPixel32(uint8_t *pixel)
 	pixel[3] = 255;
 }
 
+static void SetBitMapDirtyRect(BitMap *bitmap, const Rect &rect)
+{
+	// Every BitMap that can be a blit target is a PixMapImpl
+	PortabilityLayer::QDPort *port = static_cast<PortabilityLayer::PixMapImpl*>(bitmap)->GetOwnerPort();
+	if (port)
+		port->SetDirtyRect(rect);
+}
+
 void EndUpdate(WindowPtr graf)
 {
 	graf->GetDrawSurface()->m_port.SetDirty(PortabilityLayer::QDPortDirtyFlag_Contents);
@@ -115,6 +125,8 @@ static void PlotLine(DrawSurface *surface, const PortabilityLayer::Vec2i &pointA
 	const size_t plotRowStartOffset = static_cast<size_t>(currentPoint.m_y) * pitch;
 	const size_t plotLimit = pixMap->GetPitch() * (pixMap->m_rect.bottom - pixMap->m_rect.top);
 
+	port->SetDirtyRect(constrainedRect);
+
 	switch (pixelFormat)
 	{
 	case GpPixelFormats::k8BitStandard:
@@ -231,23 +243,69 @@ static void PlotLine(DrawSurface *surface, const PortabilityLayer::Vec2i &pointA
 		PL_NotYetImplemented();
 		return;
 	}
+}
+
+// Colors and AA tables used to blend glyph coverage, resolved once per string
+struct GlyphBlendParams
+{
+	GpPixelFormat_t m_pixelFormat;
+	const PortabilityLayer::AntiAliasTable *m_aaTables[3];
+	uint8_t m_solidColor[3];
+};
+
+static bool ResolveGlyphBlendParams(GpPixelFormat_t pixelFormat, bool isAA, PortabilityLayer::ResolveCachingColor &cacheColor, GlyphBlendParams &outParams)
+{
+	outParams.m_pixelFormat = pixelFormat;
+	for (int ch = 0; ch < 3; ch++)
+	{
+		outParams.m_aaTables[ch] = nullptr;
+		outParams.m_solidColor[ch] = 0;
+	}
 
-	surface->m_port.SetDirty(PortabilityLayer::QDPortDirtyFlag_Contents);
+	// Full coverage blends to the same value regardless of the existing pixel, so the kernels can store it directly
+	switch (pixelFormat)
+	{
+	case GpPixelFormats::k8BitStandard:
+		if (isAA)
+		{
+			const PortabilityLayer::AntiAliasTable *aaTable = &PortabilityLayer::StandardPalette::GetInstance()->GetCachedPaletteAATable(cacheColor.GetRGBAColor());
+			outParams.m_aaTables[0] = aaTable;
+			outParams.m_solidColor[0] = aaTable->m_aaTranslate[0][15];
+		}
+		else
+			outParams.m_solidColor[0] = cacheColor.Resolve8(nullptr, 0);
+		return true;
+	case GpPixelFormats::kRGB32:
+		{
+			const PortabilityLayer::RGBAColor color = cacheColor.GetRGBAColor();
+			const uint8_t rgbColor[3] = { color.r, color.g, color.b };
+
+			for (int ch = 0; ch < 3; ch++)
+			{
+				if (isAA)
+				{
+					const PortabilityLayer::AntiAliasTable *aaTable = &PortabilityLayer::StandardPalette::GetInstance()->GetCachedToneAATable(rgbColor[ch]);
+					outParams.m_aaTables[ch] = aaTable;
+					outParams.m_solidColor[ch] = aaTable->m_aaTranslate[0][15];
+				}
+				else
+					outParams.m_solidColor[ch] = rgbColor[ch];
+			}
+		}
+		return true;
+	default:
+		PL_NotYetImplemented();
+		return false;
+	}
 }
 
-static void DrawGlyph(PixMap *pixMap, const Rect &rect, const Point &penPos, const PortabilityLayer::RenderedFont *rfont, unsigned int character, PortabilityLayer::ResolveCachingColor &cacheColor)
+// Blends one glyph, either from unpacked coverage (one level per pixel) or from the font's packed glyph data
+static bool DrawGlyph(PixMap *pixMap, const Rect &rect, int32_t leftCoord, int32_t topCoord, uint32_t glyphWidth, uint32_t glyphHeight, const uint8_t *coverage, const void *packedData, size_t packedPitch, bool isAA, const GlyphBlendParams &blendParams, Rect &outDrawnRect)
 {
 	assert(rect.IsValid());
 
-	const GpRenderedGlyphMetrics *metrics;
-	const void *data;
-	if (!rfont->GetGlyph(character, metrics, data))
-		return;
-
-	const int32_t leftCoord = penPos.h + metrics->m_bearingX;
-	const int32_t topCoord = penPos.v - metrics->m_bearingY;
-	const int32_t rightCoord = leftCoord + metrics->m_glyphWidth;
-	const int32_t bottomCoord = topCoord + metrics->m_glyphHeight;
+	const int32_t rightCoord = leftCoord + static_cast<int32_t>(glyphWidth);
+	const int32_t bottomCoord = topCoord + static_cast<int32_t>(glyphHeight);
 
 	const int32_t clampedLeftCoord = std::max<int32_t>(leftCoord, rect.left);
 	const int32_t clampedTopCoord = std::max<int32_t>(topCoord, rect.top);
@@ -255,7 +313,9 @@ static void DrawGlyph(PixMap *pixMap, const Rect &rect, const Point &penPos, con
 	const int32_t clampedBottomCoord = std::min<int32_t>(bottomCoord, rect.bottom);
 
 	if (clampedLeftCoord >= clampedRightCoord || clampedTopCoord >= clampedBottomCoord)
-		return;
+		return false;
+
+	outDrawnRect = Rect::Create(clampedTopCoord, clampedLeftCoord, clampedBottomCoord, clampedRightCoord);
 
 	const uint32_t firstOutputRow = clampedTopCoord;
 	const uint32_t firstOutputCol = clampedLeftCoord;
@@ -266,125 +326,99 @@ static void DrawGlyph(PixMap *pixMap, const Rect &rect, const Point &penPos, con
 	const uint32_t numCols = clampedRightCoord - clampedLeftCoord;
 	const uint32_t numRows = clampedBottomCoord - clampedTopCoord;
 
-	const size_t inputPitch = metrics->m_glyphDataPitch;
+	const size_t bytesPerPixel = (blendParams.m_pixelFormat == GpPixelFormats::k8BitStandard) ? 1 : 4;
 	const size_t outputPitch = pixMap->m_pitch;
-	const uint8_t *firstInputRowData = static_cast<const uint8_t*>(data) + firstInputRow * inputPitch;
+	uint8_t *firstOutputRowData = static_cast<uint8_t*>(pixMap->m_data) + firstOutputRow * outputPitch + firstOutputCol * bytesPerPixel;
 
-	const bool isAA = rfont->IsAntiAliased();
+	const PortabilityLayer::BlitKernels *kernels = PortabilityLayer::BlitKernels::GetInstance();
 
-	switch (pixMap->m_pixelFormat)
-	{
-	case GpPixelFormats::k8BitStandard:
-		{
-			uint8_t *firstOutputRowData = static_cast<uint8_t*>(pixMap->m_data) + firstOutputRow * outputPitch;
+	const uint32_t kUnpackChunkSize = 256;
+	uint8_t unpackedCoverage[kUnpackChunkSize];
 
-			const PortabilityLayer::AntiAliasTable *aaTable = nullptr;
+	for (uint32_t row = 0; row < numRows; row++)
+	{
+		uint8_t *outputRowData = firstOutputRowData + row * outputPitch;
 
-			if (isAA)
-				aaTable = &PortabilityLayer::StandardPalette::GetInstance()->GetCachedPaletteAATable(cacheColor.GetRGBAColor());
+		for (uint32_t chunkStart = 0; chunkStart < numCols; chunkStart += kUnpackChunkSize)
+		{
+			const uint32_t chunkCols = std::min<uint32_t>(numCols - chunkStart, kUnpackChunkSize);
 
-			const uint8_t color = cacheColor.Resolve8(nullptr, 0);
-			for (uint32_t row = 0; row < numRows; row++)
+			const uint8_t *rowCoverage = unpackedCoverage;
+			if (coverage)
+				rowCoverage = coverage + (firstInputRow + row) * glyphWidth + firstInputCol + chunkStart;
+			else
 			{
-				const uint8_t *inputRowData = firstInputRowData + row * inputPitch;
-				uint8_t *outputRowData = firstOutputRowData + row * outputPitch;
-
-				// It should be possible to speed this up, if needed.  The input is guaranteed to be well-aligned and not mutable within this loop.
-				if (isAA)
-				{
-					for (uint32_t col = 0; col < numCols; col++)
-					{
-						const size_t inputOffset = firstInputCol + col;
-
-						const unsigned int grayLevel = (inputRowData[inputOffset / 2] >> ((inputOffset & 1) * 4)) & 0xf;
-						uint8_t &targetPixel = outputRowData[firstOutputCol + col];
-
-						targetPixel = aaTable->m_aaTranslate[targetPixel][grayLevel];
-					}
-				}
-				else
-				{
-					for (uint32_t col = 0; col < numCols; col++)
-					{
-						const size_t inputOffset = firstInputCol + col;
-						if (inputRowData[inputOffset / 8] & (1 << (inputOffset & 0x7)))
-							outputRowData[firstOutputCol + col] = color;
-					}
-				}
+				const uint8_t *inputRowData = static_cast<const uint8_t*>(packedData) + (firstInputRow + row) * packedPitch;
+				PortabilityLayer::TextRunCache::UnpackGlyphRow(inputRowData, isAA, firstInputCol + chunkStart, chunkCols, unpackedCoverage);
 			}
+
+			uint8_t *outputChunkData = outputRowData + chunkStart * bytesPerPixel;
+			if (bytesPerPixel == 1)
+				kernels->m_blendGlyphRow8(outputChunkData, rowCoverage, chunkCols, blendParams.m_aaTables[0], blendParams.m_solidColor[0]);
+			else
+				kernels->m_blendGlyphRow32(outputChunkData, rowCoverage, chunkCols, blendParams.m_aaTables, blendParams.m_solidColor);
 		}
-		break;
-	case GpPixelFormats::kRGB32:
-		{
-			uint8_t *firstOutputRowData = static_cast<uint8_t*>(pixMap->m_data) + firstOutputRow * outputPitch;
+	}
 
-			const PortabilityLayer::RGBAColor color = cacheColor.GetRGBAColor();
-			uint8_t colorRGB[3] = { color.r, color.g, color.b };
+	return true;
+}
 
-			const PortabilityLayer::AntiAliasTable *aaTables[3] = { nullptr, nullptr, nullptr };
+static void AccumulateDrawnRect(const Rect &glyphRect, bool &haveDrawnRect, Rect &drawnRect)
+{
+	if (!haveDrawnRect)
+	{
+		drawnRect = glyphRect;
+		haveDrawnRect = true;
+	}
+	else
+		drawnRect = Rect::Create(std::min(drawnRect.top, glyphRect.top), std::min(drawnRect.left, glyphRect.left), std::max(drawnRect.bottom, glyphRect.bottom), std::max(drawnRect.right, glyphRect.right));
+}
 
-			if (isAA)
-			{
-				PortabilityLayer::RGBAColor rgbaColor = cacheColor.GetRGBAColor();
-				uint8_t rgbColor[3] = { rgbaColor.r, rgbaColor.g, rgbaColor.b };
+static void DrawText(const PortabilityLayer::Vec2i &basePoint, int32_t spanWidth, const PLPasStr &str, PixMap *pixMap, const Rect &rect, PortabilityLayer::RenderedFont *rfont, PortabilityLayer::ResolveCachingColor &cacheColor, PortabilityLayer::QDPort *port)
+{
+	const bool isAA = rfont->IsAntiAliased();
 
-				for (int ch = 0; ch < 3; ch++)
-					aaTables[ch] = &PortabilityLayer::StandardPalette::GetInstance()->GetCachedToneAATable(rgbColor[ch]);
-			}
+	GlyphBlendParams blendParams;
+	if (!ResolveGlyphBlendParams(pixMap->m_pixelFormat, isAA, cacheColor, blendParams))
+		return;
 
-			for (uint32_t row = 0; row < numRows; row++)
-			{
-				const uint8_t *inputRowData = firstInputRowData + row * inputPitch;
-				uint8_t *outputRowData = firstOutputRowData + row * outputPitch;
+	bool haveDrawnRect = false;
+	Rect drawnRect = Rect::Create(0, 0, 0, 0);
 
-				// It should be possible to speed this up, if needed.  The input is guaranteed to be well-aligned and not mutable within this loop.
-				if (isAA)
-				{
-					for (uint32_t col = 0; col < numCols; col++)
-					{
-						const size_t inputOffset = firstInputCol + col;
+	PortabilityLayer::TextRun run;
+	if (PortabilityLayer::TextRunCache::GetInstance()->GetTextRun(rfont, spanWidth, str, run))
+	{
+		for (size_t i = 0; i < run.m_numGlyphs; i++)
+		{
+			const PortabilityLayer::TextRunGlyph &glyph = run.m_glyphs[i];
 
-						const unsigned int grayLevel = (inputRowData[inputOffset / 2] >> ((inputOffset & 1) * 4)) & 0xf;
-						uint8_t *targetPixel = outputRowData + (firstOutputCol + col) * 4;
+			Rect glyphRect;
+			if (DrawGlyph(pixMap, rect, basePoint.m_x + glyph.m_left, basePoint.m_y + glyph.m_top, glyph.m_width, glyph.m_height, glyph.m_coverage, nullptr, 0, isAA, blendParams, glyphRect))
+				AccumulateDrawnRect(glyphRect, haveDrawnRect, drawnRect);
+		}
+	}
+	else
+	{
+		PortabilityLayer::TextPlacer placer(basePoint, spanWidth, rfont, str);
 
-						if (grayLevel > 0)
-						{
-							for (int ch = 0; ch < 3; ch++)
-								targetPixel[ch] = aaTables[ch]->m_aaTranslate[targetPixel[ch]][grayLevel];
-						}
-					}
-				}
-				else
-				{
-					for (uint32_t col = 0; col < numCols; col++)
-					{
-						uint8_t *targetPixel = outputRowData + (firstOutputCol + col) * 4;
+		PortabilityLayer::GlyphPlacementCharacteristics characteristics;
+		while (placer.PlaceGlyph(characteristics))
+		{
+			if (characteristics.m_haveGlyph)
+			{
+				const GpRenderedGlyphMetrics *metrics = characteristics.m_glyphMetrics;
+				const int32_t leftCoord = characteristics.m_glyphStartPos.m_x + metrics->m_bearingX;
+				const int32_t topCoord = characteristics.m_glyphStartPos.m_y - metrics->m_bearingY;
 
-						const size_t inputOffset = firstInputCol + col;
-						if (inputRowData[inputOffset / 8] & (1 << (inputOffset & 0x7)))
-						{
-							targetPixel[0] = color.r;
-							targetPixel[1] = color.g;
-							targetPixel[2] = color.b;
-						}
-					}
-				}
+				Rect glyphRect;
+				if (DrawGlyph(pixMap, rect, leftCoord, topCoord, metrics->m_glyphWidth, metrics->m_glyphHeight, nullptr, characteristics.m_glyphData, metrics->m_glyphDataPitch, isAA, blendParams, glyphRect))
+					AccumulateDrawnRect(glyphRect, haveDrawnRect, drawnRect);
 			}
 		}
-		break;
-	default:
-		PL_NotYetImplemented();
 	}
-}
 
-static void DrawText(PortabilityLayer::TextPlacer &placer, PixMap *pixMap, const Rect &rect, const PortabilityLayer::RenderedFont *rfont, PortabilityLayer::ResolveCachingColor &cacheColor)
-{
-	PortabilityLayer::GlyphPlacementCharacteristics characteristics;
-	while (placer.PlaceGlyph(characteristics))
-	{
-		if (characteristics.m_haveGlyph)
-			DrawGlyph(pixMap, rect, Point::Create(characteristics.m_glyphStartPos.m_x, characteristics.m_glyphStartPos.m_y), rfont, characteristics.m_character, cacheColor);
-	}
+	if (haveDrawnRect)
+		port->SetDirtyRect(drawnRect);
 }
 
 void DrawSurface::DrawString(const Point &point, const PLPasStr &str, PortabilityLayer::ResolveCachingColor &cacheColor, PortabilityLayer::RenderedFont *font)
@@ -405,11 +439,7 @@ void DrawSurface::DrawStringConstrained(const Point &point, const PLPasStr &str,
 	if (!rect.IsValid())
 		return;
 
-	PortabilityLayer::TextPlacer placer(PortabilityLayer::Vec2i(point.h, point.v), -1, rfont, str);
-
-	DrawText(placer, pixMap, rect, rfont, cacheColor);
-
-	m_port.SetDirty(PortabilityLayer::QDPortDirtyFlag_Contents);
+	DrawText(PortabilityLayer::Vec2i(point.h, point.v), -1, str, pixMap, rect, rfont, cacheColor, port);
 }
 
 void DrawSurface::DrawStringWrap(const Point &point, const Rect &constrainRect, const PLPasStr &str, PortabilityLayer::ResolveCachingColor &cacheColor, PortabilityLayer::RenderedFont *rfont)
@@ -430,11 +460,7 @@ void DrawSurface::DrawStringWrap(const Point &point, const Rect &constrainRect,
 	if (!limitRect.IsValid() || !areaRect.IsValid())
 		return;	// ???
 
-	PortabilityLayer::TextPlacer placer(PortabilityLayer::Vec2i(point.h, point.v), areaRect.Width(), rfont, str);
-
-	DrawText(placer, pixMap, limitRect, rfont, cacheColor);
-
-	m_port.SetDirty(PortabilityLayer::QDPortDirtyFlag_Contents);
+	DrawText(PortabilityLayer::Vec2i(point.h, point.v), areaRect.Width(), str, pixMap, limitRect, rfont, cacheColor, port);
 }
 
 struct ErrorDiffusionWorkPixel
@@ -600,8 +626,6 @@ void DrawSurface::DrawPicture(THandle<BitmapImage> pictHdl, const Rect &bounds,
 
 		PortabilityLayer::PixMapImpl::Destroy(scaled);
 
-		m_port.SetDirty(PortabilityLayer::QDPortDirtyFlag_Contents);
-
 		return;
 	}
 
@@ -1163,7 +1187,7 @@ void DrawSurface::DrawPicture(THandle<BitmapImage> pictHdl, const Rect &bounds,
 		return;
 	};
 
-	m_port.SetDirty(PortabilityLayer::QDPortDirtyFlag_Contents);
+	m_port.SetDirtyRect(bounds);
 }
 
 void DrawSurface::FillRect(const Rect &rect, PortabilityLayer::ResolveCachingColor &cacheColor)
@@ -1224,7 +1248,7 @@ void DrawSurface::FillRect(const Rect &rect, PortabilityLayer::ResolveCachingCol
 		return;
 	}
 
-	m_port.SetDirty(PortabilityLayer::QDPortDirtyFlag_Contents);
+	m_port.SetDirtyRect(constrainedRect);
 }
 
 void DrawSurface::FillRectWithMaskPattern8x8(const Rect &rect, const uint8_t *pattern, PortabilityLayer::ResolveCachingColor &cacheColor)
@@ -1303,7 +1327,7 @@ void DrawSurface::FillRectWithMaskPattern8x8(const Rect &rect, const uint8_t *pa
 		return;
 	}
 
-	m_port.SetDirty(PortabilityLayer::QDPortDirtyFlag_Contents);
+	m_port.SetDirtyRect(constrainedRect);
 }
 
 void DrawSurface::FillEllipse(const Rect &rect, PortabilityLayer::ResolveCachingColor &cacheColor)
@@ -1425,7 +1449,7 @@ void DrawSurface::FrameEllipse(const Rect &rect, PortabilityLayer::ResolveCachin
 		return;
 	}
 
-	m_port.SetDirty(PortabilityLayer::QDPortDirtyFlag_Contents);
+	m_port.SetDirtyRect(constrainedRect);
 }
 
 static void FillScanlineSpan8(uint8_t *rowStart, size_t startCol, size_t endCol, uint8_t patternByte, uint8_t foreColor)
@@ -1628,7 +1652,7 @@ void DrawSurface::FillScanlineMaskWithMaskPattern(const PortabilityLayer::Scanli
 		}
 	}
 
-	m_port.SetDirty(PortabilityLayer::QDPortDirtyFlag_Contents);
+	m_port.SetDirtyRect(constrainedRect);
 }
 
 
@@ -1668,8 +1692,6 @@ void DrawSurface::FrameRect(const Rect &rect, PortabilityLayer::ResolveCachingCo
 		edgeRect.top = edgeRect.bottom - 1;
 		FillRect(edgeRect, cacheColor);
 	}
-
-	m_port.SetDirty(PortabilityLayer::QDPortDirtyFlag_Contents);
 }
 
 void DrawSurface::FrameRoundRect(const Rect &rect, int quadrantWidth, int quadrantHeight, PortabilityLayer::ResolveCachingColor &cacheColor)
@@ -1769,7 +1791,7 @@ void DrawSurface::InvertFillRect(const Rect &rect, const uint8_t *pattern)
 		return;
 	}
 
-	m_port.SetDirty(PortabilityLayer::QDPortDirtyFlag_Contents);
+	m_port.SetDirtyRect(constrainedRect);
 }
 
 void InsetRect(Rect *rect, int x, int y)
@@ -1988,7 +2010,33 @@ static void CopyBitsComplete(const BitMap *srcBitmap, const BitMap *maskBitmap8,
 		const size_t numCopiedCols = srcRect.right - srcRect.left;
 		const size_t numCopiedBytesPerScanline = numCopiedCols * pixelSizeBytes;
 
+		const PortabilityLayer::BlitKernels *blitKernels = PortabilityLayer::BlitKernels::GetInstance();
+
+		PortabilityLayer::BlitKernels::MaskedRowFunc_t maskedRowFunc = nullptr;
+		size_t maskPixelSizeBytes = 0;
 		if (maskBitmap8)
+		{
+			maskPixelSizeBytes = 1;
+			if (pixelSizeBytes == 1)
+				maskedRowFunc = blitKernels->m_copyMask8Row8;
+			else if (pixelSizeBytes == 4)
+				maskedRowFunc = blitKernels->m_copyMask8Row32;
+		}
+		else if (maskBitmap32)
+		{
+			maskPixelSizeBytes = 4;
+			if (pixelSizeBytes == 4)
+				maskedRowFunc = blitKernels->m_copyMask32Row32;
+		}
+
+		if (maskedRowFunc)
+		{
+			const size_t firstMaskByte = firstMaskRowByte + maskFirstCol * maskPixelSizeBytes;
+
+			for (size_t i = 0; i < numCopiedRows; i++)
+				maskedRowFunc(destBytes + firstDestByte + i * destPitch, srcBytes + firstSrcByte + i * srcPitch, maskBytes + firstMaskByte + i * maskPitch, numCopiedCols);
+		}
+		else if (maskBitmap8)
 		{
 			for (size_t i = 0; i < numCopiedRows; i++)
 			{
@@ -2054,6 +2102,8 @@ static void CopyBitsComplete(const BitMap *srcBitmap, const BitMap *maskBitmap8,
 				memcpy(destBytes + firstDestByte + i * destPitch, srcBytes + firstSrcByte + i * srcPitch, numCopiedBytesPerScanline);
 		}
 	}
+
+	SetBitMapDirtyRect(destBitmap, destRect);
 }
 
 void CopyBits(const BitMap *srcBitmap, BitMap *destBitmap, const Rect *srcRectBase, const Rect *destRectBase, CopyBitsMode copyMode)
@@ -2150,6 +2200,8 @@ void ImageInvert(const PixMap *invertMask, PixMap *targetBitmap, const Rect &src
 			break;
 		}
 	}
+
+	SetBitMapDirtyRect(targetBitmap, constrainedDestRect);
 }
 
 bool PointInScanlineMask(Point point, PortabilityLayer::ScanlineMask *scanlineMask)
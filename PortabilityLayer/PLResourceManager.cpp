@@ -2,6 +2,8 @@
 
 #include "BinarySearch.h"
 #include "BMPFormat.h"
+#include "DecodedImageCache.h"
+#include "DeflateCodec.h"
 #include "FileManager.h"
 #include "GPArchive.h"
 #include "IGpDirectoryCursor.h"
@@ -14,6 +16,7 @@
 #include "MMHandleBlock.h"
 #include "ResourceCompiledTypeList.h"
 #include "ResourceFile.h"
+#include "SoundCache.h"
 #include "VirtualDirectory.h"
 #include "WaveFormat.h"
 #include "ZipFileProxy.h"
@@ -42,10 +45,23 @@ typedef ResourceValidationRules::ResourceValidationRule ResourceValidationRule_t
 
 namespace PortabilityLayer
 {
+	struct ResourceArchiveIndexEntry
+	{
+		ResTypeID m_resTypeID;
+		int16_t m_resID;
+		uint32_t m_fileIndex;
+	};
+
+	struct ResourceArchiveTypeSummary
+	{
+		ResTypeID m_resTypeID;
+		int16_t m_lowestID;
+	};
+
 	class ResourceArchiveZipFileIterator : public IResourceIterator
 	{
 	public:
-		explicit ResourceArchiveZipFileIterator(PortabilityLayer::ZipFileProxy *proxy);
+		explicit ResourceArchiveZipFileIterator(const PortabilityLayer::ResourceArchiveIndex &index);
 
 		void Destroy() override;
 		bool GetOne(ResTypeID &resTypeID, int16_t &outID) override;
@@ -53,16 +69,16 @@ namespace PortabilityLayer
 	private:
 		~ResourceArchiveZipFileIterator();
 
-		PortabilityLayer::ZipFileProxy *m_proxy;
-		size_t m_numFiles;
+		const PortabilityLayer::ResourceArchiveIndexEntry *m_entries;
+		size_t m_numEntries;
 		size_t m_currentIndex;
 	};
 }
 
 
-PortabilityLayer::ResourceArchiveZipFileIterator::ResourceArchiveZipFileIterator(PortabilityLayer::ZipFileProxy *proxy)
-	: m_proxy(proxy)
-	, m_numFiles(proxy->NumFiles())
+PortabilityLayer::ResourceArchiveZipFileIterator::ResourceArchiveZipFileIterator(const PortabilityLayer::ResourceArchiveIndex &index)
+	: m_entries(index.m_entries)
+	, m_numEntries(index.m_numEntries)
 	, m_currentIndex(0)
 {
 }
@@ -75,20 +91,14 @@ void PortabilityLayer::ResourceArchiveZipFileIterator::Destroy()
 
 bool PortabilityLayer::ResourceArchiveZipFileIterator::GetOne(ResTypeID &resTypeID, int16_t &outID)
 {
-	while (m_currentIndex != m_numFiles)
-	{
-		const size_t index = m_currentIndex++;
-
-		const char *name = nullptr;
-		size_t nameLength = 0;
-		m_proxy->GetFileName(index, name, nameLength);
+	if (m_currentIndex == m_numEntries)
+		return false;
 
-		const bool isParseable = ResourceArchiveZipFile::ParseResFromName(name, nameLength, resTypeID, outID);
-		if (isParseable)
-			return true;
-	}
+	const PortabilityLayer::ResourceArchiveIndexEntry &entry = m_entries[m_currentIndex++];
+	resTypeID = entry.m_resTypeID;
+	outID = entry.m_resID;
 
-	return false;
+	return true;
 }
 
 PortabilityLayer::ResourceArchiveZipFileIterator::~ResourceArchiveZipFileIterator()
@@ -324,6 +334,27 @@ namespace PortabilityLayer
 		return extension;
 	}
 
+	bool ResourceArchiveBase::DecodeStoredResource(const ResTypeID &resTypeID, const void *storedData, size_t storedSize, bool isDeflated, void *outContents, size_t size)
+	{
+		if (isDeflated)
+		{
+			if (!DeflateCodec::DecompressBuffer(storedData, storedSize, outContents, size))
+				return false;
+		}
+		else
+		{
+			if (storedSize != size)
+				return false;
+
+			memcpy(outContents, storedData, size);
+		}
+
+		int validationRule = 0;
+		GetFileExtensionForResType(resTypeID, validationRule);
+
+		return validationRule == ResourceValidationRules::kNone || ValidateResource(outContents, size, static_cast<ResourceValidationRule_t>(validationRule));
+	}
+
 	// ===========================================================================================
 
 	ResourceArchiveRef::ResourceArchiveRef()
@@ -333,6 +364,16 @@ namespace PortabilityLayer
 	{
 	}
 
+	ResourceArchiveIndex::ResourceArchiveIndex()
+		: m_entries(nullptr)
+		, m_numEntries(0)
+		, m_slots(nullptr)
+		, m_slotMask(0)
+		, m_types(nullptr)
+		, m_numTypes(0)
+	{
+	}
+
 	// ===========================================================================================
 
 	ResourceArchiveZipFile *ResourceArchiveZipFile::Create(ZipFileProxy *zipFileProxy, bool proxyIsShared, GpIOStream *stream)
@@ -352,18 +393,29 @@ namespace PortabilityLayer
 				new (refs + i) ResourceArchiveRef();
 		}
 
+		ResourceArchiveIndex index;
+		if (!BuildIndex(zipFileProxy, index))
+		{
+			mm->Release(refs);
+			return nullptr;
+		}
+
 		void *storage = mm->Alloc(sizeof(ResourceArchiveZipFile));
 		if (!storage)
 		{
+			mm->Release(index.m_entries);
 			mm->Release(refs);
 			return nullptr;
 		}
 
-		return new (storage) ResourceArchiveZipFile(zipFileProxy, proxyIsShared, stream, refs);
+		return new (storage) ResourceArchiveZipFile(zipFileProxy, proxyIsShared, stream, refs, index);
 	}
 
 	void ResourceArchiveZipFile::Destroy()
 	{
+		DecodedImageCache::GetInstance()->PurgeArchive(this);
+		SoundCache::GetInstance()->PurgeArchive(this);
+
 		this->~ResourceArchiveZipFile();
 		PortabilityLayer::MemoryManager::GetInstance()->Release(this);
 	}
@@ -373,119 +425,95 @@ namespace PortabilityLayer
 		return GetResource(resTypeID, id, true);
 	}
 
-	bool ResourceArchiveZipFile::HasAnyResourcesOfType(const ResTypeID &resTypeID) const
-	{
-		char resPrefix[6];
-		resTypeID.ExportAsChars(resPrefix);
-		resPrefix[4] = '/';
-		resPrefix[5] = '\0';
-
-		return m_zipFileProxy->HasPrefix(resPrefix);
-	}
-
-	bool ResourceArchiveZipFile::FindFirstResourceOfType(const ResTypeID &resTypeID, int16_t &outID) const
+	bool ResourceArchiveZipFile::MapResource(const ResTypeID &resTypeID, int id, const void *&outContents, size_t &outSize) const
 	{
-		char resPrefix[6];
-		resTypeID.ExportAsChars(resPrefix);
-		resPrefix[4] = '/';
-		resPrefix[5] = '\0';
-
-		size_t firstFileIndex = 0;
-		if (!m_zipFileProxy->FindFirstWithPrefix(resPrefix, firstFileIndex))
+		int validationRule = 0;
+		size_t index = 0;
+		if (!IndexResource(resTypeID, id, index, validationRule))
 			return false;
 
-		const size_t numFiles = m_zipFileProxy->NumFiles();
-
-		bool haveAny = false;
-		int16_t lowestID = 32767;
-
-		for (size_t fileIndex = firstFileIndex; fileIndex < numFiles; fileIndex++)
-		{
-			const char *resName = nullptr;
-			size_t fnLength = 0;
-			m_zipFileProxy->GetFileName(fileIndex, resName, fnLength);
-
-			if (fnLength <= 5 || memcmp(resName, resPrefix, 5))
-				break;
-
-			const char *idChars = resName + 5;
-			size_t idCharsRemaining = fnLength - 5;
+		const size_t resSize = m_zipFileProxy->GetFileSize(index);
+		if (resSize == 0 || resSize > kMaxResourceSize)
+			return false;
 
-			const size_t extLength = strlen(kPICTExtension);
+		const void *contents = nullptr;
+		if (!m_zipFileProxy->MapStoredFile(index, contents))
+			return false;
 
-			if (idCharsRemaining <= extLength)
-				continue;
+		if (validationRule != ResourceValidationRules::kNone && !ValidateResource(contents, resSize, static_cast<ResourceValidationRule_t>(validationRule)))
+			return false;
 
-			if (memcmp(idChars + idCharsRemaining - extLength, kPICTExtension, extLength))
-				continue;
+		outContents = contents;
+		outSize = resSize;
+		return true;
+	}
 
-			idCharsRemaining -= extLength;
+	bool ResourceArchiveZipFile::LoadStoredResource(const ResTypeID &resTypeID, int id, void *&outStoredData, size_t &outStoredSize, size_t &outSize, bool &outIsDeflated) const
+	{
+		int validationRule = 0;
+		size_t index = 0;
+		if (!IndexResource(resTypeID, id, index, validationRule))
+			return false;
 
-			bool isNegative = false;
+		const size_t resSize = m_zipFileProxy->GetFileSize(index);
+		const size_t storedSize = m_zipFileProxy->GetStoredFileSize(index);
+		if (resSize == 0 || resSize > kMaxResourceSize || storedSize == 0 || storedSize > kMaxResourceSize)
+			return false;
 
-			if (idChars[0] == '-')
-			{
-				isNegative = true;
-				idCharsRemaining--;
-				idChars++;
-			}
+		MemoryManager *mm = MemoryManager::GetInstance();
 
-			if (idCharsRemaining == 0)
-				continue;
+		void *storedData = mm->Alloc(storedSize);
+		if (!storedData)
+			return false;
 
-			if (idChars[0] == '0' && (idCharsRemaining > 1 || isNegative))
-				continue;
+		bool isDeflated = false;
+		if (!m_zipFileProxy->LoadStoredFile(index, storedData, isDeflated))
+		{
+			mm->Release(storedData);
+			return false;
+		}
 
-			int32_t resID = 0;
-			bool failedName = false;
-			while (idCharsRemaining)
-			{
-				const char idChar = *idChars;
+		outStoredData = storedData;
+		outStoredSize = storedSize;
+		outSize = resSize;
+		outIsDeflated = isDeflated;
+		return true;
+	}
 
-				if (idChar < '0' || idChar > '9')
-				{
-					failedName = true;
-					break;
-				}
+	GpIOStream *ResourceArchiveZipFile::OpenResourceStream(const ResTypeID &resTypeID, int id) const
+	{
+		int validationRule = 0;
+		size_t index = 0;
+		if (!IndexResource(resTypeID, id, index, validationRule))
+			return nullptr;
 
-				resID = resID * 10;
-				if (isNegative)
-				{
-					resID -= (idChar - '0');
-					if (resID < -32768)
-					{
-						failedName = true;
-						break;
-					}
-				}
-				else
-				{
-					resID += (idChar - '0');
-					if (resID > 32767)
-					{
-						failedName = true;
-						break;
-					}
-				}
+		const size_t resSize = m_zipFileProxy->GetFileSize(index);
+		if (resSize == 0 || resSize > kMaxResourceSize)
+			return nullptr;
 
-				idChars++;
-				idCharsRemaining--;
-			}
+		return m_zipFileProxy->OpenFile(index);
+	}
 
-			if (failedName)
-				continue;
+	bool ResourceArchiveZipFile::HasResource(const ResTypeID &resTypeID, int id) const
+	{
+		int validationRule = 0;
+		size_t index = 0;
+		return IndexResource(resTypeID, id, index, validationRule);
+	}
 
-			if (haveAny == false || resID < lowestID)
-			{
-				lowestID = resID;
-				haveAny = true;
-			}
-		}
+	bool ResourceArchiveZipFile::HasAnyResourcesOfType(const ResTypeID &resTypeID) const
+	{
+		return FindTypeSummary(resTypeID) != nullptr;
+	}
 
-		if (haveAny)
-			outID = static_cast<int16_t>(lowestID);
+	bool ResourceArchiveZipFile::FindFirstResourceOfType(const ResTypeID &resTypeID, int16_t &outID) const
+	{
+		const ResourceArchiveTypeSummary *typeSummary = FindTypeSummary(resTypeID);
+		if (!typeSummary)
+			return false;
 
-		return haveAny;
+		outID = typeSummary->m_lowestID;
+		return true;
 	}
 
 	IResourceIterator *ResourceArchiveZipFile::EnumerateResources() const
@@ -495,7 +523,7 @@ namespace PortabilityLayer
 		if (!storage)
 			return nullptr;
 
-		return new (storage) ResourceArchiveZipFileIterator(m_zipFileProxy);
+		return new (storage) ResourceArchiveZipFileIterator(m_index);
 	}
 
 	bool ResourceArchiveZipFile::ParseResFromName(const char *name, size_t nameLength, ResTypeID &outResTypeID, int16_t &outID)
@@ -575,18 +603,153 @@ namespace PortabilityLayer
 		return true;
 	}
 
+	bool ResourceArchiveZipFile::BuildIndex(ZipFileProxy *zipFileProxy, ResourceArchiveIndex &outIndex)
+	{
+		const size_t numFiles = zipFileProxy->NumFiles();
+		if (numFiles == 0)
+			return true;
+
+		if (numFiles > 0x7fffffff)
+			return false;
+
+		size_t numSlots = 16;
+		while (numSlots < numFiles * 2)
+			numSlots *= 2;
+
+		// Entries and type summaries are sized for the worst case, where every file is a resource of a different type
+		const size_t entriesSize = sizeof(ResourceArchiveIndexEntry) * numFiles;
+		const size_t slotsSize = sizeof(uint32_t) * numSlots;
+		const size_t typesSize = sizeof(ResourceArchiveTypeSummary) * numFiles;
+
+		GP_STATIC_ASSERT(sizeof(ResourceArchiveIndexEntry) % sizeof(uint32_t) == 0);
+
+		uint8_t *storage = static_cast<uint8_t*>(MemoryManager::GetInstance()->Alloc(entriesSize + slotsSize + typesSize));
+		if (!storage)
+			return false;
+
+		ResourceArchiveIndexEntry *entries = reinterpret_cast<ResourceArchiveIndexEntry*>(storage);
+		uint32_t *slots = reinterpret_cast<uint32_t*>(storage + entriesSize);
+		ResourceArchiveTypeSummary *types = reinterpret_cast<ResourceArchiveTypeSummary*>(storage + entriesSize + slotsSize);
+
+		memset(slots, 0, slotsSize);
+
+		const size_t slotMask = numSlots - 1;
+		size_t numEntries = 0;
+		size_t numTypes = 0;
+
+		for (size_t fileIndex = 0; fileIndex < numFiles; fileIndex++)
+		{
+			const char *name = nullptr;
+			size_t nameLength = 0;
+			zipFileProxy->GetFileName(fileIndex, name, nameLength);
+
+			ResTypeID resTypeID;
+			int16_t resID = 0;
+			if (!ParseResFromName(name, nameLength, resTypeID, resID))
+				continue;
+
+			// Only index the name that a lookup would have formatted, so names with leading zeros and such stay unreachable
+			int validationRule = 0;
+			const char *extension = GetFileExtensionForResType(resTypeID, validationRule);
+			GpArcResourceTypeTag resTag = GpArcResourceTypeTag::Encode(resTypeID);
+
+			char canonicalName[64];
+			const int canonicalLength = snprintf(canonicalName, sizeof(canonicalName), "%s/%i%s", resTag.m_id, static_cast<int>(resID), extension);
+			if (canonicalLength < 0 || static_cast<size_t>(canonicalLength) != nameLength || memcmp(canonicalName, name, nameLength) != 0)
+				continue;
+
+			size_t slot = HashResource(resTypeID, resID) & slotMask;
+			bool isDuplicate = false;
+			while (slots[slot] != 0)
+			{
+				const ResourceArchiveIndexEntry &existing = entries[slots[slot] - 1];
+				if (existing.m_resTypeID == resTypeID && existing.m_resID == resID)
+				{
+					isDuplicate = true;
+					break;
+				}
+
+				slot = (slot + 1) & slotMask;
+			}
+
+			if (isDuplicate)
+				continue;
+
+			ResourceArchiveIndexEntry &entry = entries[numEntries++];
+			entry.m_resTypeID = resTypeID;
+			entry.m_resID = resID;
+			entry.m_fileIndex = static_cast<uint32_t>(fileIndex);
+			slots[slot] = static_cast<uint32_t>(numEntries);
+
+			size_t typeIndex = 0;
+			while (typeIndex < numTypes && types[typeIndex].m_resTypeID != resTypeID)
+				typeIndex++;
+
+			if (typeIndex == numTypes)
+			{
+				types[numTypes].m_resTypeID = resTypeID;
+				types[numTypes].m_lowestID = resID;
+				numTypes++;
+			}
+			else if (resID < types[typeIndex].m_lowestID)
+				types[typeIndex].m_lowestID = resID;
+		}
+
+		outIndex.m_entries = entries;
+		outIndex.m_numEntries = numEntries;
+		outIndex.m_slots = slots;
+		outIndex.m_slotMask = slotMask;
+		outIndex.m_types = types;
+		outIndex.m_numTypes = numTypes;
+
+		return true;
+	}
+
+	uint32_t ResourceArchiveZipFile::HashResource(const ResTypeID &resTypeID, int16_t id)
+	{
+		uint32_t hash = static_cast<uint32_t>(resTypeID.ExportAsInt32()) * 0x9e3779b1u;
+		hash ^= static_cast<uint32_t>(static_cast<uint16_t>(id)) * 0x85ebca77u;
+		hash ^= hash >> 15;
+
+		return hash;
+	}
+
+	const ResourceArchiveTypeSummary *ResourceArchiveZipFile::FindTypeSummary(const ResTypeID &resTypeID) const
+	{
+		for (size_t i = 0; i < m_index.m_numTypes; i++)
+		{
+			if (m_index.m_types[i].m_resTypeID == resTypeID)
+				return m_index.m_types + i;
+		}
+
+		return nullptr;
+	}
+
 	bool ResourceArchiveZipFile::IndexResource(const ResTypeID &resTypeID, int id, size_t &outIndex, int &outValidationRule) const
 	{
-		const char *extension = GetFileExtensionForResType(resTypeID, outValidationRule);
+		GetFileExtensionForResType(resTypeID, outValidationRule);
 
-		char resourceFile[64];
+		if (m_index.m_numEntries == 0 || id < -32768 || id > 32767)
+			return false;
 
-		GpArcResourceTypeTag resTag = GpArcResourceTypeTag::Encode(resTypeID);
+		const int16_t resID = static_cast<int16_t>(id);
 
-		snprintf(resourceFile, sizeof(resourceFile) - 1, "%s/%i%s", resTag.m_id, id, extension);
+		size_t slot = HashResource(resTypeID, resID) & m_index.m_slotMask;
+		for (;;)
+		{
+			const uint32_t entryRef = m_index.m_slots[slot];
+			if (entryRef == 0)
+				return false;
 
-		size_t index = 0;
-		return m_zipFileProxy->IndexFile(resourceFile, outIndex);
+			const ResourceArchiveIndexEntry &entry = m_index.m_entries[entryRef - 1];
+			if (entry.m_resTypeID == resTypeID && entry.m_resID == resID)
+			{
+				outIndex = entry.m_fileIndex;
+				return true;
+			}
+
+			slot = (slot + 1) & m_index.m_slotMask;
+		}
 	}
 
 	THandle<void> ResourceArchiveZipFile::GetResource(const ResTypeID &resTypeID, int id, bool load)
@@ -640,11 +803,12 @@ namespace PortabilityLayer
 		return THandle<void>(handle);
 	}
 
-	ResourceArchiveZipFile::ResourceArchiveZipFile(ZipFileProxy *zipFileProxy, bool proxyIsShared, GpIOStream *stream, ResourceArchiveRef *resourceHandles)
+	ResourceArchiveZipFile::ResourceArchiveZipFile(ZipFileProxy *zipFileProxy, bool proxyIsShared, GpIOStream *stream, ResourceArchiveRef *resourceHandles, const ResourceArchiveIndex &index)
 		: m_zipFileProxy(zipFileProxy)
 		, m_proxyIsShared(proxyIsShared)
 		, m_stream(stream)
 		, m_resourceHandles(resourceHandles)
+		, m_index(index)
 	{
 	}
 
@@ -663,6 +827,7 @@ namespace PortabilityLayer
 		}
 
 		mm->Release(m_resourceHandles);
+		mm->Release(m_index.m_entries);
 
 		if (!m_proxyIsShared)
 			m_zipFileProxy->Destroy();
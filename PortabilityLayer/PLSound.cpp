@@ -13,6 +13,7 @@
 #include "PLDrivers.h"
 
 #include <assert.h>
+#include <atomic>
 
 namespace PortabilityLayer
 {
@@ -39,6 +40,30 @@ namespace PortabilityLayer
 		AudioCommandParam m_param;
 	};
 
+	class AudioChannelImpl;
+
+	class SoundSystemImpl final : public SoundSystem
+	{
+	public:
+		AudioChannel *CreateChannel() override;
+		void DispatchCallbacks() override;
+
+		void SetVolume(uint8_t vol) override;
+		uint8_t GetVolume() const override;
+
+		void UnregisterChannel(AudioChannelImpl *channel);
+
+		static SoundSystemImpl *GetInstance();
+
+	private:
+		SoundSystemImpl();
+
+		static SoundSystemImpl ms_instance;
+
+		AudioChannelImpl *m_firstChannel;
+		uint8_t m_volume;
+	};
+
 	class AudioChannelImpl final : public AudioChannel, public IGpAudioChannelCallbacks
 	{
 	public:
@@ -51,129 +76,106 @@ namespace PortabilityLayer
 		void ClearAllCommands() override;
 		void Stop() override;
 
+		void SetCallbackContext(void *context) override;
+		void *GetCallbackContext() const override;
+
+		// Called on the audio thread, so this only counts the buffer.  Everything else happens in DispatchCallbacks.
 		void NotifyBufferFinished() override;
 
-	private:
-		bool PushCommand(const AudioCommand &command, bool blocking);
+		void DispatchCallbacks();
+
+		AudioChannelImpl *m_prevChannel;
+		AudioChannelImpl *m_nextChannel;
 
-		enum WorkingState
+	private:
+		struct PendingCallback
 		{
-			// NOTE: In all cases where the thread event is fired, the event may be fired under a mutex lock.
-			// Therefore, if the mutex is to be destroyed, it must be locked first even though the thread has transitioned to idle.
-
-			State_Idle,				// No thread is playing sound, the sound thread is out of work
-			State_PlayingAsync,		// Sound thread is playing sound.  When it finishes, it will digest queue events under a lock.
-			State_PlayingBlocked,	// Sound thread is playing sound.  When it finishes, it will transition to Idle and fire the thread event.
-			State_FlushStarting,	// Sound thread is aborting.  When it aborts, it will transition to Idle and fire the thread event.
-			State_ShuttingDown,		// Sound thread is shutting down.  When it finishes, it will transition to Idle and fire the thread event.
+			AudioChannelCallback_t m_callback;
+			uint32_t m_postedBuffersBefore;	// Runs once this many buffers have finished
 		};
 
 		static const unsigned int kMaxQueuedCommands = 64;
+		static const uint32_t kWaitPollMSec = 1;
+
+		bool PushCommand(const AudioCommand &command, bool blocking);
 
-		void DigestQueueItems();
-		void DigestBufferCommand(IGpAudioBuffer *buffer);
+		void PostQueuedCommands();
+		void WaitForPostedBuffers();
+		void WaitForAudioThread();
+		void DiscardQueueItems();
+		void DiscardPendingCallbacks();
 
 		IGpAudioChannel *m_audioChannel;
+		void *m_callbackContext;
 
 		IGpMutex *m_mutex;
 		IGpThreadEvent *m_threadEvent;
 
+		// Commands that haven't been handed to the driver yet
 		AudioCommand m_commandQueue[kMaxQueuedCommands];
 		size_t m_numQueuedCommands;
 		size_t m_nextInsertCommandPos;
 		size_t m_nextDequeueCommandPos;
-		WorkingState m_state;
-		bool m_isIdle;
+
+		// Callbacks waiting on posted buffers to finish
+		PendingCallback m_pendingCallbacks[kMaxQueuedCommands];
+		size_t m_numPendingCallbacks;
+		size_t m_nextInsertCallbackPos;
+		size_t m_nextDequeueCallbackPos;
+
+		uint32_t m_numPostedBuffers;
+		std::atomic<uint32_t> m_numFinishedBuffers;	// The only state the audio thread touches
 	};
 
 	AudioChannelImpl::AudioChannelImpl(IGpAudioChannel *channel, IGpThreadEvent *threadEvent, IGpMutex *mutex)
-		: m_audioChannel(channel)
-		, m_threadEvent(threadEvent)
+		: m_prevChannel(nullptr)
+		, m_nextChannel(nullptr)
+		, m_audioChannel(channel)
+		, m_callbackContext(nullptr)
 		, m_mutex(mutex)
+		, m_threadEvent(threadEvent)
+		, m_numQueuedCommands(0)
 		, m_nextInsertCommandPos(0)
 		, m_nextDequeueCommandPos(0)
-		, m_numQueuedCommands(0)
-		, m_state(State_Idle)
-		, m_isIdle(false)
+		, m_numPendingCallbacks(0)
+		, m_nextInsertCallbackPos(0)
+		, m_nextDequeueCallbackPos(0)
+		, m_numPostedBuffers(0)
+		, m_numFinishedBuffers(0)
 	{
 		m_audioChannel->SetAudioChannelContext(this);
 	}
 
 	AudioChannelImpl::~AudioChannelImpl()
 	{
+		m_audioChannel->Destroy();
 		m_mutex->Destroy();
 		m_threadEvent->Destroy();
-		m_audioChannel->Destroy();
 
-		while (m_numQueuedCommands)
-		{
-			const AudioCommand &command = m_commandQueue[m_nextDequeueCommandPos];
-			m_numQueuedCommands--;
-			m_nextDequeueCommandPos = (m_nextDequeueCommandPos + 1) % static_cast<size_t>(kMaxQueuedCommands);
-
-			if (command.m_commandType == AudioCommandTypes::kBuffer)
-				command.m_param.m_buffer->Release();
-		}
+		DiscardQueueItems();
 	}
 
 	void AudioChannelImpl::NotifyBufferFinished()
 	{
-		m_mutex->Lock();
-
-		if (m_state == State_PlayingAsync)
-		{
-			m_state = State_Idle;
-			DigestQueueItems();
-		}
-		else if (m_state == State_PlayingBlocked || m_state == State_FlushStarting || m_state == State_ShuttingDown)
-		{
-			m_state = State_Idle;
-			m_threadEvent->Signal();
-		}
-
-		m_mutex->Unlock();
+		m_numFinishedBuffers.fetch_add(1, std::memory_order_release);
 	}
 
 	void AudioChannelImpl::Destroy(bool wait)
 	{
 		ClearAllCommands();
 
-		bool synchronizeMutex = false;
-
 		if (!wait)
-		{
 			Stop();
-			synchronizeMutex = true;
-		}
 		else
 		{
 			m_mutex->Lock();
-
-			if (m_state == State_PlayingAsync)
-			{
-				m_state = State_ShuttingDown;
-				m_mutex->Unlock();
-
-				m_threadEvent->Wait();
-
-				synchronizeMutex = true;
-			}
-			else
-			{
-				assert(m_state == State_Idle);
-				m_mutex->Unlock();
-			}
-		}
-
-		if (synchronizeMutex)
-		{
-			// If we had to stop the audio thread, then the event was fired under a lock.
-			// We have to wait for the unlock to complete before destroying the mutex.
-			m_mutex->Lock();
-			assert(m_state == State_Idle);
+			WaitForPostedBuffers();
+			DiscardPendingCallbacks();
 			m_mutex->Unlock();
 		}
 
+		SoundSystemImpl::GetInstance()->UnregisterChannel(this);
+
 		this->~AudioChannelImpl();
 		PortabilityLayer::MemoryManager::GetInstance()->Release(this);
 	}
@@ -205,131 +207,194 @@ namespace PortabilityLayer
 		return this->PushCommand(cmd, blocking);
 	}
 
-	void AudioChannelImpl::DigestQueueItems()
+	void AudioChannelImpl::PostQueuedCommands()
 	{
-		m_mutex->Lock();
-
-		assert(m_state == State_Idle);
-
+		// Buffers go to the driver as soon as it has room for them, so it can play them back to back without
+		// waiting on this thread.  Callbacks are held until every buffer posted before them has finished.
 		while (m_numQueuedCommands > 0)
 		{
 			const AudioCommand &command = m_commandQueue[m_nextDequeueCommandPos];
-			m_numQueuedCommands--;
-			m_nextDequeueCommandPos = (m_nextDequeueCommandPos + 1) % static_cast<size_t>(kMaxQueuedCommands);
 
 			switch (command.m_commandType)
 			{
 			case AudioCommandTypes::kBuffer:
-				DigestBufferCommand(command.m_param.m_buffer);
-				assert(m_state == State_PlayingAsync);
-				m_mutex->Unlock();
-				return;
-			case AudioCommandTypes::kCallback:
-				command.m_param.m_callback(this);
+				{
+					// Sampled before posting, so a buffer that finishes in between can't make a full queue look idle
+					const bool wasPlaying = (m_numPostedBuffers != m_numFinishedBuffers.load(std::memory_order_acquire));
 
-				if (m_state != State_Idle)
+					if (m_audioChannel->PostBuffer(command.m_param.m_buffer))
+						m_numPostedBuffers++;
+					else if (wasPlaying)
+						return;	// Driver queue is full, try again once something finishes
+
+					// If the driver rejects a buffer with nothing playing then it isn't full, so the buffer is dropped
+					command.m_param.m_buffer->Release();
+				}
+				break;
+			case AudioCommandTypes::kCallback:
 				{
-					// Child call changed state (i.e. callback called PushBuffer, which triggered a digest)
-					m_mutex->Unlock();
-					return;
+					if (m_numPendingCallbacks == kMaxQueuedCommands)
+						return;
+
+					PendingCallback &pending = m_pendingCallbacks[m_nextInsertCallbackPos];
+					pending.m_callback = command.m_param.m_callback;
+					pending.m_postedBuffersBefore = m_numPostedBuffers;
+
+					m_nextInsertCallbackPos = (m_nextInsertCallbackPos + 1) % static_cast<size_t>(kMaxQueuedCommands);
+					m_numPendingCallbacks++;
 				}
 				break;
 			default:
 				assert(false);
 				break;
 			}
+
+			m_numQueuedCommands--;
+			m_nextDequeueCommandPos = (m_nextDequeueCommandPos + 1) % static_cast<size_t>(kMaxQueuedCommands);
 		}
-		m_mutex->Unlock();
 	}
 
-	void AudioChannelImpl::DigestBufferCommand(IGpAudioBuffer *buffer)
+	void AudioChannelImpl::DispatchCallbacks()
 	{
-		assert(m_state == State_Idle);
+		for (;;)
+		{
+			m_mutex->Lock();
 
-		if (m_audioChannel->PostBuffer(buffer))
-			m_state = State_PlayingAsync;
+			PostQueuedCommands();
 
-		buffer->Release();
-	}
+			if (m_numPendingCallbacks == 0)
+			{
+				m_mutex->Unlock();
+				return;
+			}
 
-	bool AudioChannelImpl::PushCommand(const AudioCommand &command, bool blocking)
-	{
-		bool digestOnThisThread = false;
+			const PendingCallback &pending = m_pendingCallbacks[m_nextDequeueCallbackPos];
 
-		m_mutex->Lock();
-		if (m_numQueuedCommands == kMaxQueuedCommands)
-		{
-			if (!blocking)
+			// Counts wrap, so compare how many buffers are still playing against how many were posted after the callback
+			const uint32_t numBuffersInFlight = m_numPostedBuffers - m_numFinishedBuffers.load(std::memory_order_acquire);
+			const uint32_t numBuffersAfterCallback = m_numPostedBuffers - pending.m_postedBuffersBefore;
+
+			if (numBuffersInFlight > numBuffersAfterCallback)
 			{
 				m_mutex->Unlock();
-				return false;
+				return;
 			}
-			else
-			{
-				assert(m_state == State_PlayingAsync);
-
-				if (m_numQueuedCommands == kMaxQueuedCommands)
-				{
-					m_state = State_PlayingBlocked;
-					m_mutex->Unlock();
 
-					m_threadEvent->Wait();
+			const AudioChannelCallback_t callback = pending.m_callback;
+			m_numPendingCallbacks--;
+			m_nextDequeueCallbackPos = (m_nextDequeueCallbackPos + 1) % static_cast<size_t>(kMaxQueuedCommands);
 
-					m_mutex->Lock();
+			// Run without the lock so that the callback can't stall a streaming thread that is feeding this channel
+			m_mutex->Unlock();
 
-					assert(m_state == State_Idle);
-					digestOnThisThread = true;
-				}
-			}
+			callback(this);
 		}
-		else
+	}
+
+	bool AudioChannelImpl::PushCommand(const AudioCommand &command, bool blocking)
+	{
+		m_mutex->Lock();
+
+		PostQueuedCommands();
+
+		while (m_numQueuedCommands == kMaxQueuedCommands)
 		{
-			if (m_state == State_Idle)
-				digestOnThisThread = true;
+			m_mutex->Unlock();
+
+			if (!blocking)
+				return false;
+
+			// Nothing signals when the audio thread finishes a buffer, so poll.  Blocking callers get their callbacks
+			// run while they wait, since the queue may be backed up behind them.
+			WaitForAudioThread();
+			DispatchCallbacks();
+
+			m_mutex->Lock();
 		}
 
 		m_commandQueue[m_nextInsertCommandPos] = command;
 		m_nextInsertCommandPos = (m_nextInsertCommandPos + 1) % static_cast<size_t>(kMaxQueuedCommands);
 		m_numQueuedCommands++;
-		m_mutex->Unlock();
 
-		if (digestOnThisThread)
-			DigestQueueItems();
+		PostQueuedCommands();
+
+		m_mutex->Unlock();
 
 		return true;
 	}
 
+	void AudioChannelImpl::WaitForPostedBuffers()
+	{
+		// The audio thread never takes the mutex, so it's safe to hold it while waiting
+		while (m_numPostedBuffers != m_numFinishedBuffers.load(std::memory_order_acquire))
+			WaitForAudioThread();
+	}
+
+	void AudioChannelImpl::WaitForAudioThread()
+	{
+		m_threadEvent->WaitTimed(kWaitPollMSec);
+
+		// A driver on the tick clock only plays while ticks are served, so keep it going while blocked on it
+		PLDrivers::GetAudioDriver()->ServeTicks(1);
+	}
+
+	void AudioChannelImpl::DiscardQueueItems()
+	{
+		while (m_numQueuedCommands)
+		{
+			const AudioCommand &command = m_commandQueue[m_nextDequeueCommandPos];
+			m_numQueuedCommands--;
+			m_nextDequeueCommandPos = (m_nextDequeueCommandPos + 1) % static_cast<size_t>(kMaxQueuedCommands);
+
+			if (command.m_commandType == AudioCommandTypes::kBuffer)
+				command.m_param.m_buffer->Release();
+		}
+	}
+
+	void AudioChannelImpl::DiscardPendingCallbacks()
+	{
+		m_numPendingCallbacks = 0;
+		m_nextInsertCallbackPos = 0;
+		m_nextDequeueCallbackPos = 0;
+	}
+
 	void AudioChannelImpl::ClearAllCommands()
 	{
 		m_mutex->Lock();
-		m_numQueuedCommands = 0;
+		DiscardQueueItems();
 		m_nextDequeueCommandPos = 0;
 		m_nextInsertCommandPos = 0;
 		m_mutex->Unlock();
 	}
 
+	void AudioChannelImpl::SetCallbackContext(void *context)
+	{
+		m_callbackContext = context;
+	}
+
+	void *AudioChannelImpl::GetCallbackContext() const
+	{
+		return m_callbackContext;
+	}
+
 	void AudioChannelImpl::Stop()
 	{
+		// Callbacks for buffers that already finished would have run by now if the audio thread ran them, so
+		// run them before stopping.  The rest belong to buffers that are being cut off and are dropped.
+		DispatchCallbacks();
+
 		m_mutex->Lock();
-		if (m_state == State_Idle)
-		{
-			m_mutex->Unlock();
-		}
-		else if (m_state == State_PlayingAsync)
-		{
-			m_state = State_FlushStarting;
-			m_audioChannel->Stop();
-			m_mutex->Unlock();
 
-			m_threadEvent->Wait();
-		}
-		else
+		if (m_numPostedBuffers != m_numFinishedBuffers.load(std::memory_order_acquire))
 		{
-			m_mutex->Unlock();
-			assert(false);
+			m_audioChannel->Stop();
+			WaitForPostedBuffers();
 		}
-	}
 
+		DiscardPendingCallbacks();
+
+		m_mutex->Unlock();
+	}
 }
 
 PLError_t GetDefaultOutputVolume(long *vol)
@@ -352,24 +417,6 @@ PLError_t SetDefaultOutputVolume(long vol)
 
 namespace PortabilityLayer
 {
-	class SoundSystemImpl final : public SoundSystem
-	{
-	public:
-		AudioChannel *CreateChannel() override;
-
-		void SetVolume(uint8_t vol) override;
-		uint8_t GetVolume() const override;
-
-		static SoundSystemImpl *GetInstance();
-
-	private:
-		SoundSystemImpl();
-
-		static SoundSystemImpl ms_instance;
-
-		uint8_t m_volume;
-	};
-
 	AudioChannel *SoundSystemImpl::CreateChannel()
 	{
 		IGpAudioDriver *audioDriver = PLDrivers::GetAudioDriver();
@@ -405,7 +452,34 @@ namespace PortabilityLayer
 			return nullptr;
 		}
 
-		return new (storage) PortabilityLayer::AudioChannelImpl(audioChannel, threadEvent, mutex);
+		PortabilityLayer::AudioChannelImpl *channel = new (storage) PortabilityLayer::AudioChannelImpl(audioChannel, threadEvent, mutex);
+
+		channel->m_nextChannel = m_firstChannel;
+		if (m_firstChannel)
+			m_firstChannel->m_prevChannel = channel;
+		m_firstChannel = channel;
+
+		return channel;
+	}
+
+	void SoundSystemImpl::DispatchCallbacks()
+	{
+		for (AudioChannelImpl *channel = m_firstChannel; channel; channel = channel->m_nextChannel)
+			channel->DispatchCallbacks();
+	}
+
+	void SoundSystemImpl::UnregisterChannel(AudioChannelImpl *channel)
+	{
+		if (channel->m_prevChannel)
+			channel->m_prevChannel->m_nextChannel = channel->m_nextChannel;
+		else
+			m_firstChannel = channel->m_nextChannel;
+
+		if (channel->m_nextChannel)
+			channel->m_nextChannel->m_prevChannel = channel->m_prevChannel;
+
+		channel->m_prevChannel = nullptr;
+		channel->m_nextChannel = nullptr;
 	}
 
 	void SoundSystemImpl::SetVolume(uint8_t vol)
@@ -431,7 +505,8 @@ namespace PortabilityLayer
 	}
 
 	SoundSystemImpl::SoundSystemImpl()
-		: m_volume(255)
+		: m_firstChannel(nullptr)
+		, m_volume(255)
 	{
 	}
 
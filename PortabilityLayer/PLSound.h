@@ -17,13 +17,23 @@ namespace PortabilityLayer
 		virtual bool AddCallback(AudioChannelCallback_t callback, bool blocking) = 0;
 		virtual void ClearAllCommands() = 0;
 		virtual void Stop() = 0;
+
+		// Arbitrary pointer for callbacks to find their state with
+		virtual void SetCallbackContext(void *context) = 0;
+		virtual void *GetCallbackContext() const = 0;
 	};
 
 	class SoundSystem
 	{
 	public:
+		// Channels must be created and destroyed on the main thread, and not from inside channel callbacks
 		virtual AudioChannel *CreateChannel() = 0;
 
+		// Runs channel callbacks whose buffers have finished playing and feeds the driver any buffers that were
+		// waiting for room.  The audio thread only counts finished buffers, so this has to be called regularly
+		// from the main thread.
+		virtual void DispatchCallbacks() = 0;
+
 		virtual void SetVolume(uint8_t vol) = 0;
 		virtual uint8_t GetVolume() const = 0;
 
@@ -4,6 +4,7 @@
 #include "PLEventQueue.h"
 #include "PLKeyEncoding.h"
 #include "PLMovies.h"
+#include "PLSound.h"
 #include "PLSysCalls.h"
 #include "PLTimeTaggedVOSEvent.h"
 #include "DisplayDeviceManager.h"
@@ -15,6 +16,7 @@
 #include "HostSuspendCallArgument.h"
 #include "HostSuspendHook.h"
 #include "MacRomanConversion.h"
+#include "PerformanceOverlay.h"
 
 #include "PLDrivers.h"
 #include "CoreDefs.h"
@@ -97,6 +99,16 @@ static void TranslateKeyboardInputEvent(const GpVOSEvent &vosEventBase, uint32_t
 		}
 	}
 
+	// Alt-F12 toggles the performance overlay
+	if (vosEventBase.m_event.m_keyboardInputEvent.m_eventType == GpKeyboardInputEventTypes::kDown &&
+		vosEventBase.m_event.m_keyboardInputEvent.m_keyIDSubset == GpKeyIDSubsets::kFKey &&
+		vosEventBase.m_event.m_keyboardInputEvent.m_key.m_fKey == 12)
+	{
+		const KeyDownStates *keyStates = inputManager->GetKeys();
+		if (keyStates->m_special.Get(GpKeySpecials::kLeftAlt) || keyStates->m_special.Get(GpKeySpecials::kRightAlt))
+			PortabilityLayer::PerformanceOverlay::GetInstance()->Toggle();
+	}
+
 	if (TimeTaggedVOSEvent *evt = queue->Enqueue())
 		*evt = TimeTaggedVOSEvent::Create(vosEventBase, timestamp);
 }
@@ -225,6 +237,8 @@ namespace PLSysCalls
 
 			AnimationManager::GetInstance()->TickPlayers(ticks);
 		}
+
+		PortabilityLayer::SoundSystem::GetInstance()->DispatchCallbacks();
 	}
 
 	static jmp_buf gs_mainExitWrapper;
@@ -0,0 +1,403 @@
+#include "PerformanceOverlay.h"
+
+#include "GpDisplayDriverFrameStats.h"
+#include "IGpDisplayDriver.h"
+#include "IGpLogDriver.h"
+#include "FontPresets.h"
+#include "MenuManager.h"
+#include "QDGraf.h"
+#include "QDManager.h"
+#include "RenderedFont.h"
+#include "ResolveCachingColor.h"
+
+#include "GpRenderedFontMetrics.h"
+#include "PLDrivers.h"
+#include "PLPasStr.h"
+#include "PLQDraw.h"
+#include "PLStandardColors.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+namespace PortabilityLayer
+{
+	class PerformanceOverlayImpl final : public PerformanceOverlay
+	{
+	public:
+		PerformanceOverlayImpl();
+
+		void Init() override;
+		void Shutdown() override;
+
+		void SetEnabled(bool enabled) override;
+		bool IsEnabled() const override;
+		void Toggle() override;
+
+		void BeginServeTicks() override;
+		void EndServeTicks(unsigned int ticks) override;
+
+		void RenderFrame(IGpDisplayDriver *displayDriver) override;
+
+		static PerformanceOverlayImpl *GetInstance();
+
+	private:
+		struct GameTickStats
+		{
+			GameTickStats();
+
+			uint64_t m_numYields;
+			uint64_t m_numTicks;
+			uint64_t m_workUSec;	// Time spent in the game between yields to the display driver
+			uint64_t m_waitUSec;	// Time spent in the display driver
+		};
+
+		// Differences between two snapshots of the stats
+		struct StatsWindow
+		{
+			StatsWindow();
+
+			void Reset(const GpDisplayDriverFrameStats &frameStats, const GameTickStats &gameStats, int64_t timeUSec);
+
+			GpDisplayDriverFrameStats m_baseFrameStats;
+			GameTickStats m_baseGameStats;
+			int64_t m_startTimeUSec;
+			uint32_t m_maxWorkUSec;
+		};
+
+		static const int64_t kOverlayRefreshIntervalUSec = 500000;
+		static const int64_t kLogIntervalUSec = 10000000;
+
+		static const unsigned int kNumOverlayLines = 5;
+		static const int16_t kOverlayWidth = 320;
+		static const int16_t kOverlayPadding = 4;
+		static const int16_t kHistogramHeight = 24;
+
+		static int64_t GetTimeUSec();
+
+		void RedrawOverlay(const GpDisplayDriverFrameStats &frameStats, int64_t timeUSec);
+		void LogStats(const GpDisplayDriverFrameStats &frameStats, int64_t timeUSec) const;
+
+		bool m_isEnabled;
+		bool m_haveFrameStats;
+
+		DrawSurface *m_overlayGraf;
+
+		GameTickStats m_gameStats;
+		int64_t m_lastYieldEndTimeUSec;
+		int64_t m_yieldStartTimeUSec;
+
+		StatsWindow m_overlayWindow;
+		StatsWindow m_logWindow;
+
+		static PerformanceOverlayImpl ms_instance;
+	};
+
+	PerformanceOverlayImpl::GameTickStats::GameTickStats()
+		: m_numYields(0)
+		, m_numTicks(0)
+		, m_workUSec(0)
+		, m_waitUSec(0)
+	{
+	}
+
+	PerformanceOverlayImpl::StatsWindow::StatsWindow()
+		: m_startTimeUSec(0)
+		, m_maxWorkUSec(0)
+	{
+	}
+
+	void PerformanceOverlayImpl::StatsWindow::Reset(const GpDisplayDriverFrameStats &frameStats, const GameTickStats &gameStats, int64_t timeUSec)
+	{
+		m_baseFrameStats = frameStats;
+		m_baseGameStats = gameStats;
+		m_startTimeUSec = timeUSec;
+		m_maxWorkUSec = 0;
+	}
+
+	PerformanceOverlayImpl::PerformanceOverlayImpl()
+		: m_isEnabled(false)
+		, m_haveFrameStats(false)
+		, m_overlayGraf(nullptr)
+		, m_lastYieldEndTimeUSec(0)
+		, m_yieldStartTimeUSec(0)
+	{
+	}
+
+	void PerformanceOverlayImpl::Init()
+	{
+	}
+
+	void PerformanceOverlayImpl::Shutdown()
+	{
+		if (m_overlayGraf)
+		{
+			QDManager::GetInstance()->DisposeGWorld(m_overlayGraf);
+			m_overlayGraf = nullptr;
+		}
+	}
+
+	void PerformanceOverlayImpl::SetEnabled(bool enabled)
+	{
+		if (enabled && !m_isEnabled)
+		{
+			// Force a refresh on the next frame
+			m_overlayWindow.m_startTimeUSec = GetTimeUSec() - kOverlayRefreshIntervalUSec;
+		}
+
+		m_isEnabled = enabled;
+	}
+
+	bool PerformanceOverlayImpl::IsEnabled() const
+	{
+		return m_isEnabled;
+	}
+
+	void PerformanceOverlayImpl::Toggle()
+	{
+		SetEnabled(!m_isEnabled);
+	}
+
+	void PerformanceOverlayImpl::BeginServeTicks()
+	{
+		const int64_t timeUSec = GetTimeUSec();
+
+		if (m_gameStats.m_numYields > 0 && timeUSec > m_lastYieldEndTimeUSec)
+		{
+			const uint64_t workUSec = static_cast<uint64_t>(timeUSec - m_lastYieldEndTimeUSec);
+			const uint32_t clampedWorkUSec = (workUSec > 0xffffffffu) ? 0xffffffffu : static_cast<uint32_t>(workUSec);
+
+			m_gameStats.m_workUSec += workUSec;
+
+			if (clampedWorkUSec > m_overlayWindow.m_maxWorkUSec)
+				m_overlayWindow.m_maxWorkUSec = clampedWorkUSec;
+			if (clampedWorkUSec > m_logWindow.m_maxWorkUSec)
+				m_logWindow.m_maxWorkUSec = clampedWorkUSec;
+		}
+
+		m_yieldStartTimeUSec = timeUSec;
+	}
+
+	void PerformanceOverlayImpl::EndServeTicks(unsigned int ticks)
+	{
+		const int64_t timeUSec = GetTimeUSec();
+
+		if (timeUSec > m_yieldStartTimeUSec)
+			m_gameStats.m_waitUSec += static_cast<uint64_t>(timeUSec - m_yieldStartTimeUSec);
+
+		m_gameStats.m_numYields++;
+		m_gameStats.m_numTicks += ticks;
+		m_lastYieldEndTimeUSec = timeUSec;
+	}
+
+	void PerformanceOverlayImpl::RenderFrame(IGpDisplayDriver *displayDriver)
+	{
+		IGpLogDriver *logger = PLDrivers::GetLogDriver();
+		if (!m_isEnabled && !logger)
+			return;
+
+		const int64_t timeUSec = GetTimeUSec();
+
+		GpDisplayDriverFrameStats frameStats;
+		displayDriver->GetFrameStats(frameStats);
+
+		if (!m_haveFrameStats)
+		{
+			m_overlayWindow.Reset(frameStats, m_gameStats, timeUSec - kOverlayRefreshIntervalUSec);
+			m_logWindow.Reset(frameStats, m_gameStats, timeUSec);
+			m_haveFrameStats = true;
+		}
+
+		if (logger && timeUSec - m_logWindow.m_startTimeUSec >= kLogIntervalUSec)
+		{
+			LogStats(frameStats, timeUSec);
+			m_logWindow.Reset(frameStats, m_gameStats, timeUSec);
+		}
+
+		if (!m_isEnabled)
+			return;
+
+		if (timeUSec - m_overlayWindow.m_startTimeUSec >= kOverlayRefreshIntervalUSec)
+		{
+			RedrawOverlay(frameStats, timeUSec);
+			m_overlayWindow.Reset(frameStats, m_gameStats, timeUSec);
+		}
+
+		if (m_overlayGraf)
+		{
+			m_overlayGraf->PushToDDSurface(displayDriver);
+
+			if (m_overlayGraf->m_ddSurface)
+			{
+				const Rect rect = m_overlayGraf->m_port.GetRect();
+				const int32_t y = MenuManager::GetInstance()->GetMenuBarHeight();
+
+				displayDriver->DrawSurface(m_overlayGraf->m_ddSurface, 0, y, rect.right, rect.bottom, nullptr);
+			}
+		}
+	}
+
+	int64_t PerformanceOverlayImpl::GetTimeUSec()
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	void PerformanceOverlayImpl::RedrawOverlay(const GpDisplayDriverFrameStats &frameStats, int64_t timeUSec)
+	{
+		RenderedFont *font = GetFont(FontPresets::kMono10);
+		if (!font)
+			return;
+
+		const GpRenderedFontMetrics &metrics = font->GetMetrics();
+		const int16_t lineSpacing = static_cast<int16_t>(metrics.m_ascent + metrics.m_descent + metrics.m_linegap);
+		const int16_t histogramTop = kOverlayPadding + lineSpacing * static_cast<int16_t>(kNumOverlayLines) + kOverlayPadding;
+		const Rect overlayRect = Rect::Create(0, 0, histogramTop + kHistogramHeight + kOverlayPadding, kOverlayWidth);
+
+		if (m_overlayGraf == nullptr)
+		{
+			if (QDManager::GetInstance()->NewGWorld(&m_overlayGraf, GpPixelFormats::k8BitStandard, overlayRect) != PLErrors::kNone)
+				return;
+		}
+		else if (m_overlayGraf->m_port.GetRect() != overlayRect)
+		{
+			if (!m_overlayGraf->m_port.Resize(overlayRect))
+				return;
+		}
+
+		const GpDisplayDriverFrameStats &base = m_overlayWindow.m_baseFrameStats;
+		const GameTickStats &baseGame = m_overlayWindow.m_baseGameStats;
+
+		const uint64_t numPresents = frameStats.m_numPresents - base.m_numPresents;
+		const uint64_t numYields = m_gameStats.m_numYields - baseGame.m_numYields;
+		const int64_t elapsedUSec = timeUSec - m_overlayWindow.m_startTimeUSec;
+
+		const double presentsPerFrame = (numPresents > 0) ? static_cast<double>(numPresents) : 1.0;
+		const double yieldsPerFrame = (numYields > 0) ? static_cast<double>(numYields) : 1.0;
+
+		char lines[kNumOverlayLines][128];
+
+		snprintf(lines[0], sizeof(lines[0]), "Present: %.1f fps, last %.2f ms%s",
+			(elapsedUSec > 0) ? static_cast<double>(numPresents) * 1000000.0 / static_cast<double>(elapsedUSec) : 0.0,
+			static_cast<double>(frameStats.m_lastPresentIntervalUSec) / 1000.0,
+			frameStats.m_isInFrameTimeLock ? ", time locked" : "");
+
+		snprintf(lines[1], sizeof(lines[1]), "Dropped %u  Doubled %u  Catch-up %u",
+			static_cast<unsigned int>(frameStats.m_numFramesDropped - base.m_numFramesDropped),
+			static_cast<unsigned int>(frameStats.m_numFramesDoubled - base.m_numFramesDoubled),
+			static_cast<unsigned int>(frameStats.m_numCatchUpSteps - base.m_numCatchUpSteps));
+
+		snprintf(lines[2], sizeof(lines[2]), "Per frame: %.1f uploads (%.1f KB), %.1f draws",
+			static_cast<double>(frameStats.m_totalUploadCount - base.m_totalUploadCount) / presentsPerFrame,
+			static_cast<double>(frameStats.m_totalUploadBytes - base.m_totalUploadBytes) / presentsPerFrame / 1024.0,
+			static_cast<double>(frameStats.m_totalDrawCalls - base.m_totalDrawCalls) / presentsPerFrame);
+
+		snprintf(lines[3], sizeof(lines[3]), "Game: %.2f ms avg, %.2f ms max",
+			static_cast<double>(m_gameStats.m_workUSec - baseGame.m_workUSec) / yieldsPerFrame / 1000.0,
+			static_cast<double>(m_overlayWindow.m_maxWorkUSec) / 1000.0);
+
+		snprintf(lines[4], sizeof(lines[4]), "Display wait: %.2f ms avg, %.2f ticks/yield",
+			static_cast<double>(m_gameStats.m_waitUSec - baseGame.m_waitUSec) / yieldsPerFrame / 1000.0,
+			static_cast<double>(m_gameStats.m_numTicks - baseGame.m_numTicks) / yieldsPerFrame);
+
+		ResolveCachingColor blackColor = StdColors::Black();
+		ResolveCachingColor whiteColor = StdColors::White();
+		ResolveCachingColor barColor = StdColors::Green();
+		ResolveCachingColor slowBarColor = StdColors::Red();
+
+		m_overlayGraf->FillRect(overlayRect, blackColor);
+
+		for (unsigned int i = 0; i < kNumOverlayLines; i++)
+		{
+			const int16_t baseline = static_cast<int16_t>(kOverlayPadding + metrics.m_ascent + lineSpacing * static_cast<int16_t>(i));
+			m_overlayGraf->DrawString(Point::Create(kOverlayPadding, baseline), PLPasStr(static_cast<uint8_t>(strlen(lines[i])), lines[i]), whiteColor, font);
+		}
+
+		// Present interval histogram, one bar per bucket, scaled to the most common interval
+		uint64_t bucketCounts[GpDisplayDriverFrameStats::kNumPresentIntervalBuckets];
+		uint64_t maxBucketCount = 0;
+		for (unsigned int i = 0; i < GpDisplayDriverFrameStats::kNumPresentIntervalBuckets; i++)
+		{
+			bucketCounts[i] = frameStats.m_presentIntervalHistogram[i] - base.m_presentIntervalHistogram[i];
+			if (bucketCounts[i] > maxBucketCount)
+				maxBucketCount = bucketCounts[i];
+		}
+
+		if (maxBucketCount > 0)
+		{
+			const int16_t barSpacing = (kOverlayWidth - kOverlayPadding * 2) / static_cast<int16_t>(GpDisplayDriverFrameStats::kNumPresentIntervalBuckets);
+			const int16_t histogramBottom = histogramTop + kHistogramHeight;
+
+			for (unsigned int i = 0; i < GpDisplayDriverFrameStats::kNumPresentIntervalBuckets; i++)
+			{
+				if (bucketCounts[i] == 0)
+					continue;
+
+				const int16_t barHeight = static_cast<int16_t>((bucketCounts[i] * static_cast<uint64_t>(kHistogramHeight - 1) + maxBucketCount - 1) / maxBucketCount) + 1;
+				const int16_t barLeft = kOverlayPadding + barSpacing * static_cast<int16_t>(i);
+
+				// Intervals longer than 1.5 ticks missed at least one refresh
+				const uint32_t bucketStartUSec = i * GpDisplayDriverFrameStats::kPresentIntervalBucketUSec;
+				const bool isSlow = (frameStats.m_tickIntervalUSec > 0 && static_cast<uint64_t>(bucketStartUSec) * 2 >= static_cast<uint64_t>(frameStats.m_tickIntervalUSec) * 3);
+
+				const Rect barRect = Rect::Create(histogramBottom - barHeight, barLeft, histogramBottom, barLeft + barSpacing - 1);
+				m_overlayGraf->FillRect(barRect, isSlow ? slowBarColor : barColor);
+			}
+		}
+	}
+
+	void PerformanceOverlayImpl::LogStats(const GpDisplayDriverFrameStats &frameStats, int64_t timeUSec) const
+	{
+		IGpLogDriver *logger = PLDrivers::GetLogDriver();
+
+		const GpDisplayDriverFrameStats &base = m_logWindow.m_baseFrameStats;
+		const GameTickStats &baseGame = m_logWindow.m_baseGameStats;
+
+		const uint64_t numPresents = frameStats.m_numPresents - base.m_numPresents;
+		const uint64_t numYields = m_gameStats.m_numYields - baseGame.m_numYields;
+		const double elapsedSec = static_cast<double>(timeUSec - m_logWindow.m_startTimeUSec) / 1000000.0;
+
+		const double presentsPerFrame = (numPresents > 0) ? static_cast<double>(numPresents) : 1.0;
+		const double yieldsPerFrame = (numYields > 0) ? static_cast<double>(numYields) : 1.0;
+
+		logger->Printf(IGpLogDriver::Category_Information, "PerformanceOverlay: %u presents in %.1f s (%.1f fps), %u ticks, %u dropped, %u doubled, %u catch-up",
+			static_cast<unsigned int>(numPresents), elapsedSec, static_cast<double>(numPresents) / elapsedSec,
+			static_cast<unsigned int>(frameStats.m_numTicks - base.m_numTicks),
+			static_cast<unsigned int>(frameStats.m_numFramesDropped - base.m_numFramesDropped),
+			static_cast<unsigned int>(frameStats.m_numFramesDoubled - base.m_numFramesDoubled),
+			static_cast<unsigned int>(frameStats.m_numCatchUpSteps - base.m_numCatchUpSteps));
+
+		logger->Printf(IGpLogDriver::Category_Information, "PerformanceOverlay: Per frame %.1f uploads, %.0f upload bytes, %.1f draws; game %.2f ms avg, %.2f ms max; display wait %.2f ms avg",
+			static_cast<double>(frameStats.m_totalUploadCount - base.m_totalUploadCount) / presentsPerFrame,
+			static_cast<double>(frameStats.m_totalUploadBytes - base.m_totalUploadBytes) / presentsPerFrame,
+			static_cast<double>(frameStats.m_totalDrawCalls - base.m_totalDrawCalls) / presentsPerFrame,
+			static_cast<double>(m_gameStats.m_workUSec - baseGame.m_workUSec) / yieldsPerFrame / 1000.0,
+			static_cast<double>(m_logWindow.m_maxWorkUSec) / 1000.0,
+			static_cast<double>(m_gameStats.m_waitUSec - baseGame.m_waitUSec) / yieldsPerFrame / 1000.0);
+
+		char histogramStr[GpDisplayDriverFrameStats::kNumPresentIntervalBuckets * 12 + 1];
+		size_t histogramLength = 0;
+		for (unsigned int i = 0; i < GpDisplayDriverFrameStats::kNumPresentIntervalBuckets; i++)
+		{
+			const int written = snprintf(histogramStr + histogramLength, sizeof(histogramStr) - histogramLength, " %u",
+				static_cast<unsigned int>(frameStats.m_presentIntervalHistogram[i] - base.m_presentIntervalHistogram[i]));
+			if (written > 0)
+				histogramLength += static_cast<size_t>(written);
+		}
+		histogramStr[histogramLength] = '\0';
+
+		logger->Printf(IGpLogDriver::Category_Information, "PerformanceOverlay: Present intervals in %u ms buckets:%s",
+			static_cast<unsigned int>(GpDisplayDriverFrameStats::kPresentIntervalBucketUSec / 1000), histogramStr);
+	}
+
+	PerformanceOverlayImpl *PerformanceOverlayImpl::GetInstance()
+	{
+		return &ms_instance;
+	}
+
+	PerformanceOverlayImpl PerformanceOverlayImpl::ms_instance;
+
+	PerformanceOverlay *PerformanceOverlay::GetInstance()
+	{
+		return PerformanceOverlayImpl::GetInstance();
+	}
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+struct IGpDisplayDriver;
+
+namespace PortabilityLayer
+{
+	// Frame pacing readout, drawn over everything else when enabled (Alt+F12).  Combines the display
+	// driver's frame stats with how long the game spends between yields to the display driver.  If a log
+	// driver is present, a summary of the same stats is also logged periodically whether or not the
+	// overlay is visible.
+	class PerformanceOverlay
+	{
+	public:
+		virtual void Init() = 0;
+		virtual void Shutdown() = 0;
+
+		virtual void SetEnabled(bool enabled) = 0;
+		virtual bool IsEnabled() const = 0;
+		virtual void Toggle() = 0;
+
+		// Called around IGpDisplayDriver::ServeTicks, the time between the two is spent waiting on the display
+		virtual void BeginServeTicks() = 0;
+		virtual void EndServeTicks(unsigned int ticks) = 0;
+
+		virtual void RenderFrame(IGpDisplayDriver *displayDriver) = 0;
+
+		static PerformanceOverlay *GetInstance();
+	};
+}
@@ -2,9 +2,11 @@
 #include "AppEventHandler.cpp"
 #include "BinHex4.cpp"
 #include "BitmapImage.cpp"
+#include "BlitKernels.cpp"
 #include "ByteSwap.cpp"
 #include "CFileStream.cpp"
 #include "CompositeRenderedFont.cpp"
+#include "DecodedImageCache.cpp"
 #include "DeflateCodec.cpp"
 #include "DialogManager.cpp"
 #include "DisplayDeviceManager.cpp"
@@ -28,6 +30,7 @@
 #include "MemReaderStream.cpp"
 #include "MenuManager.cpp"
 #include "MMHandleBlock.cpp"
+#include "PerformanceOverlay.cpp"
 #include "PLApplication.cpp"
 #include "PLButtonWidget.cpp"
 #include "PLControlDefinitions.cpp"
@@ -76,10 +79,14 @@
 #include "ScanlineMaskConverter.cpp"
 #include "ScanlineMaskIterator.cpp"
 #include "SimpleGraphic.cpp"
+#include "SoundCache.cpp"
+#include "SoundStreamer.cpp"
 #include "TextPlacer.cpp"
+#include "TextRunCache.cpp"
 #include "UTF8.cpp"
 #include "WindowDef.cpp"
 #include "WindowManager.cpp"
 #include "WorkerThread.cpp"
+#include "WorkerThreadPool.cpp"
 #include "XModemCRC.cpp"
 #include "ZipFileProxy.cpp"
@@ -30,7 +30,41 @@ void DrawSurface::PushToDDSurface(IGpDisplayDriver *displayDriver)
 
 	if (m_port.IsDirty(PortabilityLayer::QDPortDirtyFlag_Contents) && m_ddSurface != nullptr)
 	{
-		m_ddSurface->UploadEntire(pixMap->m_data, pixMap->m_pitch);
+		const Rect pixMapRect = pixMap->m_rect;
+		const size_t numDirtyRects = m_port.GetNumDirtyRects();
+		const Rect *dirtyRects = m_port.GetDirtyRects();
+
+		if (numDirtyRects == 0 || (numDirtyRects == 1 && dirtyRects[0] == pixMapRect))
+			m_ddSurface->UploadEntire(pixMap->m_data, pixMap->m_pitch);
+		else
+		{
+			size_t pixelSize = 1;
+			switch (pixMap->m_pixelFormat)
+			{
+			case GpPixelFormats::kRGB555:
+				pixelSize = 2;
+				break;
+			case GpPixelFormats::kRGB24:
+				pixelSize = 3;
+				break;
+			case GpPixelFormats::kRGB32:
+				pixelSize = 4;
+				break;
+			default:
+				break;
+			}
+
+			for (size_t i = 0; i < numDirtyRects; i++)
+			{
+				const Rect &dirtyRect = dirtyRects[i];
+				const size_t x = static_cast<size_t>(dirtyRect.left - pixMapRect.left);
+				const size_t y = static_cast<size_t>(dirtyRect.top - pixMapRect.top);
+				const uint8_t *firstPixel = static_cast<const uint8_t*>(pixMap->m_data) + y * pixMap->m_pitch + x * pixelSize;
+
+				m_ddSurface->Upload(firstPixel, x, y, dirtyRect.Width(), dirtyRect.Height(), pixMap->m_pitch);
+			}
+		}
+
 		m_port.ClearDirty(PortabilityLayer::QDPortDirtyFlag_Contents);
 	}
 }
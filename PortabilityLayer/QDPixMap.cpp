@@ -230,6 +230,7 @@ namespace PortabilityLayer
 		, m_width(width)
 		, m_height(height)
 		, m_dataCapacity(0)
+		, m_ownerPort(nullptr)
 	{
 		const Rect rect = Rect::Create(top, left, static_cast<uint16_t>(top + height), static_cast<uint16_t>(left + width));
 
@@ -13,6 +13,8 @@ struct PixMap : public BitMap
 
 namespace PortabilityLayer
 {
+	class QDPort;
+
 	class PixMapImpl final : public PixMap
 	{
 	public:
@@ -24,6 +26,10 @@ namespace PortabilityLayer
 		const void *GetPixelData() const;
 		size_t GetDataCapacity() const;
 
+		// The port that owns this pixmap, if any.  Blits into owned pixmaps report their dirty region to the port.
+		QDPort *GetOwnerPort() const;
+		void SetOwnerPort(QDPort *port);
+
 		THandle<PixMapImpl> ScaleTo(uint16_t width, uint16_t height);
 
 		static THandle<PixMapImpl> Create(const Rect &rect, GpPixelFormat_t pixelFormat);
@@ -43,6 +49,7 @@ namespace PortabilityLayer
 		uint16_t m_height;
 
 		size_t m_dataCapacity;
+		QDPort *m_ownerPort;
 	};
 }
 
@@ -70,3 +77,13 @@ inline size_t PortabilityLayer::PixMapImpl::GetDataCapacity() const
 {
 	return m_dataCapacity;
 }
+
+inline PortabilityLayer::QDPort *PortabilityLayer::PixMapImpl::GetOwnerPort() const
+{
+	return m_ownerPort;
+}
+
+inline void PortabilityLayer::PixMapImpl::SetOwnerPort(QDPort *port)
+{
+	m_ownerPort = port;
+}
@@ -6,6 +6,8 @@
 #include "QDManager.h"
 #include "QDPixMap.h"
 
+#include <algorithm>
+
 #if GP_DEBUG_CONFIG
 #include <assert.h>
 
@@ -24,6 +26,7 @@ namespace PortabilityLayer
 		, m_height(0)
 		, m_pixelFormat(GpPixelFormats::kInvalid)
 		, m_dirtyFlags(0)
+		, m_numDirtyRects(0)
 		, m_debugID(gs_nextQDPortDebugID++)
 #if GP_DEBUG_CONFIG
 		, m_portSentinel(kQDPortSentinelValue)
@@ -63,8 +66,6 @@ namespace PortabilityLayer
 		if (!newPixMap)
 			return false;
 
-		SetDirty(QDPortDirtyFlag_Size | QDPortDirtyFlag_Contents);
-
 		m_left = rect.left;
 		m_top = rect.top;
 		m_width = rect.Width();
@@ -73,6 +74,9 @@ namespace PortabilityLayer
 		DisposePixMap();
 
 		m_pixMap = newPixMap;
+		(*m_pixMap)->SetOwnerPort(this);
+
+		SetDirty(QDPortDirtyFlag_Size | QDPortDirtyFlag_Contents);
 
 		return true;
 	}
@@ -85,11 +89,71 @@ namespace PortabilityLayer
 	void QDPort::SetDirty(uint32_t flag)
 	{
 		m_dirtyFlags |= flag;
+
+		if (flag & QDPortDirtyFlag_Contents)
+		{
+			m_dirtyRects[0] = GetRect();
+			m_numDirtyRects = 1;
+		}
 	}
 
 	void QDPort::ClearDirty(uint32_t flag)
 	{
 		m_dirtyFlags &= ~flag;
+
+		if (flag & QDPortDirtyFlag_Contents)
+			m_numDirtyRects = 0;
+	}
+
+	void QDPort::SetDirtyRect(const Rect &rect)
+	{
+		const Rect constrainedRect = rect.Intersect(GetRect());
+		if (!constrainedRect.IsValid() || constrainedRect.Width() == 0 || constrainedRect.Height() == 0)
+			return;
+
+		m_dirtyFlags |= QDPortDirtyFlag_Contents;
+
+		for (size_t i = 0; i < m_numDirtyRects; i++)
+		{
+			if (m_dirtyRects[i].Intersect(constrainedRect) == constrainedRect)
+				return;
+		}
+
+		if (m_numDirtyRects < kMaxDirtyRects)
+		{
+			m_dirtyRects[m_numDirtyRects++] = constrainedRect;
+			return;
+		}
+
+		// Out of space, merge into whichever rect grows the least
+		size_t bestIndex = 0;
+		int32_t bestGrowth = 0;
+
+		for (size_t i = 0; i < m_numDirtyRects; i++)
+		{
+			const Rect &existing = m_dirtyRects[i];
+			const Rect merged = Rect::Create(std::min(existing.top, constrainedRect.top), std::min(existing.left, constrainedRect.left), std::max(existing.bottom, constrainedRect.bottom), std::max(existing.right, constrainedRect.right));
+
+			const int32_t growth = static_cast<int32_t>(merged.Width()) * static_cast<int32_t>(merged.Height()) - static_cast<int32_t>(existing.Width()) * static_cast<int32_t>(existing.Height());
+			if (i == 0 || growth < bestGrowth)
+			{
+				bestIndex = i;
+				bestGrowth = growth;
+			}
+		}
+
+		Rect &target = m_dirtyRects[bestIndex];
+		target = Rect::Create(std::min(target.top, constrainedRect.top), std::min(target.left, constrainedRect.left), std::max(target.bottom, constrainedRect.bottom), std::max(target.right, constrainedRect.right));
+	}
+
+	size_t QDPort::GetNumDirtyRects() const
+	{
+		return m_numDirtyRects;
+	}
+
+	const Rect *QDPort::GetDirtyRects() const
+	{
+		return m_dirtyRects;
 	}
 
 	THandle<PixMap> QDPort::GetPixMap() const
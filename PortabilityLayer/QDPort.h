@@ -4,9 +4,9 @@
 #include "GpPixelFormat.h"
 #include "PLErrorCodes.h"
 #include "PLHandle.h"
+#include "SharedTypes.h"
 
 struct PixMap;
-struct Rect;
 
 namespace PortabilityLayer
 {
@@ -45,11 +45,19 @@ namespace PortabilityLayer
 		void SetDirty(uint32_t flag);
 		void ClearDirty(uint32_t flag);
 
+		// Marks a region of the port contents dirty.  If too many regions are
+		// dirty, they are merged, so the dirty rect list is always conservative.
+		void SetDirtyRect(const Rect &rect);
+		size_t GetNumDirtyRects() const;
+		const Rect *GetDirtyRects() const;
+
 #if GP_DEBUG_CONFIG
 		void CheckPortSentinel() const;
 #endif
 
 	private:
+		static const size_t kMaxDirtyRects = 16;
+
 		void DisposePixMap();
 
 #if GP_DEBUG_CONFIG
@@ -67,6 +75,9 @@ namespace PortabilityLayer
 		uint32_t m_dirtyFlags;
 		GpPixelFormat_t m_pixelFormat;
 
+		Rect m_dirtyRects[kMaxDirtyRects];
+		size_t m_numDirtyRects;
+
 		uint32_t m_debugID;
 	};
 
@@ -1,5 +1,4 @@
 #include "QDStandardPalette.h"
-#include "IGpMutex.h"
 
 #include <string.h>
 
@@ -25,9 +24,19 @@ namespace
 namespace PortabilityLayer
 {
 	StandardPalette::StandardPalette()
-		: m_numCachedPaletteTables(0)
-		, m_numCachedToneTables(0)
+		: m_numCachedToneTables(0)
 	{
+		for (size_t set = 0; set < kNumPaletteTableSets; set++)
+		{
+			for (size_t way = 0; way < kNumPaletteTableWays; way++)
+				m_cachedPaletteTableKeys[set][way] = kInvalidPaletteTableKey;
+
+			m_nextPaletteTableWay[set] = 0;
+		}
+
+		memset(m_toneTableSlots, kInvalidToneTableSlot, sizeof(m_toneTableSlots));
+		memset(m_cachedToneTableTones, 0, sizeof(m_cachedToneTableTones));
+
 		for (unsigned int rs = 0; rs < 6; rs++)
 		{
 			for (unsigned int gs = 0; gs < 6; gs++)
@@ -233,69 +242,59 @@ namespace PortabilityLayer
 		return &ms_instance;
 	}
 
-	const AntiAliasTable &StandardPalette::GetCachedPaletteAATable(const RGBAColor &color, IGpMutex *mutex)
+	const AntiAliasTable &StandardPalette::GetCachedPaletteAATable(const RGBAColor &color)
 	{
-		uint8_t rgb[3] = { color.r, color.g, color.b };
+		const uint32_t key = static_cast<uint32_t>(color.r) | (static_cast<uint32_t>(color.g) << 8) | (static_cast<uint32_t>(color.b) << 16);
+		const size_t set = HashPaletteTableKey(key);
 
-		if (mutex)
-			mutex->Lock();
-
-		for (size_t i = 0; i < m_numCachedPaletteTables; i++)
+		uint32_t *keys = m_cachedPaletteTableKeys[set];
+		for (size_t way = 0; way < kNumPaletteTableWays; way++)
 		{
-			const CachedPaletteTableEntry &entry = m_cachedPaletteTables[i];
-			if (entry.m_rgb[0] == rgb[0] && entry.m_rgb[1] == rgb[1] && entry.m_rgb[2] == rgb[2])
-			{
-				if (mutex)
-					mutex->Unlock();
-				return entry.m_aaTable;
-			}
+			if (keys[way] == key)
+				return m_cachedPaletteTables[set][way];
 		}
 
-		if (m_numCachedPaletteTables == kMaxCachedPaletteTables)
-			m_numCachedPaletteTables = 0;
+		const size_t way = m_nextPaletteTableWay[set];
+		m_nextPaletteTableWay[set] = static_cast<uint8_t>((way + 1) % kNumPaletteTableWays);
 
-		CachedPaletteTableEntry &entry = m_cachedPaletteTables[m_numCachedPaletteTables++];
-		entry.m_rgb[0] = rgb[0];
-		entry.m_rgb[1] = rgb[1];
-		entry.m_rgb[2] = rgb[2];
+		keys[way] = key;
 
-		if (mutex)
-			mutex->Unlock();
+		AntiAliasTable &aaTable = m_cachedPaletteTables[set][way];
 
-		//entry.m_aaTable.GenerateForPalette(color, m_colors, 256, true);
-		entry.m_aaTable.GenerateForPaletteFast(color);
+		//aaTable.GenerateForPalette(color, m_colors, 256, true);
+		aaTable.GenerateForPaletteFast(color);
 
-		return entry.m_aaTable;
+		return aaTable;
 	}
 
-	const AntiAliasTable &StandardPalette::GetCachedToneAATable(uint8_t tone, IGpMutex *mutex)
+	const AntiAliasTable &StandardPalette::GetCachedToneAATable(uint8_t tone)
 	{
-		if (mutex)
-			mutex->Lock();
-
-		for (size_t i = 0; i < m_numCachedToneTables; i++)
-		{
-			const CachedToneTableEntry &entry = m_cachedToneTables[i];
-			if (entry.m_tone == tone)
-			{
-				if (mutex)
-					mutex->Unlock();
-				return entry.m_aaTable;
-			}
-		}
+		const uint8_t existingSlot = m_toneTableSlots[tone];
+		if (existingSlot != kInvalidToneTableSlot)
+			return m_cachedToneTables[existingSlot];
 
 		if (m_numCachedToneTables == kMaxCachedToneTables)
 			m_numCachedToneTables = 0;
 
-		CachedToneTableEntry &entry = m_cachedToneTables[m_numCachedToneTables++];
-		entry.m_tone = tone;
+		const size_t slot = m_numCachedToneTables++;
 
-		if (mutex)
-			mutex->Unlock();
+		// Evict the tone that previously used the slot, if any
+		const uint8_t evictedTone = m_cachedToneTableTones[slot];
+		if (m_toneTableSlots[evictedTone] == slot)
+			m_toneTableSlots[evictedTone] = kInvalidToneTableSlot;
 
-		entry.m_aaTable.GenerateForSimpleScale(tone);
+		m_cachedToneTableTones[slot] = tone;
+		m_toneTableSlots[tone] = static_cast<uint8_t>(slot);
 
-		return entry.m_aaTable;
+		AntiAliasTable &aaTable = m_cachedToneTables[slot];
+		aaTable.GenerateForSimpleScale(tone);
+
+		return aaTable;
+	}
+
+	size_t StandardPalette::HashPaletteTableKey(uint32_t key)
+	{
+		return static_cast<size_t>((key * 0x9e3779b1U) >> 29) % kNumPaletteTableSets;
 	}
 
 	StandardPalette StandardPalette::ms_instance;
@@ -3,8 +3,6 @@
 #include "AntiAliasTable.h"
 #include "RGBAColor.h"
 
-struct IGpMutex;
-
 namespace PortabilityLayer
 {
 	struct AntiAliasTable;
@@ -23,33 +21,33 @@ namespace PortabilityLayer
 		uint8_t MapColorLUT(uint8_t r, uint8_t g, uint8_t b) const;
 		uint8_t MapColorLUT(const RGBAColor &color) const;
 
-		const AntiAliasTable &GetCachedPaletteAATable(const RGBAColor &color, IGpMutex *mutex = nullptr);
-		const AntiAliasTable &GetCachedToneAATable(uint8_t tone, IGpMutex *mutex = nullptr);
+		const AntiAliasTable &GetCachedPaletteAATable(const RGBAColor &color);
+		const AntiAliasTable &GetCachedToneAATable(uint8_t tone);
 
 		static StandardPalette *GetInstance();
 
 	private:
 		static StandardPalette ms_instance;
 
-		struct CachedPaletteTableEntry
-		{
-			uint8_t m_rgb[3];
-			AntiAliasTable m_aaTable;
-		};
+		// Palette tables are kept in a set-associative cache indexed by a hash of the color, with the keys
+		// stored apart from the tables so that a lookup only touches one cache line.  Tone tables are found
+		// through a direct map from tone to slot.
+		static const size_t kNumPaletteTableSets = 8;
+		static const size_t kNumPaletteTableWays = 4;
+		static const size_t kMaxCachedToneTables = 16;
 
-		struct CachedToneTableEntry
-		{
-			uint8_t m_tone;
-			AntiAliasTable m_aaTable;
-		};
+		static const uint32_t kInvalidPaletteTableKey = 0xffffffffU;
+		static const uint8_t kInvalidToneTableSlot = 0xff;
 
-		static const size_t kMaxCachedPaletteTables = 16;
-		static const size_t kMaxCachedToneTables = 16;
+		static size_t HashPaletteTableKey(uint32_t key);
 
-		CachedPaletteTableEntry m_cachedPaletteTables[kMaxCachedPaletteTables];
-		size_t m_numCachedPaletteTables;
+		uint32_t m_cachedPaletteTableKeys[kNumPaletteTableSets][kNumPaletteTableWays];
+		uint8_t m_nextPaletteTableWay[kNumPaletteTableSets];
+		AntiAliasTable m_cachedPaletteTables[kNumPaletteTableSets][kNumPaletteTableWays];
 
-		CachedToneTableEntry m_cachedToneTables[kMaxCachedToneTables];
+		uint8_t m_toneTableSlots[256];
+		uint8_t m_cachedToneTableTones[kMaxCachedToneTables];
+		AntiAliasTable m_cachedToneTables[kMaxCachedToneTables];
 		size_t m_numCachedToneTables;
 
 		RGBAColor m_colors[kSize];
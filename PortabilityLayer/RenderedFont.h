@@ -17,6 +17,9 @@ namespace PortabilityLayer
 		virtual size_t MeasureString(const uint8_t *chars, size_t len) const = 0;
 		virtual bool IsAntiAliased() const = 0;
 
+		// False for fonts that are temporary wrappers, since their address doesn't identify them
+		virtual bool CanCacheTextRuns() const = 0;
+
 		virtual void Destroy() = 0;
 
 		size_t MeasureCharStr(const char *str, size_t len) const;
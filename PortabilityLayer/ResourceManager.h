@@ -18,6 +18,9 @@ namespace PortabilityLayer
 	class ZipFileProxy;
 	class CompositeFile;
 
+	struct ResourceArchiveIndexEntry;
+	struct ResourceArchiveTypeSummary;
+
 	struct ResourceArchiveRef
 	{
 		ResourceArchiveRef();
@@ -27,6 +30,20 @@ namespace PortabilityLayer
 		int16_t m_resID;
 	};
 
+	// Maps (type, ID) to zip entries, built once when the archive is opened so lookups don't need to
+	// format and binary search file names.  The entries, slots, and types are all in one allocation.
+	struct ResourceArchiveIndex
+	{
+		ResourceArchiveIndex();
+
+		ResourceArchiveIndexEntry *m_entries;	// Resources with parseable names, in file order
+		size_t m_numEntries;
+		uint32_t *m_slots;	// Open-addressed, entry index + 1, or 0 if empty
+		size_t m_slotMask;
+		ResourceArchiveTypeSummary *m_types;
+		size_t m_numTypes;
+	};
+
 	struct IResourceIterator
 	{
 		virtual void Destroy() = 0;
@@ -39,6 +56,20 @@ namespace PortabilityLayer
 
 		virtual THandle<void> LoadResource(const ResTypeID &resTypeID, int id) = 0;
 
+		// Returns read-only resource contents without loading them, if the archive can provide them in place
+		// (i.e. an uncompressed entry in a memory-mapped archive).  Otherwise, LoadResource must be used.
+		virtual bool MapResource(const ResTypeID &resTypeID, int id, const void *&outContents, size_t &outSize) const = 0;
+
+		// Reads a resource without decompressing or validating it, so that can be done later with DecodeStoredResource,
+		// i.e. on a worker thread.  The stored data is allocated with the memory manager and must be released by the caller.
+		virtual bool LoadStoredResource(const ResTypeID &resTypeID, int id, void *&outStoredData, size_t &outStoredSize, size_t &outSize, bool &outIsDeflated) const = 0;
+
+		// Opens a resource for reading a piece at a time, decompressing as it goes.  The contents are not validated.
+		// Reads go through the archive's stream, so the archive must not be used from another thread while it is open.
+		virtual GpIOStream *OpenResourceStream(const ResTypeID &resTypeID, int id) const = 0;
+
+		// Returns true if the archive has the resource, without loading or validating it
+		virtual bool HasResource(const ResTypeID &resTypeID, int id) const = 0;
 		virtual bool HasAnyResourcesOfType(const ResTypeID &resTypeID) const = 0;
 		virtual bool FindFirstResourceOfType(const ResTypeID &resTypeID, int16_t &outID) const = 0;
 
@@ -49,6 +80,9 @@ namespace PortabilityLayer
 	{
 	public:
 		static const char *GetFileExtensionForResType(const ResTypeID &resTypeID, int &outValidationRule);
+
+		// Decompresses and validates data read by LoadStoredResource.  Doesn't touch any archive state, so it can be called from any thread.
+		static bool DecodeStoredResource(const ResTypeID &resTypeID, const void *storedData, size_t storedSize, bool isDeflated, void *outContents, size_t size);
 	};
 
 	class ResourceArchiveZipFileIterator;
@@ -62,7 +96,11 @@ namespace PortabilityLayer
 		void Destroy() override;
 
 		THandle<void> LoadResource(const ResTypeID &resTypeID, int id) override;
+		bool MapResource(const ResTypeID &resTypeID, int id, const void *&outContents, size_t &outSize) const override;
+		bool LoadStoredResource(const ResTypeID &resTypeID, int id, void *&outStoredData, size_t &outStoredSize, size_t &outSize, bool &outIsDeflated) const override;
+		GpIOStream *OpenResourceStream(const ResTypeID &resTypeID, int id) const override;
 
+		bool HasResource(const ResTypeID &resTypeID, int id) const override;
 		bool HasAnyResourcesOfType(const ResTypeID &resTypeID) const override;
 		bool FindFirstResourceOfType(const ResTypeID &resTypeID, int16_t &outID) const override;
 
@@ -74,9 +112,13 @@ namespace PortabilityLayer
 	private:
 		static const size_t kMaxResourceSize = 32 * 1024 * 1024;
 
-		ResourceArchiveZipFile(ZipFileProxy *zipFileProxy, bool proxyIsShared, GpIOStream *stream, ResourceArchiveRef *resourceHandles);
+		ResourceArchiveZipFile(ZipFileProxy *zipFileProxy, bool proxyIsShared, GpIOStream *stream, ResourceArchiveRef *resourceHandles, const ResourceArchiveIndex &index);
 		~ResourceArchiveZipFile();
 
+		static bool BuildIndex(ZipFileProxy *zipFileProxy, ResourceArchiveIndex &outIndex);
+		static uint32_t HashResource(const ResTypeID &resTypeID, int16_t id);
+		const ResourceArchiveTypeSummary *FindTypeSummary(const ResTypeID &resTypeID) const;
+
 		bool IndexResource(const ResTypeID &resTypeID, int id, size_t &outIndex, int &outValidationRule) const;
 
 		THandle<void> GetResource(const ResTypeID &resTypeID, int id, bool load);
@@ -84,6 +126,7 @@ namespace PortabilityLayer
 		ZipFileProxy *m_zipFileProxy;
 		GpIOStream *m_stream;	// This may be null, i.e. a composite file may own it instead
 		ResourceArchiveRef *m_resourceHandles;
+		ResourceArchiveIndex m_index;
 		bool m_proxyIsShared;
 	};
 
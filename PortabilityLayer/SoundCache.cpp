@@ -0,0 +1,437 @@
+#include "SoundCache.h"
+
+#include "IGpAudioBuffer.h"
+#include "IGpAudioDriver.h"
+#include "MemoryManager.h"
+#include "MMHandleBlock.h"
+#include "ResourceManager.h"
+#include "ResTypeID.h"
+#include "WaveFormat.h"
+
+#include "PLDrivers.h"
+
+#include <assert.h>
+#include <string.h>
+#include <new>
+
+namespace PortabilityLayer
+{
+	class SoundCacheImpl final : public SoundCache
+	{
+	public:
+		SoundCacheImpl();
+
+		void Init() override;
+		void Shutdown() override;
+
+		IGpAudioBuffer *GetSound(IResourceArchive *archive, int16_t resID) override;
+
+		void PurgeArchive(const IResourceArchive *archive) override;
+		void PurgeAll() override;
+
+		void SetByteBudget(size_t byteBudget) override;
+		void GetStats(SoundCacheStats &outStats) const override;
+
+		static SoundCacheImpl *GetInstance();
+
+	private:
+		struct Entry
+		{
+			const IResourceArchive *m_archive;
+			int16_t m_resID;
+
+			IGpAudioBuffer *m_buffer;	// One reference is held by the entry
+			size_t m_size;
+
+			Entry *m_nextInBucket;
+			Entry *m_lruPrev;	// More recently used
+			Entry *m_lruNext;	// Less recently used
+		};
+
+		static const size_t kNumBuckets = 64;
+		static const size_t kDefaultByteBudget = 4 * 1024 * 1024;
+
+		// The drivers convert to s16 and store the samples after the buffer object, which is padded out to the
+		// memory alignment.  This is an upper bound on the size of that header.
+		static const size_t kAudioBufferHeaderSize = 64;
+
+		static size_t HashKey(const IResourceArchive *archive, int16_t resID);
+
+		Entry *FindEntry(const IResourceArchive *archive, int16_t resID) const;
+		Entry *InsertEntry(const IResourceArchive *archive, int16_t resID, IGpAudioBuffer *buffer, size_t size);
+
+		static IGpAudioBuffer *ConvertSound(IResourceArchive *archive, int16_t resID, size_t &outSize);
+		static size_t AudioBufferSize(size_t numSamples);
+
+		void LinkMostRecent(Entry *entry);
+		void UnlinkLRU(Entry *entry);
+		void RemoveEntry(Entry *entry);
+		void EnforceBudget(const Entry *keepEntry);
+
+		Entry *m_buckets[kNumBuckets];
+		Entry *m_lruFirst;
+		Entry *m_lruLast;
+
+		size_t m_byteBudget;
+		size_t m_bytesUsed;
+		size_t m_numEntries;
+		size_t m_numHits;
+		size_t m_numMisses;
+		size_t m_numEvictions;
+
+		static SoundCacheImpl ms_instance;
+	};
+
+	SoundCacheImpl::SoundCacheImpl()
+		: m_lruFirst(nullptr)
+		, m_lruLast(nullptr)
+		, m_byteBudget(kDefaultByteBudget)
+		, m_bytesUsed(0)
+		, m_numEntries(0)
+		, m_numHits(0)
+		, m_numMisses(0)
+		, m_numEvictions(0)
+	{
+		for (size_t i = 0; i < kNumBuckets; i++)
+			m_buckets[i] = nullptr;
+	}
+
+	void SoundCacheImpl::Init()
+	{
+	}
+
+	void SoundCacheImpl::Shutdown()
+	{
+		PurgeAll();
+	}
+
+	IGpAudioBuffer *SoundCacheImpl::GetSound(IResourceArchive *archive, int16_t resID)
+	{
+		if (!archive)
+			return nullptr;
+
+		Entry *entry = FindEntry(archive, resID);
+		if (entry)
+		{
+			m_numHits++;
+
+			UnlinkLRU(entry);
+			LinkMostRecent(entry);
+
+			entry->m_buffer->AddRef();
+			return entry->m_buffer;
+		}
+
+		size_t size = 0;
+		IGpAudioBuffer *buffer = ConvertSound(archive, resID, size);
+		if (!buffer)
+			return nullptr;
+
+		m_numMisses++;
+
+		// If the entry can't be allocated, the sound is still usable, it just isn't cached
+		if (InsertEntry(archive, resID, buffer, size))
+			buffer->AddRef();
+
+		return buffer;
+	}
+
+	void SoundCacheImpl::PurgeArchive(const IResourceArchive *archive)
+	{
+		Entry *entry = m_lruFirst;
+		while (entry)
+		{
+			Entry *nextEntry = entry->m_lruNext;
+			if (entry->m_archive == archive)
+				RemoveEntry(entry);
+
+			entry = nextEntry;
+		}
+	}
+
+	void SoundCacheImpl::PurgeAll()
+	{
+		while (m_lruFirst)
+			RemoveEntry(m_lruFirst);
+	}
+
+	void SoundCacheImpl::SetByteBudget(size_t byteBudget)
+	{
+		m_byteBudget = byteBudget;
+		EnforceBudget(nullptr);
+	}
+
+	void SoundCacheImpl::GetStats(SoundCacheStats &outStats) const
+	{
+		outStats.m_numHits = m_numHits;
+		outStats.m_numMisses = m_numMisses;
+		outStats.m_numEvictions = m_numEvictions;
+		outStats.m_numEntries = m_numEntries;
+		outStats.m_bytesUsed = m_bytesUsed;
+		outStats.m_byteBudget = m_byteBudget;
+	}
+
+	size_t SoundCacheImpl::HashKey(const IResourceArchive *archive, int16_t resID)
+	{
+		size_t hash = reinterpret_cast<uintptr_t>(archive) / sizeof(void*);
+		hash = hash * 31 + static_cast<uint16_t>(resID);
+
+		return hash;
+	}
+
+	SoundCacheImpl::Entry *SoundCacheImpl::FindEntry(const IResourceArchive *archive, int16_t resID) const
+	{
+		for (Entry *entry = m_buckets[HashKey(archive, resID) % kNumBuckets]; entry; entry = entry->m_nextInBucket)
+		{
+			if (entry->m_archive == archive && entry->m_resID == resID)
+				return entry;
+		}
+
+		return nullptr;
+	}
+
+	SoundCacheImpl::Entry *SoundCacheImpl::InsertEntry(const IResourceArchive *archive, int16_t resID, IGpAudioBuffer *buffer, size_t size)
+	{
+		const size_t bucket = HashKey(archive, resID) % kNumBuckets;
+
+		void *storage = MemoryManager::GetInstance()->Alloc(sizeof(Entry));
+		if (!storage)
+			return nullptr;
+
+		Entry *entry = new (storage) Entry();
+		entry->m_archive = archive;
+		entry->m_resID = resID;
+		entry->m_buffer = buffer;
+		entry->m_size = size;
+		entry->m_nextInBucket = m_buckets[bucket];
+		m_buckets[bucket] = entry;
+
+		LinkMostRecent(entry);
+
+		m_bytesUsed += size;
+		m_numEntries++;
+
+		EnforceBudget(entry);
+
+		return entry;
+	}
+
+	IGpAudioBuffer *SoundCacheImpl::ConvertSound(IResourceArchive *archive, int16_t resID, size_t &outSize)
+	{
+		IGpAudioDriver *audioDriver = PLDrivers::GetAudioDriver();
+		if (!audioDriver)
+			return nullptr;
+
+		const void *samples = nullptr;
+		size_t numSamples = 0;
+
+		// Uncompressed sounds in mapped archives are converted in place
+		const void *mappedContents = nullptr;
+		size_t mappedSize = 0;
+		if (archive->MapResource('snd ', resID, mappedContents, mappedSize))
+		{
+			if (!ParseSound(mappedContents, mappedSize, samples, numSamples))
+				return nullptr;
+
+			outSize = AudioBufferSize(numSamples);
+			return audioDriver->CreateBuffer(samples, numSamples);
+		}
+
+		THandle<void> resHandle = archive->LoadResource('snd ', resID);
+		if (!resHandle)
+			return nullptr;
+
+		IGpAudioBuffer *buffer = nullptr;
+		if (ParseSound(*resHandle, resHandle.MMBlock()->m_size, samples, numSamples))
+		{
+			outSize = AudioBufferSize(numSamples);
+			buffer = audioDriver->CreateBuffer(samples, numSamples);
+		}
+
+		resHandle.Dispose();
+
+		return buffer;
+	}
+
+	size_t SoundCacheImpl::AudioBufferSize(size_t numSamples)
+	{
+		return numSamples * sizeof(int16_t) + kAudioBufferHeaderSize;
+	}
+
+	void SoundCacheImpl::LinkMostRecent(Entry *entry)
+	{
+		entry->m_lruPrev = nullptr;
+		entry->m_lruNext = m_lruFirst;
+
+		if (m_lruFirst)
+			m_lruFirst->m_lruPrev = entry;
+		else
+			m_lruLast = entry;
+
+		m_lruFirst = entry;
+	}
+
+	void SoundCacheImpl::UnlinkLRU(Entry *entry)
+	{
+		if (entry->m_lruPrev)
+			entry->m_lruPrev->m_lruNext = entry->m_lruNext;
+		else
+			m_lruFirst = entry->m_lruNext;
+
+		if (entry->m_lruNext)
+			entry->m_lruNext->m_lruPrev = entry->m_lruPrev;
+		else
+			m_lruLast = entry->m_lruPrev;
+
+		entry->m_lruPrev = nullptr;
+		entry->m_lruNext = nullptr;
+	}
+
+	void SoundCacheImpl::RemoveEntry(Entry *entry)
+	{
+		Entry **bucketLink = &m_buckets[HashKey(entry->m_archive, entry->m_resID) % kNumBuckets];
+		while (*bucketLink != entry)
+		{
+			assert(*bucketLink != nullptr);
+			bucketLink = &(*bucketLink)->m_nextInBucket;
+		}
+		*bucketLink = entry->m_nextInBucket;
+
+		UnlinkLRU(entry);
+
+		m_bytesUsed -= entry->m_size;
+		m_numEntries--;
+
+		entry->m_buffer->Release();
+
+		entry->~Entry();
+		MemoryManager::GetInstance()->Release(entry);
+	}
+
+	void SoundCacheImpl::EnforceBudget(const Entry *keepEntry)
+	{
+		while (m_bytesUsed > m_byteBudget && m_lruLast != nullptr && m_lruLast != keepEntry)
+		{
+			RemoveEntry(m_lruLast);
+			m_numEvictions++;
+		}
+	}
+
+	SoundCacheImpl *SoundCacheImpl::GetInstance()
+	{
+		return &ms_instance;
+	}
+
+	SoundCacheImpl SoundCacheImpl::ms_instance;
+
+	bool SoundCache::ParseSound(const void *data, size_t size, const void *&outSamples, size_t &outNumSamples)
+	{
+		const uint8_t *dataStart = static_cast<const uint8_t*>(data);
+
+		if (size < sizeof(RIFFTag))
+			return false;
+
+		RIFFTag mainRiffTag = {};
+		memcpy(static_cast<void*>(&mainRiffTag), dataStart, sizeof(RIFFTag));
+
+		if (mainRiffTag.m_tag != WaveConstants::kRiffChunkID)
+			return false;
+
+		const uint32_t riffSize = mainRiffTag.m_chunkSize;
+		if (riffSize < 4 || riffSize - 4 > size - sizeof(RIFFTag))
+			return false;
+
+		const uint8_t *riffStart = dataStart + sizeof(RIFFTag);
+		const uint8_t *riffEnd = riffStart + riffSize;
+
+		const uint8_t *formatTagLoc = nullptr;
+		const uint8_t *dataTagLoc = nullptr;
+
+		LEUInt32_t waveMarker;
+		memcpy(static_cast<void*>(&waveMarker), riffStart, 4);
+
+		if (waveMarker != WaveConstants::kWaveChunkID)
+			return false;
+
+		const uint8_t *tagSearchLoc = riffStart + 4;
+
+		// Find tags
+		while (tagSearchLoc != riffEnd)
+		{
+			if (static_cast<size_t>(riffEnd - tagSearchLoc) < sizeof(RIFFTag))
+				return false;
+
+			RIFFTag riffTag = {};
+			memcpy(static_cast<void*>(&riffTag), tagSearchLoc, sizeof(RIFFTag));
+
+			if (riffTag.m_tag == WaveConstants::kFormatChunkID)
+				formatTagLoc = tagSearchLoc;
+			else if (riffTag.m_tag == WaveConstants::kDataChunkID)
+				dataTagLoc = tagSearchLoc;
+
+			const uint32_t riffTagSizeUnpadded = riffTag.m_chunkSize;
+
+			if (riffTagSizeUnpadded == 0xffffffffU)
+				return false;
+
+			const uint32_t riffTagSizePadded = riffTagSizeUnpadded + (riffTagSizeUnpadded & 1);
+
+			tagSearchLoc += sizeof(RIFFTag);
+
+			if (static_cast<size_t>(riffEnd - tagSearchLoc) < riffTagSizePadded)
+				return false;
+
+			tagSearchLoc += riffTagSizePadded;
+		}
+
+		if (formatTagLoc == nullptr || dataTagLoc == nullptr)
+			return false;
+
+		RIFFTag fmtTag = {};
+		memcpy(static_cast<void*>(&fmtTag), formatTagLoc, sizeof(RIFFTag));
+
+		const uint8_t *formatContents = formatTagLoc + sizeof(RIFFTag);
+
+		RIFFTag dataTag = {};
+		memcpy(static_cast<void*>(&dataTag), dataTagLoc, sizeof(RIFFTag));
+
+		const uint8_t *dataContents = dataTagLoc + sizeof(RIFFTag);
+
+		WaveFormatChunkV3 formatChunkV3 = {};
+
+		size_t copyableSize = 0;
+		if (fmtTag.m_chunkSize >= sizeof(WaveFormatChunkV3))
+			copyableSize = sizeof(WaveFormatChunkV3);
+		else if (fmtTag.m_chunkSize >= sizeof(WaveFormatChunkV2))
+			copyableSize = sizeof(WaveFormatChunkV2);
+		else if (fmtTag.m_chunkSize >= sizeof(WaveFormatChunkV1))
+			copyableSize = sizeof(WaveFormatChunkV1);
+		else
+			return false;
+
+		memcpy(static_cast<void*>(&formatChunkV3), formatContents, copyableSize);
+
+		const WaveFormatChunkV2 formatChunkV2 = formatChunkV3.m_v2;
+		const WaveFormatChunkV1 formatChunkV1 = formatChunkV2.m_v1;
+
+		if (formatChunkV1.m_formatCode != WaveConstants::kFormatPCM ||
+			formatChunkV1.m_numChannels != 1 ||
+			formatChunkV1.m_blockAlignmentBytes != 1 ||
+			formatChunkV1.m_bitsPerSample != 8)
+			return false;
+
+		uint32_t dataSize = dataTag.m_chunkSize;
+		if (dataSize > 0x1000000 || dataSize < 1)
+			return false;
+
+		outSamples = dataContents;
+		outNumSamples = dataSize;
+
+		return true;
+	}
+
+	SoundCache *SoundCache::GetInstance()
+	{
+		return SoundCacheImpl::GetInstance();
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct IGpAudioBuffer;
+
+namespace PortabilityLayer
+{
+	struct IResourceArchive;
+
+	struct SoundCacheStats
+	{
+		size_t m_numHits;
+		size_t m_numMisses;
+		size_t m_numEvictions;
+		size_t m_numEntries;
+		size_t m_bytesUsed;
+		size_t m_byteBudget;
+	};
+
+	// Keeps recently used 'snd ' resources converted to audio driver buffers, so that sounds used over and over
+	// (i.e. the same trigger sound in many rooms) aren't parsed and converted every time.  Buffers are
+	// reference counted, so evicting an entry only drops the cache's reference.  Entries are evicted
+	// least-recently-used first once the byte budget is exceeded.
+	class SoundCache
+	{
+	public:
+		virtual void Init() = 0;
+		virtual void Shutdown() = 0;
+
+		// Returns a converted sound with a reference added for the caller, or nullptr if the archive doesn't
+		// contain it or it isn't a valid sound
+		virtual IGpAudioBuffer *GetSound(IResourceArchive *archive, int16_t resID) = 0;
+
+		virtual void PurgeArchive(const IResourceArchive *archive) = 0;
+		virtual void PurgeAll() = 0;
+
+		virtual void SetByteBudget(size_t byteBudget) = 0;
+		virtual void GetStats(SoundCacheStats &outStats) const = 0;
+
+		// Finds the samples in a sound resource, which must be an 8-bit mono PCM WAV
+		static bool ParseSound(const void *data, size_t size, const void *&outSamples, size_t &outNumSamples);
+
+		static SoundCache *GetInstance();
+	};
+}
@@ -0,0 +1,531 @@
+#include "SoundStreamer.h"
+
+#include "FileManager.h"
+#include "GpIOStream.h"
+#include "IGpAudioBuffer.h"
+#include "IGpAudioDriver.h"
+#include "IGpLogDriver.h"
+#include "IGpMutex.h"
+#include "IGpSystemServices.h"
+#include "IGpThreadEvent.h"
+#include "MemoryManager.h"
+#include "PascalStrLiteral.h"
+#include "ResourceManager.h"
+#include "ResTypeID.h"
+#include "VirtualDirectory.h"
+#include "WaveFormat.h"
+#include "WorkerThread.h"
+
+#include "PLDrivers.h"
+#include "PLPasStr.h"
+#include "PLSound.h"
+
+#include <string.h>
+#include <new>
+
+namespace PortabilityLayer
+{
+	class SoundStreamerImpl final : public SoundStreamer
+	{
+	public:
+		SoundStreamerImpl(AudioChannel *channel, int baseResID, size_t numSounds, NextSoundCallback_t nextSoundCallback, void *callbackContext);
+
+		bool Init();
+		void Destroy() override;
+
+		bool Start(const size_t *leadInSounds, size_t numLeadInSounds) override;
+		void Stop() override;
+
+	private:
+		struct SoundInfo
+		{
+			uint32_t m_dataOffset;
+			uint32_t m_dataSize;
+		};
+
+		static const size_t kChunkSize = 8192;		// Samples, the sounds are 8-bit mono
+		static const size_t kMaxQueuedChunks = 4;
+
+		~SoundStreamerImpl() override;
+
+		static bool ParseSoundHeader(GpIOStream *stream, SoundInfo &outInfo);
+
+		static void StaticFeedThreadFunc(void *context);
+		void FeedThreadFunc();
+
+		static void StaticChunkFinished(AudioChannel *channel);
+		void ChunkFinished();
+
+		bool NeedsChunk() const;
+		bool QueueChunk();
+		bool OpenNextSound();
+		void CloseSound();
+
+		AudioChannel *m_channel;
+		IGpAudioDriver *m_audioDriver;
+		int m_baseResID;
+		size_t m_numSounds;
+		NextSoundCallback_t m_nextSoundCallback;
+		void *m_callbackContext;
+
+		CompositeFile *m_resFile;
+		IResourceArchive *m_resArchive;	// Only used by the worker thread once it is running
+		SoundInfo *m_sounds;
+
+		WorkerThread *m_feedThread;
+		IGpMutex *m_feedMutex;	// Held by the worker while feeding, guards everything below except the queued chunk count
+		IGpMutex *m_queueMutex;	// Guards the queued chunk count, which the channel callback changes
+		IGpThreadEvent *m_wakeEvent;
+		IGpThreadEvent *m_feedExitEvent;
+		bool m_feedThreadRunning;
+
+		bool m_isPlaying;
+		bool m_isTerminating;
+		size_t m_numQueuedChunks;
+
+		size_t m_leadInSounds[kMaxLeadInSounds];
+		size_t m_numLeadInSounds;
+		size_t m_nextLeadInSound;
+
+		GpIOStream *m_soundStream;
+		size_t m_soundBytesRemaining;
+
+		uint8_t m_chunkData[kChunkSize];
+	};
+
+	SoundStreamerImpl::SoundStreamerImpl(AudioChannel *channel, int baseResID, size_t numSounds, NextSoundCallback_t nextSoundCallback, void *callbackContext)
+		: m_channel(channel)
+		, m_audioDriver(PLDrivers::GetAudioDriver())
+		, m_baseResID(baseResID)
+		, m_numSounds(numSounds)
+		, m_nextSoundCallback(nextSoundCallback)
+		, m_callbackContext(callbackContext)
+		, m_resFile(nullptr)
+		, m_resArchive(nullptr)
+		, m_sounds(nullptr)
+		, m_feedThread(nullptr)
+		, m_feedMutex(nullptr)
+		, m_queueMutex(nullptr)
+		, m_wakeEvent(nullptr)
+		, m_feedExitEvent(nullptr)
+		, m_feedThreadRunning(false)
+		, m_isPlaying(false)
+		, m_isTerminating(false)
+		, m_numQueuedChunks(0)
+		, m_numLeadInSounds(0)
+		, m_nextLeadInSound(0)
+		, m_soundStream(nullptr)
+		, m_soundBytesRemaining(0)
+	{
+	}
+
+	SoundStreamerImpl::~SoundStreamerImpl()
+	{
+		if (m_feedThreadRunning)
+		{
+			Stop();
+
+			m_feedMutex->Lock();
+			m_isTerminating = true;
+			m_feedMutex->Unlock();
+
+			m_wakeEvent->Signal();
+			m_feedExitEvent->Wait();
+		}
+
+		if (m_feedThread)
+			m_feedThread->Destroy();
+
+		if (m_channel->GetCallbackContext() == this)
+			m_channel->SetCallbackContext(nullptr);
+
+		CloseSound();
+
+		if (m_sounds)
+			MemoryManager::GetInstance()->Release(m_sounds);
+
+		if (m_resArchive)
+			m_resArchive->Destroy();
+
+		if (m_resFile)
+			m_resFile->Close();
+
+		if (m_feedMutex)
+			m_feedMutex->Destroy();
+		if (m_queueMutex)
+			m_queueMutex->Destroy();
+		if (m_wakeEvent)
+			m_wakeEvent->Destroy();
+		if (m_feedExitEvent)
+			m_feedExitEvent->Destroy();
+	}
+
+	bool SoundStreamerImpl::Init()
+	{
+		if (!m_audioDriver || m_numSounds == 0)
+			return false;
+
+		// Check for threads first, there's no point in opening anything without them
+		IGpSystemServices *sysServices = PLDrivers::GetSystemServices();
+
+		m_feedMutex = sysServices->CreateMutex();
+		m_queueMutex = sysServices->CreateMutex();
+		m_wakeEvent = sysServices->CreateThreadEvent(true, false);
+		m_feedExitEvent = sysServices->CreateThreadEvent(true, false);
+		if (!m_feedMutex || !m_queueMutex || !m_wakeEvent || !m_feedExitEvent)
+			return false;
+
+		m_feedThread = WorkerThread::Create();
+		if (!m_feedThread)
+			return false;
+
+		// Open a separate copy of the resources, since the main thread's archive shares one stream between all of its reads
+		m_resFile = FileManager::GetInstance()->OpenCompositeFile(VirtualDirectories::kApplicationData, PSTR("ApplicationResources"));
+		if (!m_resFile)
+			return false;
+
+		m_resArchive = ResourceManager::GetInstance()->LoadResFile(m_resFile);
+		if (!m_resArchive)
+			return false;
+
+		m_sounds = static_cast<SoundInfo*>(MemoryManager::GetInstance()->Alloc(sizeof(SoundInfo) * m_numSounds));
+		if (!m_sounds)
+			return false;
+
+		for (size_t i = 0; i < m_numSounds; i++)
+		{
+			GpIOStream *stream = m_resArchive->OpenResourceStream('snd ', m_baseResID + static_cast<int>(i));
+			if (!stream)
+				return false;
+
+			const bool parsedOK = ParseSoundHeader(stream, m_sounds[i]);
+			stream->Close();
+
+			if (!parsedOK)
+				return false;
+		}
+
+		m_channel->SetCallbackContext(this);
+
+		m_feedThreadRunning = true;
+		m_feedThread->AsyncExecuteTask(StaticFeedThreadFunc, this);
+
+		return true;
+	}
+
+	void SoundStreamerImpl::Destroy()
+	{
+		this->~SoundStreamerImpl();
+		MemoryManager::GetInstance()->Release(this);
+	}
+
+	bool SoundStreamerImpl::Start(const size_t *leadInSounds, size_t numLeadInSounds)
+	{
+		if (numLeadInSounds > kMaxLeadInSounds)
+			return false;
+
+		for (size_t i = 0; i < numLeadInSounds; i++)
+		{
+			if (leadInSounds[i] >= m_numSounds)
+				return false;
+		}
+
+		m_feedMutex->Lock();
+
+		for (size_t i = 0; i < numLeadInSounds; i++)
+			m_leadInSounds[i] = leadInSounds[i];
+
+		m_numLeadInSounds = numLeadInSounds;
+		m_nextLeadInSound = 0;
+		m_isPlaying = true;
+
+		m_feedMutex->Unlock();
+
+		m_wakeEvent->Signal();
+
+		return true;
+	}
+
+	void SoundStreamerImpl::Stop()
+	{
+		// Taking the feed mutex waits out any chunk that is being queued.  The channel callback only takes the
+		// queue mutex, so it can't deadlock against clearing the channel here.
+		m_feedMutex->Lock();
+
+		m_isPlaying = false;
+
+		m_channel->ClearAllCommands();
+		m_channel->Stop();
+
+		CloseSound();
+		m_numLeadInSounds = 0;
+		m_nextLeadInSound = 0;
+
+		m_queueMutex->Lock();
+		m_numQueuedChunks = 0;
+		m_queueMutex->Unlock();
+
+		m_feedMutex->Unlock();
+	}
+
+	bool SoundStreamerImpl::ParseSoundHeader(GpIOStream *stream, SoundInfo &outInfo)
+	{
+		const GpUFilePos_t size = stream->Size();
+
+		if (size < sizeof(RIFFTag))
+			return false;
+
+		RIFFTag mainRiffTag;
+		if (!stream->ReadExact(&mainRiffTag, sizeof(RIFFTag)))
+			return false;
+
+		if (mainRiffTag.m_tag != WaveConstants::kRiffChunkID)
+			return false;
+
+		const uint32_t riffSize = mainRiffTag.m_chunkSize;
+		if (riffSize < 4 || riffSize - 4 > size - sizeof(RIFFTag))
+			return false;
+
+		const GpUFilePos_t riffEnd = sizeof(RIFFTag) + static_cast<GpUFilePos_t>(riffSize);
+
+		LEUInt32_t waveMarker;
+		if (!stream->ReadExact(&waveMarker, 4))
+			return false;
+
+		if (waveMarker != WaveConstants::kWaveChunkID)
+			return false;
+
+		WaveFormatChunkV3 formatChunkV3 = {};
+
+		bool haveFormat = false;
+		bool haveData = false;
+		uint32_t dataOffset = 0;
+		uint32_t dataSize = 0;
+
+		// Find tags, this stops once both are found so the stream doesn't have to be decompressed through the sample data
+		GpUFilePos_t tagSearchPos = sizeof(RIFFTag) + 4;
+		while (tagSearchPos != riffEnd && !(haveFormat && haveData))
+		{
+			if (riffEnd - tagSearchPos < sizeof(RIFFTag))
+				return false;
+
+			RIFFTag riffTag;
+			if (!stream->SeekStart(tagSearchPos) || !stream->ReadExact(&riffTag, sizeof(RIFFTag)))
+				return false;
+
+			const uint32_t riffTagSizeUnpadded = riffTag.m_chunkSize;
+
+			if (riffTagSizeUnpadded == 0xffffffffU)
+				return false;
+
+			const uint32_t riffTagSizePadded = riffTagSizeUnpadded + (riffTagSizeUnpadded & 1);
+
+			tagSearchPos += sizeof(RIFFTag);
+
+			if (riffEnd - tagSearchPos < riffTagSizePadded)
+				return false;
+
+			if (riffTag.m_tag == WaveConstants::kFormatChunkID && !haveFormat)
+			{
+				size_t copyableSize = 0;
+				if (riffTagSizeUnpadded >= sizeof(WaveFormatChunkV3))
+					copyableSize = sizeof(WaveFormatChunkV3);
+				else if (riffTagSizeUnpadded >= sizeof(WaveFormatChunkV2))
+					copyableSize = sizeof(WaveFormatChunkV2);
+				else if (riffTagSizeUnpadded >= sizeof(WaveFormatChunkV1))
+					copyableSize = sizeof(WaveFormatChunkV1);
+				else
+					return false;
+
+				if (!stream->ReadExact(&formatChunkV3, copyableSize))
+					return false;
+
+				haveFormat = true;
+			}
+			else if (riffTag.m_tag == WaveConstants::kDataChunkID && !haveData)
+			{
+				dataOffset = static_cast<uint32_t>(tagSearchPos);
+				dataSize = riffTagSizeUnpadded;
+				haveData = true;
+			}
+
+			tagSearchPos += riffTagSizePadded;
+		}
+
+		if (!haveFormat || !haveData)
+			return false;
+
+		const WaveFormatChunkV1 formatChunkV1 = formatChunkV3.m_v2.m_v1;
+
+		if (formatChunkV1.m_formatCode != WaveConstants::kFormatPCM ||
+			formatChunkV1.m_numChannels != 1 ||
+			formatChunkV1.m_blockAlignmentBytes != 1 ||
+			formatChunkV1.m_bitsPerSample != 8)
+			return false;
+
+		if (dataSize > 0x1000000 || dataSize < 1)
+			return false;
+
+		outInfo.m_dataOffset = dataOffset;
+		outInfo.m_dataSize = dataSize;
+
+		return true;
+	}
+
+	void SoundStreamerImpl::StaticFeedThreadFunc(void *context)
+	{
+		static_cast<SoundStreamerImpl*>(context)->FeedThreadFunc();
+	}
+
+	void SoundStreamerImpl::FeedThreadFunc()
+	{
+		for (;;)
+		{
+			m_wakeEvent->Wait();
+
+			m_feedMutex->Lock();
+
+			if (m_isTerminating)
+			{
+				m_feedMutex->Unlock();
+				break;
+			}
+
+			while (m_isPlaying && NeedsChunk())
+			{
+				if (!QueueChunk())
+				{
+					IGpLogDriver *logger = PLDrivers::GetLogDriver();
+					if (logger)
+						logger->Printf(IGpLogDriver::Category_Error, "SoundStreamer: Failed to queue a chunk, stopping");
+
+					CloseSound();
+					m_isPlaying = false;
+				}
+			}
+
+			m_feedMutex->Unlock();
+		}
+
+		m_feedExitEvent->Signal();
+	}
+
+	void SoundStreamerImpl::StaticChunkFinished(AudioChannel *channel)
+	{
+		static_cast<SoundStreamerImpl*>(channel->GetCallbackContext())->ChunkFinished();
+	}
+
+	void SoundStreamerImpl::ChunkFinished()
+	{
+		m_queueMutex->Lock();
+		if (m_numQueuedChunks > 0)
+			m_numQueuedChunks--;
+		m_queueMutex->Unlock();
+
+		m_wakeEvent->Signal();
+	}
+
+	bool SoundStreamerImpl::NeedsChunk() const
+	{
+		m_queueMutex->Lock();
+		const bool needsChunk = (m_numQueuedChunks < kMaxQueuedChunks);
+		m_queueMutex->Unlock();
+
+		return needsChunk;
+	}
+
+	bool SoundStreamerImpl::QueueChunk()
+	{
+		if (!m_soundStream && !OpenNextSound())
+			return false;
+
+		size_t chunkSize = kChunkSize;
+		if (chunkSize > m_soundBytesRemaining)
+			chunkSize = m_soundBytesRemaining;
+
+		if (!m_soundStream->ReadExact(m_chunkData, chunkSize))
+			return false;
+
+		m_soundBytesRemaining -= chunkSize;
+		if (m_soundBytesRemaining == 0)
+			CloseSound();
+
+		IGpAudioBuffer *buffer = m_audioDriver->CreateBuffer(m_chunkData, chunkSize);
+		if (!buffer)
+			return false;
+
+		// Counted before queueing, since the chunk can finish before AddBuffer returns
+		m_queueMutex->Lock();
+		m_numQueuedChunks++;
+		m_queueMutex->Unlock();
+
+		const bool queuedOK = m_channel->AddBuffer(buffer, false) && m_channel->AddCallback(StaticChunkFinished, false);
+		buffer->Release();
+
+		return queuedOK;
+	}
+
+	bool SoundStreamerImpl::OpenNextSound()
+	{
+		size_t soundIndex = 0;
+		if (m_nextLeadInSound < m_numLeadInSounds)
+			soundIndex = m_leadInSounds[m_nextLeadInSound++];
+		else
+			soundIndex = m_nextSoundCallback(m_callbackContext);
+
+		if (soundIndex >= m_numSounds)
+			return false;
+
+		const SoundInfo &info = m_sounds[soundIndex];
+
+		GpIOStream *stream = m_resArchive->OpenResourceStream('snd ', m_baseResID + static_cast<int>(soundIndex));
+		if (!stream)
+			return false;
+
+		if (!stream->SeekStart(info.m_dataOffset))
+		{
+			stream->Close();
+			return false;
+		}
+
+		m_soundStream = stream;
+		m_soundBytesRemaining = info.m_dataSize;
+
+		return true;
+	}
+
+	void SoundStreamerImpl::CloseSound()
+	{
+		if (m_soundStream)
+		{
+			m_soundStream->Close();
+			m_soundStream = nullptr;
+		}
+
+		m_soundBytesRemaining = 0;
+	}
+
+	SoundStreamer::SoundStreamer()
+	{
+	}
+
+	SoundStreamer::~SoundStreamer()
+	{
+	}
+
+	SoundStreamer *SoundStreamer::Create(AudioChannel *channel, int baseResID, size_t numSounds, NextSoundCallback_t nextSoundCallback, void *callbackContext)
+	{
+		void *storage = MemoryManager::GetInstance()->Alloc(sizeof(SoundStreamerImpl));
+		if (!storage)
+			return nullptr;
+
+		SoundStreamerImpl *streamer = new (storage) SoundStreamerImpl(channel, baseResID, numSounds, nextSoundCallback, callbackContext);
+		if (!streamer->Init())
+		{
+			streamer->Destroy();
+			return nullptr;
+		}
+
+		return streamer;
+	}
+}
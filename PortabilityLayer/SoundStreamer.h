@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace PortabilityLayer
+{
+	struct AudioChannel;
+
+	// Plays a sequence of application 'snd ' resources on a channel, reading and converting a few chunks ahead
+	// of the playhead on a worker thread instead of keeping whole sounds resident.  The worker reads from its
+	// own copy of the application resources, so the main thread's resource archive is never touched.
+	class SoundStreamer
+	{
+	public:
+		// Called on the worker thread when the next sound needs to be read, returns the index of the sound to
+		// play next.  This runs a few chunks before the current sound finishes playing.
+		typedef size_t(*NextSoundCallback_t)(void *context);
+
+		static const size_t kMaxLeadInSounds = 4;
+
+		// Returns null if sounds can't be streamed, i.e. there are no worker threads or one of the sounds isn't
+		// an 8-bit mono PCM WAV, in which case they should be loaded instead.  Sounds are indexed from 0 and
+		// have consecutive resource IDs starting at baseResID.  The streamer takes over the channel's callback
+		// context.
+		static SoundStreamer *Create(AudioChannel *channel, int baseResID, size_t numSounds, NextSoundCallback_t nextSoundCallback, void *callbackContext);
+		virtual void Destroy() = 0;
+
+		// Plays the lead-in sounds in order, then whatever the callback returns
+		virtual bool Start(const size_t *leadInSounds, size_t numLeadInSounds) = 0;
+
+		// Stops playback and clears the channel, nothing is queued to the channel after this returns
+		virtual void Stop() = 0;
+
+	protected:
+		SoundStreamer();
+		virtual ~SoundStreamer();
+	};
+}
@@ -0,0 +1,377 @@
+#include "TextRunCache.h"
+
+#include "GpRenderedGlyphMetrics.h"
+#include "MemoryManager.h"
+#include "RenderedFont.h"
+#include "TextPlacer.h"
+
+#include "PLPasStr.h"
+
+#include <assert.h>
+#include <string.h>
+#include <new>
+
+namespace PortabilityLayer
+{
+	class TextRunCacheImpl final : public TextRunCache
+	{
+	public:
+		TextRunCacheImpl();
+
+		void Init() override;
+		void Shutdown() override;
+
+		bool GetTextRun(RenderedFont *rfont, int32_t spanWidth, const PLPasStr &str, TextRun &outRun) override;
+
+		void PurgeFont(const RenderedFont *rfont) override;
+		void PurgeAll() override;
+
+		void GetStats(TextRunCacheStats &outStats) const override;
+
+		static TextRunCacheImpl *GetInstance();
+
+	private:
+		// Allocated in one block, followed by the glyphs, the string and then the coverage
+		struct Entry
+		{
+			const RenderedFont *m_rfont;
+			int32_t m_spanWidth;
+			size_t m_hash;
+
+			const uint8_t *m_chars;
+			size_t m_length;
+
+			TextRunGlyph *m_glyphs;
+			size_t m_numGlyphs;
+
+			size_t m_size;
+
+			Entry *m_nextInBucket;
+			Entry *m_lruPrev;	// More recently used
+			Entry *m_lruNext;	// Less recently used
+		};
+
+		static const size_t kNumBuckets = 64;
+		static const size_t kDefaultByteBudget = 1024 * 1024;
+		static const size_t kMaxEntrySize = 64 * 1024;
+
+		static size_t HashKey(const RenderedFont *rfont, int32_t spanWidth, const uint8_t *chars, size_t length);
+
+		Entry *FindEntry(const RenderedFont *rfont, int32_t spanWidth, const uint8_t *chars, size_t length, size_t hash) const;
+		Entry *CreateEntry(RenderedFont *rfont, int32_t spanWidth, const PLPasStr &str, size_t hash);
+
+		void LinkMostRecent(Entry *entry);
+		void UnlinkLRU(Entry *entry);
+		void RemoveEntry(Entry *entry);
+		void EnforceBudget(const Entry *keepEntry);
+
+		Entry *m_buckets[kNumBuckets];
+		Entry *m_lruFirst;
+		Entry *m_lruLast;
+
+		size_t m_byteBudget;
+		size_t m_bytesUsed;
+		size_t m_numEntries;
+		size_t m_numHits;
+		size_t m_numMisses;
+		size_t m_numEvictions;
+
+		static TextRunCacheImpl ms_instance;
+	};
+
+	TextRunCacheImpl::TextRunCacheImpl()
+		: m_lruFirst(nullptr)
+		, m_lruLast(nullptr)
+		, m_byteBudget(kDefaultByteBudget)
+		, m_bytesUsed(0)
+		, m_numEntries(0)
+		, m_numHits(0)
+		, m_numMisses(0)
+		, m_numEvictions(0)
+	{
+		for (size_t i = 0; i < kNumBuckets; i++)
+			m_buckets[i] = nullptr;
+	}
+
+	void TextRunCacheImpl::Init()
+	{
+	}
+
+	void TextRunCacheImpl::Shutdown()
+	{
+		PurgeAll();
+	}
+
+	bool TextRunCacheImpl::GetTextRun(RenderedFont *rfont, int32_t spanWidth, const PLPasStr &str, TextRun &outRun)
+	{
+		if (!rfont->CanCacheTextRuns())
+			return false;
+
+		const size_t hash = HashKey(rfont, spanWidth, str.UChars(), str.Length());
+
+		Entry *entry = FindEntry(rfont, spanWidth, str.UChars(), str.Length(), hash);
+		if (entry)
+		{
+			m_numHits++;
+
+			UnlinkLRU(entry);
+			LinkMostRecent(entry);
+		}
+		else
+		{
+			entry = CreateEntry(rfont, spanWidth, str, hash);
+			if (!entry)
+				return false;
+
+			m_numMisses++;
+		}
+
+		outRun.m_glyphs = entry->m_glyphs;
+		outRun.m_numGlyphs = entry->m_numGlyphs;
+
+		return true;
+	}
+
+	void TextRunCacheImpl::PurgeFont(const RenderedFont *rfont)
+	{
+		Entry *entry = m_lruFirst;
+		while (entry)
+		{
+			Entry *nextEntry = entry->m_lruNext;
+			if (entry->m_rfont == rfont)
+				RemoveEntry(entry);
+
+			entry = nextEntry;
+		}
+	}
+
+	void TextRunCacheImpl::PurgeAll()
+	{
+		while (m_lruFirst)
+			RemoveEntry(m_lruFirst);
+	}
+
+	void TextRunCacheImpl::GetStats(TextRunCacheStats &outStats) const
+	{
+		outStats.m_numHits = m_numHits;
+		outStats.m_numMisses = m_numMisses;
+		outStats.m_numEvictions = m_numEvictions;
+		outStats.m_numEntries = m_numEntries;
+		outStats.m_bytesUsed = m_bytesUsed;
+		outStats.m_byteBudget = m_byteBudget;
+	}
+
+	size_t TextRunCacheImpl::HashKey(const RenderedFont *rfont, int32_t spanWidth, const uint8_t *chars, size_t length)
+	{
+		size_t hash = reinterpret_cast<uintptr_t>(rfont) / sizeof(void*);
+		hash = hash * 31 + static_cast<uint32_t>(spanWidth);
+
+		for (size_t i = 0; i < length; i++)
+			hash = hash * 31 + chars[i];
+
+		return hash;
+	}
+
+	TextRunCacheImpl::Entry *TextRunCacheImpl::FindEntry(const RenderedFont *rfont, int32_t spanWidth, const uint8_t *chars, size_t length, size_t hash) const
+	{
+		for (Entry *entry = m_buckets[hash % kNumBuckets]; entry; entry = entry->m_nextInBucket)
+		{
+			if (entry->m_hash == hash && entry->m_rfont == rfont && entry->m_spanWidth == spanWidth && entry->m_length == length && !memcmp(entry->m_chars, chars, length))
+				return entry;
+		}
+
+		return nullptr;
+	}
+
+	TextRunCacheImpl::Entry *TextRunCacheImpl::CreateEntry(RenderedFont *rfont, int32_t spanWidth, const PLPasStr &str, size_t hash)
+	{
+		const Vec2i basePoint(0, 0);
+
+		// Measure first, so the entry can be allocated in one block
+		size_t numGlyphs = 0;
+		size_t coverageSize = 0;
+		{
+			TextPlacer placer(basePoint, spanWidth, rfont, str);
+
+			GlyphPlacementCharacteristics characteristics;
+			while (placer.PlaceGlyph(characteristics))
+			{
+				if (!characteristics.m_haveGlyph)
+					continue;
+
+				const GpRenderedGlyphMetrics *metrics = characteristics.m_glyphMetrics;
+				if (metrics->m_glyphWidth == 0 || metrics->m_glyphHeight == 0)
+					continue;
+
+				numGlyphs++;
+				coverageSize += static_cast<size_t>(metrics->m_glyphWidth) * metrics->m_glyphHeight;
+			}
+		}
+
+		const size_t length = str.Length();
+		const size_t glyphsOffset = sizeof(Entry);
+		const size_t charsOffset = glyphsOffset + numGlyphs * sizeof(TextRunGlyph);
+		const size_t coverageOffset = charsOffset + length;
+		const size_t entrySize = coverageOffset + coverageSize;
+
+		if (entrySize > kMaxEntrySize)
+			return nullptr;
+
+		void *storage = MemoryManager::GetInstance()->Alloc(entrySize);
+		if (!storage)
+			return nullptr;
+
+		uint8_t *entryBytes = static_cast<uint8_t*>(storage);
+
+		Entry *entry = new (storage) Entry();
+		entry->m_rfont = rfont;
+		entry->m_spanWidth = spanWidth;
+		entry->m_hash = hash;
+		entry->m_chars = entryBytes + charsOffset;
+		entry->m_length = length;
+		entry->m_glyphs = reinterpret_cast<TextRunGlyph*>(entryBytes + glyphsOffset);
+		entry->m_numGlyphs = numGlyphs;
+		entry->m_size = entrySize;
+
+		memcpy(entryBytes + charsOffset, str.UChars(), length);
+
+		const bool isAA = rfont->IsAntiAliased();
+		uint8_t *coverage = entryBytes + coverageOffset;
+		size_t glyphIndex = 0;
+
+		TextPlacer placer(basePoint, spanWidth, rfont, str);
+
+		GlyphPlacementCharacteristics characteristics;
+		while (placer.PlaceGlyph(characteristics))
+		{
+			if (!characteristics.m_haveGlyph)
+				continue;
+
+			const GpRenderedGlyphMetrics *metrics = characteristics.m_glyphMetrics;
+			if (metrics->m_glyphWidth == 0 || metrics->m_glyphHeight == 0)
+				continue;
+
+			assert(glyphIndex < numGlyphs);
+
+			TextRunGlyph *glyph = new (entry->m_glyphs + glyphIndex) TextRunGlyph();
+			glyph->m_left = characteristics.m_glyphStartPos.m_x + metrics->m_bearingX;
+			glyph->m_top = characteristics.m_glyphStartPos.m_y - metrics->m_bearingY;
+			glyph->m_width = metrics->m_glyphWidth;
+			glyph->m_height = metrics->m_glyphHeight;
+			glyph->m_coverage = coverage;
+
+			const uint8_t *glyphData = static_cast<const uint8_t*>(characteristics.m_glyphData);
+			for (uint32_t row = 0; row < metrics->m_glyphHeight; row++)
+			{
+				UnpackGlyphRow(glyphData + row * metrics->m_glyphDataPitch, isAA, 0, metrics->m_glyphWidth, coverage);
+				coverage += metrics->m_glyphWidth;
+			}
+
+			glyphIndex++;
+		}
+
+		assert(glyphIndex == numGlyphs);
+
+		const size_t bucket = hash % kNumBuckets;
+		entry->m_nextInBucket = m_buckets[bucket];
+		m_buckets[bucket] = entry;
+
+		LinkMostRecent(entry);
+
+		m_bytesUsed += entrySize;
+		m_numEntries++;
+
+		EnforceBudget(entry);
+
+		return entry;
+	}
+
+	void TextRunCacheImpl::LinkMostRecent(Entry *entry)
+	{
+		entry->m_lruPrev = nullptr;
+		entry->m_lruNext = m_lruFirst;
+
+		if (m_lruFirst)
+			m_lruFirst->m_lruPrev = entry;
+		else
+			m_lruLast = entry;
+
+		m_lruFirst = entry;
+	}
+
+	void TextRunCacheImpl::UnlinkLRU(Entry *entry)
+	{
+		if (entry->m_lruPrev)
+			entry->m_lruPrev->m_lruNext = entry->m_lruNext;
+		else
+			m_lruFirst = entry->m_lruNext;
+
+		if (entry->m_lruNext)
+			entry->m_lruNext->m_lruPrev = entry->m_lruPrev;
+		else
+			m_lruLast = entry->m_lruPrev;
+
+		entry->m_lruPrev = nullptr;
+		entry->m_lruNext = nullptr;
+	}
+
+	void TextRunCacheImpl::RemoveEntry(Entry *entry)
+	{
+		Entry **bucketLink = &m_buckets[entry->m_hash % kNumBuckets];
+		while (*bucketLink != entry)
+		{
+			assert(*bucketLink != nullptr);
+			bucketLink = &(*bucketLink)->m_nextInBucket;
+		}
+		*bucketLink = entry->m_nextInBucket;
+
+		UnlinkLRU(entry);
+
+		m_bytesUsed -= entry->m_size;
+		m_numEntries--;
+
+		entry->~Entry();
+		MemoryManager::GetInstance()->Release(entry);
+	}
+
+	void TextRunCacheImpl::EnforceBudget(const Entry *keepEntry)
+	{
+		while (m_bytesUsed > m_byteBudget && m_lruLast != nullptr && m_lruLast != keepEntry)
+		{
+			RemoveEntry(m_lruLast);
+			m_numEvictions++;
+		}
+	}
+
+	TextRunCacheImpl *TextRunCacheImpl::GetInstance()
+	{
+		return &ms_instance;
+	}
+
+	TextRunCacheImpl TextRunCacheImpl::ms_instance;
+
+	void TextRunCache::UnpackGlyphRow(const uint8_t *glyphRowData, bool isAA, uint32_t firstCol, uint32_t numCols, uint8_t *outCoverage)
+	{
+		if (isAA)
+		{
+			for (uint32_t col = 0; col < numCols; col++)
+			{
+				const size_t inputOffset = firstCol + col;
+				outCoverage[col] = (glyphRowData[inputOffset / 2] >> ((inputOffset & 1) * 4)) & 0xf;
+			}
+		}
+		else
+		{
+			for (uint32_t col = 0; col < numCols; col++)
+			{
+				const size_t inputOffset = firstCol + col;
+				outCoverage[col] = (glyphRowData[inputOffset / 8] & (1 << (inputOffset & 0x7))) ? 15 : 0;
+			}
+		}
+	}
+
+	TextRunCache *TextRunCache::GetInstance()
+	{
+		return TextRunCacheImpl::GetInstance();
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+class PLPasStr;
+
+namespace PortabilityLayer
+{
+	class RenderedFont;
+
+	struct TextRunGlyph
+	{
+		// Position of the glyph bitmap relative to the pen position that the run was drawn at
+		int32_t m_left;
+		int32_t m_top;
+
+		uint32_t m_width;
+		uint32_t m_height;
+
+		// One coverage level (0..15) per pixel, m_width bytes per row
+		const uint8_t *m_coverage;
+	};
+
+	struct TextRun
+	{
+		const TextRunGlyph *m_glyphs;
+		size_t m_numGlyphs;
+	};
+
+	struct TextRunCacheStats
+	{
+		size_t m_numHits;
+		size_t m_numMisses;
+		size_t m_numEvictions;
+		size_t m_numEntries;
+		size_t m_bytesUsed;
+		size_t m_byteBudget;
+	};
+
+	// Keeps the glyph layout of recently drawn strings, with each glyph's bitmap unpacked to one coverage
+	// level per pixel, so that redrawing a string (i.e. the scoreboard or a menu) skips both the text
+	// placement and the bit unpacking.  Color and pixel format are applied when the run is drawn, so one
+	// entry serves every color and surface that the string is drawn to.
+	class TextRunCache
+	{
+	public:
+		virtual void Init() = 0;
+		virtual void Shutdown() = 0;
+
+		// Returns false if the font can't be cached or the run is too large, in which case the caller
+		// should place the glyphs itself.  The run is only valid until the next call to GetTextRun.
+		virtual bool GetTextRun(RenderedFont *rfont, int32_t spanWidth, const PLPasStr &str, TextRun &outRun) = 0;
+
+		virtual void PurgeFont(const RenderedFont *rfont) = 0;
+		virtual void PurgeAll() = 0;
+
+		virtual void GetStats(TextRunCacheStats &outStats) const = 0;
+
+		// Unpacks part of one row of a glyph bitmap to coverage levels
+		static void UnpackGlyphRow(const uint8_t *glyphRowData, bool isAA, uint32_t firstCol, uint32_t numCols, uint8_t *outCoverage);
+
+		static TextRunCache *GetInstance();
+	};
+}
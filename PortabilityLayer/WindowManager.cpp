@@ -210,9 +210,16 @@ namespace PortabilityLayer
 		static WindowManagerImpl *GetInstance();
 
 	private:
+		static const size_t kMaxOccluders = 8;
+
+		void PushWindowSurfaces(WindowImpl *window, IGpDisplayDriver *displayDriver);
 		void RenderWindow(WindowImpl *window, IGpDisplayDriver *displayDriver);
 		void DetachWindow(Window *window);
 
+		bool IsWindowOccluded(const WindowImpl *window) const;
+		static Rect2i GetWindowRenderRect(const WindowImpl *window);
+		static bool IsRectOccluded(const Rect2i &rect, const Rect2i *occluders, size_t numOccluders);
+
 		void ResetResizeInProgressSurfaces();
 
 		void ComputeFlickerEffects(const Vec2i &windowUpperLeft, int32_t offset, GpDisplayDriverSurfaceEffects &effects) const;
@@ -1454,18 +1461,28 @@ namespace PortabilityLayer
 
 		dd->SyncPalette(displayDriver);
 
-		WindowImpl *window = m_windowStackBottom;
-		while (window)
+		// Everything is uploaded before anything is drawn, so the display driver can batch all of the frame's draws.
+		// Windows hidden under other windows aren't uploaded or drawn.  Their contents stay dirty until they're visible again.
+		for (WindowImpl *window = m_windowStackBottom; window != nullptr; window = window->GetWindowAbove())
 		{
-			RenderWindow(window, displayDriver);
-			window = window->GetWindowAbove();
+			if (!IsWindowOccluded(window))
+				PushWindowSurfaces(window, displayDriver);
 		}
 
 		if (m_isResizeInProgress)
 		{
 			m_resizeInProgressHorizontalBar.PushToDDSurface(displayDriver);
 			m_resizeInProgressVerticalBar.PushToDDSurface(displayDriver);
+		}
+
+		for (WindowImpl *window = m_windowStackBottom; window != nullptr; window = window->GetWindowAbove())
+		{
+			if (!IsWindowOccluded(window))
+				RenderWindow(window, displayDriver);
+		}
 
+		if (m_isResizeInProgress)
+		{
 			displayDriver->DrawSurface(m_resizeInProgressHorizontalBar.m_ddSurface, m_resizeInProgressRect.m_topLeft.m_x - 2, m_resizeInProgressRect.m_topLeft.m_y - 2, m_resizeInProgressRect.Right() - m_resizeInProgressRect.Left() + 4, 3, nullptr);
 			displayDriver->DrawSurface(m_resizeInProgressHorizontalBar.m_ddSurface, m_resizeInProgressRect.m_topLeft.m_x - 2, m_resizeInProgressRect.m_bottomRight.m_y - 1, m_resizeInProgressRect.Right() - m_resizeInProgressRect.Left() + 4, 3, nullptr);
 			displayDriver->DrawSurface(m_resizeInProgressVerticalBar.m_ddSurface, m_resizeInProgressRect.m_topLeft.m_x - 2, m_resizeInProgressRect.m_topLeft.m_y, 3, m_resizeInProgressRect.Bottom() - m_resizeInProgressRect.Top(), nullptr);
@@ -1638,6 +1655,20 @@ namespace PortabilityLayer
 		return reinterpret_cast<Window*>(&ms_putInFrontSentinel);
 	}
 
+	void WindowManagerImpl::PushWindowSurfaces(WindowImpl *window, IGpDisplayDriver *displayDriver)
+	{
+		if (!window->IsVisible())
+			return;
+
+		window->GetDrawSurface()->PushToDDSurface(displayDriver);
+
+		if (!window->IsBorderless())
+		{
+			for (int i = 0; i < WindowChromeSides::kCount; i++)
+				window->GetChromeSurface(static_cast<WindowChromeSide_t>(i))->PushToDDSurface(displayDriver);
+		}
+	}
+
 	void WindowManagerImpl::RenderWindow(WindowImpl *window, IGpDisplayDriver *displayDriver)
 	{
 		if (!window->IsVisible())
@@ -1654,8 +1685,6 @@ namespace PortabilityLayer
 
 		DrawSurface &graf = *window->GetDrawSurface();
 
-		graf.PushToDDSurface(displayDriver);
-
 		const PixMap *pixMap = *graf.m_port.GetPixMap();
 		const uint16_t width = pixMap->m_rect.Width();
 		const uint16_t height = pixMap->m_rect.Height();
@@ -1688,8 +1717,6 @@ namespace PortabilityLayer
 			{
 				DrawSurface *chromeSurface = window->GetChromeSurface(static_cast<WindowChromeSide_t>(i));
 
-				chromeSurface->PushToDDSurface(displayDriver);
-
 				if (hasFlicker)
 					ComputeFlickerEffects(Vec2i(chromeOrigins[i].m_x, chromeOrigins[i].m_y), m_flickerChromeDistanceOffset, effects);
 
@@ -1698,6 +1725,70 @@ namespace PortabilityLayer
 		}
 	}
 
+	bool WindowManagerImpl::IsWindowOccluded(const WindowImpl *window) const
+	{
+		if (!window->IsVisible())
+			return false;
+
+		// Surfaces are drawn without blending, so every window is opaque except while it's flickering
+		Rect2i occluders[kMaxOccluders];
+		size_t numOccluders = 0;
+
+		for (const WindowImpl *above = window->GetWindowAbove(); above != nullptr && numOccluders < kMaxOccluders; above = above->GetWindowAbove())
+		{
+			if (!above->IsVisible() || above == m_flickerWindow)
+				continue;
+
+			occluders[numOccluders++] = GetWindowRenderRect(above);
+		}
+
+		return numOccluders > 0 && IsRectOccluded(GetWindowRenderRect(window), occluders, numOccluders);
+	}
+
+	Rect2i WindowManagerImpl::GetWindowRenderRect(const WindowImpl *window)
+	{
+		const Rect surfaceRect = window->GetDrawSurface()->m_port.GetRect();
+		const Vec2i windowPos = window->GetPosition();
+
+		Rect2i rect(windowPos, windowPos + Vec2i(surfaceRect.Width(), surfaceRect.Height()));
+
+		if (!window->IsBorderless())
+		{
+			uint16_t chromePadding[WindowChromeSides::kCount];
+			window->GetChromePadding(chromePadding);
+
+			rect.m_topLeft -= Vec2i(chromePadding[WindowChromeSides::kLeft], chromePadding[WindowChromeSides::kTop]);
+			rect.m_bottomRight += Vec2i(chromePadding[WindowChromeSides::kRight], chromePadding[WindowChromeSides::kBottom]);
+		}
+
+		return rect;
+	}
+
+	bool WindowManagerImpl::IsRectOccluded(const Rect2i &rect, const Rect2i *occluders, size_t numOccluders)
+	{
+		if (rect.Right() <= rect.Left() || rect.Bottom() <= rect.Top())
+			return true;
+
+		for (size_t i = 0; i < numOccluders; i++)
+		{
+			const Rect2i overlap = rect.Intersect(occluders[i]);
+			if (overlap.Right() <= overlap.Left() || overlap.Bottom() <= overlap.Top())
+				continue;
+
+			// The parts outside of this occluder have to be covered by the ones after it,
+			// since none of the ones before it overlap the rect at all
+			const Rect2i *remaining = occluders + i + 1;
+			const size_t numRemaining = numOccluders - i - 1;
+
+			return IsRectOccluded(Rect2i(rect.Top(), rect.Left(), overlap.Top(), rect.Right()), remaining, numRemaining)
+				&& IsRectOccluded(Rect2i(overlap.Bottom(), rect.Left(), rect.Bottom(), rect.Right()), remaining, numRemaining)
+				&& IsRectOccluded(Rect2i(overlap.Top(), rect.Left(), overlap.Bottom(), overlap.Left()), remaining, numRemaining)
+				&& IsRectOccluded(Rect2i(overlap.Top(), overlap.Right(), overlap.Bottom(), rect.Right()), remaining, numRemaining);
+		}
+
+		return false;
+	}
+
 	WindowManagerImpl *WindowManagerImpl::GetInstance()
 	{
 		return &ms_instance;
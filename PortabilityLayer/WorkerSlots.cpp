@@ -0,0 +1,257 @@
+#include "WorkerSlots.h"
+#include "WorkerThread.h"
+#include "IGpMutex.h"
+#include "IGpThreadEvent.h"
+#include "IGpSystemServices.h"
+
+#include "CoreDefs.h"
+#include "PLCore.h"
+#include "PLDrivers.h"
+
+#include <assert.h>
+#include <new>
+
+namespace PortabilityLayer
+{
+	class WorkerSlotsImpl final : public WorkerSlots
+	{
+	public:
+		WorkerSlotsImpl(size_t numSlots, WorkerSlotState_t *states, uint32_t *queueOrder, WorkCallback_t callback, void *context);
+
+		void Init();
+		void Destroy() override;
+
+		bool HasWorker() const override;
+		size_t GetNumSlots() const override;
+
+		void Lock() override;
+		void Unlock() override;
+
+		WorkerSlotState_t GetState(size_t slotIndex) const override;
+		void SetState(size_t slotIndex, WorkerSlotState_t state) override;
+
+		size_t FindFreeSlot() const override;
+
+		void WaitForSlot(size_t slotIndex) override;
+		void QueueSlot(size_t slotIndex) override;
+
+	private:
+		~WorkerSlotsImpl() override;
+
+		static void StaticWorkerFunc(void *context);
+		void WorkerFunc();
+
+		size_t m_numSlots;
+		WorkerSlotState_t *m_states;
+		uint32_t *m_queueOrder;	// Position in the queue of each kQueued slot
+		uint32_t m_nextQueueOrder;
+
+		WorkCallback_t m_callback;
+		void *m_context;
+
+		WorkerThread *m_worker;
+		IGpMutex *m_mutex;
+		IGpThreadEvent *m_doneEvent;
+		bool m_workerActive;
+	};
+}
+
+void PortabilityLayer::WorkerSlotsImpl::Destroy()
+{
+	this->~WorkerSlotsImpl();
+	DisposePtr(this);
+}
+
+bool PortabilityLayer::WorkerSlotsImpl::HasWorker() const
+{
+	return m_worker != nullptr;
+}
+
+size_t PortabilityLayer::WorkerSlotsImpl::GetNumSlots() const
+{
+	return m_numSlots;
+}
+
+void PortabilityLayer::WorkerSlotsImpl::Lock()
+{
+	if (m_mutex)
+		m_mutex->Lock();
+}
+
+void PortabilityLayer::WorkerSlotsImpl::Unlock()
+{
+	if (m_mutex)
+		m_mutex->Unlock();
+}
+
+PortabilityLayer::WorkerSlotState_t PortabilityLayer::WorkerSlotsImpl::GetState(size_t slotIndex) const
+{
+	return m_states[slotIndex];
+}
+
+void PortabilityLayer::WorkerSlotsImpl::SetState(size_t slotIndex, WorkerSlotState_t state)
+{
+	m_states[slotIndex] = state;
+}
+
+size_t PortabilityLayer::WorkerSlotsImpl::FindFreeSlot() const
+{
+	for (size_t i = 0; i < m_numSlots; i++)
+	{
+		if (m_states[i] == WorkerSlotStates::kFree)
+			return i;
+	}
+
+	return m_numSlots;
+}
+
+void PortabilityLayer::WorkerSlotsImpl::WaitForSlot(size_t slotIndex)
+{
+	if (!m_worker)
+		return;
+
+	while (m_states[slotIndex] == WorkerSlotStates::kWorking)
+	{
+		m_mutex->Unlock();
+		m_doneEvent->Wait();
+		m_mutex->Lock();
+	}
+}
+
+void PortabilityLayer::WorkerSlotsImpl::QueueSlot(size_t slotIndex)
+{
+	assert(m_worker != nullptr);
+
+	m_mutex->Lock();
+
+	assert(m_states[slotIndex] == WorkerSlotStates::kFree);
+	m_states[slotIndex] = WorkerSlotStates::kQueued;
+	m_queueOrder[slotIndex] = m_nextQueueOrder++;
+
+	const bool needWorker = !m_workerActive;
+	m_workerActive = true;
+
+	m_mutex->Unlock();
+
+	if (needWorker)
+		m_worker->AsyncExecuteTask(StaticWorkerFunc, this);
+}
+
+PortabilityLayer::WorkerSlotsImpl::WorkerSlotsImpl(size_t numSlots, WorkerSlotState_t *states, uint32_t *queueOrder, WorkCallback_t callback, void *context)
+	: m_numSlots(numSlots)
+	, m_states(states)
+	, m_queueOrder(queueOrder)
+	, m_nextQueueOrder(0)
+	, m_callback(callback)
+	, m_context(context)
+	, m_worker(nullptr)
+	, m_mutex(nullptr)
+	, m_doneEvent(nullptr)
+	, m_workerActive(false)
+{
+	for (size_t i = 0; i < numSlots; i++)
+	{
+		m_states[i] = WorkerSlotStates::kFree;
+		m_queueOrder[i] = 0;
+	}
+}
+
+PortabilityLayer::WorkerSlotsImpl::~WorkerSlotsImpl()
+{
+	if (m_worker)
+		m_worker->Destroy();
+
+	if (m_doneEvent)
+		m_doneEvent->Destroy();
+	if (m_mutex)
+		m_mutex->Destroy();
+}
+
+void PortabilityLayer::WorkerSlotsImpl::StaticWorkerFunc(void *context)
+{
+	static_cast<PortabilityLayer::WorkerSlotsImpl*>(context)->WorkerFunc();
+}
+
+void PortabilityLayer::WorkerSlotsImpl::WorkerFunc()
+{
+	for (;;)
+	{
+		size_t slotIndex = m_numSlots;
+
+		m_mutex->Lock();
+		for (size_t i = 0; i < m_numSlots; i++)
+		{
+			// Wrapping differences keep the order right when the counter overflows
+			if (m_states[i] == WorkerSlotStates::kQueued && (slotIndex == m_numSlots || static_cast<int32_t>(m_queueOrder[i] - m_queueOrder[slotIndex]) < 0))
+				slotIndex = i;
+		}
+
+		if (slotIndex == m_numSlots)
+		{
+			m_workerActive = false;
+			m_mutex->Unlock();
+			return;
+		}
+
+		m_states[slotIndex] = WorkerSlotStates::kWorking;
+		m_mutex->Unlock();
+
+		m_callback(m_context, slotIndex);
+
+		m_mutex->Lock();
+		m_states[slotIndex] = WorkerSlotStates::kDone;
+		m_mutex->Unlock();
+
+		m_doneEvent->Signal();
+	}
+}
+
+void PortabilityLayer::WorkerSlotsImpl::Init()
+{
+	IGpSystemServices *sysServices = PLDrivers::GetSystemServices();
+
+	m_mutex = sysServices->CreateMutex();
+	m_doneEvent = sysServices->CreateThreadEvent(true, false);
+
+	if (m_mutex && m_doneEvent)
+		m_worker = WorkerThread::Create();
+
+	if (!m_worker)
+	{
+		// Platforms without threads do all of the work on demand
+		if (m_doneEvent)
+			m_doneEvent->Destroy();
+		if (m_mutex)
+			m_mutex->Destroy();
+
+		m_doneEvent = nullptr;
+		m_mutex = nullptr;
+	}
+}
+
+
+PortabilityLayer::WorkerSlots::WorkerSlots()
+{
+}
+
+PortabilityLayer::WorkerSlots::~WorkerSlots()
+{
+}
+
+PortabilityLayer::WorkerSlots *PortabilityLayer::WorkerSlots::Create(size_t numSlots, WorkCallback_t callback, void *context)
+{
+	size_t baseSize = sizeof(PortabilityLayer::WorkerSlotsImpl) + GP_SYSTEM_MEMORY_ALIGNMENT - 1;
+	baseSize -= baseSize % GP_SYSTEM_MEMORY_ALIGNMENT;
+
+	void *storage = NewPtr(baseSize + numSlots * (sizeof(WorkerSlotState_t) + sizeof(uint32_t)));
+	if (!storage)
+		return nullptr;
+
+	uint32_t *queueOrder = reinterpret_cast<uint32_t*>(static_cast<uint8_t*>(storage) + baseSize);
+	WorkerSlotState_t *states = reinterpret_cast<WorkerSlotState_t*>(queueOrder + numSlots);
+
+	PortabilityLayer::WorkerSlotsImpl *slots = new (storage) PortabilityLayer::WorkerSlotsImpl(numSlots, states, queueOrder, callback, context);
+	slots->Init();
+
+	return slots;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace PortabilityLayer
+{
+	namespace WorkerSlotStates
+	{
+		enum WorkerSlotState
+		{
+			kFree,
+			kQueued,
+			kWorking,
+			kDone,
+		};
+	}
+
+	typedef WorkerSlotStates::WorkerSlotState WorkerSlotState_t;
+
+	// A fixed set of slots for work that the main thread queues and a worker thread does, oldest first.  The
+	// owner keeps the work for each slot in its own array, indexed the same way.
+	//
+	// Only the main thread moves slots out of kFree and back into it.  Whoever moves a slot into kWorking
+	// owns it until it's kDone, which is either the worker or the main thread taking over queued work.
+	// States may only be read or changed between Lock and Unlock.
+	class WorkerSlots
+	{
+	public:
+		typedef void(*WorkCallback_t)(void *context, size_t slotIndex);
+
+		// Creates numSlots free slots.  If no worker thread can be created, the slots still work, but
+		// HasWorker returns false, locking does nothing, and nothing may be queued.  Returns null if out of
+		// memory.
+		static WorkerSlots *Create(size_t numSlots, WorkCallback_t callback, void *context);
+
+		// Every slot has to be free by now.  Stops the worker thread.
+		virtual void Destroy() = 0;
+
+		virtual bool HasWorker() const = 0;
+		virtual size_t GetNumSlots() const = 0;
+
+		virtual void Lock() = 0;
+		virtual void Unlock() = 0;
+
+		virtual WorkerSlotState_t GetState(size_t slotIndex) const = 0;
+		virtual void SetState(size_t slotIndex, WorkerSlotState_t state) = 0;
+
+		// Returns GetNumSlots() if every slot is in use
+		virtual size_t FindFreeSlot() const = 0;
+
+		// Waits until the slot isn't kWorking, unlocking while waiting
+		virtual void WaitForSlot(size_t slotIndex) = 0;
+
+		// Marks a free slot as kQueued behind everything already queued, and starts the worker if it's idle
+		virtual void QueueSlot(size_t slotIndex) = 0;
+
+	protected:
+		WorkerSlots();
+		virtual ~WorkerSlots();
+	};
+}
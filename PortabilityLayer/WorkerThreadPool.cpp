@@ -0,0 +1,219 @@
+#include "WorkerThreadPool.h"
+#include "WorkerThread.h"
+#include "IGpMutex.h"
+#include "IGpThreadEvent.h"
+#include "IGpSystemServices.h"
+
+#include "PLCore.h"
+#include "PLDrivers.h"
+
+#include <stdlib.h>
+#include <new>
+
+namespace PortabilityLayer
+{
+	class WorkerThreadPoolImpl final : public WorkerThreadPool
+	{
+	public:
+		explicit WorkerThreadPoolImpl(unsigned int maxWorkers);
+
+		bool Init();
+		void Destroy() override;
+
+		void ParallelFor(size_t numItems, ItemCallback_t callback, void *context) override;
+
+		unsigned int GetNumThreads() const override;
+
+	private:
+		static const unsigned int kMaxWorkers = 16;
+		static const size_t kBatchesPerThread = 8;
+
+		~WorkerThreadPoolImpl() override;
+
+		static void StaticWorkerFunc(void *context);
+		void WorkerFunc();
+
+		void RunBatches();
+
+		WorkerThread *m_workers[kMaxWorkers];
+		unsigned int m_maxWorkers;
+		unsigned int m_numWorkers;
+
+		IGpMutex *m_mutex;
+		IGpThreadEvent *m_doneEvent;
+
+		// Guarded by the mutex while a ParallelFor is running
+		ItemCallback_t m_callback;
+		void *m_context;
+		size_t m_numItems;
+		size_t m_nextItem;
+		size_t m_batchSize;
+		unsigned int m_numActiveWorkers;
+	};
+}
+
+void PortabilityLayer::WorkerThreadPoolImpl::Destroy()
+{
+	this->~WorkerThreadPoolImpl();
+	DisposePtr(this);
+}
+
+void PortabilityLayer::WorkerThreadPoolImpl::ParallelFor(size_t numItems, ItemCallback_t callback, void *context)
+{
+	if (numItems == 0)
+		return;
+
+	unsigned int numWorkersToUse = m_numWorkers;
+	if (numWorkersToUse > numItems - 1)
+		numWorkersToUse = static_cast<unsigned int>(numItems - 1);
+
+	// Items are handed out in batches, so the lock isn't taken for every item, but small enough that threads finishing early can pick up the slack
+	size_t batchSize = numItems / ((numWorkersToUse + 1) * kBatchesPerThread);
+	if (batchSize < 1)
+		batchSize = 1;
+
+	m_mutex->Lock();
+	m_callback = callback;
+	m_context = context;
+	m_numItems = numItems;
+	m_nextItem = 0;
+	m_batchSize = batchSize;
+	m_numActiveWorkers = numWorkersToUse;
+	m_mutex->Unlock();
+
+	for (unsigned int i = 0; i < numWorkersToUse; i++)
+		m_workers[i]->AsyncExecuteTask(StaticWorkerFunc, this);
+
+	RunBatches();
+
+	if (numWorkersToUse > 0)
+		m_doneEvent->Wait();
+}
+
+unsigned int PortabilityLayer::WorkerThreadPoolImpl::GetNumThreads() const
+{
+	return m_numWorkers + 1;
+}
+
+PortabilityLayer::WorkerThreadPoolImpl::WorkerThreadPoolImpl(unsigned int maxWorkers)
+	: m_maxWorkers(maxWorkers)
+	, m_numWorkers(0)
+	, m_mutex(nullptr)
+	, m_doneEvent(nullptr)
+	, m_callback(nullptr)
+	, m_context(nullptr)
+	, m_numItems(0)
+	, m_nextItem(0)
+	, m_batchSize(1)
+	, m_numActiveWorkers(0)
+{
+	if (m_maxWorkers > kMaxWorkers)
+		m_maxWorkers = kMaxWorkers;
+
+	for (unsigned int i = 0; i < kMaxWorkers; i++)
+		m_workers[i] = nullptr;
+}
+
+PortabilityLayer::WorkerThreadPoolImpl::~WorkerThreadPoolImpl()
+{
+	for (unsigned int i = 0; i < m_numWorkers; i++)
+		m_workers[i]->Destroy();
+
+	if (m_mutex)
+		m_mutex->Destroy();
+	if (m_doneEvent)
+		m_doneEvent->Destroy();
+}
+
+void PortabilityLayer::WorkerThreadPoolImpl::StaticWorkerFunc(void *context)
+{
+	static_cast<PortabilityLayer::WorkerThreadPoolImpl*>(context)->WorkerFunc();
+}
+
+void PortabilityLayer::WorkerThreadPoolImpl::WorkerFunc()
+{
+	RunBatches();
+
+	m_mutex->Lock();
+	const bool isLastWorker = (--m_numActiveWorkers == 0);
+	m_mutex->Unlock();
+
+	if (isLastWorker)
+		m_doneEvent->Signal();
+}
+
+void PortabilityLayer::WorkerThreadPoolImpl::RunBatches()
+{
+	for (;;)
+	{
+		m_mutex->Lock();
+		const size_t firstItem = m_nextItem;
+		size_t endItem = firstItem + m_batchSize;
+		if (endItem > m_numItems)
+			endItem = m_numItems;
+		m_nextItem = endItem;
+
+		const ItemCallback_t callback = m_callback;
+		void *context = m_context;
+		m_mutex->Unlock();
+
+		if (firstItem == endItem)
+			return;
+
+		for (size_t i = firstItem; i < endItem; i++)
+			callback(context, i);
+	}
+}
+
+bool PortabilityLayer::WorkerThreadPoolImpl::Init()
+{
+	IGpSystemServices *sysServices = PLDrivers::GetSystemServices();
+
+	m_mutex = sysServices->CreateMutex();
+	if (!m_mutex)
+		return false;
+
+	m_doneEvent = sysServices->CreateThreadEvent(true, false);
+	if (!m_doneEvent)
+		return false;
+
+	// Run with however many threads could be created, as long as there's at least one besides the caller
+	while (m_numWorkers < m_maxWorkers)
+	{
+		WorkerThread *worker = WorkerThread::Create();
+		if (!worker)
+			break;
+
+		m_workers[m_numWorkers++] = worker;
+	}
+
+	return m_numWorkers > 0;
+}
+
+
+PortabilityLayer::WorkerThreadPool::WorkerThreadPool()
+{
+}
+
+PortabilityLayer::WorkerThreadPool::~WorkerThreadPool()
+{
+}
+
+PortabilityLayer::WorkerThreadPool *PortabilityLayer::WorkerThreadPool::Create(unsigned int numThreads)
+{
+	if (numThreads < 2)
+		return nullptr;
+
+	void *storage = NewPtr(sizeof(PortabilityLayer::WorkerThreadPoolImpl));
+	if (!storage)
+		return nullptr;
+
+	PortabilityLayer::WorkerThreadPoolImpl *pool = new (storage) PortabilityLayer::WorkerThreadPoolImpl(numThreads - 1);
+	if (!pool->Init())
+	{
+		pool->Destroy();
+		return nullptr;
+	}
+
+	return pool;
+}
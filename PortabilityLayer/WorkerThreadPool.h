@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace PortabilityLayer
+{
+	class WorkerThreadPool
+	{
+	public:
+		typedef void(*ItemCallback_t)(void *context, size_t itemIndex);
+
+		// Creates a pool that runs work on up to numThreads threads, including the calling thread.  Returns
+		// null if no worker threads could be created.
+		static WorkerThreadPool *Create(unsigned int numThreads);
+		virtual void Destroy() = 0;
+
+		// Calls the callback for every item in [0, numItems) across the pool and the calling thread, in no
+		// particular order, and returns once all of them have finished
+		virtual void ParallelFor(size_t numItems, ItemCallback_t callback, void *context) = 0;
+
+		virtual unsigned int GetNumThreads() const = 0;
+
+	protected:
+		WorkerThreadPool();
+		virtual ~WorkerThreadPool();
+	};
+}
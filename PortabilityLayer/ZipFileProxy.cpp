@@ -11,6 +11,7 @@
 
 #include <algorithm>
 #include <stdlib.h>
+#include <string.h>
 
 namespace
 {
@@ -204,6 +205,27 @@ namespace PortabilityLayer
 	{
 		ZipCentralDirectoryFileHeader centralDirHeader = m_sortedFiles[index].Get();
 
+		if (m_mappedContents)
+		{
+			const uint8_t *fileData = GetMappedFileData(centralDirHeader);
+			if (!fileData)
+				return false;
+
+			const size_t uncompressedSize = centralDirHeader.m_uncompressedSize;
+			if (centralDirHeader.m_method == PortabilityLayer::ZipConstants::kStoredMethod)
+			{
+				if (centralDirHeader.m_compressedSize != uncompressedSize)
+					return false;
+
+				memcpy(outBuffer, fileData, uncompressedSize);
+				return true;
+			}
+			else if (centralDirHeader.m_method == PortabilityLayer::ZipConstants::kDeflatedMethod)
+				return DeflateCodec::DecompressBuffer(fileData, centralDirHeader.m_compressedSize, outBuffer, uncompressedSize);
+			else
+				return false;
+		}
+
 		if (!m_stream->SeekStart(centralDirHeader.m_localHeaderOffset))
 			return false;
 
@@ -230,6 +252,86 @@ namespace PortabilityLayer
 			return false;
 	}
 
+	bool ZipFileProxy::MapStoredFile(size_t index, const void *&outContents) const
+	{
+		if (!m_mappedContents)
+			return false;
+
+		ZipCentralDirectoryFileHeader centralDirHeader = m_sortedFiles[index].Get();
+		if (centralDirHeader.m_method != PortabilityLayer::ZipConstants::kStoredMethod || centralDirHeader.m_compressedSize != centralDirHeader.m_uncompressedSize)
+			return false;
+
+		const uint8_t *fileData = GetMappedFileData(centralDirHeader);
+		if (!fileData)
+			return false;
+
+		outContents = fileData;
+		return true;
+	}
+
+	bool ZipFileProxy::LoadStoredFile(size_t index, void *outBuffer, bool &outIsDeflated)
+	{
+		ZipCentralDirectoryFileHeader centralDirHeader = m_sortedFiles[index].Get();
+
+		if (centralDirHeader.m_method == PortabilityLayer::ZipConstants::kStoredMethod)
+		{
+			if (centralDirHeader.m_compressedSize != centralDirHeader.m_uncompressedSize)
+				return false;
+
+			outIsDeflated = false;
+		}
+		else if (centralDirHeader.m_method == PortabilityLayer::ZipConstants::kDeflatedMethod)
+			outIsDeflated = true;
+		else
+			return false;
+
+		const size_t storedSize = centralDirHeader.m_compressedSize;
+
+		if (m_mappedContents)
+		{
+			const uint8_t *fileData = GetMappedFileData(centralDirHeader);
+			if (!fileData)
+				return false;
+
+			memcpy(outBuffer, fileData, storedSize);
+			return true;
+		}
+
+		if (!m_stream->SeekStart(centralDirHeader.m_localHeaderOffset))
+			return false;
+
+		ZipFileLocalHeader localHeader;
+		if (m_stream->Read(&localHeader, sizeof(ZipFileLocalHeader)) != sizeof(ZipFileLocalHeader))
+			return false;
+
+		if (!m_stream->SeekCurrent(localHeader.m_fileNameLength + localHeader.m_extraFieldLength))
+			return false;
+
+		if (localHeader.m_compressedSize != centralDirHeader.m_compressedSize || localHeader.m_uncompressedSize != centralDirHeader.m_uncompressedSize || localHeader.m_method != centralDirHeader.m_method)
+			return false;
+
+		return m_stream->Read(outBuffer, storedSize) == storedSize;
+	}
+
+	const uint8_t *ZipFileProxy::GetMappedFileData(const ZipCentralDirectoryFileHeader &centralDirHeader) const
+	{
+		const GpUFilePos_t localHeaderOffset = centralDirHeader.m_localHeaderOffset;
+		if (localHeaderOffset > m_mappedSize || m_mappedSize - localHeaderOffset < sizeof(ZipFileLocalHeader))
+			return nullptr;
+
+		ZipFileLocalHeader localHeader;
+		memcpy(&localHeader, m_mappedContents + localHeaderOffset, sizeof(ZipFileLocalHeader));
+
+		if (localHeader.m_compressedSize != centralDirHeader.m_compressedSize || localHeader.m_uncompressedSize != centralDirHeader.m_uncompressedSize || localHeader.m_method != centralDirHeader.m_method)
+			return nullptr;
+
+		const GpUFilePos_t dataOffset = localHeaderOffset + sizeof(ZipFileLocalHeader) + localHeader.m_fileNameLength + localHeader.m_extraFieldLength;
+		if (dataOffset > m_mappedSize || m_mappedSize - dataOffset < centralDirHeader.m_compressedSize)
+			return nullptr;
+
+		return m_mappedContents + dataOffset;
+	}
+
 	GpIOStream *ZipFileProxy::OpenFile(size_t index) const
 	{
 		ZipCentralDirectoryFileHeader centralDirHeader = m_sortedFiles[index].Get();
@@ -272,6 +374,11 @@ namespace PortabilityLayer
 		return m_sortedFiles[index].Get().m_uncompressedSize;
 	}
 
+	size_t ZipFileProxy::GetStoredFileSize(size_t index) const
+	{
+		return m_sortedFiles[index].Get().m_compressedSize;
+	}
+
 	void ZipFileProxy::GetFileName(size_t index, const char *&outName, size_t &outLength) const
 	{
 		const UnalignedPtr<PortabilityLayer::ZipCentralDirectoryFileHeader> itemPtr = m_sortedFiles[index];
@@ -425,7 +532,11 @@ namespace PortabilityLayer
 		, m_centralDirImage(centralDirImage)
 		, m_sortedFiles(sortedFiles)
 		, m_numFiles(numFiles)
+		, m_mappedContents(static_cast<const uint8_t*>(stream->GetMappedContents()))
+		, m_mappedSize(0)
 	{
+		if (m_mappedContents)
+			m_mappedSize = stream->Size();
 	}
 
 	ZipFileProxy::~ZipFileProxy()
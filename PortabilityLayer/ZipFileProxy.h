@@ -1,7 +1,10 @@
 #pragma once
 
+#include "GpFilePos.h"
 #include "PLUnalignedPtr.h"
 
+#include <stdint.h>
+
 class GpIOStream;
 
 namespace PortabilityLayer
@@ -16,6 +19,14 @@ namespace PortabilityLayer
 		bool IndexFile(const char *path, size_t &outIndex) const;
 		bool LoadFile(size_t index, void *outBuffer);
 
+		// If the archive stream is memory-mapped and the file is stored uncompressed, returns its contents
+		// in place without copying.  The contents are read-only and are valid as long as the stream is open.
+		bool MapStoredFile(size_t index, const void *&outContents) const;
+
+		// Reads a file's data as it is stored in the archive, without decompressing it.  The buffer must be
+		// GetStoredFileSize bytes.
+		bool LoadStoredFile(size_t index, void *outBuffer, bool &outIsDeflated);
+
 		GpIOStream *OpenFile(size_t index) const;
 
 		bool HasPrefix(const char *path) const;
@@ -23,6 +34,7 @@ namespace PortabilityLayer
 
 		size_t NumFiles() const;
 		size_t GetFileSize(size_t index) const;
+		size_t GetStoredFileSize(size_t index) const;
 		void GetFileName(size_t index, const char *&outName, size_t &outLength) const;
 
 		static ZipFileProxy *Create(GpIOStream *stream);
@@ -31,9 +43,14 @@ namespace PortabilityLayer
 		ZipFileProxy(GpIOStream *stream, void *centralDirImage, UnalignedPtr<ZipCentralDirectoryFileHeader> *sortedFiles, size_t numFiles);
 		~ZipFileProxy();
 
+		const uint8_t *GetMappedFileData(const ZipCentralDirectoryFileHeader &centralDirHeader) const;
+
 		GpIOStream *m_stream;
 		void *m_centralDirImage;
 		UnalignedPtr<ZipCentralDirectoryFileHeader> *m_sortedFiles;
 		size_t m_numFiles;
+
+		const uint8_t *m_mappedContents;
+		GpUFilePos_t m_mappedSize;
 	};
 }
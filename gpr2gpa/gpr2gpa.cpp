@@ -34,6 +34,14 @@
 #include <utility>
 #include <vector>
 #include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
 
 enum AudioCompressionCodecID
 {
@@ -55,10 +63,376 @@ struct PlannedEntry
 	std::string m_comment;
 	bool m_isDirectory;
 
+	// Hash of the source resource, written to the central directory in incremental mode
+	uint64_t m_sourceHash;
+	bool m_haveSourceHash;
+
+	// Set if the entry was copied from the previous archive.  m_compressedContents then holds the data
+	// exactly as it was stored, which may not be deflated.
+	bool m_isReused;
+	bool m_reusedIsCompressed;
+	uint32_t m_reusedCRC;
+	uint32_t m_reusedUncompressedSize;
+
 	PlannedEntry()
 		: m_isDirectory(false)
+		, m_sourceHash(0)
+		, m_haveSourceHash(false)
+		, m_isReused(false)
+		, m_reusedIsCompressed(false)
+		, m_reusedCRC(0)
+		, m_reusedUncompressedSize(0)
+	{
+	}
+};
+
+namespace ConversionStages
+{
+	enum ConversionStage
+	{
+		kLoad,
+		kPICT,
+		kSound,
+		kOther,
+		kDeflate,
+		kWrite,
+
+		kCount,
+	};
+}
+
+typedef ConversionStages::ConversionStage ConversionStage_t;
+
+static const char *gs_conversionStageNames[ConversionStages::kCount] =
+{
+	"Load",
+	"PICT",
+	"Sound",
+	"Other",
+	"Deflate",
+	"Write",
+};
+
+struct ConversionStageStats
+{
+	std::atomic<uint64_t> m_numItems;
+	std::atomic<uint64_t> m_inputBytes;
+	std::atomic<uint64_t> m_outputBytes;
+	std::atomic<uint64_t> m_nanoseconds;
+};
+
+struct ConversionStats
+{
+	ConversionStageStats m_stages[ConversionStages::kCount];
+	std::atomic<uint64_t> m_numFiles;
+	std::atomic<uint64_t> m_numReusedEntries;
+
+	ConversionStats();
+
+	void Record(ConversionStage_t stage, uint64_t inputBytes, uint64_t outputBytes, const std::chrono::steady_clock::time_point &startTime);
+	void Print(FILE *f, double wallSeconds) const;
+};
+
+ConversionStats::ConversionStats()
+	: m_numFiles(0)
+	, m_numReusedEntries(0)
+{
+	for (int i = 0; i < ConversionStages::kCount; i++)
+	{
+		m_stages[i].m_numItems = 0;
+		m_stages[i].m_inputBytes = 0;
+		m_stages[i].m_outputBytes = 0;
+		m_stages[i].m_nanoseconds = 0;
+	}
+}
+
+void ConversionStats::Record(ConversionStage_t stage, uint64_t inputBytes, uint64_t outputBytes, const std::chrono::steady_clock::time_point &startTime)
+{
+	const std::chrono::steady_clock::duration duration = std::chrono::steady_clock::now() - startTime;
+
+	ConversionStageStats &stageStats = m_stages[stage];
+	stageStats.m_numItems++;
+	stageStats.m_inputBytes += inputBytes;
+	stageStats.m_outputBytes += outputBytes;
+	stageStats.m_nanoseconds += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+}
+
+void ConversionStats::Print(FILE *f, double wallSeconds) const
+{
+	// Stage times are summed over all threads, so throughput is per thread
+	fprintf(f, "%-8s %8s %12s %12s %10s %10s\n", "Stage", "Items", "In (KB)", "Out (KB)", "Time (s)", "MB/s");
+
+	for (int i = 0; i < ConversionStages::kCount; i++)
+	{
+		const ConversionStageStats &stageStats = m_stages[i];
+		const double seconds = static_cast<double>(stageStats.m_nanoseconds) / 1000000000.0;
+		const double inputMB = static_cast<double>(stageStats.m_inputBytes) / (1024.0 * 1024.0);
+
+		fprintf(f, "%-8s %8u %12.1f %12.1f %10.3f %10.1f\n", gs_conversionStageNames[i], static_cast<unsigned int>(stageStats.m_numItems),
+			static_cast<double>(stageStats.m_inputBytes) / 1024.0, static_cast<double>(stageStats.m_outputBytes) / 1024.0,
+			seconds, (seconds > 0.0) ? (inputMB / seconds) : 0.0);
+	}
+
+	fprintf(f, "%u files in %.3f s, %u entries reused from previous archives\n", static_cast<unsigned int>(m_numFiles), wallSeconds, static_cast<unsigned int>(m_numReusedEntries));
+}
+
+// Work-stealing job pool for -j.  Each thread queues the jobs that it submits on its own deque and runs
+// them newest first, and idle threads steal the oldest jobs from the other deques.  A thread that waits on
+// a job group runs jobs from that group while it waits, so jobs can queue and wait on their own sub-jobs.
+class WorkPool
+{
+public:
+	class JobGroup
+	{
+	public:
+		JobGroup();
+
+	private:
+		friend class WorkPool;
+
+		size_t m_numPending;
+	};
+
+	// numThreads includes the calling thread, so 1 runs everything on the calling thread inside Wait
+	explicit WorkPool(unsigned int numThreads);
+	~WorkPool();
+
+	void Submit(JobGroup &group, const std::function<void()> &func);
+	void Wait(JobGroup &group);
+
+private:
+	struct Job
+	{
+		JobGroup *m_group;
+		std::function<void()> m_func;
+	};
+
+	bool TakeJobLocked(unsigned int queueIndex, const JobGroup *group, Job &outJob);
+	void RunJob(std::unique_lock<std::mutex> &lock, Job &job);
+	void WorkerThreadFunc(unsigned int queueIndex);
+
+	std::vector<std::deque<Job> > m_queues;
+	std::vector<std::thread> m_threads;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	bool m_isShuttingDown;
+
+	static thread_local unsigned int ms_queueIndex;
+};
+
+thread_local unsigned int WorkPool::ms_queueIndex = 0;
+
+WorkPool::JobGroup::JobGroup()
+	: m_numPending(0)
+{
+}
+
+WorkPool::WorkPool(unsigned int numThreads)
+	: m_queues(std::max(numThreads, 1u))
+	, m_isShuttingDown(false)
+{
+	for (unsigned int i = 1; i < numThreads; i++)
+		m_threads.push_back(std::thread(&WorkPool::WorkerThreadFunc, this, i));
+}
+
+WorkPool::~WorkPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_isShuttingDown = true;
+	}
+	m_condition.notify_all();
+
+	for (std::thread &thread : m_threads)
+		thread.join();
+}
+
+void WorkPool::Submit(JobGroup &group, const std::function<void()> &func)
+{
+	Job job;
+	job.m_group = &group;
+	job.m_func = func;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_queues[ms_queueIndex].push_back(std::move(job));
+		group.m_numPending++;
+	}
+	m_condition.notify_all();
+}
+
+void WorkPool::Wait(JobGroup &group)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (group.m_numPending > 0)
+	{
+		Job job;
+		if (TakeJobLocked(ms_queueIndex, &group, job))
+			RunJob(lock, job);
+		else
+			m_condition.wait(lock);
+	}
+}
+
+bool WorkPool::TakeJobLocked(unsigned int queueIndex, const JobGroup *group, Job &outJob)
+{
+	std::deque<Job> &ownQueue = m_queues[queueIndex];
+	for (std::deque<Job>::iterator it = ownQueue.end(); it != ownQueue.begin(); )
+	{
+		--it;
+		if (group == nullptr || it->m_group == group)
+		{
+			outJob = std::move(*it);
+			ownQueue.erase(it);
+			return true;
+		}
+	}
+
+	const size_t numQueues = m_queues.size();
+	for (size_t i = 1; i < numQueues; i++)
+	{
+		std::deque<Job> &victimQueue = m_queues[(queueIndex + i) % numQueues];
+		for (std::deque<Job>::iterator it = victimQueue.begin(), itEnd = victimQueue.end(); it != itEnd; ++it)
+		{
+			if (group == nullptr || it->m_group == group)
+			{
+				outJob = std::move(*it);
+				victimQueue.erase(it);
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+void WorkPool::RunJob(std::unique_lock<std::mutex> &lock, Job &job)
+{
+	lock.unlock();
+	job.m_func();
+	lock.lock();
+
+	job.m_group->m_numPending--;
+	m_condition.notify_all();
+}
+
+void WorkPool::WorkerThreadFunc(unsigned int queueIndex)
+{
+	ms_queueIndex = queueIndex;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (;;)
 	{
+		Job job;
+		if (TakeJobLocked(queueIndex, nullptr, job))
+			RunJob(lock, job);
+		else if (m_isShuttingDown)
+			break;
+		else
+			m_condition.wait(lock);
+	}
+}
+
+struct ConversionContext
+{
+	WorkPool *m_pool;
+	ConversionStats *m_stats;
+	bool m_incremental;
+};
+
+// The memory manager isn't initialized in this tool, so it has no lock of its own.  Resource files are
+// the only thing that allocates through it.
+static std::mutex gs_resourceFileMutex;
+
+// Keeps progress messages from different files from interleaving
+static std::mutex gs_consoleMutex;
+
+// Bump this whenever an importer's output changes, so incremental builds don't reuse stale entries
+static const uint32_t kConverterVersion = 1;
+
+// Zip extra field that holds the source hash of an entry, as a little-endian 64-bit value
+static const uint16_t kSourceHashExtraFieldID = 0x4750;
+static const size_t kSourceHashExtraFieldSize = 12;
+
+uint64_t HashSourceResource(const PortabilityLayer::ResTypeID &resType, int resID, const void *data, size_t size)
+{
+	// 64-bit FNV-1a
+	uint64_t hash = 14695981039346656037ULL;
+
+	const uint32_t header[3] = { kConverterVersion, static_cast<uint32_t>(resType.ExportAsInt32()), static_cast<uint32_t>(resID) };
+	for (size_t i = 0; i < 3; i++)
+	{
+		for (int byte = 0; byte < 4; byte++)
+		{
+			hash ^= (header[i] >> (byte * 8)) & 0xff;
+			hash *= 1099511628211ULL;
+		}
+	}
+
+	const uint8_t *bytes = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+void EncodeSourceHashExtraField(uint64_t sourceHash, uint8_t (&outField)[kSourceHashExtraFieldSize])
+{
+	outField[0] = static_cast<uint8_t>(kSourceHashExtraFieldID & 0xff);
+	outField[1] = static_cast<uint8_t>((kSourceHashExtraFieldID >> 8) & 0xff);
+	outField[2] = 8;
+	outField[3] = 0;
+
+	for (int i = 0; i < 8; i++)
+		outField[4 + i] = static_cast<uint8_t>((sourceHash >> (i * 8)) & 0xff);
+}
+
+bool DecodeSourceHashExtraField(const uint8_t *extraData, size_t extraSize, uint64_t &outSourceHash)
+{
+	while (extraSize >= 4)
+	{
+		const uint16_t fieldID = static_cast<uint16_t>(extraData[0] | (extraData[1] << 8));
+		const size_t fieldSize = static_cast<size_t>(extraData[2] | (extraData[3] << 8));
+
+		if (extraSize - 4 < fieldSize)
+			return false;
+
+		if (fieldID == kSourceHashExtraFieldID && fieldSize == 8)
+		{
+			uint64_t sourceHash = 0;
+			for (int i = 0; i < 8; i++)
+				sourceHash |= static_cast<uint64_t>(extraData[4 + i]) << (i * 8);
+
+			outSourceHash = sourceHash;
+			return true;
+		}
+
+		extraData += 4 + fieldSize;
+		extraSize -= 4 + fieldSize;
 	}
+
+	return false;
+}
+
+struct PreviousArchiveEntry
+{
+	uint64_t m_sourceHash;
+	bool m_isCompressed;
+	uint32_t m_crc;
+	uint32_t m_uncompressedSize;
+	size_t m_dataOffset;
+	size_t m_dataSize;
+};
+
+// Entries of the archive from a previous run that have a source hash
+struct PreviousArchive
+{
+	std::vector<uint8_t> m_contents;
+	std::map<std::string, PreviousArchiveEntry> m_entries;
 };
 
 bool EntryAlphaSortPredicate(const PlannedEntry &a, const PlannedEntry &b)
@@ -197,7 +571,23 @@ bool TryDeflate(const std::vector<uint8_t> &uncompressed, std::vector<uint8_t> &
 	return true;
 }
 
-void ExportZipFile(const char *path, std::vector<PlannedEntry> &entries, const PortabilityLayer::CombinedTimestamp &ts)
+void DeflateEntry(PlannedEntry &entry, ConversionStats *stats)
+{
+	if (entry.m_isReused || entry.m_uncompressedContents.size() == 0)
+		return;
+
+	const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+	if (!TryDeflate(entry.m_uncompressedContents, entry.m_compressedContents))
+		entry.m_compressedContents.resize(0);
+
+	if (entry.m_compressedContents.size() >= entry.m_uncompressedContents.size())
+		entry.m_compressedContents.resize(0);
+
+	stats->Record(ConversionStages::kDeflate, entry.m_uncompressedContents.size(), entry.m_compressedContents.size(), startTime);
+}
+
+void ExportZipFile(const char *path, std::vector<PlannedEntry> &entries, const PortabilityLayer::CombinedTimestamp &ts, const ConversionContext &ctx)
 {
 	FILE *outF = fopen_utf8(path, "wb");
 	if (!outF)
@@ -213,27 +603,20 @@ void ExportZipFile(const char *path, std::vector<PlannedEntry> &entries, const P
 
 	std::vector<PortabilityLayer::ZipCentralDirectoryFileHeader> cdirRecords;
 
-	// Why does OMP require signed indexes?  When do I ever want negative iterations?  Uggghh.
-	int numEntries = entries.size();
-
-#pragma omp parallel for
-	for (int i = 0; i < numEntries; i++)
+	WorkPool::JobGroup deflateJobs;
+	for (PlannedEntry &entry : entries)
 	{
-		PlannedEntry &entry = entries[i];
-
-		if (entry.m_uncompressedContents.size() > 0)
-		{
-			if (!TryDeflate(entry.m_uncompressedContents, entry.m_compressedContents))
-				entry.m_compressedContents.resize(0);
-
-			if (entry.m_compressedContents.size() >= entry.m_uncompressedContents.size())
-				entry.m_compressedContents.resize(0);
-		}
+		PlannedEntry *entryPtr = &entry;
+		ConversionStats *stats = ctx.m_stats;
+		ctx.m_pool->Submit(deflateJobs, [entryPtr, stats]() { DeflateEntry(*entryPtr, stats); });
 	}
+	ctx.m_pool->Wait(deflateJobs);
+
+	const std::chrono::steady_clock::time_point writeStartTime = std::chrono::steady_clock::now();
 
 	for (const PlannedEntry &entry : entries)
 	{
-		bool isCompressed = entry.m_compressedContents.size() != 0;
+		bool isCompressed = entry.m_isReused ? entry.m_reusedIsCompressed : (entry.m_compressedContents.size() != 0);
 
 		PortabilityLayer::ZipCentralDirectoryFileHeader cdirHeader;
 
@@ -251,13 +634,23 @@ void ExportZipFile(const char *path, std::vector<PlannedEntry> &entries, const P
 		else if (isCompressed)
 			cdirHeader.m_versionRequired = PortabilityLayer::ZipConstants::kCompressedRequiredVersion;
 
-		if (entry.m_uncompressedContents.size() > 0)
-			cdirHeader.m_crc = crc32(0, &entry.m_uncompressedContents[0], static_cast<uint32_t>(entry.m_uncompressedContents.size()));
+		if (entry.m_isReused)
+		{
+			cdirHeader.m_crc = entry.m_reusedCRC;
+			cdirHeader.m_compressedSize = static_cast<uint32_t>(entry.m_compressedContents.size());
+			cdirHeader.m_uncompressedSize = entry.m_reusedUncompressedSize;
+		}
+		else
+		{
+			if (entry.m_uncompressedContents.size() > 0)
+				cdirHeader.m_crc = crc32(0, &entry.m_uncompressedContents[0], static_cast<uint32_t>(entry.m_uncompressedContents.size()));
+
+			cdirHeader.m_compressedSize = static_cast<uint32_t>(isCompressed ? entry.m_compressedContents.size() : entry.m_uncompressedContents.size());
+			cdirHeader.m_uncompressedSize = static_cast<uint32_t>(entry.m_uncompressedContents.size());
+		}
 
-		cdirHeader.m_compressedSize = static_cast<uint32_t>(isCompressed ? entry.m_compressedContents.size() : entry.m_uncompressedContents.size());
-		cdirHeader.m_uncompressedSize = static_cast<uint32_t>(entry.m_uncompressedContents.size());
 		cdirHeader.m_fileNameLength = static_cast<uint32_t>(entry.m_name.size());
-		cdirHeader.m_extraFieldLength = 0;
+		cdirHeader.m_extraFieldLength = static_cast<uint16_t>((ctx.m_incremental && entry.m_haveSourceHash) ? kSourceHashExtraFieldSize : 0);
 		cdirHeader.m_commentLength = static_cast<uint32_t>(entry.m_comment.size());
 		cdirHeader.m_diskNumber = 0;
 		cdirHeader.m_internalAttributes = 0;
@@ -284,8 +677,11 @@ void ExportZipFile(const char *path, std::vector<PlannedEntry> &entries, const P
 
 		fwrite(entry.m_name.c_str(), 1, entry.m_name.size(), outF);
 
-		if (isCompressed)
-			fwrite(&entry.m_compressedContents[0], 1, entry.m_compressedContents.size(), outF);
+		if (isCompressed || entry.m_isReused)
+		{
+			if (entry.m_compressedContents.size() > 0)
+				fwrite(&entry.m_compressedContents[0], 1, entry.m_compressedContents.size(), outF);
+		}
 		else if (entry.m_uncompressedContents.size() > 0)
 			fwrite(&entry.m_uncompressedContents[0], 1, entry.m_uncompressedContents.size(), outF);
 	}
@@ -296,6 +692,14 @@ void ExportZipFile(const char *path, std::vector<PlannedEntry> &entries, const P
 	{
 		fwrite(&cdirRecords[i], 1, sizeof(PortabilityLayer::ZipCentralDirectoryFileHeader), outF);
 		fwrite(entries[i].m_name.c_str(), 1, entries[i].m_name.size(), outF);
+
+		if (cdirRecords[i].m_extraFieldLength != 0)
+		{
+			uint8_t extraField[kSourceHashExtraFieldSize];
+			EncodeSourceHashExtraField(entries[i].m_sourceHash, extraField);
+			fwrite(extraField, 1, kSourceHashExtraFieldSize, outF);
+		}
+
 		fwrite(entries[i].m_comment.c_str(), 1, entries[i].m_comment.size(), outF);
 	}
 
@@ -314,7 +718,11 @@ void ExportZipFile(const char *path, std::vector<PlannedEntry> &entries, const P
 
 	fwrite(&endRecord, 1, sizeof(endRecord), outF);
 
+	const long archiveSize = ftell(outF);
+
 	fclose(outF);
+
+	ctx.m_stats->Record(ConversionStages::kWrite, static_cast<uint64_t>(archiveSize), static_cast<uint64_t>(archiveSize), writeStartTime);
 }
 
 
@@ -2310,6 +2718,9 @@ bool ApplyPatch(const std::vector<uint8_t> &patchFileContents, std::vector<Plann
 			}
 
 			entry->m_isDirectory = false;
+			entry->m_haveSourceHash = false;
+			entry->m_isReused = false;
+			entry->m_compressedContents.clear();
 			entry->m_uncompressedContents.clear();
 			ReadFileToVector(f, entry->m_uncompressedContents);
 			fclose(f);
@@ -2358,8 +2769,181 @@ bool ContainsName(const std::vector<std::string> &names, const char *name)
 	return false;
 }
 
-int ConvertSingleFile(const char *resPath, const PortabilityLayer::CombinedTimestamp &ts, FILE *patchF, const char *dumpqtDir, const char *outPath)
+bool LoadPreviousArchive(const char *path, PreviousArchive &outArchive)
 {
+	FILE *f = fopen_utf8(path, "rb");
+	if (!f)
+		return false;
+
+	ReadFileToVector(f, outArchive.m_contents);
+	fclose(f);
+
+	const std::vector<uint8_t> &contents = outArchive.m_contents;
+	const size_t archiveSize = contents.size();
+
+	// Archives written by this tool have no comment, so the end of central directory record is always last
+	if (archiveSize < sizeof(PortabilityLayer::ZipEndOfCentralDirectoryRecord))
+		return false;
+
+	PortabilityLayer::ZipEndOfCentralDirectoryRecord endRecord;
+	memcpy(&endRecord, &contents[archiveSize - sizeof(endRecord)], sizeof(endRecord));
+
+	if (endRecord.m_signature != PortabilityLayer::ZipEndOfCentralDirectoryRecord::kSignature || endRecord.m_commentLength != 0)
+		return false;
+
+	const size_t cdirStart = endRecord.m_centralDirStartOffset;
+	const size_t cdirSize = endRecord.m_centralDirectorySizeBytes;
+	if (cdirStart > archiveSize - sizeof(endRecord) || cdirSize > archiveSize - sizeof(endRecord) - cdirStart)
+		return false;
+
+	size_t cdirPos = cdirStart;
+	const size_t cdirEnd = cdirStart + cdirSize;
+	const size_t numRecords = endRecord.m_numCentralDirRecords;
+
+	for (size_t i = 0; i < numRecords; i++)
+	{
+		PortabilityLayer::ZipCentralDirectoryFileHeader cdirHeader;
+		if (cdirEnd - cdirPos < sizeof(cdirHeader))
+			return false;
+
+		memcpy(&cdirHeader, &contents[cdirPos], sizeof(cdirHeader));
+		cdirPos += sizeof(cdirHeader);
+
+		if (cdirHeader.m_signature != PortabilityLayer::ZipCentralDirectoryFileHeader::kSignature)
+			return false;
+
+		const size_t nameLength = cdirHeader.m_fileNameLength;
+		const size_t extraLength = cdirHeader.m_extraFieldLength;
+		const size_t commentLength = cdirHeader.m_commentLength;
+		if (cdirEnd - cdirPos < nameLength + extraLength + commentLength)
+			return false;
+
+		const std::string name(reinterpret_cast<const char*>(&contents[0] + cdirPos), nameLength);
+		const uint8_t *extraData = &contents[0] + cdirPos + nameLength;
+		cdirPos += nameLength + extraLength + commentLength;
+
+		uint64_t sourceHash = 0;
+		if (!DecodeSourceHashExtraField(extraData, extraLength, sourceHash))
+			continue;
+
+		PortabilityLayer::ZipFileLocalHeader localHeader;
+		const size_t localHeaderPos = cdirHeader.m_localHeaderOffset;
+		if (localHeaderPos > cdirStart || cdirStart - localHeaderPos < sizeof(localHeader))
+			return false;
+
+		memcpy(&localHeader, &contents[localHeaderPos], sizeof(localHeader));
+		if (localHeader.m_signature != PortabilityLayer::ZipFileLocalHeader::kSignature)
+			return false;
+
+		const size_t dataOffset = localHeaderPos + sizeof(localHeader) + localHeader.m_fileNameLength + localHeader.m_extraFieldLength;
+		const size_t dataSize = cdirHeader.m_compressedSize;
+		if (dataOffset > cdirStart || dataSize > cdirStart - dataOffset)
+			return false;
+
+		PreviousArchiveEntry &prevEntry = outArchive.m_entries[name];
+		prevEntry.m_sourceHash = sourceHash;
+		prevEntry.m_isCompressed = (cdirHeader.m_method == PortabilityLayer::ZipConstants::kDeflatedMethod);
+		prevEntry.m_crc = cdirHeader.m_crc;
+		prevEntry.m_uncompressedSize = cdirHeader.m_uncompressedSize;
+		prevEntry.m_dataOffset = dataOffset;
+		prevEntry.m_dataSize = dataSize;
+	}
+
+	return true;
+}
+
+bool TryReusePreviousEntry(const PreviousArchive &prevArchive, PlannedEntry &entry)
+{
+	std::map<std::string, PreviousArchiveEntry>::const_iterator it = prevArchive.m_entries.find(entry.m_name);
+	if (it == prevArchive.m_entries.end() || it->second.m_sourceHash != entry.m_sourceHash)
+		return false;
+
+	const PreviousArchiveEntry &prevEntry = it->second;
+
+	entry.m_isReused = true;
+	entry.m_reusedIsCompressed = prevEntry.m_isCompressed;
+	entry.m_reusedCRC = prevEntry.m_crc;
+	entry.m_reusedUncompressedSize = prevEntry.m_uncompressedSize;
+
+	const uint8_t *data = &prevArchive.m_contents[0] + prevEntry.m_dataOffset;
+	entry.m_compressedContents.assign(data, data + prevEntry.m_dataSize);
+
+	return true;
+}
+
+namespace ResourceImportKinds
+{
+	enum ResourceImportKind
+	{
+		kPICT,
+		kSound,
+		kIndexedString,
+		kDialogItemTemplate,
+		kIcon,
+		kRaw,
+	};
+}
+
+typedef ResourceImportKinds::ResourceImportKind ResourceImportKind_t;
+
+struct ResourceImportJob
+{
+	ResourceImportKind_t m_kind;
+	const void *m_resData;
+	size_t m_resSize;
+	int m_resID;
+
+	uint8_t m_iconWidth;
+	uint8_t m_iconHeight;
+	uint8_t m_iconBpp;
+
+	size_t m_entryIndex;
+	bool m_succeeded;
+};
+
+void RunResourceImportJob(ResourceImportJob &job, PlannedEntry &entry, const char *dumpqtDir, ConversionStats *stats)
+{
+	const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+	ConversionStage_t stage = ConversionStages::kOther;
+
+	switch (job.m_kind)
+	{
+	case ResourceImportKinds::kPICT:
+		stage = ConversionStages::kPICT;
+		job.m_succeeded = ImportPICT(entry.m_uncompressedContents, job.m_resData, job.m_resSize, dumpqtDir, job.m_resID);
+		break;
+	case ResourceImportKinds::kSound:
+		stage = ConversionStages::kSound;
+		job.m_succeeded = ImportSound(entry.m_uncompressedContents, job.m_resData, job.m_resSize, job.m_resID);
+		break;
+	case ResourceImportKinds::kIndexedString:
+		job.m_succeeded = ImportIndexedString(entry.m_uncompressedContents, job.m_resData, job.m_resSize);
+		break;
+	case ResourceImportKinds::kDialogItemTemplate:
+		job.m_succeeded = ImportDialogItemTemplate(entry.m_uncompressedContents, job.m_resData, job.m_resSize);
+		break;
+	case ResourceImportKinds::kIcon:
+		job.m_succeeded = ImportIcon(entry.m_uncompressedContents, job.m_resData, job.m_resSize, job.m_iconWidth, job.m_iconHeight, job.m_iconBpp);
+		break;
+	case ResourceImportKinds::kRaw:
+		entry.m_uncompressedContents.resize(job.m_resSize);
+		if (job.m_resSize > 0)
+			memcpy(&entry.m_uncompressedContents[0], job.m_resData, job.m_resSize);
+		job.m_succeeded = true;
+		break;
+	default:
+		job.m_succeeded = false;
+		break;
+	}
+
+	stats->Record(stage, job.m_resSize, entry.m_uncompressedContents.size(), startTime);
+}
+
+int ConvertSingleFile(const char *resPath, const PortabilityLayer::CombinedTimestamp &ts, FILE *patchF, const char *dumpqtDir, const char *outPath, const ConversionContext &ctx)
+{
+	const std::chrono::steady_clock::time_point loadStartTime = std::chrono::steady_clock::now();
+
 	FILE *inF = fopen_utf8(resPath, "rb");
 	if (!inF)
 	{
@@ -2379,17 +2963,25 @@ int ConvertSingleFile(const char *resPath, const PortabilityLayer::CombinedTimes
 
 	PortabilityLayer::CFileStream cfs(inF);
 
-	GpDriverCollection *drivers = PLDrivers::GetDriverCollection();
-	drivers->SetDriver<GpDriverIDs::kAlloc>(GpAllocator_C::GetInstance());
+	PortabilityLayer::ResourceFile *resFile = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(gs_resourceFileMutex);
 
-	PortabilityLayer::ResourceFile *resFile = PortabilityLayer::ResourceFile::Create();
-	resFile->Load(&cfs);
+		resFile = PortabilityLayer::ResourceFile::Create();
+		resFile->Load(&cfs);
+	}
+
+	ctx.m_stats->Record(ConversionStages::kLoad, cfs.Size(), cfs.Size(), loadStartTime);
 
 	PortabilityLayer::ResourceCompiledTypeList *typeLists = nullptr;
 	size_t typeListCount = 0;
 	resFile->GetAllResourceTypeLists(typeLists, typeListCount);
 
 	std::vector<PlannedEntry> contents;
+	std::vector<ResourceImportJob> importJobs;
+
+	PreviousArchive prevArchive;
+	const bool havePrevArchive = ctx.m_incremental && LoadPreviousArchive(outPath, prevArchive);
 
 	const PortabilityLayer::ResTypeID pictTypeID = PortabilityLayer::ResTypeID('PICT');
 	const PortabilityLayer::ResTypeID dateTypeID = PortabilityLayer::ResTypeID('Date');
@@ -2423,6 +3015,7 @@ int ConvertSingleFile(const char *resPath, const PortabilityLayer::CombinedTimes
 			return -1;
 	}
 
+	// Plan the entries in resource order first, then import them on the pool
 	for (size_t tlIndex = 0; tlIndex < typeListCount; tlIndex++)
 	{
 		const PortabilityLayer::ResourceCompiledTypeList &typeList = typeLists[tlIndex];
@@ -2453,124 +3046,136 @@ int ConvertSingleFile(const char *resPath, const PortabilityLayer::CombinedTimes
 				resComment = std::string(reinterpret_cast<const char*>(pstrStart + 1), pstrStart[0]);
 			}
 
-			if (typeList.m_resType == pictTypeID || typeList.m_resType == dateTypeID)
-			{
-				std::string resName = (
-					std::ostringstream() << resTag.m_id << '/' << res.m_resID << ".bmp"
-				).str();
-
-				if (ContainsName(reservedNames, resName.c_str()))
-					continue;
+			ResourceImportJob job;
+			job.m_resData = resData;
+			job.m_resSize = resSize;
+			job.m_resID = res.m_resID;
+			job.m_iconWidth = 0;
+			job.m_iconHeight = 0;
+			job.m_iconBpp = 0;
+			job.m_succeeded = false;
 
-				PlannedEntry entry;
-				entry.m_name = std::move(resName);
-				entry.m_comment = resComment;
+			const char *extension = nullptr;
 
-				if (ImportPICT(entry.m_uncompressedContents, resData, resSize, dumpqtDir, res.m_resID))
-					contents.push_back(entry);
-				else
-					fprintf(stderr, "Failed to import PICT res %i\n", static_cast<int>(res.m_resID));
+			if (typeList.m_resType == pictTypeID || typeList.m_resType == dateTypeID)
+			{
+				job.m_kind = ResourceImportKinds::kPICT;
+				extension = ".bmp";
 			}
 			else if (typeList.m_resType == sndTypeID)
 			{
-				std::string resName = (
-					std::ostringstream() << resTag.m_id << '/' << res.m_resID << ".wav"
-				).str();
-
-				if (ContainsName(reservedNames, resName.c_str()))
-					continue;
-
-				PlannedEntry entry;
-				entry.m_name = std::move(resName);
-				entry.m_comment = resComment;
-
-				if (ImportSound(entry.m_uncompressedContents, resData, resSize, res.m_resID))
-					contents.push_back(entry);
-				else
-					fprintf(stderr, "Failed to import snd res %i\n", static_cast<int>(res.m_resID));
+				job.m_kind = ResourceImportKinds::kSound;
+				extension = ".wav";
 			}
 			else if (typeList.m_resType == indexStringTypeID)
 			{
-				std::string resName = (
-					std::ostringstream() << resTag.m_id << '/' << res.m_resID << ".txt"
-				).str();
-
-				if (ContainsName(reservedNames, resName.c_str()))
-					continue;
-
-				PlannedEntry entry;
-				entry.m_name = std::move(resName);
-				entry.m_comment = resComment;
-
-				if (ImportIndexedString(entry.m_uncompressedContents, resData, resSize))
-					contents.push_back(entry);
+				job.m_kind = ResourceImportKinds::kIndexedString;
+				extension = ".txt";
 			}
 			else if (typeList.m_resType == ditlTypeID)
 			{
-				std::string resName = (
-					std::ostringstream() << resTag.m_id << '/' << res.m_resID << ".json"
-				).str();
-
-				if (ContainsName(reservedNames, resName.c_str()))
-					continue;
-
-				PlannedEntry entry;
-				entry.m_name = std::move(resName);
-				entry.m_comment = resComment;
-
-				if (ImportDialogItemTemplate(entry.m_uncompressedContents, resData, resSize))
-					contents.push_back(entry);
+				job.m_kind = ResourceImportKinds::kDialogItemTemplate;
+				extension = ".json";
 			}
 			else
 			{
-				bool isIcon = false;
+				job.m_kind = ResourceImportKinds::kRaw;
+				extension = ".bin";
 
 				for (int i = 0; i < sizeof(iconTypeSpecs) / sizeof(iconTypeSpecs[0]); i++)
 				{
 					const IconTypeSpec &iconSpec = iconTypeSpecs[i];
 					if (typeList.m_resType == iconSpec.m_resTypeID)
 					{
-						std::string resName = (
+						std::string iconResName = (
 							std::ostringstream() << resTag.m_id << '/' << res.m_resID << ".bmp"
 						).str();
 
-						if (!ContainsName(reservedNames, resName.c_str()))
+						if (!ContainsName(reservedNames, iconResName.c_str()))
 						{
-							isIcon = true;
-
-							PlannedEntry entry;
-							entry.m_name = std::move(resName);
-							entry.m_comment = resComment;
-
-							if (ImportIcon(entry.m_uncompressedContents, resData, resSize, iconSpec.m_width, iconSpec.m_height, iconSpec.m_bpp))
-								contents.push_back(entry);
-
+							job.m_kind = ResourceImportKinds::kIcon;
+							job.m_iconWidth = iconSpec.m_width;
+							job.m_iconHeight = iconSpec.m_height;
+							job.m_iconBpp = iconSpec.m_bpp;
+							extension = ".bmp";
 							break;
 						}
 					}
 				}
+			}
 
-				if (!isIcon)
-				{
-					std::string resName = (
-						std::ostringstream() << resTag.m_id << '/' << res.m_resID << ".bin"
-					).str();
-
-					if (ContainsName(reservedNames, resName.c_str()))
-						continue;
+			std::string resName = (
+				std::ostringstream() << resTag.m_id << '/' << res.m_resID << extension
+			).str();
 
-					PlannedEntry entry;
+			if (ContainsName(reservedNames, resName.c_str()))
+				continue;
 
-					entry.m_name = std::move(resName);
-					entry.m_comment = resComment;
-					entry.m_uncompressedContents.resize(res.GetSize());
+			PlannedEntry entry;
+			entry.m_name = std::move(resName);
+			entry.m_comment = resComment;
 
-					memcpy(&entry.m_uncompressedContents[0], resData, resSize);
+			if (ctx.m_incremental)
+			{
+				entry.m_sourceHash = HashSourceResource(typeList.m_resType, res.m_resID, resData, resSize);
+				entry.m_haveSourceHash = true;
+			}
 
-					contents.push_back(entry);
-				}
+			if (havePrevArchive && TryReusePreviousEntry(prevArchive, entry))
+				ctx.m_stats->m_numReusedEntries++;
+			else
+			{
+				job.m_entryIndex = contents.size();
+				importJobs.push_back(job);
 			}
+
+			contents.push_back(std::move(entry));
+		}
+	}
+
+	{
+		WorkPool::JobGroup importJobGroup;
+		for (ResourceImportJob &job : importJobs)
+		{
+			ResourceImportJob *jobPtr = &job;
+			PlannedEntry *entryPtr = &contents[job.m_entryIndex];
+			ConversionStats *stats = ctx.m_stats;
+			ctx.m_pool->Submit(importJobGroup, [jobPtr, entryPtr, dumpqtDir, stats]() { RunResourceImportJob(*jobPtr, *entryPtr, dumpqtDir, stats); });
 		}
+		ctx.m_pool->Wait(importJobGroup);
+	}
+
+	// Drop entries that failed to import, keeping the rest in order
+	if (importJobs.size() > 0)
+	{
+		std::vector<bool> failedEntries;
+		failedEntries.resize(contents.size(), false);
+
+		for (const ResourceImportJob &job : importJobs)
+		{
+			if (job.m_succeeded)
+				continue;
+
+			failedEntries[job.m_entryIndex] = true;
+
+			if (job.m_kind == ResourceImportKinds::kPICT)
+				fprintf(stderr, "Failed to import PICT res %i\n", job.m_resID);
+			else if (job.m_kind == ResourceImportKinds::kSound)
+				fprintf(stderr, "Failed to import snd res %i\n", job.m_resID);
+		}
+
+		size_t numKept = 0;
+		for (size_t i = 0; i < contents.size(); i++)
+		{
+			if (failedEntries[i])
+				continue;
+
+			if (numKept != i)
+				contents[numKept] = std::move(contents[i]);
+			numKept++;
+		}
+
+		contents.resize(numKept);
 	}
 
 	cfs.Close();
@@ -2583,18 +3188,32 @@ int ConvertSingleFile(const char *resPath, const PortabilityLayer::CombinedTimes
 
 	std::sort(contents.begin(), contents.end(), EntryAlphaSortPredicate);
 
-	ExportZipFile(outPath, contents, ts);
+	ExportZipFile(outPath, contents, ts, ctx);
+
+	{
+		std::lock_guard<std::mutex> lock(gs_resourceFileMutex);
+		resFile->Destroy();
+	}
 
-	resFile->Destroy();
+	ctx.m_stats->m_numFiles++;
 
 	return 0;
 }
 
-int ConvertDirectory(const std::string &basePath, const PortabilityLayer::CombinedTimestamp &ts)
+struct DirectoryConversionItem
+{
+	std::string m_resPath;
+	std::string m_houseArchivePath;
+	int m_returnCode;
+};
+
+int ConvertDirectory(const std::string &basePath, const PortabilityLayer::CombinedTimestamp &ts, const ConversionContext &ctx)
 {
 	std::vector<std::string> paths;
 	ScanDirectoryForExtension(paths, basePath.c_str(), ".gpr", true);
 
+	std::vector<DirectoryConversionItem> items;
+
 	for (std::vector<std::string>::const_iterator it = paths.begin(), itEnd = paths.end(); it != itEnd; ++it)
 	{
 		const std::string &resPath = *it;
@@ -2627,19 +3246,53 @@ int ConvertDirectory(const std::string &basePath, const PortabilityLayer::Combin
 
 		if (mfp.m_fileType[0] == 'g' && mfp.m_fileType[1] == 'l' && mfp.m_fileType[2] == 'i' && mfp.m_fileType[3] == 'H')
 		{
-			std::string houseArchivePath = (housePathBase + ".gpa");
-			fprintf(stdout, "Importing ");
-			fputs_utf8(houseArchivePath.c_str(), stdout);
-			fprintf(stdout, "\n");
+			DirectoryConversionItem item;
+			item.m_resPath = resPath;
+			item.m_houseArchivePath = (housePathBase + ".gpa");
+			item.m_returnCode = 0;
+
+			items.push_back(item);
+		}
+	}
+
+	// Houses are converted concurrently, and each one also queues its own imports and deflates on the pool
+	std::atomic<bool> aborted(false);
+
+	WorkPool::JobGroup houseJobs;
+	for (DirectoryConversionItem &item : items)
+	{
+		DirectoryConversionItem *itemPtr = &item;
+		std::atomic<bool> *abortedPtr = &aborted;
+		const PortabilityLayer::CombinedTimestamp *tsPtr = &ts;
+		const ConversionContext *ctxPtr = &ctx;
+
+		ctx.m_pool->Submit(houseJobs, [itemPtr, abortedPtr, tsPtr, ctxPtr]()
+		{
+			if (*abortedPtr)
+				return;
 
-			int returnCode = ConvertSingleFile(resPath.c_str(), ts, nullptr, nullptr, houseArchivePath.c_str());
-			if (returnCode)
 			{
-				fprintf(stderr, "An error occurred while converting\n");
-				fputs_utf8(resPath.c_str(), stderr);
-				fprintf(stderr, "\n");
-				return returnCode;
+				std::lock_guard<std::mutex> lock(gs_consoleMutex);
+				fprintf(stdout, "Importing ");
+				fputs_utf8(itemPtr->m_houseArchivePath.c_str(), stdout);
+				fprintf(stdout, "\n");
 			}
+
+			itemPtr->m_returnCode = ConvertSingleFile(itemPtr->m_resPath.c_str(), *tsPtr, nullptr, nullptr, itemPtr->m_houseArchivePath.c_str(), *ctxPtr);
+			if (itemPtr->m_returnCode)
+				*abortedPtr = true;
+		});
+	}
+	ctx.m_pool->Wait(houseJobs);
+
+	for (const DirectoryConversionItem &item : items)
+	{
+		if (item.m_returnCode)
+		{
+			fprintf(stderr, "An error occurred while converting\n");
+			fputs_utf8(item.m_resPath.c_str(), stderr);
+			fprintf(stderr, "\n");
+			return item.m_returnCode;
 		}
 	}
 
@@ -2649,13 +3302,18 @@ int ConvertDirectory(const std::string &basePath, const PortabilityLayer::Combin
 int PrintUsage()
 {
 	fprintf(stderr, "Usage: gpr2gpa <input.gpr> <input.ts> <output.gpa> [options]\n");
-	fprintf(stderr, "       gpr2gpa <input dir>\\* <input.ts>\n");
-	fprintf(stderr, "       gpr2gpa <input dir>/* <input.ts>\n");
-	fprintf(stderr, "       gpr2gpa * <input.ts>\n");
+	fprintf(stderr, "       gpr2gpa <input dir>\\* <input.ts> [options]\n");
+	fprintf(stderr, "       gpr2gpa <input dir>/* <input.ts> [options]\n");
+	fprintf(stderr, "       gpr2gpa * <input.ts> [options]\n");
 	fprintf(stderr, "\n");
 	fprintf(stderr, "Options:\n");
 	fprintf(stderr, "       -patch patch.json\n");
 	fprintf(stderr, "       -dumpqt <temp dir>\n");
+	fprintf(stderr, "       -j <threads>        Number of threads to convert with, 0 for one per core (default 1)\n");
+	fprintf(stderr, "       -incremental        Reuse entries from the existing output if their source is unchanged\n");
+	fprintf(stderr, "       -stats              Print throughput for each conversion stage\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "-patch and -dumpqt are only available when converting a single file.\n");
 
 	return -1;
 }
@@ -2683,53 +3341,111 @@ int toolMain(int argc, const char **argv)
 
 	std::string base = argv[1];
 
-	if (base == "*")
-		return ConvertDirectory(".", ts);
+	bool isDirectoryMode = false;
+	std::string directoryPath;
 
-	if (base.length() >= 2)
+	if (base == "*")
+	{
+		isDirectoryMode = true;
+		directoryPath = ".";
+	}
+	else if (base.length() >= 2)
 	{
 		std::string baseEnding = base.substr(base.length() - 2, 2);
 		if (baseEnding == "\\*" || baseEnding == "/*")
-			return ConvertDirectory(base.substr(0, base.length() - 2), ts);
+		{
+			isDirectoryMode = true;
+			directoryPath = base.substr(0, base.length() - 2);
+		}
 	}
 
+	if (!isDirectoryMode && argc < 4)
+		return PrintUsage();
+
 	const char *dumpqtPath = nullptr;
 	FILE *patchF = nullptr;
-	if (argc > 4)
+	unsigned int numThreads = 1;
+	bool incremental = false;
+	bool printStats = false;
+
+	for (int optArgIndex = isDirectoryMode ? 3 : 4; optArgIndex < argc; )
 	{
-		for (int optArgIndex = 4; optArgIndex < argc; )
+		const char *optArg = argv[optArgIndex++];
+		if (!strcmp(optArg, "-patch") && !isDirectoryMode)
 		{
-			const char *optArg = argv[optArgIndex++];
-			if (!strcmp(optArg, "-patch"))
-			{
-				if (optArgIndex == argc)
-					return PrintUsage();
-
-				if (patchF != nullptr)
-				{
-					fprintf(stderr, "Already specified patch file");
-					return -1;
-				}
+			if (optArgIndex == argc)
+				return PrintUsage();
 
-				const char *patchPath = argv[optArgIndex++];
-				patchF = fopen_utf8(patchPath, "rb");
-				if (!patchF)
-				{
-					fprintf(stderr, "Error reading patch file");
-					return -1;
-				}
-			}
-			else if (!strcmp(optArg, "-dumpqt"))
+			if (patchF != nullptr)
 			{
-				if (optArgIndex == argc)
-					return PrintUsage();
+				fprintf(stderr, "Already specified patch file");
+				return -1;
+			}
 
-				dumpqtPath = argv[optArgIndex++];
+			const char *patchPath = argv[optArgIndex++];
+			patchF = fopen_utf8(patchPath, "rb");
+			if (!patchF)
+			{
+				fprintf(stderr, "Error reading patch file");
+				return -1;
 			}
-			else
+		}
+		else if (!strcmp(optArg, "-dumpqt") && !isDirectoryMode)
+		{
+			if (optArgIndex == argc)
+				return PrintUsage();
+
+			dumpqtPath = argv[optArgIndex++];
+		}
+		else if (!strcmp(optArg, "-j"))
+		{
+			if (optArgIndex == argc)
+				return PrintUsage();
+
+			const int requestedThreads = atoi(argv[optArgIndex++]);
+			if (requestedThreads < 0)
 				return PrintUsage();
+
+			numThreads = static_cast<unsigned int>(requestedThreads);
+			if (numThreads == 0)
+				numThreads = std::max(std::thread::hardware_concurrency(), 1u);
 		}
+		else if (!strcmp(optArg, "-incremental"))
+			incremental = true;
+		else if (!strcmp(optArg, "-stats"))
+			printStats = true;
+		else
+			return PrintUsage();
+	}
+
+	// Set before any workers start, since the resource loader allocates through it
+	GpDriverCollection *drivers = PLDrivers::GetDriverCollection();
+	drivers->SetDriver<GpDriverIDs::kAlloc>(GpAllocator_C::GetInstance());
+
+	const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+	ConversionStats stats;
+	int returnCode = 0;
+
+	{
+		WorkPool pool(numThreads);
+
+		ConversionContext ctx;
+		ctx.m_pool = &pool;
+		ctx.m_stats = &stats;
+		ctx.m_incremental = incremental;
+
+		if (isDirectoryMode)
+			returnCode = ConvertDirectory(directoryPath, ts, ctx);
+		else
+			returnCode = ConvertSingleFile(argv[1], ts, patchF, dumpqtPath, argv[3], ctx);
+	}
+
+	if (printStats)
+	{
+		const std::chrono::steady_clock::duration wallTime = std::chrono::steady_clock::now() - startTime;
+		stats.Print(stdout, std::chrono::duration_cast<std::chrono::duration<double> >(wallTime).count());
 	}
 
-	return ConvertSingleFile(argv[1], ts, patchF, dumpqtPath, argv[3]);
+	return returnCode;
 }